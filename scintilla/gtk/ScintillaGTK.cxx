@@ -655,7 +655,7 @@ void ScintillaGTK::Init() {
 		caret.period = 0;
 	}
 
-	for (TickReason tr = tickCaret; tr <= tickDwell; tr = static_cast<TickReason>(tr + 1)) {
+	for (TickReason tr = tickCaret; tr <= tickStyle; tr = static_cast<TickReason>(tr + 1)) {
 		timers[tr].reason = tr;
 		timers[tr].scintilla = this;
 	}
@@ -666,7 +666,7 @@ void ScintillaGTK::Init() {
 }
 
 void ScintillaGTK::Finalise() {
-	for (TickReason tr = tickCaret; tr <= tickDwell; tr = static_cast<TickReason>(tr + 1)) {
+	for (TickReason tr = tickCaret; tr <= tickStyle; tr = static_cast<TickReason>(tr + 1)) {
 		FineTickerCancel(tr);
 	}
 	if (accessible) {
@@ -45,6 +45,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_START 2000
 #define SCI_OPTIONAL_START 3000
 #define SCI_LEXER_START 4000
+#define SCI_GEANY_START 9000
 #define SCI_ADDTEXT 2001
 #define SCI_ADDSTYLEDTEXT 2002
 #define SCI_INSERTTEXT 2003
@@ -419,6 +420,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCFIND_REGEXP 0x00200000
 #define SCFIND_POSIX 0x00400000
 #define SCFIND_CXX11REGEX 0x00800000
+#define SCFIND_LINEARREGEX 0x01000000
 #define SCI_FINDTEXT 2150
 #define SCI_FORMATRANGE 2151
 #define SCI_GETFIRSTVISIBLELINE 2152
@@ -446,6 +448,10 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_CANPASTE 2173
 #define SCI_CANUNDO 2174
 #define SCI_EMPTYUNDOBUFFER 2175
+#define SCI_SETUNDOMEMORYLIMIT 9000
+#define SCI_GETUNDOMEMORYLIMIT 9001
+#define SCI_GETUNDOMEMORY 9002
+#define SCI_DISCARDSAVEPOINT 9007
 #define SCI_UNDO 2176
 #define SCI_CUT 2177
 #define SCI_COPY 2178
@@ -551,6 +557,8 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SC_IDLESTYLING_ALL 3
 #define SCI_SETIDLESTYLING 2692
 #define SCI_GETIDLESTYLING 2693
+#define SCI_SETBACKGROUNDSTYLING 9003
+#define SCI_GETBACKGROUNDSTYLING 9004
 #define SC_WRAP_NONE 0
 #define SC_WRAP_WORD 1
 #define SC_WRAP_CHAR 2
@@ -720,6 +728,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SC_DOCUMENTOPTION_DEFAULT 0
 #define SC_DOCUMENTOPTION_STYLES_NONE 0x1
 #define SC_DOCUMENTOPTION_TEXT_LARGE 0x100
+#define SC_DOCUMENTOPTION_TEXT_CHUNKED 0x200
 #define SCI_CREATEDOCUMENT 2375
 #define SCI_ADDREFDOCUMENT 2376
 #define SCI_RELEASEDOCUMENT 2377
@@ -870,6 +879,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_GETCHARACTERPOINTER 2520
 #define SCI_GETRANGEPOINTER 2643
 #define SCI_GETGAPPOSITION 2644
+#define SCI_RELEASECHARACTERPOINTER 9008
 #define SCI_INDICSETALPHA 2523
 #define SCI_INDICGETALPHA 2524
 #define SCI_INDICSETOUTLINEALPHA 2558
@@ -1026,6 +1036,8 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_SETLEXER 4001
 #define SCI_GETLEXER 4002
 #define SCI_COLOURISE 4003
+#define SCI_SETLEXINGTHREADS 9005
+#define SCI_GETLEXINGTHREADS 9006
 #define SCI_SETPROPERTY 4004
 #define KEYWORDSET_MAX 8
 #define SCI_SETKEYWORDS 4005
@@ -59,6 +59,10 @@ int LexerModule::GetLanguage() const noexcept {
 	return language;
 }
 
+bool LexerModule::HasFactory() const noexcept {
+	return fnFactory != nullptr;
+}
+
 int LexerModule::GetNumWordLists() const noexcept {
 	if (!wordListDescriptions) {
 		return -1;
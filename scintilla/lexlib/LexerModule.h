@@ -50,6 +50,7 @@ public:
 		const char *languageName_,
 		const char * const wordListDescriptions_[]=nullptr) noexcept;
 	int GetLanguage() const noexcept;
+	bool HasFactory() const noexcept;
 
 	// -1 is returned if no WordList information is available
 	int GetNumWordLists() const noexcept;
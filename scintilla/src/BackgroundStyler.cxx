@@ -0,0 +1,672 @@
+// Scintilla source code edit control
+/** @file BackgroundStyler.cxx
+ ** Lexing of snapshots of the document on worker threads.
+ **/
+// Copyright 2026 The Geany contributors
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <system_error>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "CharacterCategory.h"
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+#include "BackgroundStyler.h"
+#include "ElapsedPeriod.h"
+
+using namespace Scintilla;
+
+namespace {
+
+// Text copied around the lexed range for lexers looking back or ahead
+constexpr Sci::Position snapshotMargin = 0x10000;
+
+// Lines searched for a likely restart point when splitting a range into chunks
+constexpr Sci::Line restartSearchLines = 200;
+
+// A chunk is most likely to be lexed as when lexing everything before it if it starts with
+// a line without indentation after a blank line, which is often outside of any construct
+// spanning lines. Returns the start of such a line after position if one is near, else the
+// start of the next line, never beyond limit.
+Sci::Position RestartNear(const Document *pdoc, Sci::Position position, Sci::Position limit) {
+	const Sci::Line lineNext = pdoc->SciLineFromPosition(position) + 1;
+	for (Sci::Line line = lineNext; line < lineNext + restartSearchLines; line++) {
+		const Sci::Position lineStart = pdoc->LineStart(line);
+		if (lineStart >= limit) {
+			break;
+		}
+		const char ch = pdoc->CharAt(lineStart);
+		if (ch != ' ' && ch != '\t' && ch != '\r' && ch != '\n' && pdoc->IsWhiteLine(line - 1)) {
+			return lineStart;
+		}
+	}
+	return std::min(pdoc->LineStart(lineNext), limit);
+}
+
+/// Gives the copy of the text the line end types of the document.
+class SnapshotLineEnds : public LexInterface {
+	int lineEndTypes;
+public:
+	SnapshotLineEnds(Document *pdoc_, int lineEndTypes_) noexcept :
+		LexInterface(pdoc_), lineEndTypes(lineEndTypes_) {
+	}
+	int LineEndTypesSupported() override {
+		return lineEndTypes;
+	}
+};
+
+}
+
+namespace Scintilla {
+
+/**
+ * The document as seen by a lexer on the worker thread: a copy of whole lines around the
+ * lexed range. The text is held in a Document of its own, without styles, for its line and
+ * character handling; the styles, fold levels and line states are held in arrays.
+ * Only copying is done on the main thread, the Document is built by Prepare on the worker.
+ * Positions and lines are translated to this copy. Anything beyond the copy sets missed, as
+ * does a call that needs the whole document.
+ */
+class StyleSnapshot : public IDocumentWithLineEnd {
+	std::vector<char> textCopy;
+	bool large;
+	int dbcsCodePage;
+	int tabInChars;
+	int lineEndTypes;
+	std::unique_ptr<Document> text;
+	std::vector<char> styles;
+	std::vector<int> levels;
+	std::vector<int> lineStates;
+	Sci::Position lengthDocument;
+	Sci::Position textStart;
+	Sci::Position textEnd;
+	Sci::Line lineFirst;
+	Sci::Line linesComplete;	///< Lines of the copy with all their text
+	// Folders often look up the line of the document end, so the last two lines are known too
+	Sci::Line lineLast;
+	Sci::Position lineLastStart;
+	Sci::Position linePenultimateStart;
+	std::vector<char> wholeText;
+	// What was read of the state before start, for checking against the document when
+	// merging a chunk lexed in parallel
+	Sci::Position start;
+	Sci::Line lineStart;
+	mutable Sci::Position styleReadFrom;
+	mutable Sci::Line lineReadFrom;
+	mutable Sci::Line lineReadTo;
+	std::vector<char> stylesBefore;
+	std::vector<int> levelsBefore;
+	std::vector<int> lineStatesBefore;
+public:
+	struct Fill {
+		int indicator;
+		Sci::Position position;
+		int value;
+		Sci::Position fillLength;
+	};
+
+	// Results of the lexer to merge into the document
+	Sci::Position styledFrom;
+	Sci::Position styledTo;
+	Sci::Position endStyled;
+	Sci::Line lineChangedFirst;
+	Sci::Line lineChangedLast;
+	std::vector<std::pair<Sci::Position, Sci::Position>> lexerStateChanges;
+	int currentIndicator;
+	std::vector<Fill> fills;
+	int errorStatus;
+	mutable bool missed;
+
+	StyleSnapshot(Document *pdoc, Sci::Position start_, Sci::Position end);
+	// Deleted so StyleSnapshot objects can not be copied.
+	StyleSnapshot(const StyleSnapshot &) = delete;
+	StyleSnapshot(StyleSnapshot &&) = delete;
+	StyleSnapshot &operator=(const StyleSnapshot &) = delete;
+	StyleSnapshot &operator=(StyleSnapshot &&) = delete;
+	virtual ~StyleSnapshot() {
+	}
+
+	bool StartInside(Sci::Position position) const noexcept {
+		return position >= textStart || textStart == 0;
+	}
+	bool EndInside(Sci::Position position) const noexcept {
+		return position <= textEnd || textEnd == lengthDocument;
+	}
+	bool LineStored(Sci::Position line) const noexcept {
+		return line >= lineFirst && line - lineFirst < static_cast<Sci::Line>(levels.size());
+	}
+	bool LineInside(Sci::Position line) const noexcept {
+		return (line >= lineFirst || lineFirst == 0) &&
+			(line < lineFirst + linesComplete || textEnd == lengthDocument);
+	}
+	void Miss() noexcept {
+		missed = true;
+	}
+	void Prepare();
+	void Follow(const StyleSnapshot &previous);
+	void KeepState();
+	int StyleBefore() const noexcept {
+		return (start > textStart) ? styles[start - 1 - textStart] : 0;
+	}
+	bool MatchesDocument(Document *pdoc) const;
+	void Merge(Document *pdoc);
+
+	int SCI_METHOD Version() const override {
+		return dvLineEnd;
+	}
+	void SCI_METHOD SetErrorStatus(int status) override {
+		errorStatus = status;
+	}
+	Sci_Position SCI_METHOD Length() const override {
+		return lengthDocument;
+	}
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override;
+	char SCI_METHOD StyleAt(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position, char mask) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles) override;
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override {
+		currentIndicator = indicator;
+	}
+	void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) override {
+		fills.push_back({currentIndicator, position, value, fillLength});
+	}
+	void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override {
+		lexerStateChanges.emplace_back(start, end);
+	}
+	int SCI_METHOD CodePage() const override {
+		return text->CodePage();
+	}
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override {
+		return text->IsDBCSLeadByte(ch);
+	}
+	const char * SCI_METHOD BufferPointer() override;
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override;
+
+private:
+	void LineRead(Sci::Line line) const noexcept {
+		lineReadFrom = std::min(lineReadFrom, line);
+		lineReadTo = std::max(lineReadTo, line);
+	}
+	void LineChanged(Sci::Line line) noexcept {
+		lineChangedFirst = std::min(lineChangedFirst, line);
+		lineChangedLast = std::max(lineChangedLast, line);
+	}
+};
+
+}
+
+StyleSnapshot::StyleSnapshot(Document *pdoc, Sci::Position start_, Sci::Position end) :
+	lengthDocument(pdoc->Length()),
+	start(start_), lineStart(pdoc->SciLineFromPosition(start_)), styleReadFrom(start_ - 1), lineReadFrom(pdoc->LinesTotal()), lineReadTo(-1),
+	styledFrom(end), styledTo(start), endStyled(pdoc->GetEndStyled()),
+	lineChangedFirst(pdoc->LinesTotal()), lineChangedLast(-1),
+	currentIndicator(0), errorStatus(0), missed(false) {
+	// Whole lines, always including the line before start for its line state and fold level
+	lineFirst = std::min(pdoc->SciLineFromPosition(std::max<Sci::Position>(start - snapshotMargin, 0)),
+		std::max<Sci::Line>(lineStart - 1, 0));
+	const Sci::Line lineEnd = pdoc->SciLineFromPosition(std::min(end + snapshotMargin, lengthDocument)) + 1;
+	textStart = pdoc->LineStart(lineFirst);
+	textEnd = pdoc->LineStart(lineEnd);
+	linesComplete = lineEnd - lineFirst;
+	lineLast = pdoc->LinesTotal() - 1;
+	lineLastStart = pdoc->LineStart(lineLast);
+	linePenultimateStart = pdoc->LineStart(std::max<Sci::Line>(lineLast - 1, 0));
+
+	large = pdoc->IsLarge();
+	dbcsCodePage = pdoc->dbcsCodePage;
+	tabInChars = pdoc->tabInChars;
+	lineEndTypes = pdoc->GetLineEndTypesActive();
+
+	const Sci::Position lengthText = textEnd - textStart;
+	textCopy.resize(lengthText);
+	pdoc->GetCharRange(textCopy.data(), textStart, lengthText);
+	styles.resize(lengthText);
+	pdoc->GetStyleRange(reinterpret_cast<unsigned char *>(styles.data()), textStart, lengthText);
+	const Sci::Line linesCopied = std::min(linesComplete, lineLast + 1 - lineFirst);
+	levels.resize(linesCopied);
+	lineStates.resize(linesCopied);
+	for (Sci::Line line = 0; line < linesCopied; line++) {
+		levels[line] = pdoc->GetLevel(lineFirst + line);
+		lineStates[line] = pdoc->GetLineState(lineFirst + line);
+	}
+}
+
+// Take the state before start from the results of lexing the text before, which have not
+// been merged into the document yet.
+void StyleSnapshot::Follow(const StyleSnapshot &previous) {
+	const Sci::Position from = std::max(textStart, previous.textStart);
+	const Sci::Position to = std::min(start, previous.textEnd);
+	if (from < to) {
+		std::copy(previous.styles.begin() + (from - previous.textStart), previous.styles.begin() + (to - previous.textStart),
+			styles.begin() + (from - textStart));
+	}
+	const Sci::Line lineFrom = std::max(lineFirst, previous.lineFirst);
+	const Sci::Line lineTo = std::min(lineStart, previous.lineFirst + static_cast<Sci::Line>(previous.levels.size()));
+	for (Sci::Line line = lineFrom; line < lineTo; line++) {
+		levels[line - lineFirst] = previous.levels[line - previous.lineFirst];
+		lineStates[line - lineFirst] = previous.lineStates[line - previous.lineFirst];
+	}
+}
+
+// Keep the state before start to check it is the same in the document when merging.
+void StyleSnapshot::KeepState() {
+	stylesBefore.assign(styles.begin(), styles.begin() + (start - textStart));
+	levelsBefore = levels;
+	lineStatesBefore = lineStates;
+}
+
+// Whether the lexer read the same styles, line states and fold levels as it would have from
+// the document now, so its results are those of lexing the document. Styles after start must
+// not have been changed since the snapshot was taken.
+bool StyleSnapshot::MatchesDocument(Document *pdoc) const {
+	const Sci::Position from = std::max(styleReadFrom, textStart);
+	if (from < start) {
+		std::vector<char> current(start - from);
+		pdoc->GetStyleRange(reinterpret_cast<unsigned char *>(current.data()), from, current.size());
+		if (!std::equal(current.begin(), current.end(), stylesBefore.begin() + (from - textStart))) {
+			return false;
+		}
+	}
+	// Lines merged are checked too as they are all written, not only those the lexer changed
+	const Sci::Line lineFrom = std::max(std::min(lineReadFrom, lineChangedFirst), lineFirst);
+	const Sci::Line lineTo = std::min(std::max(lineReadTo, lineChangedLast),
+		lineFirst + static_cast<Sci::Line>(levels.size()) - 1);
+	for (Sci::Line line = lineFrom; line <= lineTo; line++) {
+		if (pdoc->GetLineState(line) != lineStatesBefore[line - lineFirst] ||
+			pdoc->GetLevel(line) != levelsBefore[line - lineFirst]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Set up the Document holding the text, on the worker thread as it scans the lines.
+void StyleSnapshot::Prepare() {
+	text = Sci::make_unique<Document>(SC_DOCUMENTOPTION_STYLES_NONE |
+		(large ? SC_DOCUMENTOPTION_TEXT_LARGE : SC_DOCUMENTOPTION_DEFAULT));
+	text->SetDBCSCodePage(dbcsCodePage);
+	text->tabInChars = tabInChars;
+	if (lineEndTypes) {
+		text->SetLexInterface(Sci::make_unique<SnapshotLineEnds>(text.get(), lineEndTypes));
+		text->SetLineEndTypesAllowed(lineEndTypes);
+	}
+	text->SetUndoCollection(false);
+	text->InsertString(0, textCopy.data(), textCopy.size());
+	textCopy.clear();
+	textCopy.shrink_to_fit();
+}
+
+void StyleSnapshot::Merge(Document *pdoc) {
+	if (styledTo > styledFrom) {
+		pdoc->StartStyling(styledFrom, '\377');
+		pdoc->SetStyles(styledTo - styledFrom, styles.data() + (styledFrom - textStart));
+	}
+	pdoc->StartStyling(endStyled, '\377');
+	for (Sci::Line line = lineChangedFirst; line <= lineChangedLast; line++) {
+		pdoc->SetLineState(line, lineStates[line - lineFirst]);
+		pdoc->SetLevel(line, levels[line - lineFirst]);
+	}
+	for (const std::pair<Sci::Position, Sci::Position> &range : lexerStateChanges) {
+		pdoc->ChangeLexerState(range.first, range.second);
+	}
+	for (const Fill &fill : fills) {
+		pdoc->DecorationSetCurrentIndicator(fill.indicator);
+		pdoc->DecorationFillRange(fill.position, fill.value, fill.fillLength);
+	}
+	if (errorStatus) {
+		pdoc->SetErrorStatus(errorStatus);
+	}
+}
+
+void SCI_METHOD StyleSnapshot::GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
+	if (StartInside(position) && EndInside(position + lengthRetrieve)) {
+		text->GetCharRange(buffer, position - textStart, lengthRetrieve);
+	} else {
+		missed = true;
+		if (lengthRetrieve > 0)
+			memset(buffer, 0, lengthRetrieve);
+	}
+}
+
+char SCI_METHOD StyleSnapshot::StyleAt(Sci_Position position) const {
+	styleReadFrom = std::min(styleReadFrom, static_cast<Sci::Position>(position));
+	if (StartInside(position) && EndInside(position + 1)) {
+		return (position >= 0 && position < lengthDocument) ? styles[position - textStart] : 0;
+	}
+	missed = true;
+	return 0;
+}
+
+Sci_Position SCI_METHOD StyleSnapshot::LineFromPosition(Sci_Position position) const {
+	if (StartInside(position) && EndInside(position)) {
+		return lineFirst + text->LineFromPosition(position - textStart);
+	}
+	if (position >= linePenultimateStart) {
+		return (position >= lineLastStart) ? lineLast : lineLast - 1;
+	}
+	missed = true;
+	return lineFirst;
+}
+
+Sci_Position SCI_METHOD StyleSnapshot::LineStart(Sci_Position line) const {
+	if (LineInside(line) || line == lineFirst + linesComplete) {
+		return textStart + text->LineStart(line - lineFirst);
+	}
+	if (line >= lineLast - 1) {
+		return (line > lineLast) ? lengthDocument : ((line == lineLast) ? lineLastStart : linePenultimateStart);
+	}
+	missed = true;
+	return textStart;
+}
+
+int SCI_METHOD StyleSnapshot::GetLevel(Sci_Position line) const {
+	if (LineStored(line)) {
+		LineRead(line);
+		return levels[line - lineFirst];
+	}
+	missed = true;
+	return SC_FOLDLEVELBASE;
+}
+
+int SCI_METHOD StyleSnapshot::SetLevel(Sci_Position line, int level) {
+	if (LineStored(line)) {
+		LineChanged(line);
+		const int prev = levels[line - lineFirst];
+		levels[line - lineFirst] = level;
+		return prev;
+	}
+	missed = true;
+	return 0;
+}
+
+int SCI_METHOD StyleSnapshot::GetLineState(Sci_Position line) const {
+	if (LineStored(line)) {
+		LineRead(line);
+		return lineStates[line - lineFirst];
+	}
+	missed = true;
+	return 0;
+}
+
+int SCI_METHOD StyleSnapshot::SetLineState(Sci_Position line, int state) {
+	if (LineStored(line)) {
+		LineChanged(line);
+		const int prev = lineStates[line - lineFirst];
+		lineStates[line - lineFirst] = state;
+		return prev;
+	}
+	missed = true;
+	return 0;
+}
+
+void SCI_METHOD StyleSnapshot::StartStyling(Sci_Position position, char) {
+	if (StartInside(position) && EndInside(position) && position >= 0) {
+		styledFrom = std::min(styledFrom, static_cast<Sci::Position>(position));
+		endStyled = position;
+	} else {
+		missed = true;
+	}
+}
+
+bool SCI_METHOD StyleSnapshot::SetStyleFor(Sci_Position length, char style) {
+	if (EndInside(endStyled + length) && endStyled + length <= lengthDocument && length >= 0) {
+		std::fill_n(styles.begin() + (endStyled - textStart), length, style);
+		endStyled += length;
+		styledTo = std::max(styledTo, endStyled);
+	} else {
+		missed = true;
+	}
+	return true;
+}
+
+bool SCI_METHOD StyleSnapshot::SetStyles(Sci_Position length, const char *styles_) {
+	if (EndInside(endStyled + length) && endStyled + length <= lengthDocument && length >= 0) {
+		std::copy(styles_, styles_ + length, styles.begin() + (endStyled - textStart));
+		endStyled += length;
+		styledTo = std::max(styledTo, endStyled);
+	} else {
+		missed = true;
+	}
+	return true;
+}
+
+const char * SCI_METHOD StyleSnapshot::BufferPointer() {
+	if (textStart == 0 && textEnd == lengthDocument) {
+		return text->BufferPointer();
+	}
+	// Only the copied lines are known, so give the lexer zeros of the document length
+	missed = true;
+	if (wholeText.empty()) {
+		wholeText.resize(lengthDocument + 1);
+	}
+	return wholeText.data();
+}
+
+int SCI_METHOD StyleSnapshot::GetLineIndentation(Sci_Position line) {
+	if (LineInside(line)) {
+		return text->GetLineIndentation(line - lineFirst);
+	}
+	missed = true;
+	return 0;
+}
+
+Sci_Position SCI_METHOD StyleSnapshot::LineEnd(Sci_Position line) const {
+	if (LineInside(line)) {
+		return textStart + text->LineEnd(line - lineFirst);
+	}
+	missed = true;
+	return textStart;
+}
+
+Sci_Position SCI_METHOD StyleSnapshot::GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const {
+	if (StartInside(positionStart) && EndInside(positionStart)) {
+		const Sci_Position pos = text->GetRelativePosition(positionStart - textStart, characterOffset);
+		if (pos != INVALID_POSITION) {
+			return textStart + pos;
+		}
+		if ((characterOffset < 0) ? textStart == 0 : textEnd == lengthDocument) {
+			return INVALID_POSITION;
+		}
+	}
+	missed = true;
+	return INVALID_POSITION;
+}
+
+int SCI_METHOD StyleSnapshot::GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const {
+	if (StartInside(position) && EndInside(position + 1)) {
+		return text->GetCharacterAndWidth(position - textStart, pWidth);
+	}
+	missed = true;
+	if (pWidth) {
+		*pWidth = 1;
+	}
+	return 0;
+}
+
+BackgroundStyler::BackgroundStyler(Document *pdoc, ILexer *instance, Sci::Position start_, Sci::Position end_) :
+	start(start_), end(end_), endStyledBefore(pdoc->GetEndStyled()), valid(true), duration(0.0), finished(false) {
+	snapshot = Sci::make_unique<StyleSnapshot>(pdoc, start, end);
+	const int styleStart = (start > 0) ? pdoc->StyleAt(start - 1) : 0;
+	worker = std::thread([this, instance, styleStart]() {
+		ElapsedPeriod epStyling;
+		try {
+			snapshot->Prepare();
+			instance->Lex(start, end - start, styleStart, snapshot.get());
+			instance->Fold(start, end - start, styleStart, snapshot.get());
+		} catch (...) {
+			// Lexed again on the main thread where the exception can be reported
+			snapshot->Miss();
+		}
+		duration = epStyling.Duration();
+		finished.store(true, std::memory_order_release);
+	});
+}
+
+BackgroundStyler::~BackgroundStyler() {
+	Wait();
+}
+
+void BackgroundStyler::Wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+BackgroundStyler::Result BackgroundStyler::Merge(Document *pdoc) {
+	Wait();
+	if (!valid || pdoc->GetEndStyled() != endStyledBefore) {
+		return Result::discarded;
+	}
+	if (snapshot->missed) {
+		return Result::missed;
+	}
+	snapshot->Merge(pdoc);
+	const Sci::Line lines = pdoc->SciLineFromPosition(end) - pdoc->SciLineFromPosition(start);
+	pdoc->durationStyleOneLine.AddSample(lines, duration);
+	return Result::merged;
+}
+
+ParallelStyler::ParallelStyler(Document *pdoc, Sci::Position start, Sci::Position end, size_t chunksWanted) :
+	chunkFirst(0) {
+	const Sci::Position lengthChunk = (end - start) / std::max<size_t>(chunksWanted, 1);
+	Sci::Position chunkStart = start;
+	while (chunkStart < end) {
+		const Sci::Position chunkEnd = (end - chunkStart >= 2 * lengthChunk) ?
+			RestartNear(pdoc, chunkStart + lengthChunk, end) : end;
+		chunks.push_back({chunkStart, chunkEnd, nullptr});
+		chunkStart = chunkEnd;
+	}
+}
+
+ParallelStyler::~ParallelStyler() {
+}
+
+// Take snapshots of the chunks not merged yet, each following the results of the last round
+// for the chunk before it.
+void ParallelStyler::TakeSnapshots(Document *pdoc) {
+	std::vector<std::unique_ptr<StyleSnapshot>> snapshots;
+	for (size_t index = chunkFirst; index < chunks.size(); index++) {
+		const Chunk &chunk = chunks[index];
+		std::unique_ptr<StyleSnapshot> snapshot = Sci::make_unique<StyleSnapshot>(pdoc, chunk.start, chunk.end);
+		if (index > chunkFirst && chunks[index - 1].snapshot && !chunks[index - 1].snapshot->missed) {
+			snapshot->Follow(*chunks[index - 1].snapshot);
+		}
+		snapshot->KeepState();
+		snapshots.push_back(std::move(snapshot));
+	}
+	for (size_t index = chunkFirst; index < chunks.size(); index++) {
+		chunks[index].snapshot = std::move(snapshots[index - chunkFirst]);
+	}
+}
+
+void ParallelStyler::Lex(const std::vector<ILexer *> &lexers) {
+	std::atomic<size_t> next(chunkFirst);
+	auto lexChunks = [this, &next](ILexer *lexer) {
+		for (size_t index = next++; index < chunks.size(); index = next++) {
+			StyleSnapshot *snapshot = chunks[index].snapshot.get();
+			try {
+				snapshot->Prepare();
+				lexer->Lex(chunks[index].start, chunks[index].end - chunks[index].start,
+					snapshot->StyleBefore(), snapshot);
+			} catch (...) {
+				// Lexed again on the main thread where the exception can be reported
+				snapshot->Miss();
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (size_t index = 1; index < lexers.size(); index++) {
+		try {
+			workers.emplace_back(lexChunks, lexers[index]);
+		} catch (const std::system_error &) {
+			// The threads started are enough to lex every chunk
+			break;
+		}
+	}
+	lexChunks(lexers.front());
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+// Merge the chunks lexed as when lexing the whole range, in order from the first not merged.
+size_t ParallelStyler::Merge(Document *pdoc) {
+	const size_t chunkStart = chunkFirst;
+	while (chunkFirst < chunks.size()) {
+		const Chunk &chunk = chunks[chunkFirst];
+		if (chunk.snapshot->styledTo > chunk.end) {
+			// Styles of the next chunk can't be checked against its snapshot
+			chunk.snapshot->Miss();
+		}
+		if (chunk.snapshot->missed || !chunk.snapshot->MatchesDocument(pdoc)) {
+			break;
+		}
+		chunk.snapshot->Merge(pdoc);
+		chunkFirst++;
+	}
+	return chunkFirst - chunkStart;
+}
+
+void ParallelStyler::LexDocument(Document *pdoc, ILexer *instance, Sci::Position start, Sci::Position end) {
+	const int styleStart = (start > 0) ? pdoc->StyleAt(start - 1) : 0;
+	instance->Lex(start, end - start, styleStart, pdoc);
+}
+
+int ParallelStyler::Colourise(Document *pdoc, ILexer *instance, const std::vector<ILexer *> &lexers) {
+	int rounds = 0;
+	while (chunkFirst < chunks.size()) {
+		TakeSnapshots(pdoc);
+		Lex(lexers);
+		rounds++;
+		const size_t merged = Merge(pdoc);
+		if (chunkFirst >= chunks.size()) {
+			break;
+		}
+		if (chunks[chunkFirst].snapshot->missed) {
+			// Needs more of the document than the snapshot
+			LexDocument(pdoc, instance, chunks[chunkFirst].start, chunks[chunkFirst].end);
+			chunkFirst++;
+		} else if (rounds > 1 && merged < 2) {
+			// The chunks don't end up in the state expected by the next
+			LexDocument(pdoc, instance, chunks[chunkFirst].start, chunks.back().end);
+			chunkFirst = chunks.size();
+		}
+	}
+	return rounds;
+}
@@ -0,0 +1,106 @@
+// Scintilla source code edit control
+/** @file BackgroundStyler.h
+ ** Lexing of snapshots of the document on worker threads.
+ **/
+// Copyright 2026 The Geany contributors
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BACKGROUNDSTYLER_H
+#define BACKGROUNDSTYLER_H
+
+namespace Scintilla {
+
+class StyleSnapshot;
+
+/**
+ * Runs a lexer over a range of the document on a worker thread. The lexer sees a snapshot
+ * of the text, styles, line states and fold levels around the range, and its results are
+ * merged back into the document on the main thread.
+ * The results are only merged when the document has not been modified or styled since the
+ * snapshot was taken. When the lexer went outside the snapshot, the range has to be lexed
+ * again synchronously.
+ * The lexer instance must not be used by anything else until Wait returns.
+ */
+class BackgroundStyler {
+	std::unique_ptr<StyleSnapshot> snapshot;
+	Sci::Position start;
+	Sci::Position end;
+	Sci::Position endStyledBefore;
+	bool valid;
+	double duration;
+	std::atomic<bool> finished;
+	std::thread worker;
+public:
+	enum class Result { merged, discarded, missed };
+
+	BackgroundStyler(Document *pdoc, ILexer *instance, Sci::Position start_, Sci::Position end_);
+	// Deleted so BackgroundStyler objects can not be copied.
+	BackgroundStyler(const BackgroundStyler &) = delete;
+	BackgroundStyler(BackgroundStyler &&) = delete;
+	BackgroundStyler &operator=(const BackgroundStyler &) = delete;
+	BackgroundStyler &operator=(BackgroundStyler &&) = delete;
+	~BackgroundStyler();
+
+	Sci::Position Start() const noexcept {
+		return start;
+	}
+	Sci::Position End() const noexcept {
+		return end;
+	}
+	bool Finished() const noexcept {
+		return finished.load(std::memory_order_acquire);
+	}
+	/// The document was modified so the results of the job are out of date.
+	void Invalidate() noexcept {
+		valid = false;
+	}
+	void Wait();
+	Result Merge(Document *pdoc);
+};
+
+/**
+ * Lexes a range of the document as consecutive chunks on several threads, each on a snapshot
+ * of the document. The chunks are merged in order, and a chunk is only merged when the styles,
+ * line states and fold levels its lexer read from before the chunk are the same in the
+ * document as they were in its snapshot, as then it was lexed exactly as when lexing the whole
+ * range at once.
+ * The chunks which can't be merged are lexed again in another round, on snapshots taking the
+ * state before them from the results of the previous chunks in the last round, as a lexer
+ * usually ends in the same state whatever state it started in. The first of them is always
+ * merged then as the chunk before it has been merged. When no more than that is merged, the
+ * rest is lexed on the calling thread.
+ * The lexers given must be configured alike and must not keep any state of the document
+ * between calls.
+ */
+class ParallelStyler {
+	struct Chunk {
+		Sci::Position start;
+		Sci::Position end;
+		std::unique_ptr<StyleSnapshot> snapshot;
+	};
+	std::vector<Chunk> chunks;
+	size_t chunkFirst;	///< The first chunk not merged yet
+	void TakeSnapshots(Document *pdoc);
+	void Lex(const std::vector<ILexer *> &lexers);
+	size_t Merge(Document *pdoc);
+	void LexDocument(Document *pdoc, ILexer *instance, Sci::Position start, Sci::Position end);
+public:
+	ParallelStyler(Document *pdoc, Sci::Position start, Sci::Position end, size_t chunksWanted);
+	// Deleted so ParallelStyler objects can not be copied.
+	ParallelStyler(const ParallelStyler &) = delete;
+	ParallelStyler(ParallelStyler &&) = delete;
+	ParallelStyler &operator=(const ParallelStyler &) = delete;
+	ParallelStyler &operator=(ParallelStyler &&) = delete;
+	~ParallelStyler();
+
+	size_t Chunks() const noexcept {
+		return chunks.size();
+	}
+	/// Lex the range with one thread for each lexer, the calling thread using the first, and
+	/// instance for the chunks lexed on the document. Returns the number of rounds.
+	int Colourise(Document *pdoc, ILexer *instance, const std::vector<ILexer *> &lexers);
+};
+
+}
+
+#endif
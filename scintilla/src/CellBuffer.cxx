@@ -7,6 +7,7 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <cstdint>
 #include <cassert>
 #include <cstring>
 #include <cstdio>
@@ -18,12 +19,17 @@
 #include <algorithm>
 #include <memory>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "Platform.h"
 
 #include "Scintilla.h"
 #include "Position.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
+#include "ChunkedVector.h"
 #include "CellBuffer.h"
 #include "UniConversion.h"
 
@@ -353,6 +359,8 @@ UndoHistory::UndoHistory() {
 	undoSequenceDepth = 0;
 	savePoint = 0;
 	tentativePoint = -1;
+	memory = 0;
+	memoryLimit = 0;
 
 	actions[currentAction].Create(startAction);
 }
@@ -369,6 +377,46 @@ void UndoHistory::EnsureUndoRoom() {
 	}
 }
 
+void UndoHistory::SetAction(int index, actionType at, Sci::Position position, const char *data, Sci::Position lengthData, bool mayCoalesce) {
+	memory -= actions[index].lenData;
+	actions[index].Create(at, position, data, lengthData, mayCoalesce);
+	memory += lengthData;
+}
+
+// When the actions and their data exceed the memory limit, the oldest user operations are
+// dropped until it is below 3/4 of the limit, so that it isn't done for every action.
+// The current user operation and the actions that can be redone are kept.
+// If the save point is dropped, it can't be reached anymore.
+void UndoHistory::DropOldestActions() {
+	const size_t used = GetMemory();
+	if (memoryLimit == 0 || used <= memoryLimit || TentativeActive())
+		return;
+
+	const size_t target = memoryLimit / 4 * 3;
+	int cut = 0;
+	size_t dropped = 0;
+	size_t droppedAtCut = 0;
+	for (int act = 1; act < currentAction; act++) {
+		if (actions[act].at == startAction) {
+			cut = act;
+			droppedAtCut = dropped;
+			// the actions before cut are dropped with their data
+			if (used - dropped - cut * sizeof(Action) <= target)
+				break;
+		}
+		dropped += actions[act].lenData;
+	}
+	if (cut == 0)
+		return;
+
+	actions.erase(actions.begin(), actions.begin() + cut);
+	memory -= droppedAtCut;
+	currentAction -= cut;
+	maxAction -= cut;
+	if (savePoint >= 0)
+		savePoint = (savePoint >= cut) ? savePoint - cut : -1;
+}
+
 const char *UndoHistory::AppendAction(actionType at, Sci::Position position, const char *data, Sci::Position lengthData,
 	bool &startSequence, bool mayCoalesce) {
 	EnsureUndoRoom();
@@ -433,12 +481,12 @@ const char *UndoHistory::AppendAction(actionType at, Sci::Position position, con
 		currentAction++;
 	}
 	startSequence = oldCurrentAction != currentAction;
-	const int actionWithData = currentAction;
-	actions[currentAction].Create(at, position, data, lengthData, mayCoalesce);
+	SetAction(currentAction, at, position, data, lengthData, mayCoalesce);
 	currentAction++;
-	actions[currentAction].Create(startAction);
+	SetAction(currentAction, startAction);
 	maxAction = currentAction;
-	return actions[actionWithData].data.get();
+	DropOldestActions();
+	return actions[currentAction - 1].data.get();
 }
 
 void UndoHistory::BeginUndoAction() {
@@ -446,7 +494,7 @@ void UndoHistory::BeginUndoAction() {
 	if (undoSequenceDepth == 0) {
 		if (actions[currentAction].at != startAction) {
 			currentAction++;
-			actions[currentAction].Create(startAction);
+			SetAction(currentAction, startAction);
 			maxAction = currentAction;
 		}
 		actions[currentAction].mayCoalesce = false;
@@ -461,7 +509,7 @@ void UndoHistory::EndUndoAction() {
 	if (0 == undoSequenceDepth) {
 		if (actions[currentAction].at != startAction) {
 			currentAction++;
-			actions[currentAction].Create(startAction);
+			SetAction(currentAction, startAction);
 			maxAction = currentAction;
 		}
 		actions[currentAction].mayCoalesce = false;
@@ -473,8 +521,9 @@ void UndoHistory::DropUndoSequence() {
 }
 
 void UndoHistory::DeleteUndoHistory() {
-	for (int i = 1; i < maxAction; i++)
+	for (size_t i = 1; i < actions.size(); i++)
 		actions[i].Clear();
+	memory = 0;
 	maxAction = 0;
 	currentAction = 0;
 	actions[currentAction].Create(startAction);
@@ -482,10 +531,27 @@ void UndoHistory::DeleteUndoHistory() {
 	tentativePoint = -1;
 }
 
+void UndoHistory::SetMemoryLimit(size_t limit) {
+	memoryLimit = limit;
+	DropOldestActions();
+}
+
+size_t UndoHistory::GetMemoryLimit() const noexcept {
+	return memoryLimit;
+}
+
+size_t UndoHistory::GetMemory() const noexcept {
+	return memory + (maxAction + 1) * sizeof(Action);
+}
+
 void UndoHistory::SetSavePoint() noexcept {
 	savePoint = currentAction;
 }
 
+void UndoHistory::DiscardSavePoint() noexcept {
+	savePoint = -1;
+}
+
 bool UndoHistory::IsSavePoint() const noexcept {
 	return savePoint == currentAction;
 }
@@ -564,8 +630,13 @@ void UndoHistory::CompletedRedoStep() {
 	currentAction++;
 }
 
-CellBuffer::CellBuffer(bool hasStyles_, bool largeDocument_) :
+CellBuffer::CellBuffer(bool hasStyles_, bool largeDocument_, bool chunked_) :
 	hasStyles(hasStyles_), largeDocument(largeDocument_) {
+	if (chunked_) {
+		chunkedSubstance = Sci::make_unique<ChunkedVector<char>>();
+		if (hasStyles)
+			chunkedStyle = Sci::make_unique<ChunkedVector<char>>();
+	}
 	readOnly = false;
 	utf8Substance = false;
 	utf8LineEnds = 0;
@@ -580,11 +651,13 @@ CellBuffer::~CellBuffer() {
 }
 
 char CellBuffer::CharAt(Sci::Position position) const noexcept {
+	if (chunkedSubstance)
+		return chunkedSubstance->ValueAt(position);
 	return substance.ValueAt(position);
 }
 
 unsigned char CellBuffer::UCharAt(Sci::Position position) const noexcept {
-	return substance.ValueAt(position);
+	return CharAt(position);
 }
 
 void CellBuffer::GetCharRange(char *buffer, Sci::Position position, Sci::Position lengthRetrieve) const {
@@ -592,18 +665,25 @@ void CellBuffer::GetCharRange(char *buffer, Sci::Position position, Sci::Positio
 		return;
 	if (position < 0)
 		return;
-	if ((position + lengthRetrieve) > substance.Length()) {
+	if ((position + lengthRetrieve) > Length()) {
 		Platform::DebugPrintf("Bad GetCharRange %.0f for %.0f of %.0f\n",
 				      static_cast<double>(position),
 				      static_cast<double>(lengthRetrieve),
-				      static_cast<double>(substance.Length()));
+				      static_cast<double>(Length()));
 		return;
 	}
-	substance.GetRange(buffer, position, lengthRetrieve);
+	if (chunkedSubstance)
+		chunkedSubstance->GetRange(buffer, position, lengthRetrieve);
+	else
+		substance.GetRange(buffer, position, lengthRetrieve);
 }
 
 char CellBuffer::StyleAt(Sci::Position position) const noexcept {
-	return hasStyles ? style.ValueAt(position) : 0;
+	if (!hasStyles)
+		return 0;
+	if (chunkedStyle)
+		return chunkedStyle->ValueAt(position);
+	return style.ValueAt(position);
 }
 
 void CellBuffer::GetStyleRange(unsigned char *buffer, Sci::Position position, Sci::Position lengthRetrieve) const {
@@ -615,28 +695,54 @@ void CellBuffer::GetStyleRange(unsigned char *buffer, Sci::Position position, Sc
 		std::fill(buffer, buffer + lengthRetrieve, static_cast<unsigned char>(0));
 		return;
 	}
-	if ((position + lengthRetrieve) > style.Length()) {
+	if ((position + lengthRetrieve) > Length()) {
 		Platform::DebugPrintf("Bad GetStyleRange %.0f for %.0f of %.0f\n",
 				      static_cast<double>(position),
 				      static_cast<double>(lengthRetrieve),
-				      static_cast<double>(style.Length()));
+				      static_cast<double>(Length()));
 		return;
 	}
-	style.GetRange(reinterpret_cast<char *>(buffer), position, lengthRetrieve);
+	if (chunkedStyle)
+		chunkedStyle->GetRange(reinterpret_cast<char *>(buffer), position, lengthRetrieve);
+	else
+		style.GetRange(reinterpret_cast<char *>(buffer), position, lengthRetrieve);
 }
 
+// A chunked buffer returns a copy of its whole text
 const char *CellBuffer::BufferPointer() {
+	if (chunkedSubstance)
+		return chunkedSubstance->BufferPointer();
 	return substance.BufferPointer();
 }
 
-const char *CellBuffer::RangePointer(Sci::Position position, Sci::Position rangeLength) noexcept {
+// Only a chunked buffer makes a copy for BufferPointer
+void CellBuffer::ReleaseBufferPointer() {
+	if (chunkedSubstance)
+		chunkedSubstance->ReleaseBufferPointer();
+}
+
+// A chunked buffer returns a copy of ranges spanning chunks
+const char *CellBuffer::RangePointer(Sci::Position position, Sci::Position rangeLength) {
+	if (chunkedSubstance)
+		return chunkedSubstance->RangePointer(position, rangeLength);
 	return substance.RangePointer(position, rangeLength);
 }
 
 Sci::Position CellBuffer::GapPosition() const noexcept {
+	if (chunkedSubstance)
+		return chunkedSubstance->Length();
 	return substance.GapPosition();
 }
 
+// The end of the contiguous part of the buffer holding position, so the range from position
+// to there can be read through RangePointer without moving the gap or copying
+Sci::Position CellBuffer::ContiguousEnd(Sci::Position position) const noexcept {
+	if (chunkedSubstance)
+		return chunkedSubstance->ContiguousEnd(position);
+	const Sci::Position gap = substance.GapPosition();
+	return (position < gap) ? gap : substance.Length();
+}
+
 // The char* returned is to an allocation owned by the undo history
 const char *CellBuffer::InsertString(Sci::Position position, const char *s, Sci::Position insertLength, bool &startSequence) {
 	// InsertString and DeleteChars are the bottleneck though which all changes occur
@@ -657,9 +763,12 @@ bool CellBuffer::SetStyleAt(Sci::Position position, char styleValue) noexcept {
 	if (!hasStyles) {
 		return false;
 	}
-	const char curVal = style.ValueAt(position);
+	const char curVal = StyleAt(position);
 	if (curVal != styleValue) {
-		style.SetValueAt(position, styleValue);
+		if (chunkedStyle)
+			chunkedStyle->SetValueAt(position, styleValue);
+		else
+			style.SetValueAt(position, styleValue);
 		return true;
 	} else {
 		return false;
@@ -672,11 +781,14 @@ bool CellBuffer::SetStyleFor(Sci::Position position, Sci::Position lengthStyle,
 	}
 	bool changed = false;
 	PLATFORM_ASSERT(lengthStyle == 0 ||
-		(lengthStyle > 0 && lengthStyle + position <= style.Length()));
+		(lengthStyle > 0 && lengthStyle + position <= Length()));
 	while (lengthStyle--) {
-		const char curVal = style.ValueAt(position);
+		const char curVal = StyleAt(position);
 		if (curVal != styleValue) {
-			style.SetValueAt(position, styleValue);
+			if (chunkedStyle)
+				chunkedStyle->SetValueAt(position, styleValue);
+			else
+				style.SetValueAt(position, styleValue);
 			changed = true;
 		}
 		position++;
@@ -693,7 +805,7 @@ const char *CellBuffer::DeleteChars(Sci::Position position, Sci::Position delete
 		if (collectingUndo) {
 			// Save into the undo/redo stack, but only the characters - not the formatting
 			// The gap would be moved to position anyway for the deletion so this doesn't cost extra
-			data = substance.RangePointer(position, deleteLength);
+			data = RangePointer(position, deleteLength);
 			data = uh.AppendAction(removeAction, position, data, deleteLength, startSequence);
 		}
 
@@ -703,10 +815,15 @@ const char *CellBuffer::DeleteChars(Sci::Position position, Sci::Position delete
 }
 
 Sci::Position CellBuffer::Length() const noexcept {
+	if (chunkedSubstance)
+		return chunkedSubstance->Length();
 	return substance.Length();
 }
 
 void CellBuffer::Allocate(Sci::Position newSize) {
+	// Chunks are allocated as text is inserted
+	if (chunkedSubstance)
+		return;
 	substance.ReAllocate(newSize);
 	if (hasStyles) {
 		style.ReAllocate(newSize);
@@ -802,6 +919,10 @@ bool CellBuffer::IsLarge() const noexcept {
 	return largeDocument;
 }
 
+bool CellBuffer::IsChunked() const noexcept {
+	return chunkedSubstance != nullptr;
+}
+
 bool CellBuffer::HasStyles() const noexcept {
 	return hasStyles;
 }
@@ -810,6 +931,10 @@ void CellBuffer::SetSavePoint() {
 	uh.SetSavePoint();
 }
 
+void CellBuffer::DiscardSavePoint() noexcept {
+	uh.DiscardSavePoint();
+}
+
 bool CellBuffer::IsSavePoint() const noexcept {
 	return uh.IsSavePoint();
 }
@@ -842,10 +967,10 @@ void CellBuffer::RemoveLine(Sci::Line line) {
 
 bool CellBuffer::UTF8LineEndOverlaps(Sci::Position position) const noexcept {
 	const unsigned char bytes[] = {
-		static_cast<unsigned char>(substance.ValueAt(position-2)),
-		static_cast<unsigned char>(substance.ValueAt(position-1)),
-		static_cast<unsigned char>(substance.ValueAt(position)),
-		static_cast<unsigned char>(substance.ValueAt(position+1)),
+		static_cast<unsigned char>(CharAt(position-2)),
+		static_cast<unsigned char>(CharAt(position-1)),
+		static_cast<unsigned char>(CharAt(position)),
+		static_cast<unsigned char>(CharAt(position+1)),
 	};
 	return UTF8IsSeparator(bytes) || UTF8IsSeparator(bytes+1) || UTF8IsNEL(bytes+1);
 }
@@ -859,7 +984,7 @@ bool CellBuffer::UTF8IsCharacterBoundary(Sci::Position position) const {
 			if (posBack < 0) {
 				return false;
 			}
-			back.insert(0, 1, substance.ValueAt(posBack));
+			back.insert(0, 1, CharAt(posBack));
 			if (!UTF8IsTrailByte(back.front())) {
 				if (i > 0) {
 					// Have reached a non-trail
@@ -873,7 +998,7 @@ bool CellBuffer::UTF8IsCharacterBoundary(Sci::Position position) const {
 		}
 	}
 	if (position < Length()) {
-		const unsigned char fore = substance.ValueAt(position);
+		const unsigned char fore = CharAt(position);
 		if (UTF8IsTrailByte(fore)) {
 			return false;
 		}
@@ -893,7 +1018,7 @@ void CellBuffer::ResetLineEnds() {
 	unsigned char chBeforePrev = 0;
 	unsigned char chPrev = 0;
 	for (Sci::Position i = 0; i < length; i++) {
-		const unsigned char ch = substance.ValueAt(position + i);
+		const unsigned char ch = CharAt(position + i);
 		if (ch == '\r') {
 			InsertLine(lineInsert, (position + i) + 1, atLineStart);
 			lineInsert++;
@@ -952,12 +1077,65 @@ void CellBuffer::RecalculateIndexLineStarts(Sci::Line lineFirst, Sci::Line lineL
 	}
 }
 
+namespace {
+
+constexpr ptrdiff_t lineEndBlockSize = 64;
+
+// Returns a mask of the bytes of the lineEndBlockSize bytes at block which are equal to value,
+// with bit i set for byte i. Compares 16 bytes at once with SSE2 where available, otherwise 8
+// bytes at once in a 64-bit word: a byte of x = word ^ (value * ones) is zero when the high bit
+// of ((x & lows) + lows) | x is clear, and the high bits are then gathered by a multiplication.
+uint64_t ByteMask(const char *block, char value) noexcept {
+	uint64_t mask = 0;
+#if defined(__SSE2__)
+	const __m128i pattern = _mm_set1_epi8(value);
+	for (int part = 0; part < 4; part++) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + part * 16));
+		const int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, pattern));
+		mask |= static_cast<uint64_t>(static_cast<uint16_t>(equal)) << (part * 16);
+	}
+#else
+	constexpr uint64_t ones = 0x0101010101010101ULL;
+	constexpr uint64_t highs = 0x8080808080808080ULL;
+	constexpr uint64_t lows = ~highs;
+	const uint64_t pattern = ones * static_cast<unsigned char>(value);
+	for (int part = 0; part < 8; part++) {
+		uint64_t word;
+		memcpy(&word, block + part * 8, sizeof(word));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		// Byte i of the block has to be the byte of significance i
+		word = __builtin_bswap64(word);
+#endif
+		const uint64_t x = word ^ pattern;
+		const uint64_t zeroHighs = ~(((x & lows) + lows) | x) & highs;
+		const uint64_t equal = ((zeroHighs >> 7) * 0x0102040810204080ULL) >> 56;
+		mask |= equal << (part * 8);
+	}
+#endif
+	return mask;
+}
+
+int LowestBit(uint64_t mask) noexcept {
+#if defined(__GNUC__)
+	return __builtin_ctzll(mask);
+#else
+	int bit = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+}
+
 void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::Position insertLength) {
 	if (insertLength == 0)
 		return;
 	PLATFORM_ASSERT(insertLength > 0);
 
-	const unsigned char chAfter = substance.ValueAt(position);
+	const unsigned char chAfter = CharAt(position);
 	bool breakingUTF8LineEnd = false;
 	if (utf8LineEnds && UTF8IsTrailByte(chAfter)) {
 		breakingUTF8LineEnd = UTF8LineEndOverlaps(position);
@@ -979,16 +1157,21 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 			UTF8IsValid(s, insertLength);
 	}
 
-	substance.InsertFromArray(position, s, 0, insertLength);
-	if (hasStyles) {
+	if (chunkedSubstance)
+		chunkedSubstance->InsertFromArray(position, s, 0, insertLength);
+	else
+		substance.InsertFromArray(position, s, 0, insertLength);
+	if (chunkedStyle) {
+		chunkedStyle->InsertValue(position, insertLength, 0);
+	} else if (hasStyles) {
 		style.InsertValue(position, insertLength, 0);
 	}
 
 	const bool atLineStart = plv->LineStart(lineInsert-1) == position;
 	// Point all the lines after the insertion point further along in the buffer
 	plv->InsertText(lineInsert-1, insertLength);
-	unsigned char chBeforePrev = substance.ValueAt(position - 2);
-	unsigned char chPrev = substance.ValueAt(position - 1);
+	unsigned char chBeforePrev = CharAt(position - 2);
+	unsigned char chPrev = CharAt(position - 1);
 	if (chPrev == '\r' && chAfter == '\n') {
 		// Splitting up a crlf pair at position
 		InsertLine(lineInsert, position, false);
@@ -1015,6 +1198,23 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 		simpleInsertion = false;
 	}
 
+	// The byte before p, which is in the buffer for the start of the insertion
+	const unsigned char chPrevInsertion = chPrev;
+	const unsigned char chBeforePrevInsertion = chBeforePrev;
+	auto byteBefore = [=](const char *p) noexcept -> unsigned char {
+		if (p > s)
+			return p[-1];
+		return (p == s) ? chPrevInsertion : chBeforePrevInsertion;
+	};
+	auto addLineStart = [&](Sci::Position lineStartPosition) {
+		positions[nPositions++] = lineStartPosition;
+		if (nPositions == PositionBlockSize) {
+			plv->InsertLines(lineInsert, positions, nPositions, atLineStart);
+			lineInsert += nPositions;
+			nPositions = 0;
+		}
+	};
+
 	if (ptr < end) {
 		uint8_t eolTable[256]{};
 		eolTable[static_cast<uint8_t>('\n')] = 1;
@@ -1026,45 +1226,52 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 			eolTable[0xa9] = 3;
 		}
 
-		do {
-			// skip to line end
-			ch = *ptr++;
-			uint8_t type;
-			while ((type = eolTable[ch]) == 0 && ptr < end) {
-				chBeforePrev = chPrev;
-				chPrev = ch;
-				ch = *ptr++;
+		// Find the line ends of whole blocks from masks of their line end bytes.
+		// The byte after a block is checked for a '\n' ending a "\r\n" at the block end.
+		while (end - ptr > lineEndBlockSize) {
+			const uint64_t lf = ByteMask(ptr, '\n');
+			const uint64_t cr = ByteMask(ptr, '\r');
+			const uint64_t lfNext = (lf >> 1) | (static_cast<uint64_t>(ptr[lineEndBlockSize] == '\n') << 63);
+			uint64_t lineEnds = lf | (cr & ~lfNext);
+			if (utf8LineEnds) {
+				lineEnds |= ByteMask(ptr, '\x85') | ByteMask(ptr, '\xa8') | ByteMask(ptr, '\xa9');
+			}
+			while (lineEnds) {
+				const char *lineEnd = ptr + LowestBit(lineEnds);
+				lineEnds &= lineEnds - 1;
+				const uint8_t type = eolTable[static_cast<uint8_t>(*lineEnd)];
+				if ((type <= 2) ||
+					(type == 3 && byteBefore(lineEnd) == 0x80 && byteBefore(lineEnd - 1) == 0xe2) ||
+					(type == 4 && byteBefore(lineEnd) == 0xc2)) {
+					addLineStart(position + lineEnd + 1 - s);
+				}
 			}
-			switch (type) {
+			ptr += lineEndBlockSize;
+		}
+
+		while (ptr < end) {
+			ch = *ptr++;
+			switch (eolTable[ch]) {
 			case 2: // '\r'
 				if (*ptr == '\n') {
 					++ptr;
 				}
+				// Fall through
 			case 1: // '\n'
-				positions[nPositions++] = position + ptr - s;
-				if (nPositions == PositionBlockSize) {
-					plv->InsertLines(lineInsert, positions, nPositions, atLineStart);
-					lineInsert += nPositions;
-					nPositions = 0;
+				addLineStart(position + ptr - s);
+				break;
+			case 3: // LS and PS
+				if (byteBefore(ptr - 1) == 0x80 && byteBefore(ptr - 2) == 0xe2) {
+					addLineStart(position + ptr - s);
 				}
 				break;
-			case 3:
-			case 4:
-				// LS, PS and NEL
-				if ((type == 3 && chPrev == 0x80 && chBeforePrev == 0xe2) || (type == 4 && chPrev == 0xc2)) {
-					positions[nPositions++] = position + ptr - s;
-					if (nPositions == PositionBlockSize) {
-						plv->InsertLines(lineInsert, positions, nPositions, atLineStart);
-						lineInsert += nPositions;
-						nPositions = 0;
-					}
+			case 4: // NEL
+				if (byteBefore(ptr - 1) == 0xc2) {
+					addLineStart(position + ptr - s);
 				}
 				break;
 			}
-
-			chBeforePrev = chPrev;
-			chPrev = ch;
-		} while (ptr < end);
+		}
 	}
 
 	if (nPositions != 0) {
@@ -1072,6 +1279,8 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 		lineInsert += nPositions;
 	}
 
+	chPrev = byteBefore(end);
+	chBeforePrev = byteBefore(end - 1);
 	ch = *end;
 	if (ptr == end) {
 		++ptr;
@@ -1098,7 +1307,7 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 		chPrev = ch;
 		// May have end of UTF-8 line end in buffer and start in insertion
 		for (int j = 0; j < UTF8SeparatorLength-1; j++) {
-			const unsigned char chAt = substance.ValueAt(position + insertLength + j);
+			const unsigned char chAt = CharAt(position + insertLength + j);
 			const unsigned char back3[3] = {chBeforePrev, chPrev, chAt};
 			if (UTF8IsSeparator(back3)) {
 				InsertLine(lineInsert, (position + insertLength + j) + 1, atLineStart);
@@ -1128,7 +1337,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 
 	Sci::Line lineRecalculateStart = INVALID_POSITION;
 
-	if ((position == 0) && (deleteLength == substance.Length())) {
+	if ((position == 0) && (deleteLength == Length())) {
 		// If whole buffer is being deleted, faster to reinitialise lines data
 		// than to delete each line.
 		plv->Init();
@@ -1140,9 +1349,9 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 		Sci::Line lineRemove = linePosition + 1;
 
 		plv->InsertText(lineRemove-1, - (deleteLength));
-		const unsigned char chPrev = substance.ValueAt(position - 1);
+		const unsigned char chPrev = CharAt(position - 1);
 		const unsigned char chBefore = chPrev;
-		unsigned char chNext = substance.ValueAt(position);
+		unsigned char chNext = CharAt(position);
 
 		// Check for breaking apart a UTF-8 sequence
 		// Needs further checks that text is UTF-8 or that some other break apart is occurring
@@ -1182,7 +1391,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 
 		unsigned char ch = chNext;
 		for (Sci::Position i = 0; i < deleteLength; i++) {
-			chNext = substance.ValueAt(position + i + 1);
+			chNext = CharAt(position + i + 1);
 			if (ch == '\r') {
 				if (chNext != '\n') {
 					RemoveLine(lineRemove);
@@ -1196,7 +1405,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 			} else if (utf8LineEnds) {
 				if (!UTF8IsAscii(ch)) {
 					const unsigned char next3[3] = {ch, chNext,
-						static_cast<unsigned char>(substance.ValueAt(position + i + 2))};
+						static_cast<unsigned char>(CharAt(position + i + 2))};
 					if (UTF8IsSeparator(next3) || UTF8IsNEL(next3)) {
 						RemoveLine(lineRemove);
 					}
@@ -1207,18 +1416,23 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 		}
 		// May have to fix up end if last deletion causes cr to be next to lf
 		// or removes one of a crlf pair
-		const char chAfter = substance.ValueAt(position + deleteLength);
+		const char chAfter = CharAt(position + deleteLength);
 		if (chBefore == '\r' && chAfter == '\n') {
 			// Using lineRemove-1 as cr ended line before start of deletion
 			RemoveLine(lineRemove - 1);
 			plv->SetLineStart(lineRemove - 1, position + 1);
 		}
 	}
-	substance.DeleteRange(position, deleteLength);
+	if (chunkedSubstance)
+		chunkedSubstance->DeleteRange(position, deleteLength);
+	else
+		substance.DeleteRange(position, deleteLength);
 	if (lineRecalculateStart >= 0) {
 		RecalculateIndexLineStarts(lineRecalculateStart, lineRecalculateStart);
 	}
-	if (hasStyles) {
+	if (chunkedStyle) {
+		chunkedStyle->DeleteRange(position, deleteLength);
+	} else if (hasStyles) {
 		style.DeleteRange(position, deleteLength);
 	}
 }
@@ -1250,6 +1464,18 @@ void CellBuffer::DeleteUndoHistory() {
 	uh.DeleteUndoHistory();
 }
 
+void CellBuffer::SetUndoMemoryLimit(size_t limit) {
+	uh.SetMemoryLimit(limit);
+}
+
+size_t CellBuffer::GetUndoMemoryLimit() const noexcept {
+	return uh.GetMemoryLimit();
+}
+
+size_t CellBuffer::GetUndoMemory() const noexcept {
+	return uh.GetMemory();
+}
+
 bool CellBuffer::CanUndo() const noexcept {
 	return uh.CanUndo();
 }
@@ -1265,7 +1491,7 @@ const Action &CellBuffer::GetUndoStep() const {
 void CellBuffer::PerformUndoStep() {
 	const Action &actionStep = uh.GetUndoStep();
 	if (actionStep.at == insertAction) {
-		if (substance.Length() < actionStep.lenData) {
+		if (Length() < actionStep.lenData) {
 			throw std::runtime_error(
 				"CellBuffer::PerformUndoStep: deletion must be less than document length.");
 		}
@@ -25,6 +25,8 @@ public:
  */
 class ILineVector;
 
+template <typename T> class ChunkedVector;
+
 enum actionType { insertAction, removeAction, startAction, containerAction };
 
 /**
@@ -45,6 +47,8 @@ public:
 	Action &operator=(const Action &&other) = delete;
 	// Move constructor allows vector to be resized without reallocating.
 	Action(Action &&other) noexcept = default;
+	// Move assignment allows the oldest actions to be erased from the vector.
+	Action &operator=(Action &&other) noexcept = default;
 	~Action();
 	void Create(actionType at_, Sci::Position position_=0, const char *data_=nullptr, Sci::Position lenData_=0, bool mayCoalesce_=true);
 	void Clear() noexcept;
@@ -60,8 +64,12 @@ class UndoHistory {
 	int undoSequenceDepth;
 	int savePoint;
 	int tentativePoint;
+	size_t memory;	/// Used by the data of the actions.
+	size_t memoryLimit;
 
 	void EnsureUndoRoom();
+	void SetAction(int index, actionType at, Sci::Position position=0, const char *data=nullptr, Sci::Position lengthData=0, bool mayCoalesce=true);
+	void DropOldestActions();
 
 public:
 	UndoHistory();
@@ -79,9 +87,16 @@ public:
 	void DropUndoSequence();
 	void DeleteUndoHistory();
 
+	/// The memory used by the actions and their data can be limited, then the oldest
+	/// user operations are dropped when it is exceeded.
+	void SetMemoryLimit(size_t limit);
+	size_t GetMemoryLimit() const noexcept;
+	size_t GetMemory() const noexcept;
+
 	/// The save point is a marker in the undo stack where the container has stated that
 	/// the buffer was saved. Undo and redo can move over the save point.
 	void SetSavePoint() noexcept;
+	void DiscardSavePoint() noexcept;
 	bool IsSavePoint() const noexcept;
 
 	// Tentative actions are used for input composition so that it can be undone cleanly
@@ -106,6 +121,8 @@ public:
  * Holder for an expandable array of characters that supports undo and line markers.
  * Based on article "Data Structures in a Bit-Mapped Text Editor"
  * by Wilfred J. Hansen, Byte January 1987, page 183.
+ * A chunked buffer holds the characters and styles in ChunkedVectors instead of SplitVectors
+ * so that huge documents need neither a single allocation nor moving the gap across them.
  */
 class CellBuffer {
 private:
@@ -113,6 +130,8 @@ private:
 	bool largeDocument;
 	SplitVector<char> substance;
 	SplitVector<char> style;
+	std::unique_ptr<ChunkedVector<char>> chunkedSubstance;
+	std::unique_ptr<ChunkedVector<char>> chunkedStyle;
 	bool readOnly;
 	bool utf8Substance;
 	int utf8LineEnds;
@@ -133,7 +152,7 @@ private:
 
 public:
 
-	CellBuffer(bool hasStyles_, bool largeDocument_);
+	CellBuffer(bool hasStyles_, bool largeDocument_, bool chunked_);
 	// Deleted so CellBuffer objects can not be copied.
 	CellBuffer(const CellBuffer &) = delete;
 	CellBuffer(CellBuffer &&) = delete;
@@ -148,8 +167,10 @@ public:
 	char StyleAt(Sci::Position position) const noexcept;
 	void GetStyleRange(unsigned char *buffer, Sci::Position position, Sci::Position lengthRetrieve) const;
 	const char *BufferPointer();
-	const char *RangePointer(Sci::Position position, Sci::Position rangeLength) noexcept;
+	void ReleaseBufferPointer();
+	const char *RangePointer(Sci::Position position, Sci::Position rangeLength);
 	Sci::Position GapPosition() const noexcept;
+	Sci::Position ContiguousEnd(Sci::Position position) const noexcept;
 
 	Sci::Position Length() const noexcept;
 	void Allocate(Sci::Position newSize);
@@ -180,11 +201,13 @@ public:
 	bool IsReadOnly() const noexcept;
 	void SetReadOnly(bool set) noexcept;
 	bool IsLarge() const noexcept;
+	bool IsChunked() const noexcept;
 	bool HasStyles() const noexcept;
 
 	/// The save point is a marker in the undo stack where the container has stated that
 	/// the buffer was saved. Undo and redo can move over the save point.
 	void SetSavePoint();
+	void DiscardSavePoint() noexcept;
 	bool IsSavePoint() const noexcept;
 
 	void TentativeStart();
@@ -198,6 +221,9 @@ public:
 	void EndUndoAction();
 	void AddUndoAction(Sci::Position token, bool mayCoalesce);
 	void DeleteUndoHistory();
+	void SetUndoMemoryLimit(size_t limit);
+	size_t GetUndoMemoryLimit() const noexcept;
+	size_t GetUndoMemory() const noexcept;
 
 	/// To perform an undo, StartUndo is called to retrieve the number of steps, then UndoStep is
 	/// called that many times. Similarly for redo.
@@ -0,0 +1,309 @@
+// Scintilla source code edit control
+/** @file ChunkedVector.h
+ ** Array held in bounded chunks, for documents too large for a single allocation.
+ **/
+// Copyright 2026 The Geany contributors
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef CHUNKEDVECTOR_H
+#define CHUNKEDVECTOR_H
+
+namespace Scintilla {
+
+/**
+ * An alternative to SplitVector for very large arrays: the elements are held in chunks of at
+ * most chunkSize elements, indexed by a Partitioning of their start positions. No operation
+ * allocates or moves more than a chunk, except BufferPointer which makes a contiguous copy
+ * kept until the next modification or ReleaseBufferPointer.
+ * Every chunk is non-empty, unless the whole vector is empty and then there is one empty chunk.
+ * The chunk found last is cached, so sequential access doesn't search; this makes const access
+ * unsafe from several threads.
+ */
+template <typename T>
+class ChunkedVector {
+	static constexpr ptrdiff_t chunkSize = 0x10000;
+
+	std::vector<std::vector<T>> chunks;
+	Partitioning<ptrdiff_t> starts;
+	T empty;	/// Returned as the result of out-of-bounds access.
+	ptrdiff_t lengthBody;
+	mutable ptrdiff_t cacheChunk;
+	mutable ptrdiff_t cacheStart;
+	mutable ptrdiff_t cacheEnd;
+	std::vector<T> whole;	/// Copy returned by BufferPointer, or empty.
+	std::vector<T> rangeCopy;	/// Copy returned by RangePointer for ranges across chunks.
+
+	void Invalidate() noexcept {
+		cacheChunk = 0;
+		cacheStart = 0;
+		cacheEnd = 0;
+	}
+
+	void ReleaseCopies() {
+		whole.clear();
+		whole.shrink_to_fit();
+		rangeCopy.clear();
+		rangeCopy.shrink_to_fit();
+	}
+
+	/// Find the chunk holding position, the last chunk for the end position.
+	ptrdiff_t ChunkFromPosition(ptrdiff_t position) const noexcept {
+		if (position < cacheStart || position >= cacheEnd) {
+			cacheChunk = starts.PartitionFromPosition(position);
+			cacheStart = starts.PositionFromPartition(cacheChunk);
+			cacheEnd = cacheStart + static_cast<ptrdiff_t>(chunks[cacheChunk].size());
+		}
+		return cacheChunk;
+	}
+
+	void InsertChunk(ptrdiff_t chunk, ptrdiff_t position, std::vector<T> &&elements) {
+		chunks.insert(chunks.begin() + chunk, std::move(elements));
+		starts.InsertPartition(chunk, position);
+	}
+
+	void RemoveChunk(ptrdiff_t chunk) {
+		chunks.erase(chunks.begin() + chunk);
+		// Partition 0 always starts at 0, so the first chunk is removed by removing the start
+		// of the second which is at 0 too as the first chunk is empty
+		starts.RemovePartition(chunk == 0 ? 1 : chunk);
+	}
+
+	/// Join the chunk with the next one if they fit in a chunk.
+	void MergeWithNext(ptrdiff_t chunk) {
+		if (chunk >= 0 && chunk + 1 < static_cast<ptrdiff_t>(chunks.size()) &&
+			chunks[chunk].size() + chunks[chunk + 1].size() <= chunkSize) {
+			std::vector<T> &next = chunks[chunk + 1];
+			chunks[chunk].insert(chunks[chunk].end(), next.begin(), next.end());
+			chunks.erase(chunks.begin() + chunk + 1);
+			starts.RemovePartition(chunk + 1);
+		}
+	}
+
+	/// Insert insertLength elements written by fill(T *destination, ptrdiff_t length),
+	/// which is called for consecutive parts of the insertion.
+	template <typename Fill>
+	void InsertWith(ptrdiff_t position, ptrdiff_t insertLength, Fill &fill) {
+		PLATFORM_ASSERT((position >= 0) && (position <= lengthBody));
+		if ((insertLength <= 0) || (position < 0) || (position > lengthBody)) {
+			return;
+		}
+		Invalidate();
+		ReleaseCopies();
+		ptrdiff_t chunk = starts.PartitionFromPosition(position);
+		const ptrdiff_t offset = position - starts.PositionFromPartition(chunk);
+		starts.InsertText(chunk, insertLength);
+		lengthBody += insertLength;
+		if (chunks[chunk].size() + insertLength <= chunkSize) {
+			std::vector<T> &target = chunks[chunk];
+			target.insert(target.begin() + offset, insertLength, T());
+			fill(target.data() + offset, insertLength);
+			return;
+		}
+
+		// Split the chunk at position, fill it up and add chunks for the rest of the insertion,
+		// then add the elements after position back
+		std::vector<T> tail(chunks[chunk].begin() + offset, chunks[chunk].end());
+		chunks[chunk].resize(offset);
+		ptrdiff_t insertion = position;
+		ptrdiff_t remaining = insertLength;
+		while (remaining > 0) {
+			if (static_cast<ptrdiff_t>(chunks[chunk].size()) >= chunkSize) {
+				chunk++;
+				InsertChunk(chunk, insertion, std::vector<T>());
+			}
+			std::vector<T> &target = chunks[chunk];
+			const ptrdiff_t sizeBefore = target.size();
+			const ptrdiff_t part = std::min(remaining, chunkSize - sizeBefore);
+			target.reserve(std::min(chunkSize, sizeBefore + remaining + static_cast<ptrdiff_t>(tail.size())));
+			target.resize(sizeBefore + part);
+			fill(target.data() + sizeBefore, part);
+			insertion += part;
+			remaining -= part;
+		}
+		if (!tail.empty()) {
+			if (chunks[chunk].size() + tail.size() <= chunkSize) {
+				chunks[chunk].insert(chunks[chunk].end(), tail.begin(), tail.end());
+			} else {
+				InsertChunk(chunk + 1, insertion, std::move(tail));
+			}
+		}
+	}
+
+public:
+	ChunkedVector() : starts(8), empty(), lengthBody(0), cacheChunk(0), cacheStart(0), cacheEnd(0) {
+		chunks.emplace_back();
+	}
+
+	// Deleted so ChunkedVector objects can not be copied.
+	ChunkedVector(const ChunkedVector &) = delete;
+	ChunkedVector(ChunkedVector &&) = delete;
+	void operator=(const ChunkedVector &) = delete;
+	void operator=(ChunkedVector &&) = delete;
+
+	~ChunkedVector() {
+	}
+
+	/// Retrieve the element at a particular position.
+	/// Retrieving positions outside the range of the buffer returns empty or 0.
+	const T &ValueAt(ptrdiff_t position) const noexcept {
+		if (position < 0 || position >= lengthBody) {
+			return empty;
+		}
+		const ptrdiff_t chunk = ChunkFromPosition(position);
+		return chunks[chunk][position - cacheStart];
+	}
+
+	/// Set the element at a particular position.
+	/// Setting positions outside the range of the buffer performs no assignment
+	/// but asserts in debug builds.
+	void SetValueAt(ptrdiff_t position, T v) noexcept {
+		PLATFORM_ASSERT(position >= 0 && position < lengthBody);
+		if (position < 0 || position >= lengthBody) {
+			return;
+		}
+		const ptrdiff_t chunk = ChunkFromPosition(position);
+		chunks[chunk][position - cacheStart] = v;
+		if (!whole.empty()) {
+			whole[position] = v;
+		}
+	}
+
+	/// Retrieve the length of the buffer.
+	ptrdiff_t Length() const noexcept {
+		return lengthBody;
+	}
+
+	/// Insert a number of elements into the buffer setting their value.
+	void InsertValue(ptrdiff_t position, ptrdiff_t insertLength, T v) {
+		auto fill = [v](T *destination, ptrdiff_t length) {
+			std::fill(destination, destination + length, v);
+		};
+		InsertWith(position, insertLength, fill);
+	}
+
+	/// Insert text into the buffer from an array.
+	void InsertFromArray(ptrdiff_t positionToInsert, const T s[], ptrdiff_t positionFrom, ptrdiff_t insertLength) {
+		const T *source = s + positionFrom;
+		auto fill = [&source](T *destination, ptrdiff_t length) {
+			std::copy(source, source + length, destination);
+			source += length;
+		};
+		InsertWith(positionToInsert, insertLength, fill);
+	}
+
+	/// Delete a range from the buffer.
+	/// Deleting positions outside the current range fails.
+	void DeleteRange(ptrdiff_t position, ptrdiff_t deleteLength) {
+		PLATFORM_ASSERT((position >= 0) && (position + deleteLength <= lengthBody));
+		if ((position < 0) || ((position + deleteLength) > lengthBody)) {
+			return;
+		}
+		if ((position == 0) && (deleteLength == lengthBody)) {
+			DeleteAll();
+			return;
+		}
+		if (deleteLength <= 0) {
+			return;
+		}
+		Invalidate();
+		ReleaseCopies();
+		ptrdiff_t chunk = starts.PartitionFromPosition(position);
+		ptrdiff_t offset = position - starts.PositionFromPartition(chunk);
+		const ptrdiff_t chunkBefore = (offset > 0) ? chunk : chunk - 1;
+		ptrdiff_t remaining = deleteLength;
+		while (remaining > 0) {
+			std::vector<T> &target = chunks[chunk];
+			const ptrdiff_t part = std::min(remaining, static_cast<ptrdiff_t>(target.size()) - offset);
+			target.erase(target.begin() + offset, target.begin() + offset + part);
+			starts.InsertText(chunk, -part);
+			lengthBody -= part;
+			remaining -= part;
+			if (target.empty()) {
+				RemoveChunk(chunk);
+			} else {
+				chunk++;
+			}
+			offset = 0;
+		}
+		// Avoid accumulating small chunks around the deletion point
+		MergeWithNext(std::max<ptrdiff_t>(chunkBefore, 0));
+		MergeWithNext(chunkBefore - 1);
+	}
+
+	/// Delete all the buffer contents.
+	void DeleteAll() {
+		chunks.clear();
+		chunks.emplace_back();
+		starts.DeleteAll();
+		lengthBody = 0;
+		Invalidate();
+		ReleaseCopies();
+	}
+
+	/// Retrieve a range of elements into an array
+	void GetRange(T *buffer, ptrdiff_t position, ptrdiff_t retrieveLength) const noexcept {
+		while (retrieveLength > 0) {
+			const ptrdiff_t chunk = ChunkFromPosition(position);
+			const std::vector<T> &source = chunks[chunk];
+			const ptrdiff_t offset = position - cacheStart;
+			const ptrdiff_t part = std::min(retrieveLength, static_cast<ptrdiff_t>(source.size()) - offset);
+			if (part <= 0)
+				break;
+			std::copy(source.data() + offset, source.data() + offset + part, buffer);
+			buffer += part;
+			position += part;
+			retrieveLength -= part;
+		}
+	}
+
+	/// Return a contiguous copy of the elements, valid until the next modification,
+	/// with an empty element beyond logical end.
+	T *BufferPointer() {
+		if (whole.empty()) {
+			whole.resize(lengthBody + 1);
+			GetRange(whole.data(), 0, lengthBody);
+			whole[lengthBody] = T();
+		}
+		return whole.data();
+	}
+
+	/// Free the copy made by BufferPointer.
+	void ReleaseBufferPointer() {
+		whole.clear();
+		whole.shrink_to_fit();
+	}
+
+	/// Return a pointer to a range of elements, valid until the next modification or
+	/// call to RangePointer. Ranges across chunks are copied.
+	T *RangePointer(ptrdiff_t position, ptrdiff_t rangeLength) {
+		if (!whole.empty() && position >= 0 && position <= lengthBody) {
+			return whole.data() + position;
+		}
+		if (position >= 0 && position < lengthBody) {
+			const ptrdiff_t chunk = ChunkFromPosition(position);
+			if (position + rangeLength <= cacheEnd) {
+				return chunks[chunk].data() + (position - cacheStart);
+			}
+		}
+		if (rangeLength <= 0 || position < 0 || position + rangeLength > lengthBody) {
+			return &empty;
+		}
+		rangeCopy.resize(rangeLength);
+		GetRange(rangeCopy.data(), position, rangeLength);
+		return rangeCopy.data();
+	}
+
+	/// Return the end of the chunk holding position, up to which a range starting at
+	/// position is not copied by RangePointer.
+	ptrdiff_t ContiguousEnd(ptrdiff_t position) const noexcept {
+		if (position < 0 || position >= lengthBody) {
+			return lengthBody;
+		}
+		ChunkFromPosition(position);
+		return cacheEnd;
+	}
+};
+
+}
+
+#endif
@@ -19,6 +19,8 @@
 #include <algorithm>
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <thread>
 
 #ifndef NO_CXX11_REGEX
 #include <regex>
@@ -42,14 +44,41 @@
 #include "Decoration.h"
 #include "CaseFolder.h"
 #include "Document.h"
+#include "BackgroundStyler.h"
 #include "RESearch.h"
+#include "LinearRegex.h"
 #include "UniConversion.h"
 #include "ElapsedPeriod.h"
 
 using namespace Scintilla;
 
+namespace {
+
+// Time a background lexing job should take, as the main thread waits for it when it needs
+// the styles or the lexer
+constexpr double secondsBackgroundJob = 0.01;
+
+// Text lexed by each thread when lexing in parallel, so that the chunks which have to be lexed
+// again because they started in a different state than expected are not long
+constexpr Sci::Position parallelChunkLength = 0x40000;
+
+// Chunks per thread lexed at once when lexing in parallel. As the chunks are copied to be
+// lexed, this bounds the extra memory to about parallelChunkLength * parallelBatchChunks
+// per thread, whatever the length of the document.
+constexpr Sci::Position parallelBatchChunks = 4;
+
+}
+
+LexInterface::LexInterface(Document *pdoc_) noexcept : pdoc(pdoc_), instance(nullptr), performingStyle(false) {
+}
+
+LexInterface::~LexInterface() {
+}
+
 void LexInterface::Colourise(Sci::Position start, Sci::Position end) {
 	if (pdoc && instance && !performingStyle) {
+		FinishBackground();
+
 		// Protect against reentrance, which may occur, for example, when
 		// fold points are discovered while performing styling and the folding
 		// code looks for child lines which may trigger styling.
@@ -76,7 +105,119 @@ void LexInterface::Colourise(Sci::Position start, Sci::Position end) {
 	}
 }
 
+// Lex a large range in chunks on several threads, with copies of the lexer, then fold it all
+// at once. Chunks ending up different from lexing the whole range are lexed again, so this
+// only helps when most chunks start in the state the lexer is in there when lexing the whole
+// range, such as after a change of colours or at the start of constructs in the text.
+// The range is lexed in batches of a few chunks per thread, each batch starting from the
+// styles of the one before.
+void LexInterface::ColouriseParallel(Sci::Position start, Sci::Position end, int threads) {
+	if (!pdoc || !instance || performingStyle) {
+		return;
+	}
+	if (end == -1)
+		end = pdoc->Length();
+	std::vector<ILexer *> lexers;
+	if (threads > 1 && (end - start) / parallelChunkLength > 1) {
+		lexers.push_back(instance);
+		while (static_cast<int>(lexers.size()) < threads) {
+			ILexer *copy = CopyLexer();
+			if (!copy) {
+				break;
+			}
+			lexers.push_back(copy);
+		}
+	}
+	if (lexers.size() < 2) {
+		Colourise(start, end);
+		return;
+	}
+
+	FinishBackground();
+	performingStyle = true;
+	const int styleStart = (start > 0) ? pdoc->StyleAt(start - 1) : 0;
+	const Sci::Position lengthBatch = parallelChunkLength * parallelBatchChunks * lexers.size();
+	Sci::Position batchStart = start;
+	while (batchStart < end) {
+		Sci::Position batchEnd = end;
+		// The last batch takes the rest rather than leaving a short one
+		if (end - batchStart >= 2 * lengthBatch) {
+			batchEnd = pdoc->LineStart(pdoc->SciLineFromPosition(batchStart + lengthBatch));
+			if (batchEnd <= batchStart)
+				batchEnd = end;
+		}
+		ParallelStyler styler(pdoc, batchStart, batchEnd,
+			std::max<size_t>((batchEnd - batchStart) / parallelChunkLength, 1));
+		styler.Colourise(pdoc, instance, lexers);
+		batchStart = batchEnd;
+	}
+	instance->Fold(start, end - start, styleStart, pdoc);
+	performingStyle = false;
+
+	for (size_t index = 1; index < lexers.size(); index++) {
+		lexers[index]->Release();
+	}
+}
+
+// Start lexing the text after the styled part, up to end, on a worker thread unless a job
+// is running already. A finished job is merged first. Returns whether a job is running.
+bool LexInterface::ColouriseInBackground(Sci::Position end) {
+	if (!pdoc || !instance || performingStyle) {
+		return false;
+	}
+	if (background) {
+		if (!background->Finished()) {
+			return true;
+		}
+		FinishBackground();
+	}
+	const Sci::Line lineFirst = pdoc->SciLineFromPosition(pdoc->GetEndStyled());
+	const Sci::Position start = pdoc->LineStart(lineFirst);
+	if (start >= end) {
+		return false;
+	}
+	const Sci::Line linesToStyle = Sci::clamp(static_cast<int>(secondsBackgroundJob / pdoc->durationStyleOneLine.Duration()),
+		10, 0x10000);
+	const Sci::Position endJob = std::min(pdoc->LineStart(lineFirst + linesToStyle), end);
+	background = Sci::make_unique<BackgroundStyler>(pdoc, instance, start, endJob);
+	return true;
+}
+
+// Wait for the background job and merge its results, lexing its range again when the
+// lexer needed text outside the snapshot.
+void LexInterface::FinishBackground() {
+	if (!background || performingStyle) {
+		return;
+	}
+	// Taken from background so nothing started by merging can reach it
+	const std::unique_ptr<BackgroundStyler> job = std::move(background);
+	performingStyle = true;
+	const BackgroundStyler::Result result = job->Merge(pdoc);
+	performingStyle = false;
+	if (result == BackgroundStyler::Result::missed) {
+		Colourise(job->Start(), job->End());
+	}
+}
+
+// Wait until the lexer isn't used by a background job, keeping the results for later.
+void LexInterface::WaitBackground() {
+	if (background) {
+		background->Wait();
+	}
+}
+
+void LexInterface::CancelBackground() {
+	background.reset();
+}
+
+void LexInterface::InvalidateBackground() noexcept {
+	if (background) {
+		background->Invalidate();
+	}
+}
+
 int LexInterface::LineEndTypesSupported() {
+	WaitBackground();
 	if (instance) {
 		const int interfaceVersion = instance->Version();
 		if (interfaceVersion >= lvSubStyles) {
@@ -87,6 +228,12 @@ int LexInterface::LineEndTypesSupported() {
 	return 0;
 }
 
+// A new lexer configured as the current one, for lexing in parallel. Only possible for
+// lexers which keep no state of the document themselves.
+ILexer *LexInterface::CopyLexer() {
+	return nullptr;
+}
+
 ActionDuration::ActionDuration(double duration_, double minDuration_, double maxDuration_) noexcept :
 	duration(duration_), minDuration(minDuration_), maxDuration(maxDuration_) {
 }
@@ -110,7 +257,10 @@ double ActionDuration::Duration() const noexcept {
 }
 
 Document::Document(int options) :
-	cb((options & SC_DOCUMENTOPTION_STYLES_NONE) == 0, (options & SC_DOCUMENTOPTION_TEXT_LARGE) != 0),
+	// Chunked text is meant for documents too large for 32-bit positions
+	cb((options & SC_DOCUMENTOPTION_STYLES_NONE) == 0,
+		(options & (SC_DOCUMENTOPTION_TEXT_LARGE | SC_DOCUMENTOPTION_TEXT_CHUNKED)) != 0,
+		(options & SC_DOCUMENTOPTION_TEXT_CHUNKED) != 0),
 	durationStyleOneLine(0.00001, 0.000001, 0.0001) {
 	refCount = 0;
 #ifdef _WIN32
@@ -261,6 +411,13 @@ void Document::SetSavePoint() {
 	NotifySavePoint(true);
 }
 
+void Document::DiscardSavePoint() {
+	const bool wasSavePoint = cb.IsSavePoint();
+	cb.DiscardSavePoint();
+	if (wasSavePoint)
+		NotifySavePoint(false);
+}
+
 void Document::TentativeUndo() {
 	if (!TentativeActive())
 		return;
@@ -1188,6 +1345,8 @@ EncodingFamily Document::CodePageFamily() const noexcept {
 void Document::ModifiedAt(Sci::Position pos) noexcept {
 	if (endStyled > pos)
 		endStyled = pos;
+	if (pli)
+		pli->InvalidateBackground();
 }
 
 void Document::CheckReadOnly() {
@@ -1691,6 +1850,7 @@ void Document::ConvertLineEnds(int eolModeSet) {
 
 int Document::Options() const noexcept {
 	return (IsLarge() ? SC_DOCUMENTOPTION_TEXT_LARGE : 0) |
+		(cb.IsChunked() ? SC_DOCUMENTOPTION_TEXT_CHUNKED : 0) |
 		(cb.HasStyles() ? 0 : SC_DOCUMENTOPTION_STYLES_NONE);
 }
 
@@ -1975,6 +2135,79 @@ bool Document::HasCaseFolder() const noexcept {
 
 void Document::SetCaseFolder(CaseFolder *pcf_) noexcept {
 	pcf.reset(pcf_);
+	foldTable.clear();
+}
+
+// Single byte folding of the case folder, so searches don't call it for every byte.
+const char *Document::FoldTable() {
+	if (foldTable.empty()) {
+		foldTable.resize(256);
+		for (int ch = 0; ch < 256; ch++) {
+			const char mixed = static_cast<char>(ch);
+			char folded[UTF8MaxBytes * 4 + 1] = "";
+			pcf->Fold(folded, sizeof(folded), &mixed, 1);
+			foldTable[ch] = folded[0];
+		}
+	}
+	return foldTable.data();
+}
+
+// Returns the first position in [pos, endPos) which is not an ASCII byte folding to other than ch.
+Sci::Position Document::SkipFoldedAscii(Sci::Position pos, Sci::Position endPos, const char *table, char ch) {
+	while (pos < endPos) {
+		const Sci::Position partLength = std::min(cb.ContiguousEnd(pos), endPos) - pos;
+		const char *part = cb.RangePointer(pos, partLength);
+		for (Sci::Position i = 0; i < partLength; i++) {
+			const unsigned char uch = part[i];
+			if (!UTF8IsAscii(uch) || (table[uch] == ch))
+				return pos + i;
+		}
+		pos += partLength;
+	}
+	return endPos;
+}
+
+// Forward search for lengthFind bytes starting in [pos, endSearch). The contiguous parts of the
+// buffer are scanned directly, without moving the gap or copying. With a fold table,
+// document bytes are folded before being compared with the already folded search.
+// Only valid where a match may start at any byte.
+Sci::Position Document::FindBytesForward(Sci::Position pos, Sci::Position endSearch, const char *search,
+	Sci::Position lengthFind, const char *table, bool word, bool wordStart) {
+	while (pos < endSearch) {
+		const Sci::Position partEnd = cb.ContiguousEnd(pos);
+		const Sci::Position partLength = std::min(partEnd, endSearch) - pos;
+		const char *part = cb.RangePointer(pos, partLength);
+		Sci::Position i = 0;
+		while (i < partLength) {
+			if (table) {
+				while ((i < partLength) && (table[static_cast<unsigned char>(part[i])] != search[0]))
+					i++;
+			} else {
+				const void *hit = memchr(part + i, static_cast<unsigned char>(search[0]), static_cast<size_t>(partLength - i));
+				i = hit ? static_cast<const char *>(hit) - part : partLength;
+			}
+			if (i >= partLength)
+				break;
+			const Sci::Position candidate = pos + i;
+			bool found = true;
+			if (!table && (candidate + lengthFind <= partEnd)) {
+				found = memcmp(part + i + 1, search + 1, static_cast<size_t>(lengthFind - 1)) == 0;
+			} else {
+				for (Sci::Position indexSearch = 1; (indexSearch < lengthFind) && found; indexSearch++) {
+					// Bytes past the end of this part are in the next one
+					const char ch = (candidate + indexSearch < partEnd) ?
+						part[i + indexSearch] : cb.CharAt(candidate + indexSearch);
+					found = (table ? table[static_cast<unsigned char>(ch)] : ch) == search[indexSearch];
+				}
+			}
+			if (found && MatchesWordOptions(word, wordStart, candidate, lengthFind)) {
+				return candidate;
+			}
+			i++;
+		}
+		pos += partLength;
+	}
+	return -1;
 }
 
 Document::CharacterExtracted Document::ExtractCharacter(Sci::Position position) const noexcept {
@@ -2035,6 +2268,11 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 		if (caseSensitive) {
 			const Sci::Position endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			const char charStartSearch =  search[0];
+			// A valid UTF-8 search can only match at the start of a character, so any byte may be a start
+			if (forward && (!dbcsCodePage ||
+				((SC_CP_UTF8 == dbcsCodePage) && !UTF8IsTrailByte(static_cast<unsigned char>(charStartSearch))))) {
+				return FindBytesForward(pos, endSearch, search, lengthFind, nullptr, word, wordStart);
+			}
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
 				if (CharAt(pos) == charStartSearch) {
 					bool found = (pos + lengthFind) <= limitPos;
@@ -2053,9 +2291,16 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 			std::vector<char> searchThing((lengthFind+1) * UTF8MaxBytes * maxFoldingExpansion + 1);
 			const size_t lenSearch =
 				pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			const char *table = FoldTable();
 			char bytes[UTF8MaxBytes + 1] = "";
 			char folded[UTF8MaxBytes * maxFoldingExpansion + 1] = "";
 			while (forward ? (pos < endPos) : (pos >= endPos)) {
+				if (forward) {
+					// Skip ASCII characters which can't start a match without decoding them
+					pos = SkipFoldedAscii(pos, endPos, table, searchThing[0]);
+					if (pos >= endPos)
+						break;
+				}
 				int widthFirstCharacter = 0;
 				Sci::Position posIndexDocument = pos;
 				size_t indexSearch = 0;
@@ -2075,7 +2320,13 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 						widthFirstCharacter = widthChar;
 					if ((posIndexDocument + widthChar) > limitPos)
 						break;
-					const size_t lenFlat = pcf->Fold(folded, sizeof(folded), bytes, widthChar);
+					size_t lenFlat = 1;
+					if (UTF8IsAscii(leadByte)) {
+						// ASCII folds to ASCII
+						folded[0] = table[leadByte];
+					} else {
+						lenFlat = pcf->Fold(folded, sizeof(folded), bytes, widthChar);
+					}
 					// memcmp may examine lenFlat bytes in both arguments so assert it doesn't read past end of searchThing
 					assert((indexSearch + lenFlat) <= searchThing.size());
 					// Does folded match the buffer
@@ -2141,6 +2392,9 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 			const Sci::Position endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			std::vector<char> searchThing(lengthFind + 1);
 			pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			if (forward) {
+				return FindBytesForward(pos, endSearch, &searchThing[0], lengthFind, FoldTable(), word, wordStart);
+			}
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
 				bool found = (pos + lengthFind) <= limitPos;
 				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
@@ -2257,9 +2511,13 @@ void Document::EnsureStyledTo(Sci::Position pos) {
 	if ((enteredStyling == 0) && (pos > GetEndStyled())) {
 		IncrementStyleClock();
 		if (pli && !pli->UseContainerLexing()) {
-			const Sci::Line lineEndStyled = SciLineFromPosition(GetEndStyled());
-			const Sci::Position endStyledTo = LineStart(lineEndStyled);
-			pli->Colourise(endStyledTo, pos);
+			// A background job may style up to pos
+			pli->FinishBackground();
+			if (pos > GetEndStyled()) {
+				const Sci::Line lineEndStyled = SciLineFromPosition(GetEndStyled());
+				const Sci::Position endStyledTo = LineStart(lineEndStyled);
+				pli->Colourise(endStyledTo, pos);
+			}
 		} else {
 			// Ask the watchers to style, and stop as soon as one responds.
 			for (std::vector<WatcherWithUserData>::iterator it = watchers.begin();
@@ -2699,7 +2957,7 @@ Sci::Position Document::BraceMatch(Sci::Position position, Sci::Position /*maxRe
  */
 class BuiltinRegex : public RegexSearchBase {
 public:
-	explicit BuiltinRegex(CharClassify *charClassTable) : search(charClassTable) {}
+	explicit BuiltinRegex(CharClassify *charClassTable) : search(charClassTable), linear(charClassTable) {}
 	BuiltinRegex(const BuiltinRegex &) = delete;
 	BuiltinRegex(BuiltinRegex &&) = delete;
 	BuiltinRegex &operator=(const BuiltinRegex &) = delete;
@@ -2714,6 +2972,7 @@ public:
 
 private:
 	RESearch search;
+	LinearRegex linear;
 	std::string substituted;
 };
 
@@ -2784,6 +3043,55 @@ public:
 	}
 };
 
+Sci::Position LinearRegexFindText(Document *doc, Sci::Position minPos, Sci::Position maxPos, const char *s,
+	bool caseSensitive, bool posix, Sci::Position *length, LinearRegex &linear, RESearch &search) {
+	const RESearchRange resr(doc, minPos, maxPos);
+	if (linear.Compile(s, *length, caseSensitive, posix))
+		return -1;
+
+	const Sci::Position docLength = doc->Length();
+	const DocumentIndexer di(doc, docLength);
+	bool matched = false;
+	if (resr.increment == 1) {
+		// Matches can't span lines, so search the whole range at once
+		matched = linear.Execute(di, resr.startPos, resr.endPos, docLength);
+	} else {
+		// Find the last match, starting with the last line of the range
+		Sci::Position bopat[LinearRegex::MAXTAG];
+		Sci::Position eopat[LinearRegex::MAXTAG];
+		for (Sci::Line line = resr.lineRangeStart; !matched && line != resr.lineRangeBreak; line += resr.increment) {
+			const Range lineRange = resr.LineRange(line);
+			Sci::Position pos = lineRange.start;
+			int repetitions = 1000;	// Break out of infinite loop
+			while (pos <= lineRange.end && repetitions-- && linear.Execute(di, pos, lineRange.end, docLength)) {
+				std::copy(linear.bopat, linear.bopat + LinearRegex::MAXTAG, bopat);
+				std::copy(linear.eopat, linear.eopat + LinearRegex::MAXTAG, eopat);
+				matched = true;
+				pos = bopat[0] + 1;
+			}
+		}
+		if (matched) {
+			std::copy(bopat, bopat + LinearRegex::MAXTAG, linear.bopat);
+			std::copy(eopat, eopat + LinearRegex::MAXTAG, linear.eopat);
+		}
+	}
+
+	// Fill in the RESearch so substitutions can use the matches
+	search.Clear();
+	if (!matched) {
+		*length = 0;
+		return -1;
+	}
+	for (int co = 0; co < LinearRegex::MAXTAG; co++) {
+		search.bopat[co] = linear.bopat[co];
+		search.eopat[co] = linear.eopat[co];
+	}
+	// Ensure only whole characters selected
+	search.eopat[0] = doc->MovePositionOutsideChar(search.eopat[0], 1, false);
+	*length = search.eopat[0] - search.bopat[0];
+	return search.bopat[0];
+}
+
 #ifndef NO_CXX11_REGEX
 
 class ByteIterator {
@@ -3176,6 +3484,11 @@ Sci::Position BuiltinRegex::FindText(Document *doc, Sci::Position minPos, Sci::P
 	}
 #endif
 
+	if (flags & SCFIND_LINEARREGEX) {
+		return LinearRegexFindText(doc, minPos, maxPos, s,
+			caseSensitive, (flags & SCFIND_POSIX) != 0, length, linear, search);
+	}
+
 	const RESearchRange resr(doc, minPos, maxPos);
 
 	const bool posix = (flags & SCFIND_POSIX) != 0;
@@ -168,18 +168,26 @@ constexpr int LevelNumber(int level) noexcept {
 	return level & SC_FOLDLEVELNUMBERMASK;
 }
 
+class BackgroundStyler;
+
 class LexInterface {
 protected:
 	Document *pdoc;
 	ILexer *instance;
 	bool performingStyle;	///< Prevent reentrance
+	std::unique_ptr<BackgroundStyler> background;	///< Lexing on a worker thread
 public:
-	explicit LexInterface(Document *pdoc_) noexcept : pdoc(pdoc_), instance(nullptr), performingStyle(false) {
-	}
-	virtual ~LexInterface() {
-	}
+	explicit LexInterface(Document *pdoc_) noexcept;
+	virtual ~LexInterface();
 	void Colourise(Sci::Position start, Sci::Position end);
+	void ColouriseParallel(Sci::Position start, Sci::Position end, int threads);
+	bool ColouriseInBackground(Sci::Position end);
+	void FinishBackground();
+	void WaitBackground();
+	void CancelBackground();
+	void InvalidateBackground() noexcept;
 	virtual int LineEndTypesSupported();
+	virtual ILexer *CopyLexer();
 	bool UseContainerLexing() const noexcept {
 		return instance == nullptr;
 	}
@@ -232,6 +240,7 @@ private:
 	CharClassify charClass;
 	CharacterCategoryMap charMap;
 	std::unique_ptr<CaseFolder> pcf;
+	std::vector<char> foldTable;
 	Sci::Position endStyled;
 	int styleClock;
 	int enteredModification;
@@ -351,6 +360,9 @@ public:
 	bool CanUndo() const noexcept { return cb.CanUndo(); }
 	bool CanRedo() const noexcept { return cb.CanRedo(); }
 	void DeleteUndoHistory() { cb.DeleteUndoHistory(); }
+	void SetUndoMemoryLimit(size_t limit) { cb.SetUndoMemoryLimit(limit); }
+	size_t GetUndoMemoryLimit() const noexcept { return cb.GetUndoMemoryLimit(); }
+	size_t GetUndoMemory() const noexcept { return cb.GetUndoMemory(); }
 	bool SetUndoCollection(bool collectUndo) {
 		return cb.SetUndoCollection(collectUndo);
 	}
@@ -359,6 +371,7 @@ public:
 	void EndUndoAction() { cb.EndUndoAction(); }
 	void AddUndoAction(Sci::Position token, bool mayCoalesce) { cb.AddUndoAction(token, mayCoalesce); }
 	void SetSavePoint();
+	void DiscardSavePoint();
 	bool IsSavePoint() const noexcept { return cb.IsSavePoint(); }
 
 	void TentativeStart() { cb.TentativeStart(); }
@@ -367,7 +380,8 @@ public:
 	bool TentativeActive() const noexcept { return cb.TentativeActive(); }
 
 	const char * SCI_METHOD BufferPointer() override { return cb.BufferPointer(); }
-	const char *RangePointer(Sci::Position position, Sci::Position rangeLength) noexcept { return cb.RangePointer(position, rangeLength); }
+	void ReleaseBufferPointer() { cb.ReleaseBufferPointer(); }
+	const char *RangePointer(Sci::Position position, Sci::Position rangeLength) { return cb.RangePointer(position, rangeLength); }
 	Sci::Position GapPosition() const noexcept { return cb.GapPosition(); }
 
 	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
@@ -441,6 +455,12 @@ public:
 	bool HasCaseFolder() const noexcept;
 	void SetCaseFolder(CaseFolder *pcf_) noexcept;
 	Sci::Position FindText(Sci::Position minPos, Sci::Position maxPos, const char *search, int flags, Sci::Position *length);
+private:
+	const char *FoldTable();
+	Sci::Position SkipFoldedAscii(Sci::Position pos, Sci::Position endPos, const char *table, char ch);
+	Sci::Position FindBytesForward(Sci::Position pos, Sci::Position endSearch, const char *search,
+		Sci::Position lengthFind, const char *table, bool word, bool wordStart);
+public:
 	const char *SubstituteByPosition(const char *text, Sci::Position *length);
 	int LineCharacterIndex() const noexcept;
 	void AllocateLineCharacterIndex(int lineCharacterIndex);
@@ -179,6 +179,7 @@ Editor::Editor() : durationWrapOneLine(0.00001, 0.000001, 0.0001) {
 	willRedrawAll = false;
 	idleStyling = SC_IDLESTYLING_NONE;
 	needIdleStyling = false;
+	backgroundStyling = false;
 
 	modEventMask = SC_MODEVENTMASKALL;
 	commandEvents = true;
@@ -5033,6 +5034,11 @@ void Editor::TickFor(TickReason reason) {
 			}
 			FineTickerCancel(tickDwell);
 			break;
+		case tickStyle:
+			if (!backgroundStyling || !StyleInBackground()) {
+				FineTickerCancel(tickStyle);
+			}
+			break;
 		default:
 			// tickPlatform handled by subclass
 			break;
@@ -5115,6 +5121,9 @@ Sci::Position Editor::PositionAfterMaxStyling(Sci::Position posMax, bool scrolli
 }
 
 void Editor::StartIdleStyling(bool truncatedLastStyling) {
+	if (backgroundStyling && StyleInBackground()) {
+		return;
+	}
 	if ((idleStyling == SC_IDLESTYLING_ALL) || (idleStyling == SC_IDLESTYLING_AFTERVISIBLE)) {
 		if (pdoc->GetEndStyled() < pdoc->Length()) {
 			// Style remainder of document in idle time
@@ -5155,6 +5164,23 @@ void Editor::IdleStyling() {
 	}
 }
 
+// Lex the rest of the document on a worker thread, a job at a time. Finished jobs are merged
+// on a timer. Returns false if the document is styled by the container.
+bool Editor::StyleInBackground() {
+	LexInterface *pli = pdoc->GetLexInterface();
+	if (!pli || pli->UseContainerLexing()) {
+		return false;
+	}
+	if (pli->ColouriseInBackground(pdoc->Length())) {
+		if (!FineTickerRunning(tickStyle)) {
+			FineTickerStart(tickStyle, 5, 1);
+		}
+	} else {
+		FineTickerCancel(tickStyle);
+	}
+	return true;
+}
+
 void Editor::IdleWork() {
 	// Style the line after the modification as this allows modifications that change just the
 	// line of the modification to heal instead of propagating to the rest of the window.
@@ -5915,6 +5941,16 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		pdoc->DeleteUndoHistory();
 		return 0;
 
+	case SCI_SETUNDOMEMORYLIMIT:
+		pdoc->SetUndoMemoryLimit(static_cast<size_t>(wParam));
+		return 0;
+
+	case SCI_GETUNDOMEMORYLIMIT:
+		return pdoc->GetUndoMemoryLimit();
+
+	case SCI_GETUNDOMEMORY:
+		return pdoc->GetUndoMemory();
+
 	case SCI_GETFIRSTVISIBLELINE:
 		return topLine;
 
@@ -6405,6 +6441,10 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		pdoc->SetSavePoint();
 		break;
 
+	case SCI_DISCARDSAVEPOINT:
+		pdoc->DiscardSavePoint();
+		break;
+
 	case SCI_GETSTYLEDTEXT: {
 			if (lParam == 0)
 				return 0;
@@ -6677,6 +6717,16 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETIDLESTYLING:
 		return idleStyling;
 
+	case SCI_SETBACKGROUNDSTYLING:
+		backgroundStyling = wParam != 0;
+		if (!backgroundStyling) {
+			FineTickerCancel(tickStyle);
+		}
+		break;
+
+	case SCI_GETBACKGROUNDSTYLING:
+		return backgroundStyling;
+
 	case SCI_SETWRAPMODE:
 		if (vs.SetWrapState(static_cast<int>(wParam))) {
 			xOffset = 0;
@@ -7978,6 +8028,10 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETGAPPOSITION:
 		return pdoc->GapPosition();
 
+	case SCI_RELEASECHARACTERPOINTER:
+		pdoc->ReleaseBufferPointer();
+		break;
+
 	case SCI_SETEXTRAASCENT:
 		vs.extraAscent = static_cast<int>(wParam);
 		InvalidateStyleRedraw();
@@ -238,6 +238,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	WorkNeeded workNeeded;
 	int idleStyling;
 	bool needIdleStyling;
+	bool backgroundStyling;
 
 	int modEventMask;
 	bool commandEvents;
@@ -515,7 +516,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void ButtonUpWithModifiers(Point pt, unsigned int curTime, int modifiers);
 
 	bool Idle();
-	enum TickReason { tickCaret, tickScroll, tickWiden, tickDwell, tickPlatform };
+	enum TickReason { tickCaret, tickScroll, tickWiden, tickDwell, tickStyle, tickPlatform };
 	virtual void TickFor(TickReason reason);
 	virtual bool FineTickerRunning(TickReason reason);
 	virtual void FineTickerStart(TickReason reason, int millis, int tolerance);
@@ -534,6 +535,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 		return (idleStyling == SC_IDLESTYLING_NONE) || (idleStyling == SC_IDLESTYLING_AFTERVISIBLE);
 	}
 	void IdleStyling();
+	bool StyleInBackground();
 	virtual void IdleWork();
 	virtual void QueueIdleWork(WorkNeeded::workItems items, Sci::Position upTo=0);
 
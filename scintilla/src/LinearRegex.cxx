@@ -0,0 +1,559 @@
+// Scintilla source code edit control
+/** @file LinearRegex.cxx
+ ** Regular expression search in linear time.
+ **/
+// Copyright 2026 The Geany contributors
+// The License.txt file describes the conditions under which this software may be distributed.
+
+/*
+ * The pattern is compiled to a program for a Pike VM: a set of threads, one per alternative
+ * still possible, advances over the text a byte at a time. Threads are kept in priority order
+ * and threads reaching the same instruction are merged, keeping the one with the higher
+ * priority. This gives the same match as the backtracking of RESearch (leftmost, then greedy
+ * or lazy closures) while never looking at a byte twice, so the time taken is bounded by the
+ * length of the text times the length of the program.
+ *
+ * The syntax is the one documented in RESearch.cxx, except that back references (\1 to \9)
+ * are rejected as they can't be matched in linear time.
+ * Unlike RESearch, which is called for each line, the program runs over a whole range of
+ * lines: the line end characters are never matched, ^ and $ match at the start and end of
+ * lines, so matches can't span lines.
+ */
+
+#include <cstddef>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Position.h"
+#include "CharClassify.h"
+#include "RESearch.h"
+#include "LinearRegex.h"
+
+using namespace Scintilla;
+
+namespace {
+
+bool IsLineEndChar(unsigned char c) noexcept {
+	return c == '\r' || c == '\n';
+}
+
+unsigned char EscapeValue(unsigned char ch) noexcept {
+	switch (ch) {
+	case 'a':	return '\a';
+	case 'b':	return '\b';
+	case 'f':	return '\f';
+	case 'n':	return '\n';
+	case 'r':	return '\r';
+	case 't':	return '\t';
+	case 'v':	return '\v';
+	}
+	return 0;
+}
+
+int HexDigit(unsigned char hd) noexcept {
+	if (hd >= '0' && hd <= '9')
+		return hd - '0';
+	if (hd >= 'A' && hd <= 'F')
+		return hd - 'A' + 10;
+	if (hd >= 'a' && hd <= 'f')
+		return hd - 'a' + 10;
+	return -1;
+}
+
+}
+
+LinearRegex::LinearRegex(CharClassify *charClassTable) :
+	charClass(charClassTable), firstSet(), useFirstSet(false), clist(), nlist() {
+	for (int i = 0; i < MAXTAG; i++) {
+		bopat[i] = NOTFOUND;
+		eopat[i] = NOTFOUND;
+	}
+}
+
+void LinearRegex::Emit(Op op, int x, int y) {
+	program.push_back({op, x, y});
+}
+
+void LinearRegex::EmitSet(const CharSet &set) {
+	Emit(Op::Set, static_cast<int>(sets.size()));
+	sets.push_back(set);
+}
+
+void LinearRegex::EmitChar(unsigned char c, bool caseSensitive) {
+	CharSet set {};
+	set.Add(c);
+	if (!caseSensitive && iswordc(c)) {
+		if (c >= 'a' && c <= 'z')
+			set.Add(c - 'a' + 'A');
+		else if (c >= 'A' && c <= 'Z')
+			set.Add(c - 'A' + 'a');
+	}
+	EmitSet(set);
+}
+
+/*
+ * Interprets the character after a backslash like RESearch::GetBackslashExpression():
+ * returns the character, or -1 after adding a character class to set.
+ */
+int LinearRegex::GetBackslashExpression(const char *pattern, const char *end, int &incr, CharSet &set) const {
+	incr = 0;
+	if (pattern >= end)
+		return '\\';	// \ at end of pattern, take it literally
+
+	const unsigned char bsc = *pattern;
+	switch (bsc) {
+	case 'a':
+	case 'b':
+	case 'n':
+	case 'f':
+	case 'r':
+	case 't':
+	case 'v':
+		return EscapeValue(bsc);
+	case 'x':
+		if (pattern + 2 < end) {
+			const int hd1 = HexDigit(pattern[1]);
+			const int hd2 = HexDigit(pattern[2]);
+			if (hd1 >= 0 && hd2 >= 0) {
+				incr = 2;
+				return hd1 * 16 + hd2;
+			}
+		}
+		return 'x';
+	case 'd':
+	case 'D':
+	case 's':
+	case 'S':
+	case 'w':
+	case 'W':
+		for (int c = 0; c < 256; c++) {
+			const unsigned char uc = static_cast<unsigned char>(c);
+			bool in;
+			if (bsc == 'd' || bsc == 'D')
+				in = c >= '0' && c <= '9';
+			else if (bsc == 's' || bsc == 'S')
+				in = c == ' ' || (c >= 0x09 && c <= 0x0D);
+			else
+				in = iswordc(uc);
+			if (in == (bsc == 'd' || bsc == 's' || bsc == 'w'))
+				set.Add(uc);
+		}
+		return -1;
+	default:
+		return bsc;
+	}
+}
+
+const char *LinearRegex::Tag(bool open, int *tagStack, int &tagDepth, int &tagCount) {
+	if (open) {
+		if (tagCount >= MAXTAG)
+			return "Too many () pairs";
+		tagStack[tagDepth++] = tagCount;
+		Emit(Op::Save, 2 * tagCount++);
+	} else {
+		if (tagDepth == 0)
+			return "Unmatched )";
+		const int tag = tagStack[--tagDepth];
+		if (program.back().op == Op::Save && program.back().x == 2 * tag)
+			return "Null pattern inside ()";
+		Emit(Op::Save, 2 * tag + 1);
+	}
+	return nullptr;
+}
+
+const char *LinearRegex::Compile(const char *pattern, Sci::Position length, bool caseSensitive, bool posix) {
+	program.clear();
+	sets.clear();
+	useFirstSet = false;
+
+	if (!pattern || !length)
+		return "No regular expression";
+
+	int tagStack[MAXTAG];
+	int tagDepth = 0;
+	int tagCount = 1;
+	bool quantified = false;	// the last item was a closure
+
+	const char *end = pattern + length;
+	for (const char *p = pattern; p < end; p++) {
+		const bool wasQuantified = quantified;
+		quantified = false;
+
+		switch (*p) {
+
+		case '.': {
+				CharSet set;
+				memset(set.bits, 0xff, sizeof(set.bits));
+				EmitSet(set);
+			}
+			break;
+
+		case '^':
+			if (p == pattern) {
+				Emit(Op::LineStart);
+			} else {
+				EmitChar('^', true);
+			}
+			break;
+
+		case '$':
+			if (p + 1 == end) {
+				Emit(Op::LineEnd);
+			} else {
+				EmitChar('$', true);
+			}
+			break;
+
+		case '[': {
+				CharSet set {};
+				int prevChar = 0;
+				bool negate = false;
+
+				p++;
+				if (p < end && *p == '^') {
+					negate = true;
+					p++;
+				}
+				if (p < end && *p == '-') {	// real dash
+					prevChar = *p;
+					set.Add(*p++);
+				}
+				if (p < end && *p == ']') {	// real brace
+					prevChar = *p;
+					set.Add(*p++);
+				}
+				while (p < end && *p != ']') {
+					if (*p == '-') {
+						if (prevChar < 0) {
+							// Previous def. was a char class like \d, take dash literally
+							prevChar = *p;
+							set.Add(*p);
+						} else if (p + 1 < end) {
+							if (p[1] != ']') {
+								const int c1 = prevChar + 1;
+								int c2 = static_cast<unsigned char>(*++p);
+								if (c2 == '\\') {
+									if (p + 1 >= end)
+										return "Missing ]";
+									p++;
+									int incr;
+									c2 = GetBackslashExpression(p, end, incr, set);
+									p += incr;
+									if (c2 >= 0) {
+										// Convention: \c (c is any char) is case sensitive, whatever the option
+										set.Add(static_cast<unsigned char>(c2));
+										prevChar = c2;
+									} else {
+										prevChar = -1;
+									}
+								}
+								if (prevChar < 0) {
+									// Char after dash is char class like \d, take dash literally
+									prevChar = '-';
+									set.Add('-');
+								} else {
+									// Put all chars between c1 and c2 included in the char set
+									for (int c = c1; c <= c2; c++) {
+										const unsigned char uc = static_cast<unsigned char>(c);
+										set.Add(uc);
+										if (!caseSensitive && uc >= 'a' && uc <= 'z')
+											set.Add(uc - 'a' + 'A');
+										else if (!caseSensitive && uc >= 'A' && uc <= 'Z')
+											set.Add(uc - 'A' + 'a');
+									}
+								}
+							} else {
+								// Dash before the ], take it literally
+								prevChar = *p;
+								set.Add(*p);
+							}
+						} else {
+							return "Missing ]";
+						}
+					} else if (*p == '\\' && p + 1 < end) {
+						p++;
+						int incr;
+						const int c = GetBackslashExpression(p, end, incr, set);
+						p += incr;
+						if (c >= 0) {
+							set.Add(static_cast<unsigned char>(c));
+							prevChar = c;
+						} else {
+							prevChar = -1;
+						}
+					} else {
+						const unsigned char uc = *p;
+						prevChar = uc;
+						set.Add(uc);
+						if (!caseSensitive && uc >= 'a' && uc <= 'z')
+							set.Add(uc - 'a' + 'A');
+						else if (!caseSensitive && uc >= 'A' && uc <= 'Z')
+							set.Add(uc - 'A' + 'a');
+					}
+					p++;
+				}
+				if (p >= end)
+					return "Missing ]";
+
+				if (negate) {
+					for (unsigned char &bits : set.bits)
+						bits = static_cast<unsigned char>(~bits);
+				}
+				EmitSet(set);
+			}
+			break;
+
+		case '*':
+		case '+':
+		case '?': {
+				if (p == pattern)
+					return "Empty closure";
+				if (wasQuantified) {	// equivalence...
+					quantified = true;
+					break;
+				}
+				if (program.empty() || program.back().op != Op::Set)
+					return "Illegal closure";
+
+				const char closure = *p;
+				bool lazy = false;
+				if (p + 1 < end && p[1] == '?') {
+					lazy = true;
+					p++;
+				}
+				const Instruction atom = program.back();
+				program.pop_back();
+				const int k = static_cast<int>(program.size());
+				if (closure == '*') {
+					Emit(Op::Split, lazy ? k + 3 : k + 1, lazy ? k + 1 : k + 3);
+					program.push_back(atom);
+					Emit(Op::Jump, k);
+				} else if (closure == '+') {
+					program.push_back(atom);
+					Emit(Op::Split, lazy ? k + 2 : k, lazy ? k : k + 2);
+				} else {
+					Emit(Op::Split, lazy ? k + 2 : k + 1, lazy ? k + 1 : k + 2);
+					program.push_back(atom);
+				}
+				quantified = true;
+			}
+			break;
+
+		case '\\':
+			if (p + 1 >= end) {
+				EmitChar('\\', true);	// We take it as raw backslash
+				break;
+			}
+			p++;
+			if (*p == '<') {
+				Emit(Op::WordStart);
+			} else if (*p == '>') {
+				if (!program.empty() && program.back().op == Op::WordStart)
+					return "Null pattern inside \\<\\>";
+				Emit(Op::WordEnd);
+			} else if (*p >= '1' && *p <= '9') {
+				return "Back references are not supported";
+			} else if (!posix && (*p == '(' || *p == ')')) {
+				const char *errmsg = Tag(*p == '(', tagStack, tagDepth, tagCount);
+				if (errmsg)
+					return errmsg;
+			} else {
+				CharSet set {};
+				int incr;
+				const int c = GetBackslashExpression(p, end, incr, set);
+				p += incr;
+				if (c >= 0)
+					EmitChar(static_cast<unsigned char>(c), true);
+				else
+					EmitSet(set);
+			}
+			break;
+
+		default:
+			if (posix && (*p == '(' || *p == ')')) {
+				const char *errmsg = Tag(*p == '(', tagStack, tagDepth, tagCount);
+				if (errmsg)
+					return errmsg;
+			} else {
+				EmitChar(*p, caseSensitive);
+			}
+			break;
+
+		}
+	}
+	if (tagDepth > 0)
+		return posix ? "Unmatched (" : "Unmatched \\(";
+	Emit(Op::Match);
+
+	std::vector<bool> visited(program.size());
+	CharSet first {};
+	useFirstSet = CollectFirst(0, visited, first);
+	firstSet = first;
+	return nullptr;
+}
+
+/*
+ * Adds the bytes a match can start with to first and returns true, unless the program can
+ * match without consuming a byte.
+ */
+bool LinearRegex::CollectFirst(int pc, std::vector<bool> &visited, CharSet &first) const {
+	if (visited[pc])
+		return true;
+	visited[pc] = true;
+	const Instruction &ins = program[pc];
+	switch (ins.op) {
+	case Op::Set:
+		for (size_t i = 0; i < sizeof(first.bits); i++)
+			first.bits[i] |= sets[ins.x].bits[i];
+		return true;
+	case Op::Match:
+		return false;
+	case Op::Split:
+		return CollectFirst(ins.x, visited, first) && CollectFirst(ins.y, visited, first);
+	case Op::Jump:
+		return CollectFirst(ins.x, visited, first);
+	default:
+		return CollectFirst(pc + 1, visited, first);
+	}
+}
+
+/*
+ * Adds a thread at pc to list, following jumps, saving positions and checking assertions
+ * at pos, between the bytes before and at.
+ */
+void LinearRegex::AddThread(ThreadList &list, int pc, Sci::Position *caps, Sci::Position pos,
+	unsigned char before, unsigned char at, Sci::Position docLength) {
+	if (marks[pc] == list.id)
+		return;
+	marks[pc] = list.id;
+
+	const Instruction &ins = program[pc];
+	switch (ins.op) {
+	case Op::Jump:
+		AddThread(list, ins.x, caps, pos, before, at, docLength);
+		break;
+	case Op::Split:
+		AddThread(list, ins.x, caps, pos, before, at, docLength);
+		AddThread(list, ins.y, caps, pos, before, at, docLength);
+		break;
+	case Op::Save: {
+			const Sci::Position saved = caps[ins.x];
+			caps[ins.x] = pos;
+			AddThread(list, pc + 1, caps, pos, before, at, docLength);
+			caps[ins.x] = saved;
+		}
+		break;
+	case Op::LineStart:
+		if (pos == 0 || before == '\n' || (before == '\r' && at != '\n'))
+			AddThread(list, pc + 1, caps, pos, before, at, docLength);
+		break;
+	case Op::LineEnd:
+		if (pos >= docLength || at == '\r' || (at == '\n' && before != '\r'))
+			AddThread(list, pc + 1, caps, pos, before, at, docLength);
+		break;
+	case Op::WordStart:
+		if (!(pos > 0 && iswordc(before)) && pos < docLength && iswordc(at))
+			AddThread(list, pc + 1, caps, pos, before, at, docLength);
+		break;
+	case Op::WordEnd:
+		if (pos > 0 && iswordc(before) && !(pos < docLength && iswordc(at)))
+			AddThread(list, pc + 1, caps, pos, before, at, docLength);
+		break;
+	default: {
+			Thread thread;
+			thread.pc = pc;
+			std::copy(caps, caps + MAXTAG * 2, thread.caps);
+			list.threads.push_back(thread);
+		}
+		break;
+	}
+}
+
+/*
+ * Finds the first match starting in [startPos, endPos] and ending at or before endPos.
+ * The bytes around the range are looked at for assertions, so ci must give access to the
+ * whole document of docLength bytes.
+ */
+bool LinearRegex::Execute(const CharacterIndexer &ci, Sci::Position startPos, Sci::Position endPos, Sci::Position docLength) {
+	for (int i = 0; i < MAXTAG; i++) {
+		bopat[i] = NOTFOUND;
+		eopat[i] = NOTFOUND;
+	}
+	if (program.empty())
+		return false;
+
+	Sci::Position generation = 0;
+	marks.assign(program.size(), -1);
+	clist.threads.clear();
+
+	bool matched = false;
+	Sci::Position caps[MAXTAG * 2];
+	Sci::Position pos = startPos;
+	unsigned char before = pos > 0 ? ci.CharAt(pos - 1) : 0;
+	unsigned char at = ci.CharAt(pos);
+	for (;;) {
+		if (!matched) {
+			if (clist.threads.empty()) {
+				// Forget the instructions tried at an earlier position
+				clist.id = generation++;
+				if (useFirstSet) {
+					// Skip to a byte a match can start with
+					while (pos < endPos && !firstSet.Contains(at)) {
+						pos++;
+						before = at;
+						at = ci.CharAt(pos);
+					}
+					if (pos >= endPos)
+						break;
+				}
+			}
+			// A new thread starting here has the lowest priority
+			std::fill(caps, caps + MAXTAG * 2, NOTFOUND);
+			caps[0] = pos;
+			AddThread(clist, 0, caps, pos, before, at, docLength);
+		}
+		if (clist.threads.empty() && (matched || pos >= endPos))
+			break;
+
+		const bool consume = pos < endPos && !IsLineEndChar(at);
+		const unsigned char next = consume ? ci.CharAt(pos + 1) : 0;
+		nlist.threads.clear();
+		nlist.id = generation++;
+		for (Thread &thread : clist.threads) {
+			const Instruction &ins = program[thread.pc];
+			if (ins.op == Op::Match) {
+				// Threads with a lower priority than this one can't give the match
+				thread.caps[1] = pos;
+				for (int i = 0; i < MAXTAG; i++) {
+					bopat[i] = thread.caps[2 * i];
+					eopat[i] = thread.caps[2 * i + 1];
+				}
+				matched = true;
+				break;
+			}
+			if (consume && sets[ins.x].Contains(at))
+				AddThread(nlist, thread.pc + 1, thread.caps, pos + 1, at, next, docLength);
+		}
+		std::swap(clist, nlist);
+		if (!consume) {
+			if (matched || pos >= endPos)
+				break;
+			// No thread survives a line end, the next match starts after it
+			if (at == '\r' && pos + 1 < endPos && ci.CharAt(pos + 1) == '\n') {
+				pos++;
+				at = '\n';
+			}
+			pos++;
+			before = at;
+			at = ci.CharAt(pos);
+		} else {
+			pos++;
+			before = at;
+			at = next;
+		}
+	}
+	return matched;
+}
@@ -0,0 +1,77 @@
+// Scintilla source code edit control
+/** @file LinearRegex.h
+ ** Interface to the linear time regular expression search.
+ **/
+// Copyright 2026 The Geany contributors
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef LINEARREGEX_H
+#define LINEARREGEX_H
+
+namespace Scintilla {
+
+/**
+ * Regular expression search with the syntax of RESearch except back references, simulating
+ * all alternatives at once so the time taken is linear in the length of the searched text.
+ * Matches never span lines, so a whole range of lines can be searched in a single pass.
+ * It is used for SCFIND_REGEXP | SCFIND_LINEARREGEX searches, which only come from plugins:
+ * Geany's Find and Replace dialogs search with GRegex, not with Scintilla's engines.
+ */
+class LinearRegex {
+public:
+	explicit LinearRegex(CharClassify *charClassTable);
+	const char *Compile(const char *pattern, Sci::Position length, bool caseSensitive, bool posix);
+	bool Execute(const CharacterIndexer &ci, Sci::Position startPos, Sci::Position endPos, Sci::Position docLength);
+
+	static constexpr int MAXTAG = 10;
+	static constexpr int NOTFOUND = -1;
+
+	Sci::Position bopat[MAXTAG];
+	Sci::Position eopat[MAXTAG];
+
+private:
+	enum class Op { Set, Split, Jump, Save, LineStart, LineEnd, WordStart, WordEnd, Match };
+	struct Instruction {
+		Op op;
+		int x;	// set index, first branch of Split, target of Jump or slot of Save
+		int y;	// second branch of Split
+	};
+	struct CharSet {
+		unsigned char bits[32];
+		void Add(unsigned char c) noexcept { bits[c >> 3] |= 1 << (c & 7); }
+		bool Contains(unsigned char c) const noexcept { return (bits[c >> 3] & (1 << (c & 7))) != 0; }
+	};
+	struct Thread {
+		int pc;
+		Sci::Position caps[MAXTAG * 2];
+	};
+	struct ThreadList {
+		std::vector<Thread> threads;
+		Sci::Position id;
+	};
+
+	CharClassify *charClass;
+	std::vector<Instruction> program;
+	std::vector<CharSet> sets;
+	CharSet firstSet;
+	bool useFirstSet;
+	ThreadList clist;
+	ThreadList nlist;
+	std::vector<Sci::Position> marks;
+
+	bool iswordc(unsigned char x) const noexcept {
+		return charClass->IsWord(x);
+	}
+	void Emit(Op op, int x = 0, int y = 0);
+	void EmitSet(const CharSet &set);
+	void EmitChar(unsigned char c, bool caseSensitive);
+	const char *Tag(bool open, int *tagStack, int &tagDepth, int &tagCount);
+	int GetBackslashExpression(const char *pattern, const char *end, int &incr, CharSet &set) const;
+	bool CollectFirst(int pc, std::vector<bool> &visited, CharSet &first) const;
+	void AddThread(ThreadList &list, int pc, Sci::Position *caps, Sci::Position pos,
+		unsigned char before, unsigned char at, Sci::Position docLength);
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include <map>
 #include <algorithm>
 #include <memory>
+#include <thread>
 
 #include "Platform.h"
 
@@ -72,6 +73,7 @@ ScintillaBase::ScintillaBase() {
 	listType = 0;
 	maxListWidth = 0;
 	multiAutoCMode = SC_MULTIAUTOC_ONCE;
+	lexingThreads = 1;
 #ifdef SCI_LEXER
 	Scintilla_LinkLexers();
 #endif
@@ -557,6 +559,10 @@ class LexState : public LexInterface {
 	void SetLexerModule(const LexerModule *lex);
 	PropSetSimple props;
 	int interfaceVersion;
+	// What was set on the instance, to set on copies of it
+	std::map<std::string, std::string> propertiesSet;
+	std::vector<std::string> wordLists;
+	bool copyable;
 public:
 	int lexLanguage;
 
@@ -582,6 +588,7 @@ public:
 	size_t PropGetExpanded(const char *key, char *result) const;
 
 	int LineEndTypesSupported() override;
+	ILexer *CopyLexer() override;
 	int AllocateSubStyles(int styleBase, int numberStyles);
 	int SubStylesStart(int styleBase);
 	int SubStylesLength(int styleBase);
@@ -603,10 +610,12 @@ LexState::LexState(Document *pdoc_) : LexInterface(pdoc_) {
 	lexCurrent = nullptr;
 	performingStyle = false;
 	interfaceVersion = lvOriginal;
+	copyable = false;
 	lexLanguage = SCLEX_CONTAINER;
 }
 
 LexState::~LexState() {
+	CancelBackground();
 	if (instance) {
 		instance->Release();
 		instance = nullptr;
@@ -617,16 +626,22 @@ LexState *ScintillaBase::DocumentLexState() {
 	if (!pdoc->GetLexInterface()) {
 		pdoc->SetLexInterface(Sci::make_unique<LexState>(pdoc));
 	}
+	// The lexer may be in use by a background job
+	pdoc->GetLexInterface()->WaitBackground();
 	return dynamic_cast<LexState *>(pdoc->GetLexInterface());
 }
 
 void LexState::SetLexerModule(const LexerModule *lex) {
 	if (lex != lexCurrent) {
+		CancelBackground();
 		if (instance) {
 			instance->Release();
 			instance = nullptr;
 		}
 		interfaceVersion = lvOriginal;
+		propertiesSet.clear();
+		wordLists.clear();
+		copyable = true;
 		lexCurrent = lex;
 		if (lexCurrent) {
 			instance = lexCurrent->Create();
@@ -667,6 +682,12 @@ const char *LexState::DescribeWordListSets() {
 
 void LexState::SetWordList(int n, const char *wl) {
 	if (instance) {
+		if (n >= 0) {
+			if (wordLists.size() <= static_cast<size_t>(n)) {
+				wordLists.resize(n + 1);
+			}
+			wordLists[n] = wl;
+		}
 		const Sci_Position firstModification = instance->WordListSet(n, wl);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -688,6 +709,8 @@ const char *LexState::GetName() const {
 
 void *LexState::PrivateCall(int operation, void *pointer) {
 	if (pdoc && instance) {
+		// The instance may be changed in a way copies can't be
+		copyable = false;
 		return instance->PrivateCall(operation, pointer);
 	} else {
 		return nullptr;
@@ -721,6 +744,7 @@ const char *LexState::DescribeProperty(const char *name) {
 void LexState::PropSet(const char *key, const char *val) {
 	props.Set(key, val, strlen(key), strlen(val));
 	if (instance) {
+		propertiesSet[key] = val;
 		const Sci_Position firstModification = instance->PropertySet(key, val);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -741,14 +765,62 @@ size_t LexState::PropGetExpanded(const char *key, char *result) const {
 }
 
 int LexState::LineEndTypesSupported() {
+	WaitBackground();
 	if (instance && (interfaceVersion >= lvSubStyles)) {
 		return static_cast<ILexerWithSubStyles *>(instance)->LineEndTypesSupported();
 	}
 	return 0;
 }
 
+namespace {
+
+// Whether a copy of the lexer, lexing part of the document, styles it like the lexer itself.
+// Lexers implemented as functions keep no state between calls. Lexer objects can keep state
+// of the document, like the preprocessor definitions of C++ or the modes of the lines of
+// LaTeX, which a copy would not have, so only the ones checked to keep just their properties
+// and word lists are listed.
+bool LexerCanBeCopied(const LexerModule *lexer) noexcept {
+	if (!lexer->HasFactory()) {
+		return true;
+	}
+	switch (lexer->GetLanguage()) {
+	case SCLEX_ASM:
+	case SCLEX_AS:
+	case SCLEX_BASH:
+	case SCLEX_BLITZBASIC:
+	case SCLEX_PUREBASIC:
+	case SCLEX_FREEBASIC:
+	case SCLEX_D:
+	case SCLEX_HTML:
+	case SCLEX_XML:
+	case SCLEX_PHPSCRIPT:
+	case SCLEX_PERL:
+	case SCLEX_RUST:
+		return true;
+	default:
+		return false;
+	}
+}
+
+}
+
+ILexer *LexState::CopyLexer() {
+	if (!lexCurrent || !copyable || !LexerCanBeCopied(lexCurrent)) {
+		return nullptr;
+	}
+	ILexer *copy = lexCurrent->Create();
+	for (const std::pair<const std::string, std::string> &property : propertiesSet) {
+		copy->PropertySet(property.first.c_str(), property.second.c_str());
+	}
+	for (size_t n = 0; n < wordLists.size(); n++) {
+		copy->WordListSet(static_cast<int>(n), wordLists[n].c_str());
+	}
+	return copy;
+}
+
 int LexState::AllocateSubStyles(int styleBase, int numberStyles) {
 	if (instance && (interfaceVersion >= lvSubStyles)) {
+		copyable = false;
 		return static_cast<ILexerWithSubStyles *>(instance)->AllocateSubStyles(styleBase, numberStyles);
 	}
 	return -1;
@@ -790,6 +862,7 @@ void LexState::FreeSubStyles() {
 
 void LexState::SetIdentifiers(int style, const char *identifiers) {
 	if (instance && (interfaceVersion >= lvSubStyles)) {
+		copyable = false;
 		static_cast<ILexerWithSubStyles *>(instance)->SetIdentifiers(style, identifiers);
 		pdoc->ModifiedAt(0);
 	}
@@ -1071,11 +1144,19 @@ sptr_t ScintillaBase::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lPara
 			pdoc->ModifiedAt(static_cast<Sci::Position>(wParam));
 			NotifyStyleToNeeded((lParam == -1) ? pdoc->Length() : lParam);
 		} else {
-			DocumentLexState()->Colourise(static_cast<Sci::Position>(wParam), lParam);
+			DocumentLexState()->ColouriseParallel(static_cast<Sci::Position>(wParam), lParam,
+				lexingThreads ? lexingThreads : static_cast<int>(std::thread::hardware_concurrency()));
 		}
 		Redraw();
 		break;
 
+	case SCI_SETLEXINGTHREADS:
+		lexingThreads = static_cast<int>(wParam);
+		break;
+
+	case SCI_GETLEXINGTHREADS:
+		return lexingThreads;
+
 	case SCI_SETPROPERTY:
 		DocumentLexState()->PropSet(ConstCharPtrFromUPtr(wParam),
 		          ConstCharPtrFromSPtr(lParam));
@@ -43,6 +43,7 @@ protected:
 	int listType;			///< 0 is an autocomplete list
 	int maxListWidth;		/// Maximum width of list, in average character widths
 	int multiAutoCMode; /// Mode for autocompleting when multiple selections are present
+	int lexingThreads; /// Threads lexing large ranges for SCI_COLOURISE, 0 for each processor
 
 #if SCI_LEXER
 	LexState *DocumentLexState();
@@ -112,7 +112,7 @@ void on_save1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 	if (doc != NULL)
 	{
-		document_save_file(doc, ui_prefs.allow_always_save);
+		document_save_file_async(doc, ui_prefs.allow_always_save);
 	}
 }
 
@@ -137,7 +137,7 @@ void on_save_all1_activate(GtkMenuItem *menuitem, gpointer user_data)
 		if (! doc->changed)
 			continue;
 
-		if (document_save_file(doc, FALSE))
+		if (document_save_file_async(doc, FALSE))
 			count++;
 	}
 	if (!count)
@@ -455,6 +455,9 @@ static void on_notebook1_switch_page_after(GtkNotebook *notebook, gpointer page,
 
 	if (doc != NULL)
 	{
+		/* load the file of a lazily restored session document when it is first shown */
+		document_load_pending(doc);
+
 		sidebar_select_openfiles_item(doc);
 		ui_save_buttons_toggle(doc->changed);
 		ui_set_window_title(doc);
@@ -1680,8 +1683,7 @@ static void on_search1_activate(GtkMenuItem *menuitem, gpointer user_data)
 	gboolean have_messages;
 
 	/* enable commands if the messages window has any items */
-	have_messages = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(msgwindow.store_msg),
-		NULL) > 0;
+	have_messages = msgwin_get_message_count(MSG_MESSAGE) > 0;
 
 	gtk_widget_set_sensitive(next_message, have_messages);
 	gtk_widget_set_sensitive(previous_message, have_messages);
@@ -53,8 +53,10 @@
 #include "utils.h"
 #include "vte.h"
 #include "win32.h"
+#include "wordindex.h"
 
 #include "gtkcompat.h"
+#include "SciLexer.h"
 
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
@@ -70,6 +72,7 @@
 #endif
 
 #include <stdlib.h>
+#include <fcntl.h>
 
 /* gstdio.h also includes sys/stat.h */
 #include <glib/gstdio.h>
@@ -80,9 +83,22 @@
 
 #include <gdk/gdkkeysyms.h>
 
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
 
 #define USE_GIO_FILE_OPERATIONS (!file_prefs.use_safe_file_saving && file_prefs.use_gio_unsafe_file_saving)
 
+/* files from this size are mapped and added to the editor in chunks, see map_text_file() */
+#define LOAD_MAP_MIN_SIZE (16 * 1024 * 1024)
+#define LOAD_CHUNK_SIZE (4 * 1024 * 1024)
+/* time after which the progress of loading a file is shown, in microseconds */
+#define LOAD_PROGRESS_DELAY (G_USEC_PER_SEC / 2)
+/* number of lines used to detect the indentation of large files */
+#define LARGE_FILE_INDENT_SAMPLE_LINES 10000
+/* indented lines after which the indentation detection stops */
+#define INDENT_SAMPLE_LINES 5000
+
 
 GeanyFilePrefs file_prefs;
 GPtrArray *documents_array = NULL;
@@ -102,17 +118,50 @@ enum
 {
 	RESPONSE_DOCUMENT_RELOAD = 1,
 	RESPONSE_DOCUMENT_SAVE,
+	RESPONSE_DOCUMENT_ENABLE_FEATURES,
 };
 
 
 static guint doc_id_counter = 0;
 
 
+/* A snapshot of a document to write to disk, see document_save_file_async() */
+typedef struct
+{
+	guint		 doc_id;
+	gchar		*locale_filename;
+	gchar		*encoding;		/* encoding to convert the data to, NULL to write it as is */
+	gchar		*data;			/* UTF-8 text, null-terminated */
+	gsize		 len;			/* size of data including the null terminator */
+	guint		 bom_len;		/* size of the UTF-8 BOM at the start of data */
+	gboolean	 async;			/* whether it is written in the background */
+	/* the saving prefs when the save started, as the save thread can't read file_prefs */
+	gboolean	 safe_saving;	/* file_prefs.use_safe_file_saving */
+	gboolean	 use_gio;		/* USE_GIO_FILE_OPERATIONS */
+	gboolean	 gio_backup;	/* file_prefs.gio_unsafe_save_backup */
+	GError		*conv_error;	/* error converting the data to encoding */
+	gsize		 conv_error_pos;	/* position in data of the conversion error */
+	gchar		*errmsg;		/* error writing the file */
+}
+SaveData;
+
+
+static GThreadPool *save_pool = NULL;
+/* saves written by save_pool, which need to be finished on the main thread */
+static GAsyncQueue *saved_queue = NULL;
+static guint pending_saves = 0;
+
+
 static void document_undo_clear_stack(GTrashStack **stack);
 static void document_undo_clear(GeanyDocument *doc);
 static void document_undo_add_internal(GeanyDocument *doc, guint type, gpointer data);
 static void document_redo_add(GeanyDocument *doc, guint type, gpointer data);
 static gboolean remove_page(guint page_num);
+static void finish_pending_saves(gboolean wait);
+static void finish_disk_checks(void);
+static gboolean check_disk_status_now(GeanyDocument *doc);
+static void protect_document(GeanyDocument *doc);
+static void show_large_file_message(GeanyDocument *doc);
 static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgtype,
 	void (*response_cb)(GtkWidget *info_bar, gint response_id, GeanyDocument *doc),
 	const gchar *btn_1, GtkResponseType response_1,
@@ -121,6 +170,150 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 	const gchar *extra_text, const gchar *format, ...) G_GNUC_PRINTF(11, 12);
 
 
+/* The open documents are indexed by GeanyDocument::file_name and GeanyDocument::real_path,
+ * so that looking up the documents for e.g. each line of a build output doesn't compare
+ * all the filenames. The indexes are rebuilt on the next lookup after a document was
+ * opened or closed, or one of its filenames was set, see invalidate_document_indexes(). */
+static GHashTable *file_name_index = NULL;
+static GHashTable *real_path_index = NULL;
+static gboolean document_indexes_valid = FALSE;
+/* filenames which don't match any document, cleared with the indexes */
+static GHashTable *unmatched_filenames = NULL;
+#define UNMATCHED_FILENAMES_MAX 10000
+
+
+/* Gets a key which matches for filenames equal with utils_filenamecmp() */
+static gchar *get_filename_key(const gchar *filename)
+{
+#ifdef G_OS_WIN32
+	gchar *key = NULL;
+
+	/* like utils_str_casecmp() */
+	if (g_utf8_validate(filename, -1, NULL))
+		key = g_utf8_strdown(filename, -1);
+	else
+	{
+		gchar *utf8 = g_locale_to_utf8(filename, -1, NULL, NULL, NULL);
+
+		if (utf8 != NULL)
+			key = g_utf8_strdown(utf8, -1);
+		g_free(utf8);
+	}
+	return key != NULL ? key : g_strdup(filename);
+#else
+	return g_strdup(filename);
+#endif
+}
+
+
+static GeanyDocument *lookup_filename_index(GHashTable *index, const gchar *filename)
+{
+#ifdef G_OS_WIN32
+	gchar *key = get_filename_key(filename);
+	GeanyDocument *doc = g_hash_table_lookup(index, key);
+
+	g_free(key);
+	return doc;
+#else
+	return g_hash_table_lookup(index, filename);
+#endif
+}
+
+
+static void add_to_filename_index(GHashTable *index, const gchar *filename, GeanyDocument *doc)
+{
+	gchar *key = get_filename_key(filename);
+
+	/* the first document matches, like when comparing them in order */
+	if (g_hash_table_lookup(index, key) == NULL)
+		g_hash_table_insert(index, key, doc);
+	else
+		g_free(key);
+}
+
+
+static void rebuild_document_indexes(void)
+{
+	guint i;
+
+	if (file_name_index == NULL)
+	{
+		file_name_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		real_path_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		unmatched_filenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+	else
+	{
+		g_hash_table_remove_all(file_name_index);
+		g_hash_table_remove_all(real_path_index);
+		g_hash_table_remove_all(unmatched_filenames);
+	}
+
+	for (i = 0; i < documents_array->len; i++)
+	{
+		GeanyDocument *doc = documents[i];
+
+		if (! doc->is_valid)
+			continue;
+		if (doc->file_name != NULL)
+			add_to_filename_index(file_name_index, doc->file_name, doc);
+		if (doc->real_path != NULL)
+			add_to_filename_index(real_path_index, doc->real_path, doc);
+	}
+}
+
+
+/* Must be called when a document is opened or closed, or its file_name or real_path is set.
+ * It is also called after the signals on opening and saving documents, as their plugin
+ * handlers might have set the filenames. */
+static void invalidate_document_indexes(void)
+{
+	document_indexes_valid = FALSE;
+}
+
+
+static void update_document_indexes(void)
+{
+	if (! document_indexes_valid)
+	{
+		rebuild_document_indexes();
+		document_indexes_valid = TRUE;
+	}
+}
+
+
+/* Looks up a filename in one of the indexes. Plugins can set GeanyDocument::file_name or
+ * GeanyDocument::real_path without invalidating the indexes, so a document found which
+ * doesn't have the filename anymore means the indexes are rebuilt and searched again. */
+static GeanyDocument *lookup_document_index(gboolean real_path, const gchar *filename)
+{
+	GeanyDocument *doc;
+	const gchar *doc_filename;
+
+	update_document_indexes();
+	doc = lookup_filename_index(real_path ? real_path_index : file_name_index, filename);
+	if (doc == NULL)
+		return NULL;
+
+	doc_filename = real_path ? doc->real_path : doc->file_name;
+	if (doc->is_valid && doc_filename != NULL && utils_filenamecmp(doc_filename, filename) == 0)
+		return doc;
+
+	invalidate_document_indexes();
+	update_document_indexes();
+	return lookup_filename_index(real_path ? real_path_index : file_name_index, filename);
+}
+
+
+static GeanyDocument *find_by_real_path(const gchar *realname)
+{
+	if (! realname)
+		return NULL;	/* file doesn't exist on disk */
+
+	return lookup_document_index(TRUE, realname);
+}
+
+
 /**
  * Finds a document whose @c real_path field matches the given filename.
  *
@@ -137,24 +330,7 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 GEANY_API_SYMBOL
 GeanyDocument* document_find_by_real_path(const gchar *realname)
 {
-	guint i;
-
-	if (! realname)
-		return NULL;	/* file doesn't exist on disk */
-
-	for (i = 0; i < documents_array->len; i++)
-	{
-		GeanyDocument *doc = documents[i];
-
-		if (! doc->is_valid || ! doc->real_path)
-			continue;
-
-		if (utils_filenamecmp(realname, doc->real_path) == 0)
-		{
-			return doc;
-		}
-	}
-	return NULL;
+	return find_by_real_path(realname);
 }
 
 
@@ -169,6 +345,35 @@ static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
 }
 
 
+static GeanyDocument *find_by_filename(const gchar *utf8_filename)
+{
+	GeanyDocument *doc;
+	gchar *realname;
+
+	g_return_val_if_fail(utf8_filename != NULL, NULL);
+
+	/* First search GeanyDocument::file_name, so we can find documents with a
+	 * filename set but not saved on disk, like vcdiff produces */
+	doc = lookup_document_index(FALSE, utf8_filename);
+	if (doc != NULL || g_hash_table_contains(unmatched_filenames, utf8_filename))
+		return doc;
+
+	/* Now try matching based on the realpath(), which is unique per file on disk */
+	realname = get_real_path_from_utf8(utf8_filename);
+	doc = find_by_real_path(realname);
+	g_free(realname);
+
+	/* avoid getting the real path again e.g. for each message of a build */
+	if (doc == NULL)
+	{
+		if (g_hash_table_size(unmatched_filenames) >= UNMATCHED_FILENAMES_MAX)
+			g_hash_table_remove_all(unmatched_filenames);
+		g_hash_table_add(unmatched_filenames, g_strdup(utf8_filename));
+	}
+	return doc;
+}
+
+
 /**
  *  Finds a document with the given filename.
  *  This matches either an exact GeanyDocument::file_name string, or variant
@@ -182,45 +387,37 @@ static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
  **/
 GEANY_API_SYMBOL
 GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
+{
+	return find_by_filename(utf8_filename);
+}
+
+
+/* returns the document which has sci, or NULL. */
+GeanyDocument *document_find_by_sci(ScintillaObject *sci)
 {
 	guint i;
-	GeanyDocument *doc;
-	gchar *realname;
 
-	g_return_val_if_fail(utf8_filename != NULL, NULL);
+	g_return_val_if_fail(sci != NULL, NULL);
 
-	/* First search GeanyDocument::file_name, so we can find documents with a
-	 * filename set but not saved on disk, like vcdiff produces */
 	for (i = 0; i < documents_array->len; i++)
 	{
-		doc = documents[i];
-
-		if (! doc->is_valid || doc->file_name == NULL)
-			continue;
-
-		if (utils_filenamecmp(utf8_filename, doc->file_name) == 0)
-		{
-			return doc;
-		}
+		if (documents[i]->is_valid && documents[i]->editor->sci == sci)
+			return documents[i];
 	}
-	/* Now try matching based on the realpath(), which is unique per file on disk */
-	realname = get_real_path_from_utf8(utf8_filename);
-	doc = document_find_by_real_path(realname);
-	g_free(realname);
-	return doc;
+	return NULL;
 }
 
 
-/* returns the document which has sci, or NULL. */
-GeanyDocument *document_find_by_sci(ScintillaObject *sci)
+static GeanyDocument *find_by_id(guint id)
 {
 	guint i;
 
-	g_return_val_if_fail(sci != NULL, NULL);
+	if (!id)
+		return NULL;
 
-	for (i = 0; i < documents_array->len; i++)
+	foreach_document(i)
 	{
-		if (documents[i]->is_valid && documents[i]->editor->sci == sci)
+		if (documents[i]->id == id)
 			return documents[i];
 	}
 	return NULL;
@@ -247,17 +444,7 @@ GeanyDocument *document_find_by_sci(ScintillaObject *sci)
 GEANY_API_SYMBOL
 GeanyDocument *document_find_by_id(guint id)
 {
-	guint i;
-
-	if (!id)
-		return NULL;
-
-	foreach_document(i)
-	{
-		if (documents[i]->id == id)
-			return documents[i];
-	}
-	return NULL;
+	return find_by_id(id);
 }
 
 
@@ -390,6 +577,20 @@ void document_finalize(void)
 {
 	guint i;
 
+	finish_pending_saves(TRUE);
+	if (save_pool != NULL)
+	{
+		g_thread_pool_free(save_pool, FALSE, TRUE);
+		g_async_queue_unref(saved_queue);
+	}
+	finish_disk_checks();
+	if (file_name_index != NULL)
+	{
+		g_hash_table_destroy(file_name_index);
+		g_hash_table_destroy(real_path_index);
+		g_hash_table_destroy(unmatched_filenames);
+	}
+
 	for (i = 0; i < documents_array->len; i++)
 		g_free(documents[i]);
 	g_ptr_array_free(documents_array, TRUE);
@@ -508,41 +709,89 @@ static void queue_colourise(GeanyDocument *doc)
 
 
 #ifdef USE_GIO_FILEMON
-static void monitor_file_changed_cb(G_GNUC_UNUSED GFileMonitor *monitor, G_GNUC_UNUSED GFile *file,
-									G_GNUC_UNUSED GFile *other_file, GFileMonitorEvent event,
-									GeanyDocument *doc)
+/* A monitor of a directory, shared by the documents of the files in it, so that there
+ * are not hundreds of monitors (e.g. inotify watches) when many files are open */
+typedef struct
 {
-	g_return_if_fail(doc != NULL);
+	GFileMonitor	*monitor;
+	gchar			*dirname;	/* locale encoding */
+	GHashTable		*files;		/* document IDs by locale base name */
+	guint			 ref_count;
+}
+DirMonitor;
+
+/* DirMonitor of each directory, by locale directory name */
+static GHashTable *dir_monitors = NULL;
+
+
+static void dir_monitor_free(DirMonitor *dm)
+{
+	g_object_unref(dm->monitor);
+	g_hash_table_destroy(dm->files);
+	g_free(dm->dirname);
+	g_free(dm);
+}
+
+
+static void dir_monitor_file_changed(DirMonitor *dm, GFile *file)
+{
+	gchar *base_name = g_file_get_basename(file);
+	GeanyDocument *doc = find_by_id(GPOINTER_TO_UINT(g_hash_table_lookup(dm->files, base_name)));
 
+	if (doc != NULL && doc->priv->monitor == dm)
+	{
+		if (doc->priv->file_disk_status == FILE_IGNORE)
+			doc->priv->file_disk_status = FILE_OK;
+		else
+		{
+			/* the events are coalesced and the file is checked in the background */
+			doc->priv->file_disk_status = FILE_CHANGED;
+			document_check_disk_status(doc, TRUE);
+		}
+	}
+	g_free(base_name);
+}
+
+
+static void dir_monitor_changed_cb(G_GNUC_UNUSED GFileMonitor *monitor, GFile *file,
+									GFile *other_file, GFileMonitorEvent event, DirMonitor *dm)
+{
 	if (file_prefs.disk_check_timeout == 0)
 		return;
 
-	geany_debug("%s: event: %d previous file status: %d",
-		G_STRFUNC, event, doc->priv->file_disk_status);
+	geany_debug("%s: event: %d", G_STRFUNC, event);
+
 	switch (event)
 	{
 		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-		{
-			if (doc->priv->file_disk_status == FILE_IGNORE)
-				doc->priv->file_disk_status = FILE_OK;
-			else
-				doc->priv->file_disk_status = FILE_CHANGED;
-			g_message("%s: FILE_CHANGED", G_STRFUNC);
-			break;
-		}
 		case G_FILE_MONITOR_EVENT_DELETED:
-		{
-			doc->priv->file_disk_status = FILE_CHANGED;
-			g_message("%s: FILE_MISSING", G_STRFUNC);
+		/* a file saved by writing a new one and renaming it over the old one */
+		case G_FILE_MONITOR_EVENT_CREATED:
+#if GLIB_CHECK_VERSION(2, 46, 0)
+		case G_FILE_MONITOR_EVENT_MOVED_IN:
+		case G_FILE_MONITOR_EVENT_MOVED_OUT:
+#endif
+			dir_monitor_file_changed(dm, file);
 			break;
-		}
+
+		case G_FILE_MONITOR_EVENT_MOVED:
+#if GLIB_CHECK_VERSION(2, 46, 0)
+		case G_FILE_MONITOR_EVENT_RENAMED:
+#endif
+			dir_monitor_file_changed(dm, file);
+			if (other_file != NULL)
+				dir_monitor_file_changed(dm, other_file);
+			break;
+
 		default:
 			break;
 	}
-	if (doc->priv->file_disk_status != FILE_OK)
-	{
-		ui_update_tab_status(doc);
-	}
+}
+
+
+static gboolean dir_monitor_has_document(gpointer key, gpointer value, gpointer doc)
+{
+	return GPOINTER_TO_UINT(value) == ((GeanyDocument *) doc)->id;
 }
 #endif
 
@@ -551,11 +800,17 @@ static void document_stop_file_monitoring(GeanyDocument *doc)
 {
 	g_return_if_fail(doc != NULL);
 
+#ifdef USE_GIO_FILEMON
 	if (doc->priv->monitor != NULL)
 	{
-		g_object_unref(doc->priv->monitor);
+		DirMonitor *dm = doc->priv->monitor;
+
 		doc->priv->monitor = NULL;
+		g_hash_table_foreach_remove(dm->files, dir_monitor_has_document, doc);
+		if (--dm->ref_count == 0)
+			g_hash_table_remove(dir_monitors, dm->dirname);
 	}
+#endif
 }
 
 
@@ -575,16 +830,47 @@ static void monitor_file_setup(GeanyDocument *doc)
 		locale_filename = utils_get_locale_from_utf8(doc->file_name);
 		if (locale_filename != NULL && g_file_test(locale_filename, G_FILE_TEST_EXISTS))
 		{
-			/* get a file monitor and connect to the 'changed' signal */
-			GFile *file = g_file_new_for_path(locale_filename);
-			doc->priv->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
-			g_signal_connect(doc->priv->monitor, "changed",
-				G_CALLBACK(monitor_file_changed_cb), doc);
+			gchar *dirname = g_path_get_dirname(locale_filename);
+			DirMonitor *dm;
 
-			/* we set the rate limit according to the GUI pref but it's most probably not used */
-			g_file_monitor_set_rate_limit(doc->priv->monitor, file_prefs.disk_check_timeout * 1000);
+			if (dir_monitors == NULL)
+				dir_monitors = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					(GDestroyNotify) dir_monitor_free);
+
+			dm = g_hash_table_lookup(dir_monitors, dirname);
+			if (dm == NULL)
+			{
+				/* get a directory monitor and connect to the 'changed' signal */
+				GFile *dir = g_file_new_for_path(dirname);
+				GFileMonitor *monitor;
 
-			g_object_unref(file);
+				/* report renames as one event instead of a deletion and a creation */
+#if GLIB_CHECK_VERSION(2, 46, 0)
+				monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+#else
+				monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_SEND_MOVED, NULL, NULL);
+#endif
+				if (monitor != NULL)
+				{
+					dm = g_new0(DirMonitor, 1);
+					dm->monitor = monitor;
+					dm->dirname = g_strdup(dirname);
+					dm->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+					g_signal_connect(monitor, "changed", G_CALLBACK(dir_monitor_changed_cb), dm);
+					/* we set the rate limit according to the GUI pref but it's most probably not used */
+					g_file_monitor_set_rate_limit(monitor, file_prefs.disk_check_timeout * 1000);
+					g_hash_table_insert(dir_monitors, dm->dirname, dm);
+				}
+				g_object_unref(dir);
+			}
+			if (dm != NULL)
+			{
+				dm->ref_count++;
+				doc->priv->monitor = dm;
+				g_hash_table_insert(dm->files, g_path_get_basename(locale_filename),
+					GUINT_TO_POINTER(doc->id));
+			}
+			g_free(dirname);
 		}
 		g_free(locale_filename);
 #endif
@@ -618,8 +904,9 @@ static gboolean on_idle_focus(gpointer doc)
 
 
 /* Creates a new document and editor, adding a tab in the notebook.
+ * @param chunked_text Whether to store the text in chunks, for huge files.
  * @return The created document */
-static GeanyDocument *document_create(const gchar *utf8_filename)
+static GeanyDocument *document_create(const gchar *utf8_filename, gboolean chunked_text)
 {
 	GeanyDocument *doc;
 	gint new_idx;
@@ -651,6 +938,7 @@ static GeanyDocument *document_create(const gchar *utf8_filename)
 	doc->id = ++doc_id_counter;
 	doc->index = new_idx;
 	doc->file_name = g_strdup(utf8_filename);
+	doc->priv->chunked_text = chunked_text;
 	doc->editor = editor_create(doc);
 #ifndef USE_GIO_FILEMON
 	doc->priv->last_check = time(NULL);
@@ -673,6 +961,7 @@ static GeanyDocument *document_create(const gchar *utf8_filename)
 	ui_document_buttons_update();
 
 	doc->is_valid = TRUE;	/* do this last to prevent UI updating with NULL items. */
+	invalidate_document_indexes();
 	return doc;
 }
 
@@ -703,6 +992,10 @@ static gboolean remove_page(guint page_num)
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
+	/* saving in the background can fail, and then the document is changed again */
+	if (doc->priv->pending_saves > 0)
+		finish_pending_saves(TRUE);
+
 	/* if we're closing all, document_account_for_unsaved() has been called already, no need to ask again. */
 	if (! main_status.closing_all && doc->changed && ! dialogs_show_unsaved_file(doc))
 		return FALSE;
@@ -718,6 +1011,7 @@ static gboolean remove_page(guint page_num)
 
 	doc->is_valid = FALSE;
 	doc->id = 0;
+	invalidate_document_indexes();
 
 	if (main_status.quitting)
 	{
@@ -749,6 +1043,9 @@ static gboolean remove_page(guint page_num)
 	editor_destroy(doc->editor);
 	doc->editor = NULL; /* needs to be NULL for document_undo_clear() call below */
 
+	if (doc->priv->word_index != NULL)
+		word_index_free(doc->priv->word_index);
+
 	document_stop_file_monitoring(doc);
 
 	document_undo_clear(doc);
@@ -833,7 +1130,7 @@ GeanyDocument *document_new_file(const gchar *utf8_filename, GeanyFiletype *ft,
 		utils_tidy_path(tmp);
 		utf8_filename = tmp;
 	}
-	doc = document_create(utf8_filename);
+	doc = document_create(utf8_filename, FALSE);
 
 	g_assert(doc != NULL);
 
@@ -886,6 +1183,7 @@ GeanyDocument *document_new_file(const gchar *utf8_filename, GeanyFiletype *ft,
 	g_signal_connect(doc->editor->sci, "sci-notify", G_CALLBACK(editor_sci_notify_cb), doc->editor);
 
 	g_signal_emit_by_name(geany_object, "document-new", doc);
+	invalidate_document_indexes();
 
 	msgwin_status_add(_("New file \"%s\" opened."),
 		DOC_FILENAME(doc));
@@ -913,21 +1211,27 @@ GeanyDocument *document_open_file(const gchar *locale_filename, gboolean readonl
 }
 
 
-typedef struct
+struct FileData
 {
-	gchar		*data;	/* null-terminated file data */
+	gchar		*data;	/* null-terminated file data, unless mapped is set */
 	gsize		 len;	/* string length of data */
 	gchar		*enc;
 	gboolean	 bom;
 	time_t		 mtime;	/* modification time, read by stat::st_mtime */
 	gboolean	 readonly;
-} FileData;
+	GMappedFile	*mapped;	/* if set, data points into it and is not null-terminated */
+	gchar		*error;	/* error message if the file couldn't be read */
+};
 
 
-static gboolean get_mtime(const gchar *locale_filename, time_t *time)
+/* Gets the modification time of the file. This doesn't use the UI so it can be called
+ * from any thread.
+ * Returns NULL on success, or the error message to be freed. */
+static gchar *read_mtime(const gchar *locale_filename, time_t *time)
 {
 	GError *error = NULL;
 	const gchar *err_msg = NULL;
+	gchar *message = NULL;
 
 	if (USE_GIO_FILE_OPERATIONS)
 	{
@@ -961,65 +1265,158 @@ static gboolean get_mtime(const gchar *locale_filename, time_t *time)
 	{
 		gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
 
-		ui_set_statusbar(TRUE, _("Could not open file %s (%s)"),
-			utf8_filename, err_msg);
+		message = g_strdup_printf(_("Could not open file %s (%s)"), utf8_filename, err_msg);
 		g_free(utf8_filename);
 	}
 
 	if (error)
 		g_error_free(error);
 
-	return err_msg == NULL;
+	return message;
 }
 
 
-/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
-static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
-	FileData *filedata, const gchar *forced_enc)
+static gboolean get_mtime(const gchar *locale_filename, time_t *time)
 {
-	GError *err = NULL;
+	gchar *err_msg = read_mtime(locale_filename, time);
 
-	filedata->data = NULL;
-	filedata->len = 0;
-	filedata->enc = NULL;
-	filedata->bom = FALSE;
-	filedata->readonly = FALSE;
+	if (err_msg)
+	{
+		ui_set_statusbar(TRUE, "%s", err_msg);
+		g_free(err_msg);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	if (!get_mtime(locale_filename, &filedata->mtime))
+
+/* Maps big files that can be used as UTF-8 without any conversion, so they don't have to be
+ * read into memory and copied once more to be added to the editor (see insert_file_text()).
+ * Returns FALSE if the file should be read normally. */
+static gboolean map_text_file(const gchar *locale_filename, FileData *filedata,
+	const gchar *forced_enc)
+{
+	GMappedFile *mapped;
+	GStatBuf st;
+	const gchar *contents;
+	gsize size;
+	guint bom_len;
+
+	/* don't map small files just to find out their size, errors are reported when
+	 * reading the file normally */
+	if (g_stat(locale_filename, &st) != 0 || ! S_ISREG(st.st_mode) ||
+		st.st_size < LOAD_MAP_MIN_SIZE)
 		return FALSE;
 
-	if (USE_GIO_FILE_OPERATIONS)
-	{
-		GFile *file = g_file_new_for_path(locale_filename);
+	mapped = g_mapped_file_new(locale_filename, FALSE, NULL);
+	if (mapped == NULL)
+		return FALSE;
 
-		g_file_load_contents(file, NULL, &filedata->data, &filedata->len, NULL, &err);
-		g_object_unref(file);
-	}
-	else
-		g_file_get_contents(locale_filename, &filedata->data, &filedata->len, &err);
+	contents = g_mapped_file_get_contents(mapped);
+	size = g_mapped_file_get_length(mapped);
 
-	if (err)
+	/* the file might have changed since */
+	if (size < LOAD_MAP_MIN_SIZE ||
+		! encodings_check_utf8_auto(contents, size, forced_enc, &bom_len))
 	{
-		ui_set_statusbar(TRUE, "%s", err->message);
-		g_error_free(err);
+		g_mapped_file_unref(mapped);
 		return FALSE;
 	}
 
-	if (! encodings_convert_to_utf8_auto(&filedata->data, &filedata->len, forced_enc,
-				&filedata->enc, &filedata->bom, &filedata->readonly))
-	{
+	filedata->mapped = mapped;
+	filedata->data = (gchar *) contents + bom_len;
+	filedata->len = size - bom_len;
+	filedata->enc = g_strdup("UTF-8");
+	filedata->bom = (bom_len > 0);
+	return TRUE;
+}
+
+
+static void free_file_data(FileData *filedata)
+{
+	if (filedata->mapped != NULL)
+		g_mapped_file_unref(filedata->mapped);
+	else
+		g_free(filedata->data);
+
+	filedata->mapped = NULL;
+	filedata->data = NULL;
+}
+
+
+/* Reads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM.
+ * This doesn't use the UI so it can be called from any thread, errors are stored
+ * in filedata->error and should be shown with report_text_file_errors(). */
+static void read_text_file(const gchar *locale_filename, FileData *filedata,
+	const gchar *forced_enc)
+{
+	GError *err = NULL;
+
+	filedata->data = NULL;
+	filedata->len = 0;
+	filedata->enc = NULL;
+	filedata->bom = FALSE;
+	filedata->readonly = FALSE;
+	filedata->mapped = NULL;
+	filedata->error = read_mtime(locale_filename, &filedata->mtime);
+
+	if (filedata->error != NULL)
+		return;
+
+	if (! USE_GIO_FILE_OPERATIONS && map_text_file(locale_filename, filedata, forced_enc))
+		return;
+
+	if (USE_GIO_FILE_OPERATIONS)
+	{
+		GFile *file = g_file_new_for_path(locale_filename);
+
+		g_file_load_contents(file, NULL, &filedata->data, &filedata->len, NULL, &err);
+		g_object_unref(file);
+	}
+	else
+		g_file_get_contents(locale_filename, &filedata->data, &filedata->len, &err);
+
+	if (err)
+	{
+		filedata->error = g_strdup(err->message);
+		g_error_free(err);
+		return;
+	}
+
+	if (! encodings_convert_to_utf8_auto(&filedata->data, &filedata->len, forced_enc,
+				&filedata->enc, &filedata->bom, &filedata->readonly))
+	{
+		gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
+		gchar *display_filename = utils_str_middle_truncate(utf8_filename, 100);
+
 		if (forced_enc)
 		{
-			ui_set_statusbar(TRUE, _("The file \"%s\" is not valid %s."),
+			filedata->error = g_strdup_printf(_("The file \"%s\" is not valid %s."),
 				display_filename, forced_enc);
 		}
 		else
 		{
-			ui_set_statusbar(TRUE,
+			filedata->error = g_strdup_printf(
 	_("The file \"%s\" does not look like a text file or the file encoding is not supported."),
 			display_filename);
 		}
+		g_free(display_filename);
+		g_free(utf8_filename);
 		g_free(filedata->data);
+		filedata->data = NULL;
+	}
+}
+
+
+/* Shows the errors and warnings from read_text_file().
+ * Returns FALSE if the file couldn't be loaded. */
+static gboolean report_text_file_errors(FileData *filedata, const gchar *display_filename)
+{
+	if (filedata->error != NULL)
+	{
+		ui_set_statusbar(TRUE, "%s", filedata->error);
+		g_free(filedata->error);
+		filedata->error = NULL;
 		return FALSE;
 	}
 
@@ -1040,6 +1437,122 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 }
 
 
+/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
+static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
+	FileData *filedata, const gchar *forced_enc)
+{
+	read_text_file(locale_filename, filedata, forced_enc);
+	return report_text_file_errors(filedata, display_filename);
+}
+
+
+/* Reads a file to be opened later with document_open_file_data(). This can be called from
+ * any thread, so the potentially slow reading and encoding detection can be done in the
+ * background.
+ * Returns: The file data, which should be freed with document_free_file_data() unless
+ * passed to document_open_file_data(). */
+FileData *document_read_file_data(const gchar *locale_filename, const gchar *forced_enc)
+{
+	FileData *filedata = g_new(FileData, 1);
+
+	read_text_file(locale_filename, filedata, forced_enc);
+	return filedata;
+}
+
+
+void document_free_file_data(FileData *filedata)
+{
+	free_file_data(filedata);
+	g_free(filedata->enc);
+	g_free(filedata->error);
+	g_free(filedata);
+}
+
+
+/* Shows the progress of loading in the status bar once it takes a noticeable time.
+ * This only repaints the window and doesn't run the main loop, so no other events are
+ * handled while the document is incomplete. */
+static void update_load_progress(gboolean *shown, gint64 start_time,
+	const gchar *display_filename, gdouble fraction)
+{
+	GtkProgressBar *bar = GTK_PROGRESS_BAR(main_widgets.progressbar);
+
+	if (! *shown)
+	{
+		gchar *text;
+
+		/* a visible progress bar belongs to another operation, e.g. a build */
+		if (! main_status.main_window_realized || ! interface_prefs.statusbar_visible ||
+			gtk_widget_get_visible(main_widgets.progressbar) ||
+			g_get_monotonic_time() - start_time < LOAD_PROGRESS_DELAY)
+			return;
+
+		text = g_strdup_printf(_("Loading %s..."), display_filename);
+		gtk_progress_bar_set_text(bar, text);
+		g_free(text);
+		gtk_widget_show(main_widgets.progressbar);
+		/* allocate the progress bar now, as the main loop won't */
+		gtk_container_check_resize(GTK_CONTAINER(main_widgets.window));
+		*shown = TRUE;
+	}
+
+	gtk_progress_bar_set_fraction(bar, fraction);
+	gdk_window_process_updates(gtk_widget_get_window(main_widgets.window), TRUE);
+}
+
+
+/* Adds the loaded file data to the editor.
+ * Mapped data is appended in chunks, so it is never copied as a whole, and loading
+ * can show its progress (if show_progress is set). */
+static void insert_file_text(GeanyDocument *doc, const FileData *filedata,
+	const gchar *display_filename, gboolean show_progress)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	gboolean progress_shown = FALSE;
+	gint64 start_time;
+	gsize offset = 0;
+
+	if (filedata->mapped == NULL)
+	{
+		sci_set_text(sci, filedata->data);	/* NULL terminated data */
+		return;
+	}
+
+	start_time = g_get_monotonic_time();
+
+	/* when reloading and keeping the history, this makes it a single undo action */
+	sci_start_undo_action(sci);
+	sci_clear_all(sci);
+	sci_allocate(sci, filedata->len + 1);
+	while (offset < filedata->len)
+	{
+		gsize len = MIN(LOAD_CHUNK_SIZE, filedata->len - offset);
+
+		/* don't split multi-byte characters between chunks, Scintilla checks line ends
+		 * like U+2028 around insertions */
+		if (offset + len < filedata->len)
+		{
+			while (len > 0 && ((guchar) filedata->data[offset + len] & 0xc0) == 0x80)
+				len--;
+		}
+		sci_append_text(sci, filedata->data + offset, len);
+		offset += len;
+
+		if (show_progress)
+			update_load_progress(&progress_shown, start_time, display_filename,
+				(gdouble) offset / filedata->len);
+	}
+	sci_end_undo_action(sci);
+
+	if (progress_shown)
+	{
+		gtk_progress_bar_set_text(GTK_PROGRESS_BAR(main_widgets.progressbar), NULL);
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(main_widgets.progressbar), 0.0);
+		gtk_widget_hide(main_widgets.progressbar);
+	}
+}
+
+
 /* Sets the cursor position on opening a file. First it sets the line when cl_options.goto_line
  * is set, otherwise it sets the line when pos is greater than zero and finally it sets the column
  * if cl_options.goto_column is set.
@@ -1072,77 +1585,190 @@ static gint set_cursor_position(GeanyEditor *editor, gint pos)
 }
 
 
-/* Count lines that start with some hard tabs then a soft tab. */
-static gboolean detect_tabs_and_spaces(GeanyEditor *editor)
+/* Gets the number of lines to look at for detecting the indentation, which is only
+ * a sample at the start of large files. */
+static gint get_indent_detection_line_count(GeanyEditor *editor)
 {
-	const GeanyIndentPrefs *iprefs = editor_get_indent_prefs(editor);
-	ScintillaObject *sci = editor->sci;
-	gsize count = 0;
-	struct Sci_TextToFind ttf;
-	gchar *soft_tab = g_strnfill((gsize)iprefs->width, ' ');
-	gchar *regex = g_strconcat("^\t+", soft_tab, "[^ ]", NULL);
+	gint line_count = sci_get_line_count(editor->sci);
 
-	g_free(soft_tab);
+	if (editor->document->priv->large_file)
+		return MIN(line_count, LARGE_FILE_INDENT_SAMPLE_LINES);
+	return line_count;
+}
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(sci);
-	ttf.lpstrText = regex;
-	while (1)
-	{
-		gint pos;
 
-		pos = sci_find_text(sci, SCFIND_REGEXP, &ttf);
-		if (pos == -1)
-			break;	/* no more matches */
-		count++;
-		ttf.chrg.cpMin = ttf.chrgText.cpMax + 1;	/* search after this match */
-	}
-	g_free(regex);
-	/* The 0.02 is a low weighting to ignore a few possibly accidental occurrences */
-	return count > sci_get_line_count(sci) * 0.02;
+/* Whether a file of the given size should be opened in large file mode */
+static gboolean is_large_file(GeanyFiletype *ft, gsize size)
+{
+	gint large_file_size = file_prefs.large_file_size;
+
+	if (ft == NULL)
+		ft = filetypes[GEANY_FILETYPES_NONE];
+
+	filetypes_load_config(ft->id, FALSE);
+	if (ft->priv->large_file_size >= 0)
+		large_file_size = ft->priv->large_file_size;
+
+	return large_file_size > 0 && size >= (gsize) large_file_size * 1024 * 1024;
 }
 
 
-/* Detect the indent type based on counting the leading indent characters for each line.
- * Returns whether detection succeeded, and the detected type in *type_ upon success */
-gboolean document_detect_indent_type(GeanyDocument *doc, GeanyIndentType *type_)
+/* Whether the text of a file of the given size should be stored in chunks, so that editing
+ * doesn't need a single allocation of the whole size nor moving text across it */
+static gboolean use_chunked_text(gsize size)
 {
-	GeanyEditor *editor = doc->editor;
-	ScintillaObject *sci = editor->sci;
-	gint line, line_count;
-	gsize tabs = 0, spaces = 0;
+	return file_prefs.chunked_text_size > 0 &&
+		size >= (gsize) file_prefs.chunked_text_size * 1024 * 1024;
+}
+
+
+/* Indentation of the lines of a document, counted by scan_indentation() */
+typedef struct
+{
+	gint lines;				/* lines scanned */
+	gint tabs_and_spaces;	/* lines starting with hard tabs then a soft tab */
+	gint tabs;				/* lines indented with tabs */
+	gint spaces;			/* lines indented with at least 2 spaces */
+	gint widths[7];			/* lines whose indent width is a multiple of 2 to 8 */
+}
+IndentStats;
 
-	if (detect_tabs_and_spaces(editor))
-	{
-		*type_ = GEANY_INDENT_TYPE_BOTH;
-		return TRUE;
-	}
 
-	line_count = sci_get_line_count(sci);
-	for (line = 0; line < line_count; line++)
+/* Counts the indentation of the first line_count lines of text by scanning it directly,
+ * which is much faster than getting the indentation of each line from Scintilla.
+ * Scanning stops after INDENT_SAMPLE_LINES indented lines, as the proportions are unlikely
+ * to change after that many lines.
+ * tab_width is used to detect the indent type, widths are counted with 8 wide tabs.
+ * soft_tab_width is the number of spaces following hard tabs counted as a soft tab. */
+static void scan_indentation(const gchar *text, gsize length, gint line_count, gint tab_width,
+		gint soft_tab_width, IndentStats *stats)
+{
+	const gchar *end = text + length;
+	const gchar *p;
+	gint indented = 0;
+
+	memset(stats, 0, sizeof *stats);
+
+	for (p = text; stats->lines < line_count && indented < INDENT_SAMPLE_LINES; stats->lines++)
 	{
-		gint pos = sci_get_position_from_line(sci, line);
-		gchar c;
+		const gchar *line_end = p;
+		const gchar *s = p;
+		gint indent = 0, width = 0;
+
+		while (line_end < end && *line_end != '\n' && *line_end != '\r')
+			line_end++;
+
+		/* like sci_get_line_indentation() with tab_width and 8 wide tabs */
+		for (; s < line_end && (*s == ' ' || *s == '\t'); s++)
+		{
+			if (*s == '\t')
+			{
+				indent = (indent / tab_width + 1) * tab_width;
+				width = (width / 8 + 1) * 8;
+			}
+			else
+			{
+				indent++;
+				width++;
+			}
+		}
+		if (s > p)
+			indented++;
+
+		/* hard tabs then a soft tab, like the regex "^\t+ {width}[^ ]" */
+		if (p < line_end && *p == '\t')
+		{
+			const gchar *t = p;
+			gint n_spaces = 0;
+
+			while (t < line_end && *t == '\t')
+				t++;
+			for (; t < line_end && *t == ' '; t++)
+				n_spaces++;
+			if (n_spaces == soft_tab_width && t < line_end)
+				stats->tabs_and_spaces++;
+		}
 
 		/* most code will have indent total <= 24, otherwise it's more likely to be
 		 * alignment than indentation */
-		if (sci_get_line_indentation(sci, line) > 24)
-			continue;
+		if (indent <= 24 && p < line_end)
+		{
+			if (*p == '\t')
+				stats->tabs++;
+			/* check for at least 2 spaces */
+			else if (*p == ' ' && p + 1 < line_end && p[1] == ' ')
+				stats->spaces++;
+		}
+
+		/* We probably don't have style info yet, because we're generally called just after
+		 * the document got created, so we can't use highlighting_is_code_style().
+		 * That's not good, but the assumption below that concerning lines start with an
+		 * asterisk (common continuation character for C/C++/Java/...) should do the trick
+		 * without removing too much legitimate lines.
+		 * < 2 is no indentation. */
+		if ((s >= line_end || *s != '*') && width >= 2 && width <= 24)
+		{
+			gint i;
+
+			for (i = G_N_ELEMENTS(stats->widths) - 1; i >= 0; i--)
+			{
+				if ((width % (i + 2)) == 0)
+					stats->widths[i]++;
+			}
+		}
+
+		if (line_end >= end)
+		{
+			stats->lines++;
+			break;
+		}
+		/* skip the line end, \r\n is a single one */
+		p = line_end + 1;
+		if (*line_end == '\r' && p < end && *p == '\n')
+			p++;
+	}
+}
+
+
+/* Gets the text of the lines to detect the indentation from, without getting more of
+ * the text than that, so chunked text isn't copied whole for a few lines. */
+static const gchar *get_indent_detection_text(GeanyEditor *editor, gint *line_count,
+		gsize *length)
+{
+	*line_count = get_indent_detection_line_count(editor);
+	*length = sci_get_length(editor->sci);
+	if (*line_count < sci_get_line_count(editor->sci))
+		*length = sci_get_position_from_line(editor->sci, *line_count);
+
+	return (const gchar *) SSM(editor->sci, SCI_GETRANGEPOINTER, 0, *length);
+}
+
 
-		c = sci_get_char_at(sci, pos);
-		if (c == '\t')
-			tabs++;
-		/* check for at least 2 spaces */
-		else if (c == ' ' && sci_get_char_at(sci, pos + 1) == ' ')
-			spaces++;
+/* Like document_detect_indent_type(), but for the first line_count lines of text.
+ * indent_width is the width of a soft tab. */
+GEANY_EXPORT_SYMBOL
+gboolean document_detect_indent_type_from_text(const gchar *text, gsize length,
+		gint line_count, gint tab_width, gint indent_width, GeanyIndentType *type_)
+{
+	IndentStats stats;
+
+	scan_indentation(text, length, line_count, tab_width, indent_width, &stats);
+
+	/* Count lines that start with some hard tabs then a soft tab.
+	 * The 0.02 is a low weighting to ignore a few possibly accidental occurrences */
+	if (stats.tabs_and_spaces > stats.lines * 0.02)
+	{
+		*type_ = GEANY_INDENT_TYPE_BOTH;
+		return TRUE;
 	}
-	if (spaces == 0 && tabs == 0)
+
+	if (stats.spaces == 0 && stats.tabs == 0)
 		return FALSE;
 
 	/* the factors may need to be tweaked */
-	if (spaces > tabs * 4)
+	if (stats.spaces > stats.tabs * 4)
 		*type_ = GEANY_INDENT_TYPE_SPACES;
-	else if (tabs > spaces * 4)
+	else if (stats.tabs > stats.spaces * 4)
 		*type_ = GEANY_INDENT_TYPE_TABS;
 	else
 		*type_ = GEANY_INDENT_TYPE_BOTH;
@@ -1151,60 +1777,41 @@ gboolean document_detect_indent_type(GeanyDocument *doc, GeanyIndentType *type_)
 }
 
 
-/* Detect the indent width based on counting the leading indent characters for each line.
- * Returns whether detection succeeded, and the detected width in *width_ upon success */
-static gboolean detect_indent_width(GeanyEditor *editor, GeanyIndentType type, gint *width_)
+/* Detect the indent type based on counting the leading indent characters for each line.
+ * Returns whether detection succeeded, and the detected type in *type_ upon success */
+gboolean document_detect_indent_type(GeanyDocument *doc, GeanyIndentType *type_)
 {
-	const GeanyIndentPrefs *iprefs = editor_get_indent_prefs(editor);
-	ScintillaObject *sci = editor->sci;
-	gint line, line_count;
-	gint widths[7] = { 0 }; /* width can be from 2 to 8 */
-	gint count, width, i;
-
-	/* can't easily detect the supposed width of a tab, guess the default is OK */
-	if (type == GEANY_INDENT_TYPE_TABS)
-		return FALSE;
+	GeanyEditor *editor = doc->editor;
+	const gchar *text;
+	gsize length;
+	gint line_count;
 
-	/* force 8 at detection time for tab & spaces -- anyway we don't use tabs at this point */
-	sci_set_tab_width(sci, 8);
+	text = get_indent_detection_text(editor, &line_count, &length);
+	return document_detect_indent_type_from_text(text, length, line_count,
+		sci_get_tab_width(editor->sci), editor_get_indent_prefs(editor)->width, type_);
+}
 
-	line_count = sci_get_line_count(sci);
-	for (line = 0; line < line_count; line++)
-	{
-		gint pos = sci_get_line_indent_position(sci, line);
 
-		/* We probably don't have style info yet, because we're generally called just after
-		 * the document got created, so we can't use highlighting_is_code_style().
-		 * That's not good, but the assumption below that concerning lines start with an
-		 * asterisk (common continuation character for C/C++/Java/...) should do the trick
-		 * without removing too much legitimate lines. */
-		if (sci_get_char_at(sci, pos) == '*')
-			continue;
+/* Like detect_indent_width() for spaces, but for the first line_count lines of text */
+GEANY_EXPORT_SYMBOL
+gboolean document_detect_indent_width_from_text(const gchar *text, gsize length,
+		gint line_count, gint *width_)
+{
+	IndentStats stats;
+	gint count, width, i;
 
-		width = sci_get_line_indentation(sci, line);
-		/* most code will have indent total <= 24, otherwise it's more likely to be
-		 * alignment than indentation */
-		if (width > 24)
-			continue;
-		/* < 2 is no indentation */
-		if (width < 2)
-			continue;
+	/* the soft tab width only matters for the indent type */
+	scan_indentation(text, length, line_count, 8, 0, &stats);
 
-		for (i = G_N_ELEMENTS(widths) - 1; i >= 0; i--)
-		{
-			if ((width % (i + 2)) == 0)
-				widths[i]++;
-		}
-	}
 	count = 0;
-	width = iprefs->width;
-	for (i = G_N_ELEMENTS(widths) - 1; i >= 0; i--)
+	width = 0;
+	for (i = G_N_ELEMENTS(stats.widths) - 1; i >= 0; i--)
 	{
 		/* give large indents higher weight not to be fooled by spurious indents */
-		if (widths[i] >= count * 1.5)
+		if (stats.widths[i] >= count * 1.5)
 		{
 			width = i + 2;
-			count = widths[i];
+			count = stats.widths[i];
 		}
 	}
 
@@ -1216,6 +1823,26 @@ static gboolean detect_indent_width(GeanyEditor *editor, GeanyIndentType type, g
 }
 
 
+/* Detect the indent width based on counting the leading indent characters for each line.
+ * Returns whether detection succeeded, and the detected width in *width_ upon success */
+static gboolean detect_indent_width(GeanyEditor *editor, GeanyIndentType type, gint *width_)
+{
+	const gchar *text;
+	gsize length;
+	gint line_count;
+
+	/* can't easily detect the supposed width of a tab, guess the default is OK */
+	if (type == GEANY_INDENT_TYPE_TABS)
+		return FALSE;
+
+	/* force 8 at detection time for tab & spaces -- anyway we don't use tabs at this point */
+	sci_set_tab_width(editor->sci, 8);
+
+	text = get_indent_detection_text(editor, &line_count, &length);
+	return document_detect_indent_width_from_text(text, length, line_count, width_);
+}
+
+
 /* same as detect_indent_width() but uses editor's indent type */
 gboolean document_detect_indent_width(GeanyDocument *doc, gint *width_)
 {
@@ -1278,16 +1905,16 @@ void document_show_tab(GeanyDocument *doc)
 }
 
 
-/* To open a new file, set doc to NULL; filename should be locale encoded.
- * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
- * pos is the cursor position, which can be overridden by --line and --column.
- * forced_enc can be NULL to detect the file encoding.
- * Returns: doc of the opened file or NULL if an error occurred. */
-GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
-		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
+/* See document_open_file_full(), preloaded is the file data from document_read_file_data()
+ * or NULL to read the file now. */
+static GeanyDocument *open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc, FileData *preloaded)
 {
 	gint editor_mode;
-	gboolean reload = (doc == NULL) ? FALSE : TRUE;
+	gboolean loaded;
+	/* whether doc is a placeholder from document_open_file_lazy() */
+	gboolean pending = (doc != NULL && doc->priv->pending_load);
+	gboolean reload = (doc != NULL && ! pending);
 	gchar *utf8_filename = NULL;
 	gchar *display_filename = NULL;
 	gchar *locale_filename = NULL;
@@ -1298,8 +1925,10 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 	g_return_val_if_fail(doc == NULL || doc->is_valid, NULL);
 
-	if (reload)
+	if (doc != NULL)
 	{
+		/* don't try to load it again from the document-open handlers */
+		doc->priv->pending_load = FALSE;
 		utf8_filename = g_strdup(doc->file_name);
 		locale_filename = utils_get_locale_from_utf8(utf8_filename);
 	}
@@ -1330,11 +1959,22 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 			document_check_disk_status(doc, TRUE);	/* force a file changed check */
 		}
 	}
-	if (reload || doc == NULL)
+	if (reload || pending || doc == NULL)
 	{	/* doc possibly changed */
 		display_filename = utils_str_middle_truncate(utf8_filename, 100);
 
-		if (! load_text_file(locale_filename, display_filename, &filedata, forced_enc))
+		if (preloaded != NULL)
+		{
+			/* take over the data */
+			filedata = *preloaded;
+			g_free(preloaded);
+			preloaded = NULL;
+			loaded = report_text_file_errors(&filedata, display_filename);
+		}
+		else
+			loaded = load_text_file(locale_filename, display_filename, &filedata, forced_enc);
+
+		if (! loaded)
 		{
 			g_free(display_filename);
 			g_free(utf8_filename);
@@ -1344,11 +1984,15 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 		if (! reload)
 		{
-			doc = document_create(utf8_filename);
-			g_return_val_if_fail(doc != NULL, NULL); /* really should not happen */
+			if (! pending)
+			{
+				doc = document_create(utf8_filename, use_chunked_text(filedata.len));
+				g_return_val_if_fail(doc != NULL, NULL); /* really should not happen */
+			}
 
 			/* file exists on disk, set real_path */
 			SETPTR(doc->real_path, utils_get_real_path(locale_filename));
+			invalidate_document_indexes();
 
 			doc->priv->is_remote = utils_is_remote_path(locale_filename);
 			monitor_file_setup(doc);
@@ -1382,7 +2026,7 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 		/* add the text to the ScintillaObject */
 		sci_set_readonly(doc->editor->sci, FALSE);	/* to allow replacing text */
-		sci_set_text(doc->editor->sci, filedata.data);	/* NULL terminated data */
+		insert_file_text(doc, &filedata, display_filename, ! reload && ! pending);
 		queue_colourise(doc);	/* Ensure the document gets colourised. */
 
 		/* detect & set line endings */
@@ -1395,7 +2039,7 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 				add_undo_reload_action = TRUE;
 		}
 		sci_set_eol_mode(doc->editor->sci, editor_mode);
-		g_free(filedata.data);
+		free_file_data(&filedata);
 
 		sci_set_undo_collection(doc->editor->sci, TRUE);
 
@@ -1431,6 +2075,8 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 				doc->editor);
 
 			use_ft = (ft != NULL) ? ft : filetypes_detect_from_document(doc);
+			/* needs to be known before setting the filetype */
+			doc->priv->large_file = is_large_file(use_ft, filedata.len);
 		}
 		else
 		{	/* reloading */
@@ -1484,11 +2130,13 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 		if (reload)
 		{
 			g_signal_emit_by_name(geany_object, "document-reload", doc);
+			invalidate_document_indexes();
 			ui_set_statusbar(TRUE, _("File %s reloaded."), display_filename);
 		}
 		else
 		{
 			g_signal_emit_by_name(geany_object, "document-open", doc);
+			invalidate_document_indexes();
 			/* For translators: this is the status window message for opening a file. %d is the number
 			 * of the newly opened file, %s indicates whether the file is opened read-only
 			 * (it is replaced with the string ", read-only"). */
@@ -1497,6 +2145,9 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 				(readonly) ? _(", read-only") : "");
 		}
 
+		if (! reload && doc->priv->large_file)
+			show_large_file_message(doc);
+
 		/* now the document is fully ready, display it (see notebook_new_tab()) */
 		gtk_widget_show(document_get_notebook_child(doc));
 	}
@@ -1505,6 +2156,10 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 	g_free(utf8_filename);
 	g_free(locale_filename);
 
+	/* the file was already open */
+	if (preloaded != NULL)
+		document_free_file_data(preloaded);
+
 	/* set the cursor position according to pos, cl_options.goto_line and cl_options.goto_column */
 	pos = set_cursor_position(doc->editor, pos);
 	/* now bring the file in front */
@@ -1517,27 +2172,146 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 }
 
 
-/* Takes a new line separated list of filename URIs and opens each file.
- * length is the length of the string */
-void document_open_file_list(const gchar *data, gsize length)
+/* To open a new file, set doc to NULL; filename should be locale encoded.
+ * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
+ * pos is the cursor position, which can be overridden by --line and --column.
+ * forced_enc can be NULL to detect the file encoding.
+ * Returns: doc of the opened file or NULL if an error occurred. */
+GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
 {
-	guint i;
-	gchar **list;
+	return open_file_full(doc, filename, pos, readonly, ft, forced_enc, NULL);
+}
 
-	g_return_if_fail(data != NULL);
 
-	list = g_strsplit(data, utils_get_eol_char(utils_get_line_endings(data, length)), 0);
+/* Like document_open_file_full() for a new file, but uses filedata from
+ * document_read_file_data() instead of reading filename again. This takes ownership
+ * of filedata. */
+GeanyDocument *document_open_file_data(FileData *filedata, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft)
+{
+	g_return_val_if_fail(filedata != NULL, NULL);
 
-	/* stop at the end or first empty item, because last item is empty but not null */
-	for (i = 0; list[i] != NULL && list[i][0] != '\0'; i++)
-	{
-		gchar *filename = utils_get_path_from_uri(list[i]);
+	return open_file_full(NULL, filename, pos, readonly, ft, NULL, filedata);
+}
 
-		if (filename == NULL)
-			continue;
-		document_open_file(filename, FALSE, NULL, NULL);
-		g_free(filename);
-	}
+
+/* Adds a tab for filename without reading the file, which is only loaded by
+ * document_load_pending() when the tab is first shown.
+ * filename should be locale encoded, ft and forced_enc are used when loading the file.
+ * Returns: the placeholder document, or the document if the file is already open. */
+GeanyDocument *document_open_file_lazy(const gchar *filename, gint pos, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc)
+{
+	GeanyDocument *doc;
+	gchar *locale_filename;
+	gchar *utf8_filename;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+
+	locale_filename = g_strdup(filename);
+	utils_tidy_path(locale_filename);
+	utf8_filename = utils_get_utf8_from_locale(locale_filename);
+
+	doc = find_by_filename(utf8_filename);
+	if (doc == NULL)
+	{
+		GStatBuf st;
+		/* the storage is chosen on creation, so use the size of the file to load later */
+		gboolean chunked = g_stat(locale_filename, &st) == 0 && use_chunked_text(st.st_size);
+
+		doc = document_create(utf8_filename, chunked);
+		SETPTR(doc->real_path, utils_get_real_path(locale_filename));
+		invalidate_document_indexes();
+		doc->priv->is_remote = utils_is_remote_path(locale_filename);
+
+		doc->priv->pending_load = TRUE;
+		doc->priv->pending_pos = pos;
+		doc->encoding = g_strdup(forced_enc);
+		doc->readonly = readonly;
+		sci_set_readonly(doc->editor->sci, TRUE);
+		/* the filetype is only set up when loading the file, but the icon is shown now */
+		doc->file_type = (ft != NULL) ? ft : filetypes_detect_from_extension(utf8_filename);
+
+		ui_update_tab_status(doc);
+		gtk_widget_show(document_get_notebook_child(doc));
+	}
+	g_free(utf8_filename);
+	g_free(locale_filename);
+	return doc;
+}
+
+
+/* Loads the file of a placeholder document from document_open_file_lazy(), keeping
+ * the settings restored from the session.
+ * Returns: FALSE if the file could not be loaded, it will be tried again next time. */
+gboolean document_load_pending(GeanyDocument *doc)
+{
+	GeanyFiletype *ft;
+	GeanyIndentType indent_type;
+	gint indent_width;
+	gchar *forced_enc;
+	GeanyDocument *new_doc;
+
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	if (! doc->priv->pending_load)
+		return TRUE;
+
+	ft = doc->file_type;
+	indent_type = doc->editor->indent_type;
+	indent_width = doc->editor->indent_width;
+	forced_enc = g_strdup(doc->encoding);
+
+	/* let document_set_filetype() do the full setup */
+	doc->file_type = NULL;
+	new_doc = open_file_full(doc, NULL, doc->priv->pending_pos, doc->readonly, ft, forced_enc, NULL);
+	g_free(forced_enc);
+
+	if (new_doc == NULL)
+	{
+		doc->file_type = ft;
+		doc->priv->pending_load = TRUE;
+		return FALSE;
+	}
+	editor_set_indent(doc->editor, indent_type, indent_width);
+	return TRUE;
+}
+
+
+/* Gets the cursor position to store in the session file. */
+gint document_get_session_position(GeanyDocument *doc)
+{
+	g_return_val_if_fail(doc != NULL, 0);
+
+	if (doc->priv->pending_load)
+		return doc->priv->pending_pos;
+
+	return sci_get_current_position(doc->editor->sci);
+}
+
+
+/* Takes a new line separated list of filename URIs and opens each file.
+ * length is the length of the string */
+void document_open_file_list(const gchar *data, gsize length)
+{
+	guint i;
+	gchar **list;
+
+	g_return_if_fail(data != NULL);
+
+	list = g_strsplit(data, utils_get_eol_char(utils_get_line_endings(data, length)), 0);
+
+	/* stop at the end or first empty item, because last item is empty but not null */
+	for (i = 0; list[i] != NULL && list[i][0] != '\0'; i++)
+	{
+		gchar *filename = utils_get_path_from_uri(list[i]);
+
+		if (filename == NULL)
+			continue;
+		document_open_file(filename, FALSE, NULL, NULL);
+		g_free(filename);
+	}
 
 	g_strfreev(list);
 }
@@ -1601,6 +2375,10 @@ gboolean document_reload_force(GeanyDocument *doc, const gchar *forced_enc)
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
+	/* a placeholder has no changes to keep, just load it */
+	if (doc->priv->pending_load)
+		return document_load_pending(doc);
+
 	/* Cancel resave bar if still open from previous file deletion */
 	if (doc->priv->info_bars[MSG_TYPE_RESAVE] != NULL)
 		gtk_info_bar_response(GTK_INFO_BAR(doc->priv->info_bars[MSG_TYPE_RESAVE]), GTK_RESPONSE_CANCEL);
@@ -1678,27 +2456,22 @@ static void document_update_timestamp(GeanyDocument *doc, const gchar *locale_fi
 
 /* Sets line and column to the given position byte_pos in the document.
  * byte_pos is the position counted in bytes, not characters */
-static void get_line_column_from_pos(GeanyDocument *doc, guint byte_pos, gint *line, gint *column)
+/* Gets the line and the column in characters of byte_pos in the UTF-8 text data. */
+static void get_line_column_from_data(const gchar *data, gsize byte_pos, gint *line, gint *column)
 {
-	gint i;
-	gint line_start;
-
-	/* for some reason we can use byte count instead of character count here */
-	*line = sci_get_line_from_position(doc->editor->sci, byte_pos);
-	line_start = sci_get_position_from_line(doc->editor->sci, *line);
-	/* get the column in the line */
-	*column = byte_pos - line_start;
+	gsize i;
+	gsize line_start = 0;
 
-	/* any non-ASCII characters are encoded with two bytes(UTF-8, always in Scintilla), so
-	 * skip one byte(i++) and decrease the column number which is based on byte count */
-	for (i = line_start; i < (line_start + *column); i++)
+	*line = 0;
+	for (i = 0; i < byte_pos; i++)
 	{
-		if (sci_get_char_at(doc->editor->sci, i) < 0)
+		if (data[i] == '\n' || (data[i] == '\r' && data[i + 1] != '\n'))
 		{
-			(*column)--;
-			i++;
+			(*line)++;
+			line_start = i + 1;
 		}
 	}
+	*column = g_utf8_strlen(data + line_start, byte_pos - line_start);
 }
 
 
@@ -1826,6 +2599,7 @@ gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
 
 	/* reset real path, it's retrieved again in document_save() */
 	SETPTR(doc->real_path, NULL);
+	invalidate_document_indexes();
 
 	/* detect filetype */
 	if (doc->file_type->id == GEANY_FILETYPES_NONE)
@@ -1865,80 +2639,19 @@ gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
 }
 
 
-static gsize save_convert_to_encoding(GeanyDocument *doc, gchar **data, gsize *len)
-{
-	GError *conv_error = NULL;
-	gchar* conv_file_contents = NULL;
-	gsize bytes_read;
-	gsize conv_len;
-
-	g_return_val_if_fail(data != NULL && *data != NULL, FALSE);
-	g_return_val_if_fail(len != NULL, FALSE);
-
-	/* try to convert it from UTF-8 to original encoding */
-	conv_file_contents = g_convert(*data, *len - 1, doc->encoding, "UTF-8",
-												&bytes_read, &conv_len, &conv_error);
-
-	if (conv_error != NULL)
-	{
-		gchar *text = g_strdup_printf(
-_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
-			doc->encoding);
-		gchar *error_text;
-
-		if (conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
-		{
-			gint line, column;
-			gint context_len;
-			gunichar unic;
-			/* don't read over the doc length */
-			gint max_len = MIN((gint)bytes_read + 6, (gint)*len - 1);
-			gchar context[7]; /* read 6 bytes from Sci + '\0' */
-			sci_get_text_range(doc->editor->sci, bytes_read, max_len, context);
-
-			/* take only one valid Unicode character from the context and discard the leftover */
-			unic = g_utf8_get_char_validated(context, -1);
-			context_len = g_unichar_to_utf8(unic, context);
-			context[context_len] = '\0';
-			get_line_column_from_pos(doc, bytes_read, &line, &column);
-
-			error_text = g_strdup_printf(
-				_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
-				conv_error->message, context, line + 1, column);
-		}
-		else
-			error_text = g_strdup_printf(_("Error message: %s."), conv_error->message);
-
-		geany_debug("encoding error: %s", conv_error->message);
-		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
-		g_error_free(conv_error);
-		g_free(text);
-		g_free(error_text);
-		return FALSE;
-	}
-	else
-	{
-		g_free(*data);
-		*data = conv_file_contents;
-		*len = conv_len;
-	}
-	return TRUE;
-}
-
-
-static gchar *write_data_to_disk(const gchar *locale_filename,
-								 const gchar *data, gsize len)
+static gchar *write_data_to_disk(const SaveData *sd, const gchar *data, gsize len)
 {
+	const gchar *locale_filename = sd->locale_filename;
 	GError *error = NULL;
 
-	if (file_prefs.use_safe_file_saving)
+	if (sd->safe_saving)
 	{
 		/* Use old GLib API for safe saving (GVFS-safe, but alters ownership and permissons).
 		 * This is the only option that handles disk space exhaustion. */
 		if (g_file_set_contents(locale_filename, data, len, &error))
 			geany_debug("Wrote %s with g_file_set_contents().", locale_filename);
 	}
-	else if (USE_GIO_FILE_OPERATIONS)
+	else if (sd->use_gio)
 	{
 		GFile *fp;
 
@@ -1946,7 +2659,7 @@ static gchar *write_data_to_disk(const gchar *locale_filename,
 		 * It is best in most GVFS setups but don't seem to work correctly on some more complex
 		 * setups (saving from some VM to their host, over some SMB shares, etc.) */
 		fp = g_file_new_for_path(locale_filename);
-		g_file_replace_contents(fp, data, len, NULL, file_prefs.gio_unsafe_save_backup,
+		g_file_replace_contents(fp, data, len, NULL, sd->gio_backup,
 			G_FILE_CREATE_NONE, NULL, NULL, &error);
 		g_object_unref(fp);
 	}
@@ -2018,24 +2731,390 @@ static gchar *write_data_to_disk(const gchar *locale_filename,
 }
 
 
-static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename,
-								 const gchar *data, gsize len)
+/* size of the buffer for the converted data when saving */
+#define SAVE_CONVERT_CHUNK_SIZE 65536
+
+typedef gboolean (*ConvertedDataFunc)(const gchar *data, gsize len, gpointer user_data,
+		GError **error);
+
+
+/* Converts data from UTF-8 to encoding a chunk at a time, passing the converted chunks to
+ * func (which can be NULL to only check the conversion), so the converted data is never
+ * in memory at once. Conversion errors are set in conv_error, with error_pos set to the
+ * position of the error in data, and errors of func in error. */
+static gboolean convert_data_chunked(const gchar *data, gsize len, const gchar *encoding,
+		ConvertedDataFunc func, gpointer user_data, gsize *error_pos, GError **conv_error,
+		GError **error)
 {
-	gchar *err;
+	GIConv cd;
+	gchar *in = (gchar *) data;
+	gsize in_left = len;
+	gchar *out_buf;
+	gboolean ok = TRUE;
+	gboolean flushed = FALSE;
+
+	cd = g_iconv_open(encoding, "UTF-8");
+	if (cd == (GIConv) -1)
+	{
+		g_set_error(conv_error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+			_("Conversion from UTF-8 to \"%s\" is not supported"), encoding);
+		*error_pos = 0;
+		return FALSE;
+	}
 
-	g_return_val_if_fail(doc != NULL, g_strdup(g_strerror(EINVAL)));
-	g_return_val_if_fail(data != NULL, g_strdup(g_strerror(EINVAL)));
+	out_buf = g_malloc(SAVE_CONVERT_CHUNK_SIZE);
+	while (ok && ! flushed)
+	{
+		gchar *out = out_buf;
+		gsize out_left = SAVE_CONVERT_CHUNK_SIZE;
+		gsize res;
 
-	err = write_data_to_disk(locale_filename, data, len);
-	if (err)
-		return err;
+		if (in_left > 0)
+			res = g_iconv(cd, &in, &in_left, &out, &out_left);
+		else
+		{
+			/* write the sequence resetting the shift state, if any */
+			res = g_iconv(cd, NULL, NULL, &out, &out_left);
+			flushed = (res != (gsize) -1);
+		}
 
-	/* now the file is on disk, set real_path */
-	if (doc->real_path == NULL)
+		if (res == (gsize) -1 && errno != E2BIG)
+		{
+			gint conv_errno = errno;
+
+			*error_pos = in - data;
+			/* EINVAL is a partial character at the end, which can only be invalid */
+			if (conv_errno == EILSEQ || conv_errno == EINVAL)
+				g_set_error_literal(conv_error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+					_("Invalid byte sequence in conversion input"));
+			else
+				g_set_error_literal(conv_error, G_CONVERT_ERROR, G_CONVERT_ERROR_FAILED,
+					g_strerror(conv_errno));
+			ok = FALSE;
+		}
+		else if (func != NULL && out > out_buf)
+			ok = func(out_buf, out - out_buf, user_data, error);
+	}
+	g_free(out_buf);
+	g_iconv_close(cd);
+
+	return ok;
+}
+
+
+static gboolean write_converted_to_stream(const gchar *data, gsize len, gpointer stream,
+		GError **error)
+{
+	return g_output_stream_write_all(stream, data, len, NULL, NULL, error);
+}
+
+
+static gboolean write_converted_to_file(const gchar *data, gsize len, gpointer fp,
+		GError **error)
+{
+	errno = 0;
+	if (fwrite(data, sizeof(gchar), len, fp) != len)
 	{
-		doc->real_path = utils_get_real_path(locale_filename);
-		doc->priv->is_remote = utils_is_remote_path(locale_filename);
-		monitor_file_setup(doc);
+		gint save_errno = errno;
+
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(save_errno),
+			_("fwrite() failed: %s"), g_strerror(save_errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* Passes the contents of fp to func a chunk at a time. */
+static gboolean copy_file_chunked(FILE *fp, ConvertedDataFunc func, gpointer user_data,
+		GError **error)
+{
+	gchar *buf = g_malloc(SAVE_CONVERT_CHUNK_SIZE);
+	gboolean ok = TRUE;
+	gsize len;
+
+	errno = 0;
+	while (ok && (len = fread(buf, sizeof(gchar), SAVE_CONVERT_CHUNK_SIZE, fp)) > 0)
+		ok = func(buf, len, user_data, error);
+
+	if (ok && ferror(fp))
+	{
+		gint save_errno = errno;
+
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(save_errno),
+			_("fread() failed: %s"), g_strerror(save_errno));
+		ok = FALSE;
+	}
+	g_free(buf);
+	return ok;
+}
+
+
+/* Converts the data of sd to its encoding into a temporary file, so that it is converted
+ * only once and the file to save is untouched on conversion errors.
+ * Returns: the rewound temporary file, to close and delete with tmp_name, or NULL if
+ * converting (see sd->conv_error) or writing the temporary file failed */
+static FILE *convert_save_data_to_tmp_file(SaveData *sd, gchar **tmp_name)
+{
+	FILE *fp = NULL;
+	gint fd;
+
+	fd = g_file_open_tmp("geany_save_XXXXXX", tmp_name, NULL);
+	if (fd == -1)
+		return NULL;
+
+	fp = fdopen(fd, "w+b");
+	if (fp == NULL)
+		close(fd);
+	else if (! convert_data_chunked(sd->data, sd->len - 1, sd->encoding,
+			write_converted_to_file, fp, &sd->conv_error_pos, &sd->conv_error, NULL) ||
+		fflush(fp) != 0 || fseek(fp, 0, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		fp = NULL;
+	}
+
+	if (fp == NULL)
+	{
+		g_unlink(*tmp_name);
+		SETPTR(*tmp_name, NULL);
+	}
+	return fp;
+}
+
+
+/* Writes the data of sd converted to its encoding to func, copying it from tmp_fp if set.
+ * Otherwise the data is converted again, which can only fail when the data was already
+ * checked to be convertible. */
+static gboolean write_converted_chunks(SaveData *sd, FILE *tmp_fp, ConvertedDataFunc func,
+		gpointer user_data, GError **error)
+{
+	if (tmp_fp != NULL)
+		return copy_file_chunked(tmp_fp, func, user_data, error);
+
+	return convert_data_chunked(sd->data, sd->len - 1, sd->encoding, func, user_data,
+		&sd->conv_error_pos, error, error);
+}
+
+
+/* Like write_data_to_disk() for unsafe saving, but converts the UTF-8 data of sd to its
+ * encoding without the whole converted data in memory. As when converting before
+ * writing, the file is left untouched on conversion errors, which are set in
+ * sd->conv_error and sd->conv_error_pos.
+ * Returns: the error message if writing failed */
+static gchar *write_converted_data_to_disk(SaveData *sd)
+{
+	const gchar *locale_filename = sd->locale_filename;
+	gchar *tmp_name = NULL;
+	FILE *tmp_fp;
+	GError *error = NULL;
+
+	g_return_val_if_fail(! sd->safe_saving, NULL);
+
+	/* a conversion error after opening the file would truncate it (the GIO stream
+	 * replaces symlinked and hard-linked files in place), so convert it completely into
+	 * a temporary file first, and only write the file from there */
+	tmp_fp = convert_save_data_to_tmp_file(sd, &tmp_name);
+	if (sd->conv_error != NULL)
+		return NULL;
+	/* without a temporary file (e.g. no space left for it), only check the conversion
+	 * here and convert again while writing */
+	if (tmp_fp == NULL && ! convert_data_chunked(sd->data, sd->len - 1, sd->encoding,
+			NULL, NULL, &sd->conv_error_pos, &sd->conv_error, NULL))
+		return NULL;
+
+	if (sd->use_gio)
+	{
+		GFile *fp = g_file_new_for_path(locale_filename);
+		GFileOutputStream *stream;
+
+		stream = g_file_replace(fp, NULL, sd->gio_backup,
+			G_FILE_CREATE_NONE, NULL, &error);
+		if (stream != NULL)
+		{
+			if (write_converted_chunks(sd, tmp_fp, write_converted_to_stream, stream, &error))
+			{
+				g_output_stream_close(G_OUTPUT_STREAM(stream), NULL, &error);
+			}
+			else
+			{
+				GCancellable *cancellable = g_cancellable_new();
+
+				/* keep the original file if it is replaced only when closing the stream */
+				g_cancellable_cancel(cancellable);
+				g_output_stream_close(G_OUTPUT_STREAM(stream), cancellable, NULL);
+				g_object_unref(cancellable);
+			}
+			g_object_unref(stream);
+		}
+		g_object_unref(fp);
+	}
+	else
+	{
+		gchar *display_name = g_filename_display_name(locale_filename);
+		FILE *fp;
+		gint save_errno;
+
+		errno = 0;
+		fp = g_fopen(locale_filename, "wb");
+		if (fp == NULL)
+		{
+			save_errno = errno;
+
+			g_set_error(&error,
+				G_FILE_ERROR,
+				g_file_error_from_errno(save_errno),
+				_("Failed to open file '%s' for writing: fopen() failed: %s"),
+				display_name,
+				g_strerror(save_errno));
+		}
+		else
+		{
+			if (! write_converted_chunks(sd, tmp_fp, write_converted_to_file, fp, &error))
+			{
+				SETPTR(error->message, g_strdup_printf(_("Failed to write file '%s': %s"),
+					display_name, error->message));
+			}
+
+			errno = 0;
+			/* preserve the fwrite() error if any */
+			if (fclose(fp) != 0 && error == NULL)
+			{
+				save_errno = errno;
+
+				g_set_error(&error,
+					G_FILE_ERROR,
+					g_file_error_from_errno(save_errno),
+					_("Failed to close file '%s': fclose() failed: %s"),
+					display_name,
+					g_strerror(save_errno));
+			}
+		}
+		g_free(display_name);
+	}
+
+	if (tmp_fp != NULL)
+	{
+		fclose(tmp_fp);
+		g_unlink(tmp_name);
+		g_free(tmp_name);
+	}
+
+	if (error != NULL)
+	{
+		gchar *msg = g_strdup(error->message);
+		g_error_free(error);
+		return msg;
+	}
+	return NULL;
+}
+
+
+/* Like write_data_to_disk() for safe saving, but converts the UTF-8 data of sd to its
+ * encoding while writing the temporary file, so the converted data is never in memory at
+ * once. The file is only replaced if the whole data could be converted, otherwise
+ * sd->conv_error and sd->conv_error_pos are set.
+ * Returns: the error message if writing failed */
+static gchar *write_converted_data_safely(SaveData *sd)
+{
+	gchar *display_name = g_filename_display_name(sd->locale_filename);
+	gchar *tmp_name = g_strconcat(sd->locale_filename, ".XXXXXX", NULL);
+	GError *error = NULL;
+	FILE *fp = NULL;
+	gint save_errno;
+	gint fd;
+
+	g_return_val_if_fail(sd->safe_saving, NULL);
+
+	/* like g_file_set_contents(), write a temporary file next to the file and rename it */
+	errno = 0;
+	fd = g_mkstemp_full(tmp_name, O_RDWR | O_BINARY, 0666);
+	if (fd != -1)
+		fp = fdopen(fd, "wb");
+
+	if (fp == NULL)
+	{
+		save_errno = errno;
+
+		if (fd != -1)
+		{
+			close(fd);
+			g_unlink(tmp_name);
+		}
+		g_set_error(&error,
+			G_FILE_ERROR,
+			g_file_error_from_errno(save_errno),
+			_("Failed to create file '%s': %s"),
+			display_name,
+			g_strerror(save_errno));
+	}
+	else
+	{
+		if (convert_data_chunked(sd->data, sd->len - 1, sd->encoding, write_converted_to_file,
+				fp, &sd->conv_error_pos, &sd->conv_error, &error))
+		{
+			errno = 0;
+			if (fflush(fp) != 0
+#ifndef G_OS_WIN32
+				|| fsync(fileno(fp)) != 0
+#endif
+				)
+			{
+				save_errno = errno;
+
+				g_set_error(&error,
+					G_FILE_ERROR,
+					g_file_error_from_errno(save_errno),
+					_("Failed to write file '%s': %s"),
+					display_name,
+					g_strerror(save_errno));
+			}
+		}
+		else if (error != NULL)
+		{
+			SETPTR(error->message, g_strdup_printf(_("Failed to write file '%s': %s"),
+				display_name, error->message));
+		}
+
+		errno = 0;
+		/* preserve the write error if any */
+		if (fclose(fp) != 0 && error == NULL && sd->conv_error == NULL)
+		{
+			save_errno = errno;
+
+			g_set_error(&error,
+				G_FILE_ERROR,
+				g_file_error_from_errno(save_errno),
+				_("Failed to close file '%s': fclose() failed: %s"),
+				display_name,
+				g_strerror(save_errno));
+		}
+
+		errno = 0;
+		if (error == NULL && sd->conv_error == NULL &&
+			g_rename(tmp_name, sd->locale_filename) != 0)
+		{
+			save_errno = errno;
+
+			g_set_error(&error,
+				G_FILE_ERROR,
+				g_file_error_from_errno(save_errno),
+				_("Failed to rename file '%s': g_rename() failed: %s"),
+				display_name,
+				g_strerror(save_errno));
+		}
+		/* the file itself is untouched until the rename */
+		if (error != NULL || sd->conv_error != NULL)
+			g_unlink(tmp_name);
+	}
+	g_free(display_name);
+	g_free(tmp_name);
+
+	if (error != NULL)
+	{
+		gchar *msg = g_strdup(error->message);
+		g_error_free(error);
+		return msg;
 	}
 	return NULL;
 }
@@ -2075,60 +3154,258 @@ static gboolean save_file_handle_infobars(GeanyDocument *doc, gboolean force)
 }
 
 
-/**
- *  Saves the document.
- *  Also shows the Save As dialog if necessary.
- *  If the file is not modified, this function may do nothing unless @a force is set to @c TRUE.
- *
- *  Saving may include replacing tabs with spaces,
- *  stripping trailing spaces and adding a final new line at the end of the file, depending
- *  on user preferences. Then the @c "document-before-save" signal is emitted,
- *  allowing plugins to modify the document before it is saved, and data is
- *  actually written to disk.
- *
- *  On successful saving:
- *  - GeanyDocument::real_path is set.
- *  - The filetype is set again or auto-detected if it wasn't set yet.
- *  - The @c "document-save" signal is emitted for plugins.
- *
- *  @warning You should ensure @c doc->file_name has an absolute path unless you want the
- *  Save As dialog to be shown. A @c NULL value also shows the dialog. This behaviour was
- *  added in Geany 1.22.
- *
- *  @param doc The document to save.
- *  @param force Whether to save the file even if it is not modified.
- *
- *  @return @c TRUE if the file was saved or @c FALSE if the file could not or should not be saved.
- **/
-GEANY_API_SYMBOL
-gboolean document_save_file(GeanyDocument *doc, gboolean force)
+static SaveData *save_data_new(GeanyDocument *doc)
 {
-	gchar *errmsg;
-	gchar *data;
-	gsize len;
-	gchar *locale_filename;
-	const GeanyFilePrefs *fp;
+	SaveData *sd = g_new0(SaveData, 1);
 
+	sd->doc_id = doc->id;
+	sd->locale_filename = utils_get_locale_from_utf8(doc->file_name);
+
+	sd->len = sci_get_length(doc->editor->sci) + 1;
+	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
+	{	/* always write a UTF-8 BOM because in this moment the text itself is still in UTF-8
+		 * encoding, it will be converted to doc->encoding below and this conversion
+		 * also changes the BOM */
+		sd->data = (gchar*) g_malloc(sd->len + 3);	/* 3 chars for BOM */
+		sd->data[0] = (gchar) 0xef;
+		sd->data[1] = (gchar) 0xbb;
+		sd->data[2] = (gchar) 0xbf;
+		sci_get_text(doc->editor->sci, sd->len, sd->data + 3);
+		sd->len += 3;
+		sd->bom_len = 3;
+	}
+	else
+	{
+		sd->data = (gchar*) g_malloc(sd->len);
+		sci_get_text(doc->editor->sci, sd->len, sd->data);
+	}
+
+	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
+	if (doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
+		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset))
+	{
+		sd->encoding = g_strdup(doc->encoding);
+	}
+
+	sd->safe_saving = file_prefs.use_safe_file_saving;
+	sd->use_gio = USE_GIO_FILE_OPERATIONS;
+	sd->gio_backup = file_prefs.gio_unsafe_save_backup;
+	return sd;
+}
+
+
+static void save_data_free(SaveData *sd)
+{
+	if (sd->conv_error != NULL)
+		g_error_free(sd->conv_error);
+	g_free(sd->errmsg);
+	g_free(sd->data);
+	g_free(sd->encoding);
+	g_free(sd->locale_filename);
+	g_free(sd);
+}
+
+
+/* Converts the data to its encoding and writes it to disk.
+ * This doesn't use the document, so it can be called from a worker thread. */
+static void save_data_write(SaveData *sd)
+{
+	/* convert while writing, so the converted data isn't in memory at once */
+	if (sd->encoding != NULL && sd->safe_saving)
+		sd->errmsg = write_converted_data_safely(sd);
+	else if (sd->encoding != NULL)
+		sd->errmsg = write_converted_data_to_disk(sd);
+	else
+		sd->errmsg = write_data_to_disk(sd, sd->data, strlen(sd->data));
+}
+
+
+static void show_save_conversion_error(SaveData *sd)
+{
+	gchar *text = g_strdup_printf(
+_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
+		sd->encoding);
+	gchar *error_text;
+
+	if (sd->conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
+	{
+		gint line, column;
+		gint context_len;
+		gunichar unic;
+		/* don't read over the data length */
+		gsize max_len = MIN(sd->conv_error_pos + 6, sd->len - 1);
+		gchar context[7]; /* read 6 bytes from the data + '\0' */
+
+		memcpy(context, sd->data + sd->conv_error_pos, max_len - sd->conv_error_pos);
+		context[max_len - sd->conv_error_pos] = '\0';
+
+		/* take only one valid Unicode character from the context and discard the leftover */
+		unic = g_utf8_get_char_validated(context, -1);
+		context_len = g_unichar_to_utf8(unic, context);
+		context[context_len] = '\0';
+		get_line_column_from_data(sd->data + sd->bom_len, sd->conv_error_pos - sd->bom_len,
+			&line, &column);
+
+		error_text = g_strdup_printf(
+			_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
+			sd->conv_error->message, context, line + 1, column);
+	}
+	else
+		error_text = g_strdup_printf(_("Error message: %s."), sd->conv_error->message);
+
+	geany_debug("encoding error: %s", sd->conv_error->message);
+	dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
+	g_free(text);
+	g_free(error_text);
+}
+
+
+/* Reports the result of writing sd and updates its document.
+ * Returns: whether the file was saved. */
+static gboolean save_data_finish(SaveData *sd)
+{
+	GeanyDocument *doc = find_by_id(sd->doc_id);
+
+	/* the document can only be closed when all its saves are finished */
 	g_return_val_if_fail(doc != NULL, FALSE);
 
+	if (sd->conv_error != NULL)
+		show_save_conversion_error(sd);
+	else if (sd->errmsg != NULL)
+	{
+		ui_set_statusbar(TRUE, _("Error saving file (%s)."), sd->errmsg);
+
+		if (! sd->safe_saving)
+		{
+			SETPTR(sd->errmsg,
+				g_strdup_printf(_("%s\n\nThe file on disk may now be truncated!"), sd->errmsg));
+		}
+		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, _("Error saving file."), sd->errmsg);
+		utils_beep();
+	}
+
+	if (sd->async)
+		doc->priv->pending_saves--;
+
+	if (sd->conv_error != NULL || sd->errmsg != NULL)
+	{
+		doc->priv->file_disk_status = FILE_OK;
+		/* the save point was already set when starting to save, but the file on disk
+		 * doesn't match it */
+		if (sd->async)
+			sci_discard_savepoint(doc->editor->sci);
+		return FALSE;
+	}
+
+	/* now the file is on disk, set real_path */
+	if (doc->real_path == NULL)
+	{
+		doc->real_path = utils_get_real_path(sd->locale_filename);
+		invalidate_document_indexes();
+		doc->priv->is_remote = utils_is_remote_path(sd->locale_filename);
+		monitor_file_setup(doc);
+	}
+
+	/* store the opened encoding for undo/redo */
+	store_saved_encoding(doc);
+
+	/* ignore the following things if we are quitting */
+	if (! main_status.quitting)
+	{
+		if (! sd->async)
+			sci_set_savepoint(doc->editor->sci);
+
+		if (file_prefs.disk_check_timeout > 0)
+			document_update_timestamp(doc, sd->locale_filename);
+
+		/* update filetype-related things */
+		document_set_filetype(doc, doc->file_type);
+
+		document_update_tab_label(doc);
+
+		msgwin_status_add(_("File %s saved."), doc->file_name);
+		ui_update_statusbar(doc, -1);
+#ifdef HAVE_VTE
+		vte_cwd((doc->real_path != NULL) ? doc->real_path : doc->file_name, FALSE);
+#endif
+	}
+
+	g_signal_emit_by_name(geany_object, "document-save", doc);
+	invalidate_document_indexes();
+
+	return TRUE;
+}
+
+
+/* Finishes the saves written in the background, waiting for the ones still being
+ * written if wait is set. */
+static void finish_pending_saves(gboolean wait)
+{
+	while (pending_saves > 0)
+	{
+		SaveData *sd = wait ? g_async_queue_pop(saved_queue) : g_async_queue_try_pop(saved_queue);
+
+		if (sd == NULL)
+			break;
+
+		pending_saves--;
+		save_data_finish(sd);
+		save_data_free(sd);
+	}
+}
+
+
+static gboolean on_save_written_idle(gpointer data)
+{
+	finish_pending_saves(FALSE);
+	return FALSE;
+}
+
+
+/* Called in the save thread */
+static void save_thread_func(gpointer data, gpointer user_data)
+{
+	SaveData *sd = data;
+
+	save_data_write(sd);
+
+	g_async_queue_push(saved_queue, sd);
+	g_idle_add(on_save_written_idle, NULL);
+}
+
+
+/* Does the checks and changes before saving doc, and gets the data to save.
+ * Returns: the data, or NULL if the file should not be written now, and then
+ * result is set to what document_save_file() should return. */
+static SaveData *save_file_prepare(GeanyDocument *doc, gboolean force, gboolean *result)
+{
+	const GeanyFilePrefs *fp;
+	SaveData *sd;
+
+	*result = FALSE;
+
 	if (document_need_save_as(doc))
 	{
 		/* ensure doc is the current tab before showing the dialog */
 		document_show_tab(doc);
-		return dialogs_show_save_as();
+		*result = dialogs_show_save_as();
+		return NULL;
 	}
 
 	if (!force && !doc->changed)
-		return FALSE;
+		return NULL;
 	if (doc->readonly)
 	{
 		ui_set_statusbar(TRUE,
 			_("Cannot save read-only document '%s'!"), DOC_FILENAME(doc));
-		return FALSE;
+		return NULL;
 	}
-	document_check_disk_status(doc, TRUE);
+	check_disk_status_now(doc);
 	if (doc->priv->protected)
-		return save_file_handle_infobars(doc, force);
+	{
+		*result = save_file_handle_infobars(doc, force);
+		return NULL;
+	}
 
 	fp = project_get_file_prefs();
 	/* replaces tabs with spaces but only if the current file is not a Makefile */
@@ -2147,90 +3424,93 @@ gboolean document_save_file(GeanyDocument *doc, gboolean force)
 	/* notify plugins which may wish to modify the document before it's saved */
 	g_signal_emit_by_name(geany_object, "document-before-save", doc);
 
-	len = sci_get_length(doc->editor->sci) + 1;
-	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
-	{	/* always write a UTF-8 BOM because in this moment the text itself is still in UTF-8
-		 * encoding, it will be converted to doc->encoding below and this conversion
-		 * also changes the BOM */
-		data = (gchar*) g_malloc(len + 3);	/* 3 chars for BOM */
-		data[0] = (gchar) 0xef;
-		data[1] = (gchar) 0xbb;
-		data[2] = (gchar) 0xbf;
-		sci_get_text(doc->editor->sci, len, data + 3);
-		len += 3;
-	}
-	else
-	{
-		data = (gchar*) g_malloc(len);
-		sci_get_text(doc->editor->sci, len, data);
-	}
-
-	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
-	if (doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
-		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset))
-	{
-		if (! save_convert_to_encoding(doc, &data, &len))
-		{
-			g_free(data);
-			return FALSE;
-		}
-	}
-	else
-	{
-		len = strlen(data);
-	}
-
-	locale_filename = utils_get_locale_from_utf8(doc->file_name);
+	sd = save_data_new(doc);
 
 	/* ignore file changed notification when the file is written */
 	doc->priv->file_disk_status = FILE_IGNORE;
 
-	/* actually write the content of data to the file on disk */
-	errmsg = save_doc(doc, locale_filename, data, len);
-	g_free(data);
+	return sd;
+}
 
-	if (errmsg != NULL)
-	{
-		ui_set_statusbar(TRUE, _("Error saving file (%s)."), errmsg);
 
-		if (!file_prefs.use_safe_file_saving)
-		{
-			SETPTR(errmsg,
-				g_strdup_printf(_("%s\n\nThe file on disk may now be truncated!"), errmsg));
-		}
-		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, _("Error saving file."), errmsg);
-		doc->priv->file_disk_status = FILE_OK;
-		utils_beep();
-		g_free(locale_filename);
-		g_free(errmsg);
-		return FALSE;
-	}
+/**
+ *  Saves the document.
+ *  Also shows the Save As dialog if necessary.
+ *  If the file is not modified, this function may do nothing unless @a force is set to @c TRUE.
+ *
+ *  Saving may include replacing tabs with spaces,
+ *  stripping trailing spaces and adding a final new line at the end of the file, depending
+ *  on user preferences. Then the @c "document-before-save" signal is emitted,
+ *  allowing plugins to modify the document before it is saved, and data is
+ *  actually written to disk.
+ *
+ *  On successful saving:
+ *  - GeanyDocument::real_path is set.
+ *  - The filetype is set again or auto-detected if it wasn't set yet.
+ *  - The @c "document-save" signal is emitted for plugins.
+ *
+ *  @warning You should ensure @c doc->file_name has an absolute path unless you want the
+ *  Save As dialog to be shown. A @c NULL value also shows the dialog. This behaviour was
+ *  added in Geany 1.22.
+ *
+ *  @param doc The document to save.
+ *  @param force Whether to save the file even if it is not modified.
+ *
+ *  @return @c TRUE if the file was saved or @c FALSE if the file could not or should not be saved.
+ **/
+GEANY_API_SYMBOL
+gboolean document_save_file(GeanyDocument *doc, gboolean force)
+{
+	SaveData *sd;
+	gboolean ret;
 
-	/* store the opened encoding for undo/redo */
-	store_saved_encoding(doc);
+	g_return_val_if_fail(doc != NULL, FALSE);
 
-	/* ignore the following things if we are quitting */
-	if (! main_status.quitting)
-	{
-		sci_set_savepoint(doc->editor->sci);
+	/* files being saved in the background must be written first */
+	finish_pending_saves(TRUE);
 
-		if (file_prefs.disk_check_timeout > 0)
-			document_update_timestamp(doc, locale_filename);
+	sd = save_file_prepare(doc, force, &ret);
+	if (sd == NULL)
+		return ret;
 
-		/* update filetype-related things */
-		document_set_filetype(doc, doc->file_type);
+	/* actually write the content of data to the file on disk */
+	save_data_write(sd);
+	ret = save_data_finish(sd);
+	save_data_free(sd);
 
-		document_update_tab_label(doc);
+	return ret;
+}
 
-		msgwin_status_add(_("File %s saved."), doc->file_name);
-		ui_update_statusbar(doc, -1);
-#ifdef HAVE_VTE
-		vte_cwd((doc->real_path != NULL) ? doc->real_path : doc->file_name, FALSE);
-#endif
-	}
-	g_free(locale_filename);
 
-	g_signal_emit_by_name(geany_object, "document-save", doc);
+/* Like document_save_file(), but converting and writing the file is done in the
+ * background so that slow disks don't block the UI. The document is marked as saved
+ * right away, and the "document-save" signal is emitted once the file is written.
+ * If writing fails, the document is marked as changed again.
+ * Returns: TRUE if the file is being saved. */
+gboolean document_save_file_async(GeanyDocument *doc, gboolean force)
+{
+	SaveData *sd;
+	gboolean ret;
+
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	sd = save_file_prepare(doc, force, &ret);
+	if (sd == NULL)
+		return ret;
+
+	sd->async = TRUE;
+	/* later changes will leave the save point again */
+	sci_set_savepoint(doc->editor->sci);
+	doc->priv->pending_saves++;
+
+	if (save_pool == NULL)
+	{
+		/* a single thread writes the files in the order they were saved */
+		save_pool = g_thread_pool_new(save_thread_func, NULL, 1, FALSE, NULL);
+		saved_queue = g_async_queue_new();
+	}
+	pending_saves++;
+	g_thread_pool_push(save_pool, sd, NULL);
 
 	return TRUE;
 }
@@ -2654,7 +3934,8 @@ void document_update_tags(GeanyDocument *doc)
 	g_return_if_fail(app->tm_workspace != NULL);
 
 	/* early out if it's a new file or doesn't support tags */
-	if (! doc->file_name || ! doc->file_type || !filetype_has_tags(doc->file_type))
+	if (! doc->file_name || ! doc->file_type || !filetype_has_tags(doc->file_type) ||
+		doc->priv->large_file)
 	{
 		/* We must call sidebar_update_tag_list() before returning,
 		 * to ensure that the symbol list is always updated properly (e.g.
@@ -2693,6 +3974,9 @@ void document_update_tags(GeanyDocument *doc)
 	len = sci_get_length(doc->editor->sci);
 	buffer_ptr = (guchar *) SSM(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0);
 	tm_workspace_update_source_file_buffer(doc->tm_file, buffer_ptr, len);
+	/* don't keep the copy of chunked text around, see SCI_RELEASECHARACTERPOINTER */
+	if (doc->priv->chunked_text)
+		SSM(doc->editor->sci, SCI_RELEASECHARACTERPOINTER, 0, 0);
 
 	sidebar_update_tag_list(doc, TRUE);
 	document_highlight_tags(doc);
@@ -2807,6 +4091,9 @@ static void document_load_config(GeanyDocument *doc, GeanyFiletype *type,
 			symbols_global_tags_loaded(type->id);
 
 		highlighting_set_styles(doc->editor->sci, type);
+		/* keep the styles but don't lex, which also disables folding */
+		if (doc->priv->large_file)
+			sci_set_lexer(doc->editor->sci, SCLEX_NULL);
 		editor_set_indentation_guides(doc->editor);
 		build_menu_update(doc);
 		queue_colourise(doc);
@@ -3003,6 +4290,14 @@ void document_undo(GeanyDocument *doc)
 		{
 			case UNDO_SCINTILLA:
 			{
+				if (! sci_can_undo(doc->editor->sci))
+				{
+					/* the oldest changes were dropped because of the undo memory limit,
+					 * so are the actions recorded before them */
+					document_undo_clear_stack(&doc->priv->undo_actions);
+					ui_set_statusbar(FALSE, _("Older changes can't be undone."));
+					break;
+				}
 				document_redo_add(doc, UNDO_SCINTILLA, NULL);
 
 				sci_undo(doc->editor->sci);
@@ -3234,7 +4529,7 @@ static gint document_get_status_id(GeanyDocument *doc)
 #ifdef USE_GIO_FILEMON
 	else if (doc->priv->file_disk_status == FILE_CHANGED)
 #else
-	else if (doc->priv->protected)
+	else if (doc->priv->protected || doc->priv->file_disk_status == FILE_CHANGED)
 #endif
 		return STATUS_DISK_CHANGED;
 	else if (doc->readonly)
@@ -3373,6 +4668,9 @@ gboolean document_account_for_unsaved(void)
 {
 	guint p, page_count;
 
+	/* saving in the background can fail, and then documents are changed again */
+	finish_pending_saves(TRUE);
+
 	page_count = gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
 	/* iterate over documents in tabs order */
 	for (p = 0; p < page_count; p++)
@@ -3628,6 +4926,43 @@ static void monitor_reload_file(GeanyDocument *doc)
 }
 
 
+static void on_large_file_response(GtkWidget *bar, gint response_id, GeanyDocument *doc)
+{
+	doc->priv->info_bars[MSG_TYPE_LARGE_FILE] = NULL;
+
+	if (response_id == RESPONSE_DOCUMENT_ENABLE_FEATURES)
+	{
+		doc->priv->large_file = FALSE;
+		/* set up the lexer again, which also parses the symbols */
+		document_reload_config(doc);
+		document_apply_indent_settings(doc);
+		ui_document_show_hide(doc);
+	}
+	gtk_widget_destroy(bar);
+}
+
+
+/* Tells the user about the features disabled for a large file, and allows to enable them */
+static void show_large_file_message(GeanyDocument *doc)
+{
+	gchar *base_name = g_path_get_basename(doc->file_name);
+	GtkWidget *bar;
+
+	bar = document_show_message(doc, GTK_MESSAGE_INFO, on_large_file_response,
+			_("_Enable All Features"), RESPONSE_DOCUMENT_ENABLE_FEATURES,
+			_("_Close"), GTK_RESPONSE_CANCEL,
+			NULL, GTK_RESPONSE_NONE,
+			_("Syntax highlighting, folding and symbols are disabled. "
+			  "Enabling all features can make Geany slow."),
+			_("The file '%s' is large."), base_name);
+
+	/* unlike the other messages, this one doesn't protect the document nor take its keys,
+	 * large files can be edited right away */
+	doc->priv->info_bars[MSG_TYPE_LARGE_FILE] = bar;
+	g_free(base_name);
+}
+
+
 static void on_monitor_resave_missing_file_response(GtkWidget *bar,
                                                     gint response_id,
                                                     GeanyDocument *doc)
@@ -3674,50 +5009,62 @@ static void monitor_resave_missing_file(GeanyDocument *doc)
 		document_set_text_changed(doc, TRUE);
 		/* don't prompt more than once */
 		SETPTR(doc->real_path, NULL);
+		invalidate_document_indexes();
 		doc->priv->info_bars[MSG_TYPE_RESAVE] = bar;
 		enable_key_intercept(doc, bar);
 	}
 }
 
 
-/* Set force to force a disk check, otherwise it is ignored if there was a check
- * in the last file_prefs.disk_check_timeout seconds.
- * @return @c TRUE if the file has changed. */
-gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
+/* A check of the file of a document, done in the background */
+typedef struct
 {
-	gboolean ret = FALSE;
-	gboolean use_gio_filemon;
-	time_t mtime = 0;
-	gchar *locale_filename;
-	FileDiskStatus old_status;
+	guint		 doc_id;
+	gchar		*locale_filename;
+	time_t		 mtime;
+	gchar		*err_msg;	/* set if the file could not be found */
+}
+DiskCheck;
 
-	g_return_val_if_fail(doc != NULL, FALSE);
+/* time to gather the disk checks requested together, in milliseconds */
+#define DISK_CHECK_DELAY 100
 
-	/* ignore remote files and documents that have never been saved to disk */
-	if (notebook_switch_in_progress() || file_prefs.disk_check_timeout == 0
-			|| doc->real_path == NULL || doc->priv->is_remote)
-		return FALSE;
+/* Batches of disk checks are done by disk_check_pool, so that the main thread doesn't
+ * wait for stat() calls, e.g. for many documents on a network filesystem */
+static GThreadPool *disk_check_pool = NULL;
+/* IDs of the documents to check with the next batch */
+static GHashTable *disk_check_queue = NULL;
+static guint disk_check_source = 0;
+static gboolean disk_check_running = FALSE;
 
-	use_gio_filemon = (doc->priv->monitor != NULL);
 
-	if (use_gio_filemon)
-	{
-		if (doc->priv->file_disk_status != FILE_CHANGED && ! force)
-			return FALSE;
-	}
-	else
-	{
-		time_t cur_time = time(NULL);
+static void disk_check_free(DiskCheck *check)
+{
+	g_free(check->locale_filename);
+	g_free(check->err_msg);
+	g_free(check);
+}
 
-		if (! force && doc->priv->last_check > (cur_time - file_prefs.disk_check_timeout))
-			return FALSE;
 
-		doc->priv->last_check = cur_time;
-	}
+static gboolean skip_disk_check(GeanyDocument *doc)
+{
+	/* ignore remote files, documents that have never been saved to disk,
+	 * documents whose file is not loaded yet or is being written */
+	return file_prefs.disk_check_timeout == 0 || doc->real_path == NULL ||
+		doc->priv->is_remote || doc->priv->pending_load || doc->priv->pending_saves > 0;
+}
 
-	locale_filename = utils_get_locale_from_utf8(doc->file_name);
-	if (!get_mtime(locale_filename, &mtime))
+
+/* Prompts the user if the file of doc was changed or removed.
+ * @return @c TRUE if the file has changed. */
+static gboolean handle_disk_status(GeanyDocument *doc, time_t mtime, const gchar *err_msg)
+{
+	gboolean ret = FALSE;
+	FileDiskStatus old_status;
+
+	if (err_msg != NULL)
 	{
+		ui_set_statusbar(TRUE, "%s", err_msg);
 		monitor_resave_missing_file(doc);
 		/* doc may be closed now */
 		ret = TRUE;
@@ -3730,7 +5077,6 @@ gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
 		/* doc may be closed now */
 		ret = TRUE;
 	}
-	g_free(locale_filename);
 
 	if (DOC_VALID(doc))
 	{	/* doc can get invalid when a document was closed */
@@ -3743,6 +5089,191 @@ gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
 }
 
 
+static void apply_disk_check(DiskCheck *check, GeanyDocument *current)
+{
+	GeanyDocument *doc = find_by_id(check->doc_id);
+	gchar *locale_filename;
+	gboolean same_file;
+
+	/* the document could have been closed, renamed or saved in the meantime */
+	if (doc == NULL || skip_disk_check(doc))
+		return;
+	locale_filename = utils_get_locale_from_utf8(doc->file_name);
+	same_file = utils_str_equal(locale_filename, check->locale_filename);
+	g_free(locale_filename);
+	if (! same_file)
+		return;
+
+	if (doc == current && ! notebook_switch_in_progress())
+		handle_disk_status(doc, check->mtime, check->err_msg);
+	else if (check->err_msg != NULL || doc->priv->mtime < check->mtime)
+	{
+		/* only mark the tab, the user is prompted when the document is shown */
+		if (doc->priv->file_disk_status != FILE_CHANGED)
+		{
+			doc->priv->file_disk_status = FILE_CHANGED;
+			ui_update_tab_status(doc);
+		}
+	}
+}
+
+
+static gboolean start_disk_checks(gpointer data);
+
+static gboolean on_disk_checks_done(gpointer data)
+{
+	GPtrArray *batch = data;
+	GeanyDocument *current = document_get_current();
+	guint i;
+
+	disk_check_running = FALSE;
+
+	for (i = 0; i < batch->len; i++)
+		apply_disk_check(g_ptr_array_index(batch, i), current);
+	g_ptr_array_free(batch, TRUE);
+
+	/* checks requested while the batch was done */
+	if (g_hash_table_size(disk_check_queue) > 0 && disk_check_source == 0)
+		disk_check_source = g_timeout_add(DISK_CHECK_DELAY, start_disk_checks, NULL);
+	return FALSE;
+}
+
+
+static void disk_check_thread_func(gpointer data, gpointer user_data)
+{
+	GPtrArray *batch = data;
+	guint i;
+
+	for (i = 0; i < batch->len; i++)
+	{
+		DiskCheck *check = g_ptr_array_index(batch, i);
+
+		check->err_msg = read_mtime(check->locale_filename, &check->mtime);
+	}
+	g_idle_add(on_disk_checks_done, batch);
+}
+
+
+static gboolean start_disk_checks(gpointer data)
+{
+	GPtrArray *batch;
+	GHashTableIter iter;
+	gpointer key;
+
+	disk_check_source = 0;
+	/* wait for the running batch, which starts the next one */
+	if (disk_check_running)
+		return FALSE;
+
+	batch = g_ptr_array_new_with_free_func((GDestroyNotify) disk_check_free);
+	g_hash_table_iter_init(&iter, disk_check_queue);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		GeanyDocument *doc = find_by_id(GPOINTER_TO_UINT(key));
+
+		if (doc != NULL && ! skip_disk_check(doc))
+		{
+			DiskCheck *check = g_new0(DiskCheck, 1);
+
+			check->doc_id = doc->id;
+			check->locale_filename = utils_get_locale_from_utf8(doc->file_name);
+			g_ptr_array_add(batch, check);
+		}
+	}
+	g_hash_table_remove_all(disk_check_queue);
+
+	if (batch->len == 0)
+	{
+		g_ptr_array_free(batch, TRUE);
+		return FALSE;
+	}
+
+	if (disk_check_pool == NULL)
+		disk_check_pool = g_thread_pool_new(disk_check_thread_func, NULL, 1, FALSE, NULL);
+	disk_check_running = TRUE;
+	g_thread_pool_push(disk_check_pool, batch, NULL);
+	return FALSE;
+}
+
+
+static void finish_disk_checks(void)
+{
+	if (disk_check_source != 0)
+		g_source_remove(disk_check_source);
+	if (disk_check_pool != NULL)
+		g_thread_pool_free(disk_check_pool, TRUE, TRUE);
+	if (disk_check_queue != NULL)
+		g_hash_table_destroy(disk_check_queue);
+#ifdef USE_GIO_FILEMON
+	if (dir_monitors != NULL)
+		g_hash_table_destroy(dir_monitors);
+#endif
+}
+
+
+/* Checks the file of doc right away, e.g. before it is overwritten.
+ * @return @c TRUE if the file has changed. */
+static gboolean check_disk_status_now(GeanyDocument *doc)
+{
+	time_t mtime = 0;
+	gchar *locale_filename;
+	gchar *err_msg;
+	gboolean ret;
+
+	if (notebook_switch_in_progress() || skip_disk_check(doc))
+		return FALSE;
+
+	doc->priv->last_check = time(NULL);
+	locale_filename = utils_get_locale_from_utf8(doc->file_name);
+	err_msg = read_mtime(locale_filename, &mtime);
+	ret = handle_disk_status(doc, mtime, err_msg);
+	g_free(err_msg);
+	g_free(locale_filename);
+	return ret;
+}
+
+
+/* Set force to force a disk check, otherwise it is ignored if there was a check
+ * in the last file_prefs.disk_check_timeout seconds.
+ * The file is checked in the background together with the other requested checks, then
+ * the user is prompted if doc is the current document, or else its tab is marked.
+ * @return @c TRUE if the file monitor already reported the file has changed, so a prompt
+ * is about to come. */
+gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
+{
+	gboolean changed;
+
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	if (skip_disk_check(doc))
+		return FALSE;
+
+	changed = (doc->priv->monitor != NULL && doc->priv->file_disk_status == FILE_CHANGED);
+	if (doc->priv->monitor != NULL)
+	{
+		if (! changed && ! force)
+			return FALSE;
+	}
+	else
+	{
+		time_t cur_time = time(NULL);
+
+		if (! force && doc->priv->last_check > (cur_time - file_prefs.disk_check_timeout))
+			return FALSE;
+
+		doc->priv->last_check = cur_time;
+	}
+
+	if (disk_check_queue == NULL)
+		disk_check_queue = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_add(disk_check_queue, GUINT_TO_POINTER(doc->id));
+
+	if (disk_check_source == 0 && ! disk_check_running)
+		disk_check_source = g_timeout_add(DISK_CHECK_DELAY, start_disk_checks, NULL);
+	return changed;
+}
+
+
 /** Compares documents by their display names.
  * This matches @c GCompareFunc for use with e.g. @c g_ptr_array_sort().
  * @note 'Display name' means the base name of the document's filename.
@@ -67,6 +67,10 @@ typedef struct GeanyFilePrefs
 	gboolean		show_keep_edit_history_on_reload_msg; /* whether to show the message introducing the above feature */
  	gboolean		reload_clean_doc_on_file_change;
  	gboolean		save_config_on_file_change;
+	gint			large_file_size;	/* size in MiB from which large file mode is used, 0 to disable */
+	gint			chunked_text_size;	/* size in MiB from which text is stored in chunks, 0 to disable */
+	gboolean		lazy_session_load;	/* load session files only when their tab is first shown */
+	gboolean		use_edit_journal;	/* record unsaved changes to recover them after a crash */
 }
 GeanyFilePrefs;
 
@@ -261,6 +265,22 @@ gboolean document_close_all(void);
 GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
 		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc);
 
+typedef struct FileData FileData;
+
+FileData *document_read_file_data(const gchar *locale_filename, const gchar *forced_enc);
+
+void document_free_file_data(FileData *filedata);
+
+GeanyDocument *document_open_file_data(FileData *filedata, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft);
+
+GeanyDocument *document_open_file_lazy(const gchar *filename, gint pos, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc);
+
+gboolean document_load_pending(GeanyDocument *doc);
+
+gint document_get_session_position(GeanyDocument *doc);
+
 void document_open_file_list(const gchar *data, gsize length);
 
 gboolean document_search_bar_find(GeanyDocument *doc, const gchar *text, gboolean inc,
@@ -307,10 +327,18 @@ const gchar *document_get_status_widget_class(GeanyDocument *doc);
 
 gboolean document_need_save_as(GeanyDocument *doc);
 
+gboolean document_save_file_async(GeanyDocument *doc, gboolean force);
+
 gboolean document_detect_indent_type(GeanyDocument *doc, GeanyIndentType *type_);
 
 gboolean document_detect_indent_width(GeanyDocument *doc, gint *width_);
 
+gboolean document_detect_indent_type_from_text(const gchar *text, gsize length,
+		gint line_count, gint tab_width, gint indent_width, GeanyIndentType *type_);
+
+gboolean document_detect_indent_width_from_text(const gchar *text, gsize length,
+		gint line_count, gint *width_);
+
 void document_apply_indent_settings(GeanyDocument *doc);
 
 void document_grab_focus(GeanyDocument *doc);
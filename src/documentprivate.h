@@ -66,6 +66,7 @@ enum
 	MSG_TYPE_RELOAD,
 	MSG_TYPE_RESAVE,
 	MSG_TYPE_POST_RELOAD,
+	MSG_TYPE_LARGE_FILE,
 
 	NUM_MSG_TYPES
 };
@@ -97,7 +98,8 @@ typedef struct GeanyDocumentPrivate
 	gboolean		 is_remote;
 	/* File status on disk of the document */
 	FileDiskStatus	 file_disk_status;
-	/* Reference to a GFileMonitor object, only used when GIO file monitoring is used. */
+	/* Monitor of the directory of the file, shared with the other documents in it.
+	 * Only used when GIO file monitoring is used. */
 	gpointer		 monitor;
 	/* Time of the last disk check, only used when legacy file monitoring is used. */
 	time_t			 last_check;
@@ -112,6 +114,21 @@ typedef struct GeanyDocumentPrivate
 	GtkWidget		*info_bars[NUM_MSG_TYPES];
 	/* Keyed Data List to attach arbitrary data to the document */
 	GData			*data;
+	/* Whether the document was opened with highlighting, symbols and full indent
+	 * detection disabled because of its size, see file_prefs.large_file_size */
+	gboolean		 large_file;
+	/* Whether Scintilla stores the text in chunks instead of a single buffer, chosen on
+	 * creation for files of file_prefs.chunked_text_size or more */
+	gboolean		 chunked_text;
+	/* Whether the file still has to be loaded, for session files restored lazily (see
+	 * file_prefs.lazy_session_load). The document is only a tab placeholder until then. */
+	gboolean		 pending_load;
+	/* Cursor position to restore when loading the pending file */
+	gint			 pending_pos;
+	/* Number of saves of the document still being written in the background */
+	guint			 pending_saves;
+	/* Index of the document's words for autocompletion, built on first use */
+	struct WordIndex	*word_index;
 }
 GeanyDocumentPrivate;
 
@@ -49,11 +49,13 @@
 #include "prefs.h"
 #include "projectprivate.h"
 #include "sciwrappers.h"
+#include "search.h"
 #include "support.h"
 #include "symbols.h"
 #include "templates.h"
 #include "ui_utils.h"
 #include "utils.h"
+#include "wordindex.h"
 
 #include "SciLexer.h"
 
@@ -65,6 +67,8 @@
 #include <gdk/gdkkeysyms.h>
 
 
+#define WORD_INDEX_BLOCK_SIZE	(1024 * 1024)	/* bytes of text added to a new word index at once */
+
 static GHashTable *snippet_hash = NULL;
 static GtkAccelGroup *snippet_accel_group = NULL;
 static gboolean autocomplete_scope_shown = FALSE;
@@ -106,6 +110,7 @@ static const gchar *snippets_find_completion_by_name(const gchar *type, const gc
 static void snippets_make_replacements(GeanyEditor *editor, GString *pattern);
 static GeanyFiletype *editor_get_filetype_at_line(GeanyEditor *editor, gint line);
 static gboolean sci_is_blank_line(ScintillaObject *sci, gint line);
+static void update_word_index(GeanyDocument *doc, SCNotification *nt);
 
 
 void editor_snippets_free(void)
@@ -1138,7 +1143,10 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 			if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
 			{
 				document_update_tag_list_in_idle(doc);
+				search_mark_all_text_changed(doc);
 			}
+			if (doc->priv->word_index != NULL)
+				update_word_index(doc, nt);
 			break;
 
 		case SCN_CHARADDED:
@@ -2129,6 +2137,218 @@ static gboolean autocomplete_check_html(GeanyEditor *editor, gint style, gint po
 }
 
 
+/* Whether the character at pos, or before it if before is set, is a word character for index.
+ * Sets next to the position after or before the character. */
+static gboolean word_index_char_at(ScintillaObject *sci, WordIndex *index, gint pos,
+		gboolean before, gint *next)
+{
+	gint start, end;
+
+	if (before)
+	{
+		start = (gint) SSM(sci, SCI_POSITIONBEFORE, pos, 0);
+		end = pos;
+		*next = start;
+	}
+	else
+	{
+		start = pos;
+		end = (gint) SSM(sci, SCI_POSITIONAFTER, pos, 0);
+		*next = end;
+	}
+	if (end <= start)
+		return FALSE;
+	return word_index_is_word_char(index,
+		(const gchar *) SSM(sci, SCI_GETRANGEPOINTER, start, end - start), end - start);
+}
+
+
+/* Moves start back to the start of the word containing it, and end forward to the end of
+ * the word containing it, so the range starts and ends at word boundaries */
+static void word_index_extend_range(ScintillaObject *sci, WordIndex *index, gint *start, gint *end)
+{
+	gint len = sci_get_length(sci);
+	gint next;
+
+	while (*start > 0 && word_index_char_at(sci, index, *start, TRUE, &next))
+		*start = next;
+	while (*end < len && word_index_char_at(sci, index, *end, FALSE, &next))
+		*end = next;
+}
+
+
+static void word_index_update_range(ScintillaObject *sci, WordIndex *index, gint start, gint end,
+		gboolean add)
+{
+	const gchar *text;
+
+	word_index_extend_range(sci, index, &start, &end);
+	if (end <= start)
+		return;
+
+	text = (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
+	if (add)
+		word_index_add(index, text, end - start);
+	else
+		word_index_remove(index, text, end - start);
+}
+
+
+/* Keeps the word index up to date: the words around a change are removed before it and the
+ * words of the changed range are added back after it */
+static void update_word_index(GeanyDocument *doc, SCNotification *nt)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	WordIndex *index = doc->priv->word_index;
+	gint pos = (gint) nt->position;
+	gint len = (gint) nt->length;
+
+	if (nt->modificationType & SC_MOD_BEFOREINSERT)
+		word_index_update_range(sci, index, pos, pos, FALSE);
+	else if (nt->modificationType & SC_MOD_INSERTTEXT)
+		word_index_update_range(sci, index, pos, pos + len, TRUE);
+	else if (nt->modificationType & SC_MOD_BEFOREDELETE)
+	{
+		if (pos == 0 && len == sci_get_length(sci))
+			word_index_clear(index);
+		else
+			word_index_update_range(sci, index, pos, pos + len, FALSE);
+	}
+	else if (nt->modificationType & SC_MOD_DELETETEXT)
+		word_index_update_range(sci, index, pos, pos, TRUE);
+}
+
+
+/* Adds the words of the whole document by blocks of lines, which start and end at word
+ * boundaries, so chunked text isn't copied whole */
+static void word_index_add_all(ScintillaObject *sci, WordIndex *index)
+{
+	gint length = sci_get_length(sci);
+	gint line_count = sci_get_line_count(sci);
+	gint start, end;
+
+	for (start = 0; start < length; start = end)
+	{
+		gint line = sci_get_line_from_position(sci, MIN(start + WORD_INDEX_BLOCK_SIZE, length));
+
+		end = (line + 1 < line_count) ? sci_get_position_from_line(sci, line + 1) : length;
+		word_index_add(index, (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, start, end - start),
+			end - start);
+	}
+}
+
+
+/* Returns the word index of doc, building it the first time and when the word characters
+ * changed since */
+static WordIndex *get_word_index(GeanyDocument *doc)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	WordIndex *index = doc->priv->word_index;
+	gint len = (gint) SSM(sci, SCI_GETWORDCHARS, 0, 0);
+	gchar *wordchars = g_malloc(len + 1);
+
+	SSM(sci, SCI_GETWORDCHARS, 0, (sptr_t) wordchars);
+	wordchars[len] = '\0';
+
+	if (index != NULL && ! utils_str_equal(word_index_get_wordchars(index), wordchars))
+	{
+		word_index_free(index);
+		index = NULL;
+	}
+	if (index == NULL)
+	{
+		index = word_index_new(wordchars);
+		word_index_add_all(sci, index);
+		doc->priv->word_index = index;
+	}
+	g_free(wordchars);
+	return index;
+}
+
+
+static gint compare_word_counts(gconstpointer a, gconstpointer b, gpointer counts)
+{
+	guint count_a = GPOINTER_TO_UINT(g_hash_table_lookup(counts, a));
+	guint count_b = GPOINTER_TO_UINT(g_hash_table_lookup(counts, b));
+
+	if (count_a != count_b)
+		return (count_a < count_b) ? 1 : -1;
+	return utils_str_casecmp(a, b);
+}
+
+
+/* Looks up the words starting with root in the word index of the document, and with
+ * editor_prefs.autocomplete_doc_words_shared those of the other open documents of the
+ * same filetype. If there are too many, the most frequent ones are used.
+ * @returns a sorted list of words matching @p root, or @c NULL with @a handled unset if root
+ * can't be looked up in the index */
+static GSList *get_doc_words_indexed(GeanyDocument *doc, const gchar *root, gsize rootlen,
+		gboolean *handled)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	WordIndex *index = get_word_index(doc);
+	GHashTable *counts;
+	GList *list, *node;
+	GSList *words = NULL;
+	gint current, word_end, next;
+	guint i, n;
+
+	/* roots with other characters can span several words of the index */
+	*handled = rootlen > 0 && word_index_is_word(index, root, rootlen);
+	if (! *handled)
+		return NULL;
+
+	counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	word_index_find(index, root, rootlen, counts);
+
+	if (editor_prefs.autocomplete_doc_words_shared)
+	{
+		foreach_document(i)
+		{
+			GeanyDocument *other = documents[i];
+
+			if (other != doc && other->file_type == doc->file_type && ! other->priv->pending_load)
+				word_index_find(get_word_index(other), root, rootlen, counts);
+		}
+	}
+
+	/* don't count the word being typed, unless it's only the end of a longer word */
+	current = sci_get_current_position(sci) - rootlen;
+	if (current == 0 || ! word_index_char_at(sci, index, current, TRUE, &next))
+	{
+		word_end = current + rootlen;
+		while (word_end < sci_get_length(sci) && word_index_char_at(sci, index, word_end, FALSE, &next))
+			word_end = next;
+		if (word_end - current > (gint) rootlen)
+		{
+			gchar *word = sci_get_contents_range(sci, current, word_end);
+			guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, word));
+
+			if (count > 1)
+				g_hash_table_insert(counts, g_strdup(word), GUINT_TO_POINTER(count - 1));
+			else
+				g_hash_table_remove(counts, word);
+			g_free(word);
+		}
+	}
+
+	list = g_hash_table_get_keys(counts);
+	n = g_list_length(list);
+	if (n > editor_prefs.autocompletion_max_entries)
+	{
+		/* keep the most frequent words */
+		list = g_list_sort_with_data(list, compare_word_counts, counts);
+		n = editor_prefs.autocompletion_max_entries;
+	}
+	for (node = list, i = 0; node != NULL && i < n; node = node->next, i++)
+		words = g_slist_prepend(words, g_strdup(node->data));
+	g_list_free(list);
+	g_hash_table_destroy(counts);
+
+	return g_slist_sort(words, (GCompareFunc)utils_str_casecmp);
+}
+
+
 /* Algorithm based on based on Scite's StartAutoCompleteWord()
  * @returns a sorted list of words matching @p root */
 static GSList *get_doc_words(ScintillaObject *sci, gchar *root, gsize rootlen)
@@ -2191,8 +2411,11 @@ static gboolean autocomplete_doc_word(GeanyEditor *editor, gchar *root, gsize ro
 	GSList *words, *node;
 	GString *str;
 	guint n_words = 0;
+	gboolean handled;
 
-	words = get_doc_words(sci, root, rootlen);
+	words = get_doc_words_indexed(editor->document, root, rootlen, &handled);
+	if (!handled)
+		words = get_doc_words(sci, root, rootlen);
 	if (!words)
 	{
 		SSM(sci, SCI_AUTOCCANCEL, 0, 0);
@@ -4153,6 +4376,10 @@ void editor_indicator_clear(GeanyEditor *editor, gint indic)
 
 	g_return_if_fail(editor != NULL);
 
+	/* a Mark All still running would set new search indicators */
+	if (indic == GEANY_INDICATOR_SEARCH)
+		search_mark_all_cancel(editor->document);
+
 	last_pos = sci_get_length(editor->sci);
 	if (last_pos > 0)
 	{
@@ -4912,6 +5139,16 @@ static ScintillaObject *create_new_sci(GeanyEditor *editor)
 
 	sci = SCINTILLA(scintilla_new());
 
+	/* give huge files a Scintilla document storing the text in chunks, before any setting
+	 * of the document is applied */
+	if (editor->document->priv->chunked_text)
+	{
+		gpointer sdoc = (gpointer) SSM(sci, SCI_CREATEDOCUMENT, 0, SC_DOCUMENTOPTION_TEXT_CHUNKED);
+
+		SSM(sci, SCI_SETDOCPOINTER, 0, (sptr_t) sdoc);
+		SSM(sci, SCI_RELEASEDOCUMENT, 0, (sptr_t) sdoc);
+	}
+
 	/* Scintilla doesn't support RTL languages properly and is primarily
 	 * intended to be used with LTR source code, so override the
 	 * GTK+ default text direction for the Scintilla widget. */
@@ -4954,6 +5191,12 @@ static ScintillaObject *create_new_sci(GeanyEditor *editor)
 
 	/* input method editor's candidate window behaviour */
 	SSM(sci, SCI_SETIMEINTERACTION, editor_prefs.ime_interaction, 0);
+	/* the oldest undo actions are dropped when the limit is exceeded */
+	SSM(sci, SCI_SETUNDOMEMORYLIMIT, (uptr_t) MAX(editor_prefs.undo_memory_limit, 0) * 1024 * 1024, 0);
+	/* lex the parts not yet displayed on a worker thread */
+	SSM(sci, SCI_SETBACKGROUNDSTYLING, editor_prefs.background_styling, 0);
+	/* lex whole large documents in chunks on several threads */
+	SSM(sci, SCI_SETLEXINGTHREADS, (uptr_t) MAX(editor_prefs.lexing_threads, 0), 0);
 
 #ifdef GDK_WINDOWING_QUARTZ
 # if ! GTK_CHECK_VERSION(3,16,0)
@@ -138,6 +138,10 @@ typedef struct GeanyEditorPrefs
 	gint		autocompletion_update_freq;
 	gint		scroll_lines_around_cursor;
 	gint		ime_interaction; /* input method editor's candidate window behaviour */
+	gint		undo_memory_limit; /* in MiB, 0 for no limit */
+	gboolean	autocomplete_doc_words_shared;
+	gboolean	background_styling;
+	gint		lexing_threads; /* 0 for one for each processor */
 }
 GeanyEditorPrefs;
 
@@ -44,6 +44,7 @@
 #include "utils.h"
 
 #include <string.h>
+#include <errno.h>
 
 
 /* <meta http-equiv="content-type" content="text/html; charset=UTF-8" /> */
@@ -55,6 +56,12 @@
 static GRegex *pregs[2];
 static gboolean pregs_loaded = FALSE;
 
+/* number of bytes converted to check whether a charset is suitable, before converting the
+ * whole data */
+#define ENCODING_SAMPLE_SIZE 65536
+/* maximum number of bytes passed to g_utf8_validate() at once by utf8_validate() */
+#define UTF8_VALIDATE_BLOCK 256
+
 
 GeanyEncoding encodings[GEANY_ENCODINGS_MAX];
 
@@ -609,6 +616,82 @@ void encodings_encoding_store_cell_data_func(GtkCellLayout *cell_layout,
 }
 
 
+/* Like g_utf8_validate() with an explicit length, but checks ASCII data a machine word at
+ * a time, as it is most of the contents of source files. NUL bytes are invalid. */
+static gboolean utf8_validate(const gchar *buffer, gsize len)
+{
+	const gsize ones = ((gsize) -1) / 0xff;	/* 0x0101...01 */
+	const gsize highs = ones * 0x80;		/* 0x8080...80 */
+	const guchar *p = (const guchar *) buffer;
+	const guchar *end = p + len;
+
+	while (p < end)
+	{
+		const guchar *block_end;
+		gint i;
+
+		/* skip ASCII without NUL bytes */
+		while ((gsize) (end - p) >= sizeof(gsize))
+		{
+			gsize word;
+
+			memcpy(&word, p, sizeof word);
+			if (((word | ((word - ones) & ~word)) & highs) != 0)
+				break;
+			p += sizeof word;
+		}
+		while (p < end && *p != 0 && *p < 0x80)
+			p++;
+		if (p == end)
+			break;
+
+		/* let g_utf8_validate() check the next block, without splitting a character */
+		block_end = p + MIN((gsize) (end - p), UTF8_VALIDATE_BLOCK);
+		for (i = 0; i < 3 && block_end < end && block_end > p + 1 && (*block_end & 0xc0) == 0x80; i++)
+			block_end--;
+
+		if (! g_utf8_validate((const gchar *) p, block_end - p, NULL))
+			return FALSE;
+		p = block_end;
+	}
+	return TRUE;
+}
+
+
+/* Checks whether the start of buffer can be converted from charset, to skip unsuitable
+ * charsets without converting all the data. */
+static gboolean check_sample(const gchar *buffer, gsize size, const gchar *charset)
+{
+	GIConv cd;
+	gchar *in = (gchar *) buffer;
+	gsize in_left = MIN(size, ENCODING_SAMPLE_SIZE);
+	gchar out_buf[4096];
+	gboolean ok = TRUE;
+
+	cd = g_iconv_open("UTF-8", charset);
+	if (cd == (GIConv) -1)
+		return TRUE;	/* let the conversion report the error */
+
+	while (in_left > 0)
+	{
+		gchar *out = out_buf;
+		gsize out_left = sizeof out_buf;
+
+		if (g_iconv(cd, &in, &in_left, &out, &out_left) == (gsize) -1)
+		{
+			if (errno == E2BIG)
+				continue;
+			/* the sample may end in the middle of a character */
+			ok = (errno == EINVAL);
+			break;
+		}
+	}
+	g_iconv_close(cd);
+
+	return ok;
+}
+
+
 /**
  *  Tries to convert @a buffer into UTF-8 encoding from the encoding specified with @a charset.
  *  If @a fast is not set, additional checks to validate the converted string are performed.
@@ -680,8 +763,37 @@ static gchar *encodings_check_regexes(const gchar *buffer, gsize size)
 }
 
 
+/* Converts a buffer in a charset tried by the detection, like
+ * encodings_convert_to_utf8_from_charset() with fast = FALSE, but first only checks the start
+ * of the data, and doesn't convert data checked to be UTF-8. */
+static gchar *convert_detected_charset(const gchar *buffer, gsize size, const gchar *charset)
+{
+	if (encodings_charset_equals(charset, "UTF-8"))
+	{
+		/* this stops at the first invalid byte, and there's nothing to convert */
+		if (! utf8_validate(buffer, size))
+		{
+			geany_debug("Couldn't convert from %s to UTF-8.", charset);
+			return NULL;
+		}
+		return g_strndup(buffer, size);
+	}
+
+	if (size > ENCODING_SAMPLE_SIZE && ! check_sample(buffer, size, charset))
+	{
+		geany_debug("Skipping %s, the start of the data can't be converted.", charset);
+		return NULL;
+	}
+
+	geany_debug("Trying to convert %" G_GSIZE_FORMAT " bytes of data from %s into UTF-8.",
+		size, charset);
+	return encodings_convert_to_utf8_from_charset(buffer, size, charset, FALSE);
+}
+
+
+/* utf8_checked is whether the data is already known not to be valid UTF-8 */
 static gchar *encodings_convert_to_utf8_with_suggestion(const gchar *buffer, gssize size,
-		const gchar *suggested_charset, gchar **used_encoding)
+		const gchar *suggested_charset, gboolean utf8_checked, gchar **used_encoding)
 {
 	const gchar *locale_charset = NULL;
 	const gchar *charset;
@@ -746,9 +858,10 @@ static gchar *encodings_convert_to_utf8_with_suggestion(const gchar *buffer, gss
 		if (G_UNLIKELY(charset == NULL))
 			continue;
 
-		geany_debug("Trying to convert %" G_GSIZE_FORMAT " bytes of data from %s into UTF-8.",
-			size, charset);
-		utf8_content = encodings_convert_to_utf8_from_charset(buffer, size, charset, FALSE);
+		if (utf8_checked && encodings_charset_equals(charset, "UTF-8"))
+			continue;
+
+		utf8_content = convert_detected_charset(buffer, size, charset);
 
 		if (G_LIKELY(utf8_content != NULL))
 		{
@@ -788,7 +901,8 @@ gchar *encodings_convert_to_utf8(const gchar *buffer, gssize size, gchar **used_
 
 	/* first try to read the encoding from the file content */
 	regex_charset = encodings_check_regexes(buffer, size);
-	utf8 = encodings_convert_to_utf8_with_suggestion(buffer, size, regex_charset, used_encoding);
+	utf8 = encodings_convert_to_utf8_with_suggestion(buffer, size, regex_charset, FALSE,
+		used_encoding);
 	g_free(regex_charset);
 
 	return utf8;
@@ -882,7 +996,7 @@ handle_forced_encoding(BufferData *buffer, const gchar *forced_enc)
 
 	if (utils_str_equal(forced_enc, "UTF-8"))
 	{
-		if (! g_utf8_validate(buffer->data, buffer->len, NULL))
+		if (! utf8_validate(buffer->data, buffer->len))
 		{
 			return FALSE;
 		}
@@ -952,17 +1066,22 @@ handle_encoding(BufferData *buffer, GeanyEncodingIndex enc_idx)
 			/* first try to read the encoding from the file content */
 			gchar *regex_charset = encodings_check_regexes(buffer->data, buffer->size);
 
+			gboolean utf8_checked = FALSE;
+
 			/* try UTF-8 first */
 			if (encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8 &&
-				(buffer->size == buffer->len) && g_utf8_validate(buffer->data, buffer->len, NULL))
+				(buffer->size == buffer->len))
 			{
-				buffer->enc = g_strdup("UTF-8");
+				if (utf8_validate(buffer->data, buffer->len))
+					buffer->enc = g_strdup("UTF-8");
+				else
+					utf8_checked = TRUE;
 			}
-			else
+			if (buffer->enc == NULL)
 			{
 				/* detect the encoding */
 				gchar *converted_text = encodings_convert_to_utf8_with_suggestion(buffer->data,
-					buffer->size, regex_charset, &buffer->enc);
+					buffer->size, regex_charset, utf8_checked, &buffer->enc);
 
 				if (converted_text == NULL)
 				{
@@ -1039,6 +1158,58 @@ static gboolean handle_buffer(BufferData *buffer, const gchar *forced_enc)
 }
 
 
+/*
+ * Checks whether encodings_convert_to_utf8_auto() would use @a buffer as UTF-8 without
+ * converting it, so that the caller can use the data in place (e.g. from a file mapping)
+ * instead of making a copy.
+ * Unlike encodings_convert_to_utf8_auto(), @a buffer doesn't need to be null-terminated.
+ *
+ * @param buffer the data to check.
+ * @param size the size of @a buffer.
+ * @param forced_enc forced encoding to use, or @c NULL
+ * @param bom_len return location for the length of a UTF-8 BOM to skip, or @c NULL
+ *
+ * @return @c TRUE if the data can be used as UTF-8, @c FALSE if it needs a conversion or
+ *   is not valid, in which case encodings_convert_to_utf8_auto() should be used.
+ */
+gboolean encodings_check_utf8_auto(const gchar *buffer, gsize size, const gchar *forced_enc,
+		guint *bom_len)
+{
+	GeanyEncodingIndex enc_idx;
+	guint len;
+
+	/* "None" is also not UTF-8, the data should be used as is */
+	if (forced_enc != NULL && ! utils_str_equal(forced_enc, "UTF-8"))
+		return FALSE;
+
+	enc_idx = encodings_scan_unicode_bom(buffer, size, &len);
+	if (enc_idx == GEANY_ENCODING_NONE)
+	{
+		len = 0;
+		/* mirror handle_encoding(), which only tries UTF-8 first if the content agrees */
+		if (forced_enc == NULL)
+		{
+			gchar *regex_charset = encodings_check_regexes(buffer, size);
+			GeanyEncodingIndex regex_idx = encodings_get_idx_from_charset(regex_charset);
+
+			g_free(regex_charset);
+			if (regex_idx != GEANY_ENCODING_UTF_8)
+				return FALSE;
+		}
+	}
+	else if (enc_idx != GEANY_ENCODING_UTF_8)
+		return FALSE;
+
+	/* this also fails on NUL bytes, which need truncating */
+	if (! utf8_validate(buffer + len, size - len))
+		return FALSE;
+
+	if (bom_len)
+		*bom_len = len;
+	return TRUE;
+}
+
+
 /*
  * Tries to convert @a buffer into UTF-8 encoding. Unlike encodings_convert_to_utf8()
  * and encodings_convert_to_utf8_from_charset() it handles the possible BOM in the data.
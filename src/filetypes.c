@@ -204,6 +204,7 @@ static GeanyFiletype *filetype_new(void)
 
 	ft->priv = g_new0(GeanyFiletypePrivate, 1);
 	ft->priv->project_list_entry = -1; /* no entry */
+	ft->priv->large_file_size = -1; /* use file_prefs.large_file_size */
 
 	return ft;
 }
@@ -955,6 +956,8 @@ static void load_settings(guint ft_id, GKeyFile *config, GKeyFile *configh)
 		"symbol_list_sort_mode", SYMBOLS_SORT_USE_PREVIOUS);
 	ft->priv->xml_indent_tags = utils_get_setting(boolean, configh, config, "settings",
 		"xml_indent_tags", FALSE);
+	ft->priv->large_file_size = utils_get_setting(integer, configh, config, "settings",
+		"large_file_size", -1);
 
 	/* read indent settings */
 	load_indent_settings(ft, config, configh);
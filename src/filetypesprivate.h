@@ -38,6 +38,7 @@ typedef struct GeanyFiletypePrivate
 	gboolean	custom;
 	gint		symbol_list_sort_mode;
 	gboolean	xml_indent_tags; /* XML tag autoindentation, for HTML and XML filetypes */
+	gint		large_file_size;	/* overrides file_prefs.large_file_size if >= 0 */
 	GSList		*tag_files;
 	gboolean	warn_color_scheme;
 	gboolean	user_extensions;	// true if extensions were read from user config file
@@ -0,0 +1,625 @@
+/*
+ *      journal.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2026 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Journal of unsaved edits, to recover them after a crash.
+ *
+ * Every insertion and deletion in a document is appended to a journal file in the
+ * configuration directory, which is removed when the document is saved or closed.
+ * A journal file left over when a file is opened comes from a crashed instance, and
+ * its edits can be replayed on top of the file.
+ *
+ * A journal file starts with a header:
+ *   GEANY_JOURNAL 1\n<UTF-8 filename>\n<modification time of the file>\n
+ * followed by records, where text is len bytes of UTF-8 data:
+ *   +<pos> <len>\n<text>		insertion
+ *   -<pos> <len>\n			deletion
+ *   =<len>\n<text>			the whole text, replacing the previous one
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "journal.h"
+
+#include "app.h"
+#include "dialogs.h"
+#include "document.h"
+#include "editor.h"
+#include "geanyobject.h"
+#include "sciwrappers.h"
+#include "support.h"
+#include "ui_utils.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+# include <signal.h>
+# include <unistd.h>
+#else
+# include <windows.h>
+# include <process.h>
+# define getpid _getpid
+#endif
+
+
+#define JOURNAL_HEADER "GEANY_JOURNAL 1"
+/* how long edits are kept in memory before they are written, in milliseconds */
+#define JOURNAL_FLUSH_DELAY 500
+/* size from which a journal bigger than its document is replaced by the document text */
+#define JOURNAL_COMPACT_MIN_SIZE 65536
+
+
+typedef struct
+{
+	gchar		*filename;		/* locale path of the journal file */
+	FILE		*fp;			/* the journal file, NULL until there are edits */
+	GString		*pending;		/* records not written yet */
+	gsize		 size;			/* size of the written records */
+	gboolean	 snapshot;		/* whether the whole text has to be written first */
+}
+Journal;
+
+
+static gchar *journal_dir = NULL;
+/* Journal of each document, by document ID */
+static GHashTable *journals = NULL;
+static guint flush_source = 0;
+/* IDs of the documents which have journals left over from a crash */
+static GSList *recover_queue = NULL;
+
+
+static gchar *get_journal_prefix(GeanyDocument *doc)
+{
+	gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, doc->file_name, -1);
+	gchar *prefix = g_strconcat(checksum, "-", NULL);
+
+	g_free(checksum);
+	return prefix;
+}
+
+
+static gchar *get_journal_filename(GeanyDocument *doc)
+{
+	gchar *prefix = get_journal_prefix(doc);
+	gchar *name = g_strdup_printf("%s%lu.journal", prefix, (gulong) getpid());
+	gchar *filename = g_build_filename(journal_dir, name, NULL);
+
+	g_free(name);
+	g_free(prefix);
+	return filename;
+}
+
+
+static gboolean is_process_running(gulong pid)
+{
+	if (pid == (gulong) getpid())
+		return FALSE;	/* a previous instance with the same ID */
+#ifdef G_OS_UNIX
+	return kill((pid_t) pid, 0) == 0 || errno == EPERM;
+#else
+	{
+		HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, (DWORD) pid);
+		DWORD exit_code;
+		gboolean running;
+
+		if (process == NULL)
+			return GetLastError() == ERROR_ACCESS_DENIED;
+		running = GetExitCodeProcess(process, &exit_code) && exit_code == STILL_ACTIVE;
+		CloseHandle(process);
+		return running;
+	}
+#endif
+}
+
+
+static void journal_close(Journal *journal)
+{
+	if (journal->fp != NULL)
+	{
+		fclose(journal->fp);
+		journal->fp = NULL;
+		g_unlink(journal->filename);
+	}
+	g_string_truncate(journal->pending, 0);
+	journal->size = 0;
+}
+
+
+static void journal_free(Journal *journal)
+{
+	journal_close(journal);
+	g_string_free(journal->pending, TRUE);
+	g_free(journal->filename);
+	g_free(journal);
+}
+
+
+static void schedule_flush(void);
+
+
+/* Starts over with the document text matching its file on disk, unless it was changed
+ * since, e.g. while it was saved in the background */
+static void journal_reset(GeanyDocument *doc)
+{
+	Journal *journal;
+
+	if (! file_prefs.use_edit_journal || doc->real_path == NULL)
+	{
+		g_hash_table_remove(journals, GUINT_TO_POINTER(doc->id));
+		return;
+	}
+
+	journal = g_hash_table_lookup(journals, GUINT_TO_POINTER(doc->id));
+	if (journal == NULL)
+	{
+		journal = g_new0(Journal, 1);
+		journal->filename = get_journal_filename(doc);
+		journal->pending = g_string_new(NULL);
+		g_hash_table_insert(journals, GUINT_TO_POINTER(doc->id), journal);
+	}
+	else
+		journal_close(journal);
+
+	/* the edits made since are in the text, not in the closed journal */
+	journal->snapshot = doc->changed;
+	if (journal->snapshot)
+		schedule_flush();
+}
+
+
+static void write_snapshot(Journal *journal, GeanyDocument *doc)
+{
+	/* the text can contain NUL bytes */
+	gsize len = (gsize) sci_get_length(doc->editor->sci);
+	gchar *text = sci_get_contents(doc->editor->sci, -1);
+
+	fprintf(journal->fp, "=%" G_GSIZE_FORMAT "\n", len);
+	fwrite(text, 1, len, journal->fp);
+	journal->size = len;
+	g_free(text);
+}
+
+
+static gboolean journal_flush(Journal *journal, GeanyDocument *doc)
+{
+	if (journal->pending->len == 0 && ! journal->snapshot)
+		return TRUE;
+
+	/* start over with the whole text when it's smaller than the recorded edits */
+	if (journal->size > JOURNAL_COMPACT_MIN_SIZE &&
+		journal->size > (gsize) sci_get_length(doc->editor->sci))
+	{
+		journal->snapshot = TRUE;
+	}
+
+	if (journal->fp == NULL || journal->snapshot)
+	{
+		gchar *utf8_filename = doc->file_name;
+		GStatBuf st;
+		gint64 mtime = 0;
+		gchar *locale_filename = utils_get_locale_from_utf8(utf8_filename);
+
+		if (g_stat(locale_filename, &st) == 0)
+			mtime = st.st_mtime;
+		g_free(locale_filename);
+
+		if (journal->fp != NULL)
+			fclose(journal->fp);
+
+		utils_mkdir(journal_dir, TRUE);
+		journal->fp = g_fopen(journal->filename, "wb");
+		if (journal->fp == NULL)
+		{
+			geany_debug("Could not create journal %s (%s)", journal->filename, g_strerror(errno));
+			g_string_truncate(journal->pending, 0);
+			return FALSE;
+		}
+		fprintf(journal->fp, JOURNAL_HEADER "\n%s\n%" G_GINT64_FORMAT "\n", utf8_filename, mtime);
+		journal->size = 0;
+
+		if (journal->snapshot)
+		{
+			/* the text already contains the pending edits */
+			write_snapshot(journal, doc);
+			g_string_truncate(journal->pending, 0);
+			journal->snapshot = FALSE;
+		}
+	}
+
+	if (journal->pending->len > 0)
+	{
+		fwrite(journal->pending->str, 1, journal->pending->len, journal->fp);
+		journal->size += journal->pending->len;
+		g_string_truncate(journal->pending, 0);
+	}
+	/* write it to the system, so that it survives a crash of Geany */
+	fflush(journal->fp);
+	return TRUE;
+}
+
+
+static gboolean on_flush_timeout(gpointer data)
+{
+	guint i;
+
+	foreach_document(i)
+	{
+		Journal *journal = g_hash_table_lookup(journals, GUINT_TO_POINTER(documents[i]->id));
+
+		if (journal != NULL)
+			journal_flush(journal, documents[i]);
+	}
+	flush_source = 0;
+	return FALSE;
+}
+
+
+static void schedule_flush(void)
+{
+	if (flush_source == 0)
+		flush_source = g_timeout_add(JOURNAL_FLUSH_DELAY, on_flush_timeout, NULL);
+}
+
+
+static gboolean on_editor_notify(GObject *obj, GeanyEditor *editor, SCNotification *nt,
+		gpointer user_data)
+{
+	Journal *journal;
+
+	if (nt->nmhdr.code != SCN_MODIFIED ||
+		! (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+		return FALSE;
+
+	journal = g_hash_table_lookup(journals, GUINT_TO_POINTER(editor->document->id));
+	if (journal == NULL)
+		return FALSE;
+
+	if (nt->modificationType & SC_MOD_INSERTTEXT)
+	{
+		g_string_append_printf(journal->pending, "+%" G_GSIZE_FORMAT " %" G_GSIZE_FORMAT "\n",
+			(gsize) nt->position, (gsize) nt->length);
+		g_string_append_len(journal->pending, nt->text, nt->length);
+	}
+	else
+	{
+		g_string_append_printf(journal->pending, "-%" G_GSIZE_FORMAT " %" G_GSIZE_FORMAT "\n",
+			(gsize) nt->position, (gsize) nt->length);
+	}
+
+	schedule_flush();
+	return FALSE;
+}
+
+
+/* Parses a "<number> " or "<number>\n" field at *p */
+static gboolean parse_number(const gchar **p, const gchar *end, gchar sep, gsize *value)
+{
+	gchar *num_end;
+	guint64 v;
+
+	if (*p >= end || ! g_ascii_isdigit(**p))
+		return FALSE;
+
+	v = g_ascii_strtoull(*p, &num_end, 10);
+	if (num_end >= end || *num_end != sep)
+		return FALSE;
+
+	*value = v;
+	*p = num_end + 1;
+	return TRUE;
+}
+
+
+/* Applies the records of a journal to doc.
+ * Returns: FALSE if the journal doesn't match the text */
+static gboolean replay_records(GeanyDocument *doc, const gchar *p, const gchar *end)
+{
+	ScintillaObject *sci = doc->editor->sci;
+
+	while (p < end)
+	{
+		gchar type = *p++;
+		gsize pos = 0, len;
+
+		if ((type == '+' || type == '-') && ! parse_number(&p, end, ' ', &pos))
+			return FALSE;
+		if (! parse_number(&p, end, '\n', &len))
+			return FALSE;
+
+		switch (type)
+		{
+			case '+':
+			case '=':
+				/* a record that was not fully written when crashing is ignored */
+				if (len > (gsize) (end - p))
+					return TRUE;
+				if (type == '+' && pos > (gsize) sci_get_length(sci))
+					return FALSE;
+
+				/* replace a target rather than inserting a string, as text can contain
+				 * NUL bytes */
+				sci_set_target_start(sci, pos);
+				sci_set_target_end(sci, type == '+' ? (gint) pos : sci_get_length(sci));
+				SSM(sci, SCI_REPLACETARGET, len, (sptr_t) p);
+				p += len;
+				break;
+
+			case '-':
+				if (pos + len > (gsize) sci_get_length(sci))
+					return FALSE;
+				sci_set_target_start(sci, pos);
+				sci_set_target_end(sci, pos + len);
+				sci_replace_target(sci, "", FALSE);
+				break;
+
+			default:
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+
+static void recover_journal(GeanyDocument *doc, const gchar *journal_filename)
+{
+	gchar *contents;
+	gsize length;
+	gchar **header;
+	gchar *body;
+	GStatBuf st;
+	gchar *locale_filename;
+	gboolean changed_on_disk = TRUE;
+	gboolean recover;
+
+	if (! g_file_get_contents(journal_filename, &contents, &length, NULL))
+		return;
+
+	/* the header is three lines */
+	body = contents;
+	for (gint i = 0; i < 3 && body != NULL; i++)
+	{
+		body = memchr(body, '\n', length - (body - contents));
+		if (body != NULL)
+			body++;
+	}
+	if (body == NULL || ! g_str_has_prefix(contents, JOURNAL_HEADER "\n"))
+	{
+		geany_debug("Ignoring invalid journal %s", journal_filename);
+		g_free(contents);
+		g_unlink(journal_filename);
+		return;
+	}
+	header = g_strsplit(contents, "\n", 4);
+
+	locale_filename = utils_get_locale_from_utf8(doc->file_name);
+	if (g_stat(locale_filename, &st) == 0)
+		changed_on_disk = (gint64) st.st_mtime != g_ascii_strtoll(header[2], NULL, 10);
+	g_free(locale_filename);
+
+	document_show_tab(doc);
+	recover = dialogs_show_question_full(NULL, _("_Recover"), _("_Discard"),
+		changed_on_disk && body[0] != '=' ?
+			_("The file has been changed on disk since, the recovered text may be wrong.") : NULL,
+		_("Geany did not exit properly while '%s' had unsaved changes. Do you want to recover them?"),
+		doc->file_name);
+
+	if (recover)
+	{
+		sci_start_undo_action(doc->editor->sci);
+		if (! replay_records(doc, body, contents + length))
+			ui_set_statusbar(TRUE, _("The unsaved changes of %s could only be partially recovered."),
+				doc->file_name);
+		sci_end_undo_action(doc->editor->sci);
+	}
+	g_strfreev(header);
+	g_free(contents);
+	g_unlink(journal_filename);
+}
+
+
+/* Gets the journals of doc left over from crashed instances */
+static GSList *get_leftover_journals(GeanyDocument *doc)
+{
+	GSList *list = NULL;
+	GDir *dir;
+	const gchar *name;
+	gchar *prefix;
+	Journal *journal;
+
+	dir = g_dir_open(journal_dir, 0, NULL);
+	if (dir == NULL)
+		return NULL;
+
+	journal = g_hash_table_lookup(journals, GUINT_TO_POINTER(doc->id));
+	prefix = get_journal_prefix(doc);
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		if (g_str_has_prefix(name, prefix) && g_str_has_suffix(name, ".journal") &&
+			! is_process_running(strtoul(name + strlen(prefix), NULL, 10)))
+		{
+			gchar *filename = g_build_filename(journal_dir, name, NULL);
+
+			/* skip our own journal, once it has been written */
+			if (journal != NULL && journal->fp != NULL && utils_str_equal(filename, journal->filename))
+				g_free(filename);
+			else
+				list = g_slist_prepend(list, filename);
+		}
+	}
+	g_free(prefix);
+	g_dir_close(dir);
+	return list;
+}
+
+
+static gboolean on_recover_idle(gpointer data)
+{
+	while (recover_queue != NULL)
+	{
+		GeanyDocument *doc = document_find_by_id(GPOINTER_TO_UINT(recover_queue->data));
+
+		recover_queue = g_slist_delete_link(recover_queue, recover_queue);
+		if (doc != NULL)
+		{
+			GSList *list = get_leftover_journals(doc);
+			GSList *node;
+
+			foreach_slist(node, list)
+				recover_journal(doc, node->data);
+			g_slist_free_full(list, g_free);
+		}
+	}
+	return FALSE;
+}
+
+
+static void on_document_open(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	if (file_prefs.use_edit_journal && doc->file_name != NULL)
+	{
+		GSList *list = get_leftover_journals(doc);
+
+		if (list != NULL)
+		{
+			/* ask when the main window is shown and documents are set up */
+			if (recover_queue == NULL)
+				g_idle_add(on_recover_idle, NULL);
+			recover_queue = g_slist_append(recover_queue, GUINT_TO_POINTER(doc->id));
+			g_slist_free_full(list, g_free);
+		}
+	}
+	journal_reset(doc);
+}
+
+
+static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	journal_reset(doc);
+}
+
+
+static void on_document_close(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	g_hash_table_remove(journals, GUINT_TO_POINTER(doc->id));
+}
+
+
+/* Reads the header lines of a journal file, without the records.
+ * Returns: the filename of the journal's document, or NULL if it is not a journal */
+static gchar *read_journal_filename(const gchar *journal_filename)
+{
+	GIOChannel *channel = g_io_channel_new_file(journal_filename, "r", NULL);
+	gchar *lines[2] = { NULL, NULL };
+	gchar *utf8_filename = NULL;
+	guint i;
+
+	if (channel == NULL)
+		return NULL;
+
+	g_io_channel_set_encoding(channel, NULL, NULL);
+	for (i = 0; i < G_N_ELEMENTS(lines); i++)
+	{
+		gsize terminator_pos;
+
+		if (g_io_channel_read_line(channel, &lines[i], NULL, &terminator_pos, NULL) !=
+			G_IO_STATUS_NORMAL)
+			break;
+		lines[i][terminator_pos] = '\0';
+	}
+	if (lines[1] != NULL && utils_str_equal(lines[0], JOURNAL_HEADER))
+		utf8_filename = g_strdup(lines[1]);
+
+	g_free(lines[0]);
+	g_free(lines[1]);
+	g_io_channel_unref(channel);
+	return utf8_filename;
+}
+
+
+/* Opens the files with journals left over from crashed instances, which were not
+ * opened with the session */
+static void on_startup_complete(GObject *obj, gpointer user_data)
+{
+	GDir *dir;
+	const gchar *name;
+
+	if (! file_prefs.use_edit_journal)
+		return;
+
+	dir = g_dir_open(journal_dir, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		const gchar *pid = strrchr(name, '-');
+		gchar *filename;
+		gchar *utf8_filename;
+
+		if (pid == NULL || ! g_str_has_suffix(name, ".journal") ||
+			is_process_running(strtoul(pid + 1, NULL, 10)))
+			continue;
+
+		filename = g_build_filename(journal_dir, name, NULL);
+		utf8_filename = read_journal_filename(filename);
+		if (utf8_filename != NULL && document_find_by_filename(utf8_filename) == NULL)
+		{
+			gchar *locale_filename = utils_get_locale_from_utf8(utf8_filename);
+
+			/* the document-open handler offers the recovery */
+			document_open_file(locale_filename, FALSE, NULL, NULL);
+			g_free(locale_filename);
+		}
+		g_free(utf8_filename);
+		g_free(filename);
+	}
+	g_dir_close(dir);
+}
+
+
+void journal_init(void)
+{
+	journal_dir = g_build_filename(app->configdir, "journal", NULL);
+	journals = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		(GDestroyNotify) journal_free);
+
+	g_signal_connect(geany_object, "editor-notify", G_CALLBACK(on_editor_notify), NULL);
+	g_signal_connect(geany_object, "document-open", G_CALLBACK(on_document_open), NULL);
+	g_signal_connect(geany_object, "document-reload", G_CALLBACK(on_document_save), NULL);
+	g_signal_connect(geany_object, "document-save", G_CALLBACK(on_document_save), NULL);
+	g_signal_connect(geany_object, "document-close", G_CALLBACK(on_document_close), NULL);
+	g_signal_connect(geany_object, "geany-startup-complete", G_CALLBACK(on_startup_complete), NULL);
+}
+
+
+void journal_finalize(void)
+{
+	if (flush_source != 0)
+		g_source_remove(flush_source);
+	g_hash_table_destroy(journals);
+	g_slist_free(recover_queue);
+	g_free(journal_dir);
+}
@@ -45,6 +45,7 @@
 #include "notebook.h"
 #include "prefs.h"
 #include "sciwrappers.h"
+#include "searchindex.h"
 #include "sidebar.h"
 #include "support.h"
 #include "symbols.h"
@@ -372,6 +373,8 @@ static void init_default_kb(void)
 		ui_lookup_stock_label(GTK_STOCK_PROPERTIES), "project_properties1");
 	add_kb(group, GEANY_KEYS_PROJECT_CLOSE, NULL,
 		0, 0, "project_close", _("Close"), "project_close1");
+	add_kb(group, GEANY_KEYS_PROJECT_REBUILDSEARCHINDEX, NULL,
+		0, 0, "project_rebuildsearchindex", _("Rebuild search index"), NULL);
 
 	group = keybindings_get_core_group(GEANY_KEY_GROUP_EDITOR);
 
@@ -1509,6 +1512,9 @@ static gboolean cb_func_project_action(guint key_id)
 			if (app->project)
 				on_project_properties1_activate(NULL, NULL);
 			break;
+		case GEANY_KEYS_PROJECT_REBUILDSEARCHINDEX:
+			search_index_rebuild();
+			break;
 	}
 	return TRUE;
 }
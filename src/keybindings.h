@@ -275,6 +275,8 @@ enum GeanyKeyBindingID
 	GEANY_KEYS_EDITOR_DELETELINETOBEGINNING,	/**< Keybinding. */
 	GEANY_KEYS_DOCUMENT_STRIPTRAILINGSPACES,	/**< Keybinding.
 												 * @since 1.34 (API 238) */
+	GEANY_KEYS_PROJECT_REBUILDSEARCHINDEX,		/**< Keybinding.
+												 * @since 1.38 (API 240) */
 	GEANY_KEYS_COUNT	/* must not be used by plugins */
 };
 
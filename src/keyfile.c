@@ -99,12 +99,14 @@
 #define GEANY_MAX_AUTOCOMPLETE_WORDS	30
 #define GEANY_MAX_SYMBOLS_UPDATE_FREQ	250
 #define GEANY_DEFAULT_FILETYPE_REGEX    "-\\*-\\s*([^\\s]+)\\s*-\\*-"
+/* number of threads reading session files */
+#define SESSION_READ_THREADS			4
 
 
 static gchar *scribble_text = NULL;
 static gint scribble_pos = -1;
 static GPtrArray *session_files = NULL;
-static gint session_notebook_page;
+static gint session_active_file;	/* index of the session file of the current page, or -1 */
 static gint hpan_position;
 static gint vpan_position;
 static guint document_list_update_idle_func_id = 0;
@@ -244,6 +246,14 @@ static void init_pref_groups(void)
 		"indent_hard_tab_width", 8);
 	stash_group_add_integer(group, &editor_prefs.ime_interaction,
 		"editor_ime_interaction", SC_IME_WINDOWED);
+	stash_group_add_integer(group, &editor_prefs.undo_memory_limit,
+		"undo_memory_limit", 0);
+	stash_group_add_boolean(group, &editor_prefs.autocomplete_doc_words_shared,
+		"autocomplete_doc_words_shared", FALSE);
+	stash_group_add_boolean(group, &editor_prefs.background_styling,
+		"background_styling", FALSE);
+	stash_group_add_integer(group, &editor_prefs.lexing_threads,
+		"lexing_threads", 1);
 
 	group = stash_group_new(PACKAGE);
 	configuration_add_various_pref_group(group, "files");
@@ -264,6 +274,14 @@ static void init_pref_groups(void)
 		"save_config_on_file_change", TRUE);
 	stash_group_add_string(group, &file_prefs.extract_filetype_regex,
 		"extract_filetype_regex", GEANY_DEFAULT_FILETYPE_REGEX);
+	stash_group_add_integer(group, &file_prefs.large_file_size,
+		"large_file_size", 64);
+	stash_group_add_integer(group, &file_prefs.chunked_text_size,
+		"chunked_text_size", 512);
+	stash_group_add_boolean(group, &file_prefs.lazy_session_load,
+		"lazy_session_load", FALSE);
+	stash_group_add_boolean(group, &file_prefs.use_edit_journal,
+		"edit_journal", FALSE);
 	stash_group_add_boolean(group, &ui_prefs.allow_always_save,
 		"allow_always_save", FALSE);
 
@@ -274,6 +292,12 @@ static void init_pref_groups(void)
 		"find_selection_type", GEANY_FIND_SEL_CURRENT_WORD);
 	stash_group_add_boolean(group, &search_prefs.replace_and_find_by_default,
 		"replace_and_find_by_default", TRUE);
+	stash_group_add_boolean(group, &search_prefs.builtin_find_in_files,
+		"builtin_find_in_files", FALSE);
+	stash_group_add_boolean(group, &search_prefs.use_search_index,
+		"search_index", FALSE);
+	stash_group_add_integer(group, &search_prefs.search_index_max_size,
+		"search_index_max_size", 512);
 
 	group = stash_group_new(PACKAGE);
 	configuration_add_various_pref_group(group, "socket");
@@ -365,7 +389,7 @@ static gchar *get_session_file_string(GeanyDocument *doc)
 	escaped_filename = g_uri_escape_string(locale_filename, NULL, TRUE);
 
 	fname = g_strdup_printf("%d;%s;%d;E%s;%d;%d;%d;%s;%d;%d",
-		sci_get_current_position(doc->editor->sci),
+		document_get_session_position(doc),
 		ft->name,
 		doc->readonly,
 		doc->encoding,
@@ -403,6 +427,8 @@ void configuration_save_session_files(GKeyFile *config)
 
 	npage = gtk_notebook_get_current_page(GTK_NOTEBOOK(main_widgets.notebook));
 	g_key_file_set_integer(config, "files", "current_page", npage);
+	/* the page index also counts tabs not saved in the session, so store the file index too */
+	g_key_file_set_integer(config, "files", "current_file", -1);
 
 	// clear existing entries first as they might not all be overwritten
 	remove_session_files(config);
@@ -421,6 +447,8 @@ void configuration_save_session_files(GKeyFile *config)
 			fname = get_session_file_string(doc);
 			g_key_file_set_string(config, "files", entry, fname);
 			g_free(fname);
+			if ((gint) i == npage)
+				g_key_file_set_integer(config, "files", "current_file", j);
 			j++;
 		}
 	}
@@ -696,7 +724,11 @@ void configuration_load_session_files(GKeyFile *config, gboolean read_recent_fil
 	gchar **tmp_array;
 	GError *error = NULL;
 
-	session_notebook_page = utils_get_setting_integer(config, "files", "current_page", -1);
+	/* older configurations only have the page index, which is right unless tabs were skipped */
+	if (g_key_file_has_key(config, "files", "current_file", NULL))
+		session_active_file = utils_get_setting_integer(config, "files", "current_file", -1);
+	else
+		session_active_file = utils_get_setting_integer(config, "files", "current_page", -1);
 
 	if (read_recent_files)
 	{
@@ -1187,13 +1219,93 @@ gboolean configuration_load(void)
 }
 
 
-static gboolean open_session_file(gchar **tmp, guint len)
+/* A session file being restored */
+typedef struct
 {
+	gchar		**tmp;				/* the session entry fields */
+	guint		 len;				/* number of fields in tmp */
+	gint		 index;				/* index of the session entry */
+	gchar		*locale_filename;
+	const gchar	*encoding;
+	gboolean	 lazy;				/* whether to only add a placeholder tab for it */
+	gboolean	 read;				/* whether a worker thread is done with it */
+	FileData	*filedata;			/* the read file data, NULL if the file is missing */
+	GeanyDocument *doc;				/* the opened document */
+}
+SessionFile;
+
+
+static GMutex session_read_mutex;
+static GCond session_read_cond;
+
+
+static SessionFile *session_file_new(gchar **tmp, guint len, gint index)
+{
+	SessionFile *sf = g_new0(SessionFile, 1);
+	gchar *unescaped_filename;
+
+	sf->tmp = tmp;
+	sf->len = len;
+	sf->index = index;
+	if (isdigit(tmp[3][0]))
+	{
+		sf->encoding = encodings_get_charset_from_index(atoi(tmp[3]));
+	}
+	else
+	{
+		sf->encoding = &(tmp[3][1]);
+	}
+	/* try to get the locale equivalent for the filename */
+	unescaped_filename = g_uri_unescape_string(tmp[7], NULL);
+	sf->locale_filename = utils_get_locale_from_utf8(unescaped_filename);
+	g_free(unescaped_filename);
+
+	return sf;
+}
+
+
+static void session_file_free(SessionFile *sf)
+{
+	if (sf->filedata != NULL)
+		document_free_file_data(sf->filedata);
+	g_free(sf->locale_filename);
+	g_strfreev(sf->tmp);
+	g_free(sf);
+}
+
+
+/* Reads a session file and detects its encoding, called in a worker thread */
+static void session_file_read_func(gpointer data, gpointer user_data)
+{
+	SessionFile *sf = data;
+	FileData *filedata = NULL;
+
+	if (g_file_test(sf->locale_filename, G_FILE_TEST_IS_REGULAR))
+		filedata = document_read_file_data(sf->locale_filename, sf->encoding);
+
+	g_mutex_lock(&session_read_mutex);
+	sf->filedata = filedata;
+	sf->read = TRUE;
+	g_cond_broadcast(&session_read_cond);
+	g_mutex_unlock(&session_read_mutex);
+}
+
+
+static void session_file_wait_read(SessionFile *sf)
+{
+	g_mutex_lock(&session_read_mutex);
+	while (! sf->read)
+		g_cond_wait(&session_read_cond, &session_read_mutex);
+	g_mutex_unlock(&session_read_mutex);
+}
+
+
+static gboolean open_session_file(SessionFile *sf)
+{
+	gchar **tmp = sf->tmp;
+	guint len = sf->len;
 	guint pos;
 	const gchar *ft_name;
-	gchar *locale_filename;
-	gchar *unescaped_filename;
-	const gchar *encoding;
 	gint  indent_type;
 	gboolean ro, auto_indent, line_wrapping;
 	/** TODO when we have a global pref for line breaking, use its value */
@@ -1203,30 +1315,26 @@ static gboolean open_session_file(gchar **tmp, guint len)
 	pos = atoi(tmp[0]);
 	ft_name = tmp[1];
 	ro = atoi(tmp[2]);
-	if (isdigit(tmp[3][0]))
-	{
-		encoding = encodings_get_charset_from_index(atoi(tmp[3]));
-	}
-	else
-	{
-		encoding = &(tmp[3][1]);
-	}
 	indent_type = atoi(tmp[4]);
 	auto_indent = atoi(tmp[5]);
 	line_wrapping = atoi(tmp[6]);
-	/* try to get the locale equivalent for the filename */
-	unescaped_filename = g_uri_unescape_string(tmp[7], NULL);
-	locale_filename = utils_get_locale_from_utf8(unescaped_filename);
 
 	if (len > 8)
 		line_breaking = atoi(tmp[8]);
 
-	if (g_file_test(locale_filename, G_FILE_TEST_IS_REGULAR))
+	if (sf->filedata != NULL ||
+		(sf->lazy && g_file_test(sf->locale_filename, G_FILE_TEST_IS_REGULAR)))
 	{
 		GeanyFiletype *ft = filetypes_lookup_by_name(ft_name);
-		GeanyDocument *doc = document_open_file_full(
-			NULL, locale_filename, pos, ro, ft, encoding);
+		GeanyDocument *doc;
 
+		if (sf->lazy)
+			doc = document_open_file_lazy(sf->locale_filename, pos, ro, ft, sf->encoding);
+		else
+		{
+			doc = document_open_file_data(sf->filedata, sf->locale_filename, pos, ro, ft);
+			sf->filedata = NULL;	/* taken over by document_open_file_data() */
+		}
 		if (doc)
 		{
 			gint indent_width = doc->editor->indent_width;
@@ -1237,31 +1345,87 @@ static gboolean open_session_file(gchar **tmp, guint len)
 			editor_set_line_wrapping(doc->editor, line_wrapping);
 			doc->editor->line_breaking = line_breaking;
 			doc->editor->auto_indent = auto_indent;
+			sf->doc = doc;
 			ret = TRUE;
 		}
 	}
 	else
 	{
-		geany_debug("Could not find file '%s'.", unescaped_filename);
+		gchar *utf8_filename = utils_get_utf8_from_locale(sf->locale_filename);
+
+		geany_debug("Could not find file '%s'.", utf8_filename);
+		g_free(utf8_filename);
 	}
 
-	g_free(locale_filename);
-	g_free(unescaped_filename);
 	return ret;
 }
 
 
+/* Moves the tab of the active session file, which is created first, between the tabs of the
+ * files next to it in the session */
+static void move_active_session_tab(GPtrArray *files, SessionFile *active)
+{
+	GtkNotebook *notebook = GTK_NOTEBOOK(main_widgets.notebook);
+	gint page = document_get_notebook_page(active->doc);
+	GtkWidget *child = gtk_notebook_get_nth_page(notebook, page);
+	SessionFile *prev = NULL, *next = NULL;
+	SessionFile *sf;
+	gint pos;
+	guint i;
+
+	foreach_ptr_array(sf, i, files)
+	{
+		if (sf == active || sf->doc == NULL || sf->doc == active->doc)
+			continue;
+		if (sf->index < active->index && (prev == NULL || sf->index > prev->index))
+			prev = sf;
+		else if (sf->index > active->index && (next == NULL || sf->index < next->index))
+			next = sf;
+	}
+
+	if (next != NULL)
+	{
+		pos = document_get_notebook_page(next->doc);
+		if (page < pos)
+			pos--;
+	}
+	else if (prev != NULL)
+	{
+		pos = document_get_notebook_page(prev->doc);
+		if (page > pos)
+			pos++;
+	}
+	else
+		return;
+
+	gtk_notebook_reorder_child(notebook, child, pos);
+}
+
+
 /* Open session files
+ * The files are read and their encoding detected by a pool of worker threads, starting
+ * with the file of the active tab. Its document is created and shown first, the others
+ * follow in tab order.
+ * With file_prefs.lazy_session_load, only the active file is read and the others
+ * are loaded when their tab is first shown.
  * Note: notebook page switch handler and adding to recent files list is always disabled
  * for all files opened within this function */
 void configuration_open_files(void)
 {
 	gint i;
+	guint j;
 	gboolean failure = FALSE;
+	GPtrArray *files;
+	GThreadPool *pool;
+	SessionFile *active = NULL;
+	SessionFile *sf;
+	GeanyDocument *doc;
 
 	/* necessary to set it to TRUE for project session support */
 	main_status.opening_session_files = TRUE;
 
+	/* collect the session files in tab order */
+	files = g_ptr_array_new();
 	i = file_prefs.tab_order_ltr ? 0 : (session_files->len - 1);
 	while (TRUE)
 	{
@@ -1270,10 +1434,15 @@ void configuration_open_files(void)
 
 		if (tmp != NULL && (len = g_strv_length(tmp)) >= 8)
 		{
-			if (! open_session_file(tmp, len))
-				failure = TRUE;
+			sf = session_file_new(tmp, len, i);
+			if (i == session_active_file)
+				active = sf;
+			else
+				sf->lazy = file_prefs.lazy_session_load;
+			g_ptr_array_add(files, sf);
 		}
-		g_strfreev(tmp);
+		else
+			g_strfreev(tmp);
 
 		if (file_prefs.tab_order_ltr)
 		{
@@ -1292,6 +1461,42 @@ void configuration_open_files(void)
 	g_ptr_array_free(session_files, TRUE);
 	session_files = NULL;
 
+	/* the active document is needed first, the others are read in tab order */
+	pool = g_thread_pool_new(session_file_read_func, NULL, SESSION_READ_THREADS, FALSE, NULL);
+	if (active != NULL)
+		g_thread_pool_push(pool, active, NULL);
+	foreach_ptr_array(sf, j, files)
+	{
+		if (sf != active && ! sf->lazy)
+			g_thread_pool_push(pool, sf, NULL);
+	}
+
+	if (active != NULL)
+	{
+		session_file_wait_read(active);
+		if (open_session_file(active))
+			document_show_tab(active->doc);
+		else
+			failure = TRUE;
+	}
+	foreach_ptr_array(sf, j, files)
+	{
+		if (sf == active)
+			continue;
+		if (! sf->lazy)
+			session_file_wait_read(sf);
+		if (! open_session_file(sf))
+			failure = TRUE;
+	}
+	if (active != NULL && active->doc != NULL)
+		move_active_session_tab(files, active);
+
+	g_thread_pool_free(pool, FALSE, TRUE);
+	doc = (active != NULL) ? active->doc : NULL;
+	foreach_ptr_array(sf, j, files)
+		session_file_free(sf);
+	g_ptr_array_free(files, TRUE);
+
 	if (failure)
 		ui_set_statusbar(TRUE, _("Failed to load one or more session files."));
 	else
@@ -1300,7 +1505,7 @@ void configuration_open_files(void)
 		 * for callbacks to run (and update window title, encoding settings, and so on) */
 		gint n_pages = gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
 		gint cur_page = gtk_notebook_get_current_page(GTK_NOTEBOOK(main_widgets.notebook));
-		gint target_page = session_notebook_page >= 0 ? session_notebook_page : cur_page;
+		gint target_page = (doc != NULL) ? document_get_notebook_page(doc) : cur_page;
 
 		/* if target page is current page, switch to another page first to really trigger an event */
 		if (target_page == cur_page && n_pages > 0)
@@ -1310,6 +1515,11 @@ void configuration_open_files(void)
 		gtk_notebook_set_current_page(GTK_NOTEBOOK(main_widgets.notebook), target_page);
 	}
 	main_status.opening_session_files = FALSE;
+
+	/* the current document might be a placeholder if the page switch wasn't triggered */
+	doc = document_get_current();
+	if (doc != NULL)
+		document_load_pending(doc);
 }
 
 
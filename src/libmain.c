@@ -39,6 +39,7 @@
 #include "filetypes.h"
 #include "geanyobject.h"
 #include "highlighting.h"
+#include "journal.h"
 #include "keybindings.h"
 #include "keyfile.h"
 #include "log.h"
@@ -48,6 +49,7 @@
 #include "plugins.h"
 #include "prefs.h"
 #include "printing.h"
+#include "searchindex.h"
 #include "sidebar.h"
 #ifdef HAVE_SOCKET
 # include "socket.h"
@@ -235,10 +237,15 @@ static void apply_settings(void)
 
 static void on_window_active_changed(GtkWindow *window, GParamSpec *pspec, gpointer data)
 {
-	GeanyDocument *doc = document_get_current();
+	guint i;
 
-	if (doc && gtk_window_is_active(window))
-		document_check_disk_status(doc, TRUE);
+	/* files are likely to have been changed by other programs meanwhile, check them all
+	 * in the background so that the tabs of the changed ones are marked */
+	if (gtk_window_is_active(window))
+	{
+		foreach_document(i)
+			document_check_disk_status(documents[i], TRUE);
+	}
 }
 
 
@@ -1203,6 +1210,8 @@ gint main_lib(gint argc, gchar **argv)
 	filetypes_init();
 	templates_init();
 	navqueue_init();
+	journal_init();
+	search_index_init();
 	document_init_doclist();
 	symbols_init();
 	editor_snippets_init();
@@ -1339,12 +1348,14 @@ static gboolean do_main_quit(void)
 	plugins_finalize();
 #endif
 
+	journal_finalize();
 	navqueue_free();
 	keybindings_free();
 	notebook_free();
 	highlighting_free_styles();
 	templates_free_templates();
 	msgwin_finalize();
+	search_index_finalize();
 	search_finalize();
 	build_finalize();
 	document_finalize();
@@ -86,6 +86,33 @@ static GdkColor color_error = {0, 0xFFFF, 0, 0};
 static GdkColor color_context = {0, 0x7FFF, 0, 0};
 static GdkColor color_message = {0, 0, 0, 0xD000};
 
+#define MSG_FLUSH_INTERVAL	50		/* ms */
+#define MSG_FLUSH_MAX_ROWS	2000	/* rows added at once, to keep the UI responsive */
+
+typedef struct MsgRow
+{
+	gint msg_color;
+	gint line;
+	guint doc_id;
+	gchar *text;
+}
+MsgRow;
+
+/* rows of the compiler or messages tab */
+typedef struct MsgList
+{
+	gint tabnum;
+	GQueue pending;			/* MsgRows not added to the store yet */
+	guint count;			/* rows added to the store, without more_row */
+	guint pages;			/* number of ui_prefs.msgwin_max_rows pages to show */
+	GtkTreeRowReference *more_row;	/* row telling the number of held back rows */
+}
+MsgList;
+
+static MsgList msg_list = {MSG_MESSAGE, G_QUEUE_INIT, 0, 1, NULL};
+static MsgList compiler_list = {MSG_COMPILER, G_QUEUE_INIT, 0, 1, NULL};
+static guint flush_source_id = 0;
+
 
 static void prepare_msg_tree_view(void);
 static void prepare_status_tree_view(void);
@@ -94,6 +121,8 @@ static GtkWidget *create_message_popup_menu(gint type);
 static gboolean on_msgwin_button_press_event(GtkWidget *widget, GdkEventButton *event,
 																			gpointer user_data);
 static void on_scribble_populate(GtkTextView *textview, GtkMenu *arg1, gpointer user_data);
+static void msg_row_free(gpointer data);
+static gboolean msg_list_check_more_row(MsgList *list, gboolean activate);
 
 
 void msgwin_show_hide_tabs(void)
@@ -176,6 +205,12 @@ void msgwin_init(void)
 
 void msgwin_finalize(void)
 {
+	if (flush_source_id != 0)
+		g_source_remove(flush_source_id);
+	g_queue_foreach(&msg_list.pending, (GFunc) msg_row_free, NULL);
+	g_queue_clear(&msg_list.pending);
+	g_queue_foreach(&compiler_list.pending, (GFunc) msg_row_free, NULL);
+	g_queue_clear(&compiler_list.pending);
 	g_free(msgwindow.messages_dir);
 }
 
@@ -190,12 +225,14 @@ static gboolean on_msgwin_key_press_event(GtkWidget *widget, GdkEventKey *event,
 		{
 			case MSG_COMPILER:
 			{	/* key press in the compiler treeview */
-				msgwin_goto_compiler_file_line(enter_or_return);
+				if (! msg_list_check_more_row(&compiler_list, enter_or_return))
+					msgwin_goto_compiler_file_line(enter_or_return);
 				break;
 			}
 			case MSG_MESSAGE:
 			{	/* key press in the message treeview (results of 'Find usage') */
-				msgwin_goto_messages_file_line(enter_or_return);
+				if (! msg_list_check_more_row(&msg_list, enter_or_return))
+					msgwin_goto_messages_file_line(enter_or_return);
 				break;
 			}
 		}
@@ -315,6 +352,250 @@ static const GdkColor *get_color(gint msg_color)
 }
 
 
+static GtkListStore *msg_list_get_store(MsgList *list)
+{
+	return list->tabnum == MSG_COMPILER ? msgwindow.store_compiler : msgwindow.store_msg;
+}
+
+
+static GtkTreeView *msg_list_get_tree(MsgList *list)
+{
+	return GTK_TREE_VIEW(list->tabnum == MSG_COMPILER ? msgwindow.tree_compiler : msgwindow.tree_msg);
+}
+
+
+/* the number of rows to show, 0 for all */
+static guint msg_list_get_limit(MsgList *list)
+{
+	return (guint) MAX(ui_prefs.msgwin_max_rows, 0) * list->pages;
+}
+
+
+static void msg_row_free(gpointer data)
+{
+	MsgRow *row = data;
+
+	g_free(row->text);
+	g_free(row);
+}
+
+
+static void msg_list_insert(MsgList *list, GtkTreeIter *iter, gint msg_color, gint line,
+		guint doc_id, const gchar *text)
+{
+	if (list->tabnum == MSG_COMPILER)
+		gtk_list_store_insert_with_values(msgwindow.store_compiler, iter, -1,
+			COMPILER_COL_COLOR, get_color(msg_color), COMPILER_COL_STRING, text, -1);
+	else
+		gtk_list_store_insert_with_values(msgwindow.store_msg, iter, -1,
+			MSG_COL_LINE, line, MSG_COL_DOC_ID, doc_id, MSG_COL_COLOR, get_color(msg_color),
+			MSG_COL_STRING, text, -1);
+}
+
+
+static void msg_list_remove_more_row(MsgList *list)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	if (list->more_row == NULL)
+		return;
+
+	path = gtk_tree_row_reference_get_path(list->more_row);
+	if (path != NULL)
+	{
+		GtkListStore *store = msg_list_get_store(list);
+
+		if (gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path))
+			gtk_list_store_remove(store, &iter);
+		gtk_tree_path_free(path);
+	}
+	gtk_tree_row_reference_free(list->more_row);
+	list->more_row = NULL;
+}
+
+
+/* Shows the number of rows held back by the row limit in a last row, which shows
+ * the next rows when activated. */
+static void msg_list_update_more_row(MsgList *list)
+{
+	GtkListStore *store = msg_list_get_store(list);
+	guint limit = msg_list_get_limit(list);
+	guint held = 0;
+	GtkTreePath *path = NULL;
+	GtkTreeIter iter;
+	gchar *text;
+
+	if (limit > 0 && list->count >= limit)
+		held = g_queue_get_length(&list->pending);
+	if (held == 0)
+	{
+		msg_list_remove_more_row(list);
+		return;
+	}
+
+	text = g_strdup_printf(ngettext(
+		"%u more message, double-click to show it",
+		"%u more messages, double-click to show them", held), held);
+
+	if (list->more_row != NULL)
+		path = gtk_tree_row_reference_get_path(list->more_row);
+	if (path != NULL && gtk_tree_model_get_iter(GTK_TREE_MODEL(store), &iter, path))
+		gtk_list_store_set(store, &iter, list->tabnum == MSG_COMPILER ?
+			COMPILER_COL_STRING : MSG_COL_STRING, text, -1);
+	else
+	{
+		msg_list_remove_more_row(list);
+		msg_list_insert(list, &iter, COLOR_BLUE, -1, 0, text);
+		path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), &iter);
+		list->more_row = gtk_tree_row_reference_new(GTK_TREE_MODEL(store), path);
+	}
+	gtk_tree_path_free(path);
+	g_free(text);
+}
+
+
+/* Adds up to MSG_FLUSH_MAX_ROWS pending rows to the store.
+ * Returns whether there are more rows to add now. */
+static gboolean msg_list_flush(MsgList *list)
+{
+	guint limit = msg_list_get_limit(list);
+	guint added = 0;
+	GtkTreeIter iter;
+
+	while (added < MSG_FLUSH_MAX_ROWS && ! g_queue_is_empty(&list->pending) &&
+		(limit == 0 || list->count < limit))
+	{
+		MsgRow *row = g_queue_pop_head(&list->pending);
+
+		/* keep the row telling about held back rows at the end */
+		if (added == 0)
+			msg_list_remove_more_row(list);
+		msg_list_insert(list, &iter, row->msg_color, row->line, row->doc_id, row->text);
+		msg_row_free(row);
+		list->count++;
+		added++;
+	}
+	msg_list_update_more_row(list);
+
+	/* scroll only once for all rows added */
+	if (added > 0 && list->tabnum == MSG_COMPILER &&
+		ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
+	{
+		GtkTreePath *path = gtk_tree_model_get_path(
+			GTK_TREE_MODEL(msgwindow.store_compiler), &iter);
+
+		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_compiler), path, NULL, TRUE, 0.5, 0.5);
+		gtk_tree_path_free(path);
+	}
+
+	return ! g_queue_is_empty(&list->pending) && (limit == 0 || list->count < limit);
+}
+
+
+static gboolean flush_msg_lists(gpointer data)
+{
+	gboolean more_msg = msg_list_flush(&msg_list);
+	gboolean more_compiler = msg_list_flush(&compiler_list);
+
+	if (more_msg || more_compiler)
+		return TRUE;
+
+	flush_source_id = 0;
+	return FALSE;
+}
+
+
+/* Rows are added in batches rather than one by one, which would keep the tree views
+ * busy with huge outputs like Find in Files results or build logs. */
+static void msg_list_add(MsgList *list, gint msg_color, gint line, guint doc_id, gchar *text)
+{
+	MsgRow *row = g_new(MsgRow, 1);
+
+	row->msg_color = msg_color;
+	row->line = line;
+	row->doc_id = doc_id;
+	row->text = text;
+	g_queue_push_tail(&list->pending, row);
+
+	if (flush_source_id == 0)
+		flush_source_id = g_timeout_add(MSG_FLUSH_INTERVAL, flush_msg_lists, NULL);
+}
+
+
+static void msg_list_clear(MsgList *list)
+{
+	g_queue_foreach(&list->pending, (GFunc) msg_row_free, NULL);
+	g_queue_clear(&list->pending);
+	if (list->more_row != NULL)
+	{
+		gtk_tree_row_reference_free(list->more_row);
+		list->more_row = NULL;
+	}
+	list->count = 0;
+	list->pages = 1;
+	gtk_list_store_clear(msg_list_get_store(list));
+}
+
+
+static gboolean msg_list_is_more_row(MsgList *list, GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GtkTreePath *path, *more_path;
+	gboolean ret;
+
+	if (list->more_row == NULL)
+		return FALSE;
+
+	more_path = gtk_tree_row_reference_get_path(list->more_row);
+	if (more_path == NULL)
+		return FALSE;
+	path = gtk_tree_model_get_path(model, iter);
+	ret = gtk_tree_path_compare(path, more_path) == 0;
+	gtk_tree_path_free(path);
+	gtk_tree_path_free(more_path);
+	return ret;
+}
+
+
+static gboolean msg_list_more_row_selected(MsgList *list)
+{
+	GtkTreeSelection *selection = gtk_tree_view_get_selection(msg_list_get_tree(list));
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+
+	return list->more_row != NULL && gtk_tree_selection_get_selected(selection, &model, &iter) &&
+		msg_list_is_more_row(list, model, &iter);
+}
+
+
+/* Returns whether the selected row is the one for held back rows, which shows the
+ * next page of rows if activate is set. */
+static gboolean msg_list_check_more_row(MsgList *list, gboolean activate)
+{
+	if (! msg_list_more_row_selected(list))
+		return FALSE;
+
+	if (activate)
+	{
+		list->pages++;
+		if (msg_list_flush(list) && flush_source_id == 0)
+			flush_source_id = g_timeout_add(MSG_FLUSH_INTERVAL, flush_msg_lists, NULL);
+	}
+	return TRUE;
+}
+
+
+/* Returns the number of messages in the given tab, including the ones not shown yet. */
+guint msgwin_get_message_count(gint tabnum)
+{
+	MsgList *list = tabnum == MSG_COMPILER ? &compiler_list : &msg_list;
+
+	g_return_val_if_fail(tabnum == MSG_COMPILER || tabnum == MSG_MESSAGE, 0);
+
+	return list->count + g_queue_get_length(&list->pending);
+}
+
+
 /**
  * Adds a formatted message in the compiler tab treeview in the messages window.
  *
@@ -352,30 +633,14 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...)
 GEANY_API_SYMBOL
 void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
 {
-	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
 	gchar *utf8_msg;
 
 	if (! g_utf8_validate(msg, -1, NULL))
 		utf8_msg = utils_get_utf8_from_locale(msg);
 	else
-		utf8_msg = (gchar *) msg;
-
-	gtk_list_store_append(msgwindow.store_compiler, &iter);
-	gtk_list_store_set(msgwindow.store_compiler, &iter,
-		COMPILER_COL_COLOR, color, COMPILER_COL_STRING, utf8_msg, -1);
-
-	if (ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
-	{
-		GtkTreePath *path = gtk_tree_model_get_path(
-			gtk_tree_view_get_model(GTK_TREE_VIEW(msgwindow.tree_compiler)), &iter);
-
-		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_compiler), path, NULL, TRUE, 0.5, 0.5);
-		gtk_tree_path_free(path);
-	}
+		utf8_msg = g_strdup(msg);
 
-	if (utf8_msg != msg)
-		g_free(utf8_msg);
+	msg_list_add(&compiler_list, msg_color, -1, 0, utf8_msg);
 }
 
 
@@ -442,8 +707,6 @@ void msgwin_msg_add(gint msg_color, gint line, GeanyDocument *doc, const gchar *
 GEANY_API_SYMBOL
 void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string)
 {
-	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
 	gchar *tmp;
 	gsize len;
 	gchar *utf8_msg;
@@ -465,14 +728,9 @@ void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const
 	else
 		utf8_msg = tmp;
 
-	gtk_list_store_append(msgwindow.store_msg, &iter);
-	gtk_list_store_set(msgwindow.store_msg, &iter,
-		MSG_COL_LINE, line, MSG_COL_DOC_ID, doc ? doc->id : 0, MSG_COL_COLOR,
-		color, MSG_COL_STRING, utf8_msg, -1);
-
-	g_free(tmp);
+	msg_list_add(&msg_list, msg_color, line, doc ? doc->id : 0, utf8_msg);
 	if (utf8_msg != tmp)
-		g_free(utf8_msg);
+		g_free(tmp);
 }
 
 
@@ -595,15 +853,18 @@ on_compiler_treeview_copy_activate(GtkMenuItem *menuitem, gpointer user_data)
 static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
 	GtkListStore *store = msgwindow.store_compiler;
+	MsgList *list = &compiler_list;
 	GtkTreeIter iter;
 	GString *str = g_string_new("");
 	gint str_idx = COMPILER_COL_STRING;
 	gboolean valid;
+	GList *node;
 
 	switch (GPOINTER_TO_INT(user_data))
 	{
 		case MSG_STATUS:
 		store = msgwindow.store_status;
+		list = NULL;
 		str_idx = 0;
 		break;
 
@@ -613,6 +874,7 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 
 		case MSG_MESSAGE:
 		store = msgwindow.store_msg;
+		list = &msg_list;
 		str_idx = MSG_COL_STRING;
 		break;
 	}
@@ -623,6 +885,13 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 	{
 		gchar *line;
 
+		/* the row telling about held back messages isn't a message */
+		if (list != NULL && msg_list_is_more_row(list, GTK_TREE_MODEL(store), &iter))
+		{
+			valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
+			continue;
+		}
+
 		gtk_tree_model_get(GTK_TREE_MODEL(store), &iter, str_idx, &line, -1);
 		if (!EMPTY(line))
 		{
@@ -633,6 +902,20 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 
 		valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
 	}
+	/* and the messages not shown yet */
+	if (list != NULL)
+	{
+		for (node = list->pending.head; node != NULL; node = node->next)
+		{
+			MsgRow *row = node->data;
+
+			if (!EMPTY(row->text))
+			{
+				g_string_append(str, row->text);
+				g_string_append_c(str, '\n');
+			}
+		}
+	}
 
 	/* copy the string into the clipboard */
 	if (str->len > 0)
@@ -786,6 +1069,8 @@ static gboolean goto_compiler_file_line(const gchar *fname, gint line, gboolean
 
 		if (doc != NULL)
 		{
+			/* it is shown, so load it if it is a lazily restored session document */
+			document_load_pending(doc);
 			if (! doc->changed && editor_prefs.use_indicators)	/* if modified, line may be wrong */
 				editor_indicator_set_on_line(doc->editor, GEANY_INDICATOR_ERROR, line - 1);
 
@@ -811,6 +1096,10 @@ gboolean msgwin_goto_compiler_file_line(gboolean focus_editor)
 	gchar *string;
 	GdkColor *color;
 
+	/* skip the row telling about held back messages when going to the next error */
+	if (msg_list_more_row_selected(&compiler_list))
+		return FALSE;
+
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(msgwindow.tree_compiler));
 	if (gtk_tree_selection_get_selected(selection, &model, &iter))
 	{
@@ -1184,6 +1473,10 @@ gboolean msgwin_goto_messages_file_line(gboolean focus_editor)
 	GtkTreeSelection *selection;
 	gboolean ret = FALSE;
 
+	/* skip the row telling about held back messages when going to the next message */
+	if (msg_list_more_row_selected(&msg_list))
+		return FALSE;
+
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(msgwindow.tree_msg));
 	if (gtk_tree_selection_get_selected(selection, &model, &iter))
 	{
@@ -1248,12 +1541,14 @@ static gboolean on_msgwin_button_press_event(GtkWidget *widget, GdkEventButton *
 		{
 			case MSG_COMPILER:
 			{	/* mouse click in the compiler treeview */
-				msgwin_goto_compiler_file_line(double_click);
+				if (! msg_list_check_more_row(&compiler_list, double_click))
+					msgwin_goto_compiler_file_line(double_click);
 				break;
 			}
 			case MSG_MESSAGE:
 			{	/* mouse click in the message treeview (results of 'Find usage') */
-				msgwin_goto_messages_file_line(double_click);
+				if (! msg_list_check_more_row(&msg_list, double_click))
+					msgwin_goto_messages_file_line(double_click);
 				break;
 			}
 		}
@@ -1342,11 +1637,11 @@ void msgwin_clear_tab(gint tabnum)
 	switch (tabnum)
 	{
 		case MSG_MESSAGE:
-			store = msgwindow.store_msg;
-			break;
+			msg_list_clear(&msg_list);
+			return;
 
 		case MSG_COMPILER:
-			gtk_list_store_clear(msgwindow.store_compiler);
+			msg_list_clear(&compiler_list);
 			build_menu_update(NULL);	/* update next error items */
 			return;
 
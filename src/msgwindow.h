@@ -107,6 +107,8 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 
 gboolean msgwin_goto_messages_file_line(gboolean focus_editor);
 
+guint msgwin_get_message_count(gint tabnum);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
@@ -156,6 +156,8 @@ gboolean navqueue_goto_line(GeanyDocument *old_doc, GeanyDocument *new_doc, gint
 	g_return_val_if_fail(DOC_VALID(new_doc), FALSE);
 	g_return_val_if_fail(line >= 1, FALSE);
 
+	/* the file of a lazily restored session document is only loaded when needed */
+	document_load_pending(new_doc);
 	pos = sci_get_position_from_line(new_doc->editor->sci, line - 1);
 
 	/* first add old file position */
@@ -183,6 +185,7 @@ static gboolean goto_file_pos(const gchar *file, gint pos)
 	if (doc == NULL)
 		return FALSE;
 
+	document_load_pending(doc);
 	return editor_goto_pos(doc->editor, pos, TRUE);
 }
 
@@ -249,6 +249,20 @@ void sci_add_text(ScintillaObject *sci, const gchar *text)
 }
 
 
+/* appends len bytes of text, which doesn't need to be null-terminated */
+void sci_append_text(ScintillaObject *sci, const gchar *text, gsize len)
+{
+	SSM(sci, SCI_APPENDTEXT, len, (sptr_t) text);
+}
+
+
+/* reserves space for the document text, to avoid reallocations when adding a lot of text */
+void sci_allocate(ScintillaObject *sci, gsize bytes)
+{
+	SSM(sci, SCI_ALLOCATE, bytes, 0);
+}
+
+
 /** Sets all text.
  * @param sci Scintilla widget.
  * @param text Text. */
@@ -861,6 +875,12 @@ void sci_set_savepoint(ScintillaObject *sci)
 }
 
 
+void sci_discard_savepoint(ScintillaObject *sci)
+{
+	SSM(sci, SCI_DISCARDSAVEPOINT, 0, 0);
+}
+
+
 void sci_set_indentation_guides(ScintillaObject *sci, gint mode)
 {
 	SSM(sci, SCI_SETINDENTATIONGUIDES, (uptr_t) mode, 0);
@@ -116,6 +116,8 @@ void 				sci_set_line_numbers		(ScintillaObject *sci,  gboolean set);
 void				sci_set_mark_long_lines		(ScintillaObject *sci,	gint type, gint column, const gchar *color);
 
 void 				sci_add_text				(ScintillaObject *sci,  const gchar *text);
+void				sci_append_text				(ScintillaObject *sci, const gchar *text, gsize len);
+void				sci_allocate				(ScintillaObject *sci, gsize bytes);
 gboolean			sci_can_redo				(ScintillaObject *sci);
 gboolean			sci_can_undo				(ScintillaObject *sci);
 void 				sci_undo					(ScintillaObject *sci);
@@ -165,6 +167,7 @@ void				sci_clear_all				(ScintillaObject *sci);
 gint				sci_get_end_styled			(ScintillaObject *sci);
 void				sci_set_tab_width			(ScintillaObject *sci, gint width);
 void				sci_set_savepoint			(ScintillaObject *sci);
+void				sci_discard_savepoint		(ScintillaObject *sci);
 void				sci_set_indentation_guides	(ScintillaObject *sci, gint mode);
 void				sci_use_popup				(ScintillaObject *sci, gboolean enable);
 void				sci_goto_pos				(ScintillaObject *sci, gint pos, gboolean unfold);
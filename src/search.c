@@ -37,6 +37,7 @@
 #include "msgwindow.h"
 #include "prefs.h"
 #include "sciwrappers.h"
+#include "searchindex.h"
 #include "spawn.h"
 #include "stash.h"
 #include "support.h"
@@ -49,6 +50,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <glib/gstdio.h>
 
 #include <gdk/gdkkeysyms.h>
 
@@ -146,15 +148,45 @@ static struct
 }
 fif_dlg = {NULL, NULL, NULL, NULL, NULL, NULL, {0, 0}};
 
+/* pattern variant used to skip lines in single-line regex searches, see get_line_regex() */
+static struct
+{
+	gchar		*pattern;
+	gboolean	caseless;
+	GRegex		*regex;
+}
+line_regex_cache = {NULL, FALSE, NULL};
+
+#define REGEX_CHUNK_SIZE	(1024 * 1024)	/* bytes matched at once when skipping lines */
+
+#define TEXT_COPY_HOLD_TIME	2	/* seconds a copy of chunked text is kept after a search */
+
+/* document whose copy of chunked text is freed when source_id fires, see hold_text_copy() */
+static struct
+{
+	guint	doc_id;
+	guint	source_id;
+}
+text_copy = {0, 0};
+
 
 static void search_read_io(GString *string, GIOCondition condition, gpointer data);
 static void search_read_io_stderr(GString *string, GIOCondition condition, gpointer data);
 
 static void search_finished(GPid child_pid, gint status, gpointer user_data);
+static void search_report_finished(gint exit_status, gint count);
+
+static gboolean fif_start_search(const gchar *search_text, const gchar *utf8_search_text,
+		const gchar *utf8_dir, const gchar *enc);
+static void fif_cancel_search(void);
+static void fif_free_searches(void);
 
 static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir);
 
 static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags);
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline, GeanyMatchInfo *match);
+static gint geany_find_flags_to_sci_flags(GeanyFindFlags flags);
+static void mark_all_cancel(void);
 
 
 static void
@@ -288,6 +320,13 @@ void search_finalize(void)
 	FREE_WIDGET(find_dlg.dialog);
 	FREE_WIDGET(replace_dlg.dialog);
 	FREE_WIDGET(fif_dlg.dialog);
+	fif_free_searches();
+	mark_all_cancel();
+	if (text_copy.source_id != 0)
+		g_source_remove(text_copy.source_id);
+	if (line_regex_cache.regex != NULL)
+		g_regex_unref(line_regex_cache.regex);
+	g_free(line_regex_cache.pattern);
 	g_free(search_data.text);
 	g_free(search_data.original_text);
 }
@@ -1224,40 +1263,311 @@ static GSList *find_range(ScintillaObject *sci, GeanyFindFlags flags, struct Sci
 }
 
 
-/* Clears markers if text is null/empty.
- * @return Number of matches marked. */
-gint search_mark_all(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+#define MARK_ALL_SLICE_TIME		10000	/* us spent marking before yielding to the main loop */
+
+typedef struct MarkAllJob
 {
-	gint count = 0;
-	struct Sci_TextToFind ttf;
-	GSList *match, *matches;
+	guint doc_id;
+	gchar *text;
+	gchar *report_text;		/* text for the status message when done, or NULL */
+	GeanyFindFlags flags;
+	GRegex *regex;			/* compiled once for the whole job */
+	GeanyMatchInfo *match;
+	gint length;			/* document length the job was started with */
+	gboolean text_changed;	/* whether text was inserted or deleted since */
+	gint visible_start;		/* start of the first visible line */
+	gint down_pos;			/* next position to search from below the visible start */
+	gint up_pos;			/* next position to search from above the visible start */
+	gboolean down_done;
+	gboolean up_done;
+	gboolean next_down;
+	gint down_count;		/* matches marked below the visible start */
+	gint up_count;			/* matches marked above the visible start */
+	guint source_id;
+}
+MarkAllJob;
 
-	g_return_val_if_fail(DOC_VALID(doc), 0);
+static MarkAllJob *mark_all_job = NULL;
+
+
+static void mark_all_job_free(MarkAllJob *job)
+{
+	if (job->source_id != 0)
+		g_source_remove(job->source_id);
+	if (job->regex)
+		g_regex_unref(job->regex);
+	if (job->match)
+		geany_match_info_free(job->match);
+	g_free(job->text);
+	g_free(job->report_text);
+	g_free(job);
+}
+
+
+static void mark_all_cancel(void)
+{
+	if (mark_all_job != NULL)
+	{
+		mark_all_job_free(mark_all_job);
+		mark_all_job = NULL;
+	}
+}
+
+
+/* Stops marking matches in doc, when the search indicators are cleared. */
+void search_mark_all_cancel(GeanyDocument *doc)
+{
+	if (mark_all_job != NULL && mark_all_job->doc_id == doc->id)
+		mark_all_cancel();
+}
+
+
+/* Called when text is inserted into or deleted from doc, which makes the positions of a
+ * Mark All job still running in it invalid. */
+void search_mark_all_text_changed(GeanyDocument *doc)
+{
+	if (mark_all_job != NULL && mark_all_job->doc_id == doc->id)
+		mark_all_job->text_changed = TRUE;
+}
+
+
+static void mark_all_report(gint count, const gchar *text)
+{
+	if (count == 0)
+		ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), text);
+	else
+		ui_set_statusbar(FALSE,
+			ngettext("Found %d match for \"%s\".",
+					 "Found %d matches for \"%s\".", count),
+			count, text);
+}
+
+
+static void mark_all_add(ScintillaObject *sci, gint start, gint end, gint *count)
+{
+	/* the indicator was already selected for this slice */
+	if (end != start)
+		sci_indicator_fill(sci, start, end - start);
+	(*count)++;
+}
+
+
+/* Returns the start of the next match at or after pos and sets end, or -1 */
+static gint mark_all_find_next(MarkAllJob *job, ScintillaObject *sci, gint pos, gint *end)
+{
+	if (job->regex != NULL)
+	{
+		if (find_regex(sci, pos, job->regex, job->flags & GEANY_FIND_MULTILINE, job->match) == -1)
+			return -1;
+		*end = job->match->end;
+		return job->match->start;
+	}
+	else
+	{
+		struct Sci_TextToFind ttf;
+
+		ttf.chrg.cpMin = pos;
+		ttf.chrg.cpMax = job->length;
+		ttf.lpstrText = job->text;
+		if (sci_find_text(sci, geany_find_flags_to_sci_flags(job->flags), &ttf) == -1)
+			return -1;
+		*end = ttf.chrgText.cpMax;
+		return ttf.chrgText.cpMin;
+	}
+}
+
+
+/* Marks matches from the visible start to the end of the document.
+ * Returns TRUE when done, FALSE when the deadline was hit first. */
+static gboolean mark_all_down(MarkAllJob *job, ScintillaObject *sci, gint64 deadline)
+{
+	while (job->down_pos <= job->length)
+	{
+		gint start, end;
+
+		start = mark_all_find_next(job, sci, job->down_pos, &end);
+		if (start == -1)
+			return TRUE;
+
+		mark_all_add(sci, start, end, &job->down_count);
+		/* avoid rematching with empty matches, see find_range() */
+		job->down_pos = (end == start) ? end + 1 : end;
+
+		if (g_get_monotonic_time() >= deadline)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* Marks matches from the start of the document up to the visible start. Both parts are searched
+ * forwards from the start of a line, so they find the same matches as a single search from the
+ * start of the document would, unless a match found here runs past the visible start.
+ * Returns TRUE when done, FALSE when the deadline was hit first. */
+static gboolean mark_all_up(MarkAllJob *job, ScintillaObject *sci, gint64 deadline)
+{
+	while (job->up_pos < job->visible_start)
+	{
+		gint start, end;
+
+		start = mark_all_find_next(job, sci, job->up_pos, &end);
+		if (start == -1 || start >= job->visible_start)
+			return TRUE;
+
+		if (end > job->visible_start)
+		{
+			/* the matches found below the visible start so far may overlap this one, so
+			 * search that part again from the end of this match */
+			gint down_end = MIN(job->down_pos, job->length);
+
+			if (down_end > job->visible_start)
+				sci_indicator_clear(sci, job->visible_start, down_end - job->visible_start);
+			job->down_count = 0;
+			job->down_pos = end;
+			job->down_done = FALSE;
+			mark_all_add(sci, start, end, &job->up_count);
+			return TRUE;
+		}
+
+		mark_all_add(sci, start, end, &job->up_count);
+		job->up_pos = (end == start) ? end + 1 : end;
+
+		if (g_get_monotonic_time() >= deadline)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* Marks matches for one time slice, alternating between the parts below and above the
+ * visible start. Returns TRUE when all matches have been marked. */
+static gboolean mark_all_run(MarkAllJob *job, ScintillaObject *sci)
+{
+	gint64 deadline = g_get_monotonic_time() + MARK_ALL_SLICE_TIME;
+
+	sci_indicator_set(sci, GEANY_INDICATOR_SEARCH);
+
+	while (! job->down_done || ! job->up_done)
+	{
+		if (! job->down_done && (job->next_down || job->up_done))
+			job->down_done = mark_all_down(job, sci, deadline);
+		else
+			job->up_done = mark_all_up(job, sci, deadline);
+		job->next_down = ! job->next_down;
+
+		if (g_get_monotonic_time() >= deadline)
+			break;
+	}
+	return job->down_done && job->up_done;
+}
+
+
+static void mark_all_start(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags,
+		const gchar *report_text);
+
+static gboolean mark_all_idle(gpointer data)
+{
+	MarkAllJob *job = mark_all_job;
+	GeanyDocument *doc;
+
+	g_return_val_if_fail(job != NULL, FALSE);
+
+	doc = document_find_by_id(job->doc_id);
+	if (doc == NULL)
+	{
+		job->source_id = 0;
+		mark_all_cancel();
+		return FALSE;
+	}
+
+	if (job->text_changed)
+	{
+		/* the text changed under us, start again with the current text */
+		gchar *text = g_strdup(job->text);
+		gchar *report_text = g_strdup(job->report_text);
+		GeanyFindFlags flags = job->flags;
+
+		job->source_id = 0;
+		mark_all_start(doc, text, flags, report_text);
+		g_free(text);
+		g_free(report_text);
+		return FALSE;
+	}
+
+	if (! mark_all_run(job, doc->editor->sci))
+		return TRUE;
+
+	if (job->report_text != NULL)
+		mark_all_report(job->up_count + job->down_count, job->report_text);
+	job->source_id = 0;
+	mark_all_cancel();
+	return FALSE;
+}
+
+
+/* Marks all matches, starting with the visible part of the document. The first time slice is
+ * run immediately, the rest in idle callbacks. If report_text is not NULL, the number of
+ * matches is shown in a status message when done. */
+static void mark_all_start(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags,
+		const gchar *report_text)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	MarkAllJob *job;
+	gint line;
+
+	/* any new search cancels the one still running */
+	mark_all_cancel();
 
 	/* clear previous search indicators */
 	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
 
 	if (G_UNLIKELY(EMPTY(search_text)))
-		return 0;
-
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
+		return;
 
-	matches = find_range(doc->editor->sci, flags, &ttf);
-	foreach_slist (match, matches)
+	job = g_new0(MarkAllJob, 1);
+	job->doc_id = doc->id;
+	job->text = g_strdup(search_text);
+	job->report_text = g_strdup(report_text);
+	job->flags = flags;
+	if (flags & GEANY_FIND_REGEXP)
 	{
-		GeanyMatchInfo *info = match->data;
+		job->regex = compile_regex(search_text, flags);
+		if (job->regex == NULL)
+		{
+			mark_all_job_free(job);
+			if (report_text != NULL)
+				mark_all_report(0, report_text);
+			return;
+		}
+		job->match = match_info_new(flags, 0, 0);
+	}
 
-		if (info->end != info->start)
-			editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH, info->start, info->end);
-		count++;
+	job->length = sci_get_length(sci);
+	line = (gint) SSM(sci, SCI_DOCLINEFROMVISIBLE, SSM(sci, SCI_GETFIRSTVISIBLELINE, 0, 0), 0);
+	job->visible_start = sci_get_position_from_line(sci, line);
+	job->down_pos = job->visible_start;
+	job->next_down = TRUE;
 
-		geany_match_info_free(info);
+	if (mark_all_run(job, sci))
+	{
+		if (report_text != NULL)
+			mark_all_report(job->up_count + job->down_count, report_text);
+		mark_all_job_free(job);
+		return;
 	}
-	g_slist_free(matches);
 
-	return count;
+	mark_all_job = job;
+	job->source_id = g_idle_add(mark_all_idle, NULL);
+}
+
+
+/* Clears markers if text is null/empty.
+ * Matches are marked in time slices, starting with the visible part of the document. */
+void search_mark_all(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+{
+	g_return_if_fail(DOC_VALID(doc));
+
+	mark_all_start(doc, search_text, flags, NULL);
 }
 
 
@@ -1361,17 +1671,7 @@ on_find_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
 				break;
 
 			case GEANY_RESPONSE_MARK:
-			{
-				gint count = search_mark_all(doc, search_data.text, search_data.flags);
-
-				if (count == 0)
-					ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), search_data.original_text);
-				else
-					ui_set_statusbar(FALSE,
-						ngettext("Found %d match for \"%s\".",
-								 "Found %d matches for \"%s\".", count),
-						count, search_data.original_text);
-			}
+				mark_all_start(doc, search_data.text, search_data.flags, search_data.original_text);
 			break;
 		}
 		if (check_close)
@@ -1410,6 +1710,7 @@ static void replace_in_session(GeanyDocument *doc,
 		GeanyDocument *tmp_doc = document_get_from_page(n);
 		gint reps = 0;
 
+		document_load_pending(tmp_doc);
 		reps = document_replace_all(tmp_doc, find, replace, original_find, original_replace, search_flags_re);
 		rep_count += reps;
 		if (reps)
@@ -1651,15 +1952,6 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 
 	if (EMPTY(utf8_search_text) || ! utf8_dir) return TRUE;
 
-	command_grep = g_find_program_in_path(tool_prefs.grep_cmd);
-	if (command_grep == NULL)
-		command_line = g_strdup_printf("%s %s --", tool_prefs.grep_cmd, opts);
-	else
-	{
-		command_line = g_strdup_printf("\"%s\" %s --", command_grep, opts);
-		g_free(command_grep);
-	}
-
 	/* convert the search text in the preferred encoding (if the text is not valid UTF-8. assume
 	 * it is already in the preferred encoding) */
 	utf8_text_len = strlen(utf8_search_text);
@@ -1670,6 +1962,24 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 	if (search_text == NULL)
 		search_text = g_strdup(utf8_search_text);
 
+	/* extra options are passed to grep, so they can't be used with the built-in search */
+	if (search_prefs.builtin_find_in_files &&
+		! (settings.fif_use_extra_options && *settings.fif_extra_options))
+	{
+		ret = fif_start_search(search_text, utf8_search_text, utf8_dir, enc);
+		g_free(search_text);
+		return ret;
+	}
+
+	command_grep = g_find_program_in_path(tool_prefs.grep_cmd);
+	if (command_grep == NULL)
+		command_line = g_strdup_printf("%s %s --", tool_prefs.grep_cmd, opts);
+	else
+	{
+		command_line = g_strdup_printf("\"%s\" %s --", command_grep, opts);
+		g_free(command_grep);
+	}
+
 	argv_prefix = g_new(gchar*, 3);
 	argv_prefix[0] = search_text;
 	dir = utils_get_locale_from_utf8(utf8_dir);
@@ -1695,7 +2005,8 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 		}
 	}
 
-	gtk_list_store_clear(msgwindow.store_msg);
+	fif_cancel_search();
+	msgwin_clear_tab(MSG_MESSAGE);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
 
 	/* we can pass 'enc' without strdup'ing it here because it's a global const string and
@@ -1846,7 +2157,6 @@ static void search_read_io_stderr(GString *string, GIOCondition condition, gpoin
 
 static void search_finished(GPid child_pid, gint status, gpointer user_data)
 {
-	const gchar *msg = _("Search failed.");
 	gint exit_status;
 
 	if (SPAWN_WIFEXITED(status))
@@ -1863,12 +2173,20 @@ static void search_finished(GPid child_pid, gint status, gpointer user_data)
 		exit_status = 1;
 	}
 
+	/* the first message is the command line */
+	search_report_finished(exit_status, msgwin_get_message_count(MSG_MESSAGE) - 1);
+}
+
+
+/* exit_status has the grep meaning: 0 for matches, 1 for no matches, anything else for errors */
+static void search_report_finished(gint exit_status, gint count)
+{
+	const gchar *msg = _("Search failed.");
+
 	switch (exit_status)
 	{
 		case 0:
 		{
-			gint count = gtk_tree_model_iter_n_children(
-				GTK_TREE_MODEL(msgwindow.store_msg), NULL) - 1;
 			gchar *text = ngettext(
 						"Search completed with %d match.",
 						"Search completed with %d matches.", count);
@@ -1890,101 +2208,1032 @@ static void search_finished(GPid child_pid, gint status, gpointer user_data)
 }
 
 
-static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags)
+/* Built-in Find in Files engine.
+ * One job of a thread pool walks the directories in sorted order and pushes a job for
+ * each file to search. Each file is mapped into memory and searched as a whole, the lines
+ * found are collected per file and passed to the main thread, which adds them to the
+ * message window in batches. The results are added in the order the files were found,
+ * so that they are the same for each search, however the threads are scheduled. */
+
+#define FIF_THREADS				4
+#define FIF_FLUSH_INTERVAL		100		/* ms */
+#define FIF_BINARY_CHECK_SIZE	8192	/* files with a NUL byte in this range are skipped */
+
+typedef struct FifResult
 {
-	GRegex *regex;
-	GError *error = NULL;
-	gint rflags = 0;
+	gint color;
+	gchar *text;
+}
+FifResult;
 
-	if (sflags & GEANY_FIND_MULTILINE)
-		rflags |= G_REGEX_MULTILINE;
-	if (~sflags & GEANY_FIND_MATCHCASE)
-		rflags |= G_REGEX_CASELESS;
-	if (sflags & (GEANY_FIND_WHOLEWORD | GEANY_FIND_WORDSTART))
-	{
-		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
-	}
+/* The results of a file, or of a directory that couldn't be read */
+typedef struct FifFile
+{
+	GPtrArray *results;
+	gboolean done;			/* whether no more results will be added */
+}
+FifFile;
 
-	regex = g_regex_new(str, rflags, 0, &error);
-	if (!regex)
-	{
-		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
-		g_error_free(error);
-	}
-	return regex;
+typedef struct FifJob
+{
+	gchar *path;			/* relative to the search directory, NULL for the directory walk */
+	FifFile *file;			/* where to add the results of the file */
+}
+FifJob;
+
+typedef struct FifSearch
+{
+	GThreadPool *pool;
+	gchar *dir;				/* locale encoded */
+	const gchar *enc;		/* NULL for UTF-8, otherwise a global charset string */
+	const gchar *decode_enc;	/* charset the files are converted from before searching, or NULL */
+	gchar *needle;			/* text for the literal search, NULL when using regexes */
+	gsize needle_len;
+	GRegex *regex;			/* regex for valid UTF-8 text */
+	GRegex *raw_regex;		/* regex for other text */
+	GSList *patterns;		/* GPatternSpecs for the file names to search */
+	SearchIndexQuery *index_query;	/* files to skip for a literal search, or NULL */
+	gboolean case_sensitive;
+	gboolean whole_word;
+	gboolean invert;
+	gboolean recursive;
+	gint pending;			/* number of queued and running jobs, atomic */
+	gint cancelled;			/* atomic */
+	gint matches;			/* atomic */
+	gint errors;			/* atomic */
+	GMutex lock;			/* protects files and their results */
+	GPtrArray *files;		/* FifFiles in the order the files were found */
+	guint next_file;		/* index of the first file whose results are not all shown */
+	guint source_id;
 }
+FifSearch;
 
+static FifSearch *current_fif_search = NULL;
+/* all searches not freed yet, including cancelled ones whose threads are still running */
+static GSList *fif_searches = NULL;
 
-/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
-static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+
+static void fif_result_free(gpointer data)
 {
-	const gint start = match->matches[nth].start;
-	const gint end = match->matches[nth].end;
-	return g_strndup(&text[start], end - start);
+	FifResult *result = data;
+
+	g_free(result->text);
+	g_free(result);
 }
 
 
-static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline, GeanyMatchInfo *match)
+static void fif_file_free(gpointer data)
 {
-	const gchar *text;
-	GMatchInfo *minfo;
-	guint document_length;
-	gint ret = -1;
-	gint offset = 0;
+	FifFile *file = data;
 
-	document_length = (guint)sci_get_length(sci);
-	if (document_length <= 0)
-		return -1; /* skip empty documents */
+	g_ptr_array_foreach(file->results, (GFunc) fif_result_free, NULL);
+	g_ptr_array_free(file->results, TRUE);
+	g_free(file);
+}
 
-	g_return_val_if_fail(pos <= document_length, -1);
 
-	if (multiline)
-	{
-		/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
-		text = (void*)SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
-		g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL);
-	}
-	else /* single-line mode, manually match against each line */
-	{
-		gint line = sci_get_line_from_position(sci, pos);
+/* Adds a place for the results of the next file, called from the directory walk */
+static FifFile *fif_add_file(FifSearch *search)
+{
+	FifFile *file = g_new0(FifFile, 1);
 
-		for (;;)
-		{
-			gint start = sci_get_position_from_line(sci, line);
-			gint end = sci_get_line_end_position(sci, line);
+	file->results = g_ptr_array_new();
+	g_mutex_lock(&search->lock);
+	g_ptr_array_add(search->files, file);
+	g_mutex_unlock(&search->lock);
+	return file;
+}
 
-			text = (void*)SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
-			if (g_regex_match_full(regex, text, end - start, pos - start, 0, &minfo, NULL))
-			{
-				offset = start;
-				break;
-			}
-			else /* not found, try next line */
-			{
-				line ++;
-				if (line >= sci_get_line_count(sci))
-					break;
-				pos = sci_get_position_from_line(sci, line);
-				/* don't free last info, it's freed below */
-				g_match_info_free(minfo);
-			}
-		}
-	}
 
-	/* Warning: minfo will become invalid when 'text' does! */
-	if (g_match_info_matches(minfo))
-	{
-		guint i;
+/* results can be NULL to only set done */
+static void fif_add_results(FifSearch *search, FifFile *file, GPtrArray *results, gboolean done)
+{
+	guint i;
+
+	g_mutex_lock(&search->lock);
+	for (i = 0; results != NULL && i < results->len; i++)
+		g_ptr_array_add(file->results, g_ptr_array_index(results, i));
+	if (done)
+		file->done = TRUE;
+	g_mutex_unlock(&search->lock);
+	if (results != NULL)
+		g_ptr_array_set_size(results, 0);
+}
 
-		/* copy whole match text and offsets before they become invalid */
-		SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
 
-		foreach_range(i, G_N_ELEMENTS(match->matches))
-		{
-			gint start = -1, end = -1;
+/* takes ownership of text */
+static void fif_add_error(FifSearch *search, FifFile *file, gchar *text)
+{
+	FifResult *result = g_new(FifResult, 1);
+
+	result->color = COLOR_DARK_RED;
+	result->text = text;
+	g_mutex_lock(&search->lock);
+	g_ptr_array_add(file->results, result);
+	g_mutex_unlock(&search->lock);
+	g_atomic_int_inc(&search->errors);
+}
 
-			g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
-			match->matches[i].start = offset + start;
+
+static void fif_push_job(FifSearch *search, gchar *path, FifFile *file)
+{
+	FifJob *job = g_new(FifJob, 1);
+
+	job->path = path;
+	job->file = file;
+	g_atomic_int_inc(&search->pending);
+	g_thread_pool_push(search->pool, job, NULL);
+}
+
+
+static gboolean fif_match_patterns(FifSearch *search, const gchar *name)
+{
+	return search->patterns == NULL || pattern_list_match(search->patterns, name);
+}
+
+
+static gint fif_compare_names(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+
+/* Pushes the jobs for the files in rel_dir and its subdirectories, in sorted order */
+static void fif_scan_dir(FifSearch *search, const gchar *rel_dir)
+{
+	GError *error = NULL;
+	const gchar *name;
+	gchar *locale_dir;
+	GPtrArray *names;
+	GDir *dir;
+	guint i;
+
+	locale_dir = EMPTY(rel_dir) ? g_strdup(search->dir) : g_build_filename(search->dir, rel_dir, NULL);
+	dir = g_dir_open(locale_dir, 0, &error);
+	if (dir == NULL)
+	{
+		FifFile *file = fif_add_file(search);
+
+		fif_add_error(search, file, g_strdup(error->message));
+		fif_add_results(search, file, NULL, TRUE);
+		g_error_free(error);
+		g_free(locale_dir);
+		return;
+	}
+
+	names = g_ptr_array_new_with_free_func(g_free);
+	while ((name = g_dir_read_name(dir)) != NULL)
+		g_ptr_array_add(names, g_strdup(name));
+	g_dir_close(dir);
+	g_ptr_array_sort(names, fif_compare_names);
+
+	for (i = 0; i < names->len && ! g_atomic_int_get(&search->cancelled); i++)
+	{
+		gchar *path, *rel;
+
+		name = g_ptr_array_index(names, i);
+		path = g_build_filename(locale_dir, name, NULL);
+		rel = EMPTY(rel_dir) ? g_strdup(name) : g_build_filename(rel_dir, name, NULL);
+		if (g_file_test(path, G_FILE_TEST_IS_DIR))
+		{
+			/* like grep -r, don't follow symlinks to directories to avoid loops */
+			if (search->recursive && ! g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+				fif_scan_dir(search, rel);
+			g_free(rel);
+		}
+		else if (g_file_test(path, G_FILE_TEST_IS_REGULAR) && fif_match_patterns(search, name))
+			fif_push_job(search, rel, fif_add_file(search));
+		else
+			g_free(rel);
+		g_free(path);
+	}
+	g_ptr_array_free(names, TRUE);
+	g_free(locale_dir);
+}
+
+
+static const gchar *fif_find_byte(const gchar *p, const gchar *last, gchar c)
+{
+	const gchar *found = NULL;
+
+	if (p <= last)
+		found = memchr(p, c, last - p + 1);
+	return found ? found : last + 1;
+}
+
+
+static gboolean fif_is_word_char(gchar c)
+{
+	/* treat non-ASCII bytes as letters, like grep does for UTF-8 text */
+	return g_ascii_isalnum(c) || c == '_' || (guchar) c >= 0x80;
+}
+
+
+/* Finds the needle between from and end, start is the beginning of the text and is
+ * only used for the whole word check.
+ * Candidates are located with memchr() on the first byte of the needle, which is much
+ * faster than comparing at each position. For case insensitive searches the needle is
+ * ASCII and both cases of the first byte are tracked. */
+static const gchar *fif_find_literal(FifSearch *search, const gchar *start,
+		const gchar *from, const gchar *end)
+{
+	const gchar *needle = search->needle;
+	const gsize len = search->needle_len;
+	const gchar *last, *next_lower, *next_upper;
+	gchar lower, upper;
+
+	if ((gsize) (end - from) < len)
+		return NULL;
+
+	last = end - len;
+	lower = search->case_sensitive ? needle[0] : g_ascii_tolower(needle[0]);
+	upper = search->case_sensitive ? needle[0] : g_ascii_toupper(needle[0]);
+	next_lower = fif_find_byte(from, last, lower);
+	next_upper = (upper == lower) ? last + 1 : fif_find_byte(from, last, upper);
+
+	while (TRUE)
+	{
+		const gchar *p = MIN(next_lower, next_upper);
+
+		if (p > last)
+			return NULL;
+
+		if ((search->case_sensitive ? memcmp(p, needle, len) :
+				g_ascii_strncasecmp(p, needle, len)) == 0 &&
+			(! search->whole_word ||
+				((p == start || ! fif_is_word_char(p[-1])) &&
+				 (p + len == end || ! fif_is_word_char(p[len])))))
+			return p;
+
+		if (p == next_lower)
+			next_lower = fif_find_byte(p + 1, last, lower);
+		else
+			next_upper = fif_find_byte(p + 1, last, upper);
+	}
+}
+
+
+static const gchar *fif_line_end(const gchar *line, const gchar *end)
+{
+	const gchar *line_end = memchr(line, '\n', end - line);
+
+	return line_end ? line_end : end;
+}
+
+
+static gboolean fif_line_matches(FifSearch *search, GRegex *regex,
+		const gchar *line, const gchar *line_end)
+{
+	if (regex == NULL)
+		return fif_find_literal(search, line, line, line_end) != NULL;
+
+	return g_regex_match_full(regex, line, line_end - line, 0, 0, NULL, NULL);
+}
+
+
+/* Returns the start of the next matching line at or after from, which must be
+ * the start of a line, or NULL. */
+static const gchar *fif_find_line(FifSearch *search, GRegex *regex,
+		const gchar *text, const gchar *from, const gchar *end)
+{
+	while (from < end)
+	{
+		const gchar *match, *line, *line_end;
+		gint match_end = 0;
+
+		if (regex == NULL)
+		{
+			/* the needle can't contain a newline, so the match is within a line */
+			match = fif_find_literal(search, text, from, end);
+			if (match == NULL)
+				return NULL;
+		}
+		else
+		{
+			GMatchInfo *info;
+			gint match_start;
+
+			/* search the rest of the text at once instead of each line separately */
+			if (! g_regex_match_full(regex, text, end - text, from - text, 0, &info, NULL))
+			{
+				g_match_info_free(info);
+				return NULL;
+			}
+			g_match_info_fetch_pos(info, 0, &match_start, &match_end);
+			g_match_info_free(info);
+			match = text + match_start;
+		}
+
+		line = match;
+		while (line > from && line[-1] != '\n')
+			line--;
+		line_end = fif_line_end(match, end);
+
+		/* a regex match spanning several lines has to be checked against the line alone */
+		if (regex == NULL || text + match_end <= line_end ||
+			fif_line_matches(search, regex, line, line_end))
+			return line;
+
+		from = line_end + 1;
+	}
+	return NULL;
+}
+
+
+static guint fif_count_lines(const gchar *from, const gchar *to)
+{
+	guint count = 0;
+
+	while ((from = memchr(from, '\n', to - from)) != NULL)
+	{
+		count++;
+		from++;
+	}
+	return count;
+}
+
+
+static void fif_add_line(FifSearch *search, GPtrArray *results, const gchar *rel,
+		guint line_num, const gchar *line, const gchar *line_end)
+{
+	FifResult *result = g_new(FifResult, 1);
+	gchar *text;
+
+	text = g_strdup_printf("%s:%u:%.*s", rel, line_num, (gint) (line_end - line), line);
+	/* enc is NULL when encoding is set to UTF-8, so we can skip any conversion */
+	if (search->enc != NULL && ! g_utf8_validate(text, -1, NULL))
+	{
+		gchar *utf8_text = g_convert(text, -1, "UTF-8", search->enc, NULL, NULL, NULL);
+
+		if (utf8_text != NULL)
+			SETPTR(text, utf8_text);
+	}
+	result->color = COLOR_BLACK;
+	result->text = g_strstrip(text);
+	g_ptr_array_add(results, result);
+}
+
+
+static void fif_search_text(FifSearch *search, FifFile *file, const gchar *rel,
+		const gchar *text, gsize len)
+{
+	GPtrArray *results = g_ptr_array_new();
+	GRegex *regex = search->regex;
+	const gchar *end = text + len;
+	const gchar *line = text;
+	guint line_num = 1;
+	gint matches = 0;
+
+	if (search->raw_regex != NULL &&
+		(regex == NULL || ! g_utf8_validate(text, (gssize) len, NULL)))
+		regex = search->raw_regex;
+
+	while (line < end && ! g_atomic_int_get(&search->cancelled))
+	{
+		const gchar *line_end;
+
+		if (search->invert)
+		{
+			line_end = fif_line_end(line, end);
+			if (! fif_line_matches(search, regex, line, line_end))
+			{
+				fif_add_line(search, results, rel, line_num, line, line_end);
+				matches++;
+			}
+		}
+		else
+		{
+			const gchar *match_line = fif_find_line(search, regex, text, line, end);
+
+			if (match_line == NULL)
+				break;
+			line_num += fif_count_lines(line, match_line);
+			line = match_line;
+			line_end = fif_line_end(line, end);
+			fif_add_line(search, results, rel, line_num, line, line_end);
+			matches++;
+		}
+		if (line_end == end)
+			break;
+		line = line_end + 1;
+		line_num++;
+
+		/* don't hold back the results of huge files until the end */
+		if (results->len >= 1000)
+			fif_add_results(search, file, results, FALSE);
+	}
+	fif_add_results(search, file, results, FALSE);
+	g_ptr_array_free(results, TRUE);
+	g_atomic_int_add(&search->matches, matches);
+}
+
+
+/* Searches text in search->decode_enc as UTF-8 */
+static void fif_search_decoded(FifSearch *search, FifFile *file, const gchar *rel,
+		const gchar *text, gsize len)
+{
+	GError *error = NULL;
+	gsize utf8_len;
+	gchar *utf8_text = g_convert(text, len, "UTF-8", search->decode_enc, NULL, &utf8_len, &error);
+
+	if (utf8_text == NULL)
+	{
+		fif_add_error(search, file, g_strdup_printf("%s: %s", rel, error->message));
+		g_error_free(error);
+		return;
+	}
+	fif_search_text(search, file, rel, utf8_text, utf8_len);
+	g_free(utf8_text);
+}
+
+
+static void fif_search_file(FifSearch *search, FifFile *file, const gchar *rel)
+{
+	gchar *path = g_build_filename(search->dir, rel, NULL);
+	GError *error = NULL;
+	GMappedFile *map;
+
+	if (search->index_query != NULL)
+	{
+		GStatBuf st;
+
+		if (g_stat(path, &st) == 0 &&
+			search_index_query_skip_file(search->index_query, rel, &st))
+		{
+			g_free(path);
+			return;
+		}
+	}
+
+	map = g_mapped_file_new(path, FALSE, &error);
+	if (map == NULL)
+	{
+		fif_add_error(search, file, g_strdup(error->message));
+		g_error_free(error);
+	}
+	else
+	{
+		const gchar *text = g_mapped_file_get_contents(map);
+		gsize len = g_mapped_file_get_length(map);
+
+		/* text in UTF-16 and the like is full of NUL bytes */
+		if (len > 0 && search->decode_enc != NULL)
+			fif_search_decoded(search, file, rel, text, len);
+		/* skip binary files, like grep -I */
+		else if (len > 0 && memchr(text, '\0', MIN(len, FIF_BINARY_CHECK_SIZE)) == NULL)
+			fif_search_text(search, file, rel, text, len);
+		g_mapped_file_unref(map);
+	}
+	g_free(path);
+}
+
+
+static void fif_thread_func(gpointer data, gpointer user_data)
+{
+	FifJob *job = data;
+	FifSearch *search = user_data;
+
+	if (! g_atomic_int_get(&search->cancelled))
+	{
+		if (job->path == NULL)
+			fif_scan_dir(search, "");
+		else
+			fif_search_file(search, job->file, job->path);
+	}
+	if (job->file != NULL)
+		fif_add_results(search, job->file, NULL, TRUE);
+	g_free(job->path);
+	g_free(job);
+	/* the results of this job have been added before, see fif_flush_results() */
+	g_atomic_int_add(&search->pending, -1);
+}
+
+
+static void fif_search_free(FifSearch *search)
+{
+	GSList *item;
+
+	foreach_slist(item, search->patterns)
+		g_pattern_spec_free(item->data);
+	g_slist_free(search->patterns);
+	if (search->regex != NULL)
+		g_regex_unref(search->regex);
+	if (search->raw_regex != NULL)
+		g_regex_unref(search->raw_regex);
+	if (search->index_query != NULL)
+		search_index_query_free(search->index_query);
+	g_ptr_array_free(search->files, TRUE);
+	g_mutex_clear(&search->lock);
+	g_free(search->needle);
+	g_free(search->dir);
+	g_free(search);
+}
+
+
+/* Takes the results that can be shown, in the order of their files */
+static GPtrArray *fif_take_results(FifSearch *search)
+{
+	GPtrArray *results = g_ptr_array_new_with_free_func(fif_result_free);
+
+	g_mutex_lock(&search->lock);
+	while (search->next_file < search->files->len)
+	{
+		FifFile *file = g_ptr_array_index(search->files, search->next_file);
+		guint i;
+
+		/* the results of a huge file can be shown before it's done */
+		for (i = 0; i < file->results->len; i++)
+			g_ptr_array_add(results, g_ptr_array_index(file->results, i));
+		g_ptr_array_set_size(file->results, 0);
+		if (! file->done)
+			break;
+		search->next_file++;
+	}
+	g_mutex_unlock(&search->lock);
+	return results;
+}
+
+
+static gboolean fif_flush_results(gpointer data)
+{
+	FifSearch *search = data;
+	/* check before taking the results, so that none added by the last jobs are missed */
+	gboolean done = g_atomic_int_get(&search->pending) == 0;
+	gboolean cancelled = g_atomic_int_get(&search->cancelled);
+	GPtrArray *results;
+	guint i;
+
+	results = fif_take_results(search);
+	for (i = 0; i < results->len && ! cancelled; i++)
+	{
+		FifResult *result = g_ptr_array_index(results, i);
+
+		msgwin_msg_add_string(result->color, -1, NULL, result->text);
+	}
+	g_ptr_array_free(results, TRUE);
+
+	if (! done)
+		return TRUE;
+
+	if (! cancelled)
+	{
+		gint matches = g_atomic_int_get(&search->matches);
+
+		search_report_finished(matches > 0 ? 0 : g_atomic_int_get(&search->errors) > 0 ? 2 : 1,
+			matches);
+		current_fif_search = NULL;
+	}
+	/* all jobs are done, this only waits for the threads to return */
+	g_thread_pool_free(search->pool, FALSE, TRUE);
+	fif_searches = g_slist_remove(fif_searches, search);
+	fif_search_free(search);
+	return FALSE;
+}
+
+
+/* the search is freed by fif_flush_results() once its running jobs have returned */
+static void fif_cancel_search(void)
+{
+	if (current_fif_search == NULL)
+		return;
+
+	g_atomic_int_set(&current_fif_search->cancelled, TRUE);
+	current_fif_search = NULL;
+	ui_progress_bar_stop();
+}
+
+
+/* Stops all searches right away, when quitting */
+static void fif_free_searches(void)
+{
+	fif_cancel_search();
+	while (fif_searches != NULL)
+	{
+		FifSearch *search = fif_searches->data;
+
+		g_atomic_int_set(&search->cancelled, TRUE);
+		g_source_remove(search->source_id);
+		/* the queued jobs are dropped, the running ones see the search is cancelled */
+		g_thread_pool_free(search->pool, TRUE, TRUE);
+		fif_searches = g_slist_delete_link(fif_searches, fif_searches);
+		fif_search_free(search);
+	}
+}
+
+
+static GSList *fif_get_patterns(void)
+{
+	GSList *patterns = NULL;
+
+	g_strstrip(settings.fif_files);
+	if (settings.fif_files_mode != FILES_MODE_ALL && *settings.fif_files)
+	{
+		gchar **names = g_strsplit(settings.fif_files, " ", -1);
+		gchar **name;
+
+		foreach_strv(name, names)
+		{
+			if (**name)
+				patterns = g_slist_prepend(patterns, g_pattern_spec_new(*name));
+		}
+		g_strfreev(names);
+	}
+	return patterns;
+}
+
+
+static gboolean fif_str_is_ascii(const gchar *str)
+{
+	for (; *str; str++)
+	{
+		if ((guchar) *str >= 0x80)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+static GRegex *fif_compile_regex(const gchar *pattern, gboolean raw)
+{
+	GError *error = NULL;
+	GRegex *regex;
+	gint rflags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+
+	if (! settings.fif_case_sensitive)
+		rflags |= G_REGEX_CASELESS;
+	if (raw)
+		rflags |= G_REGEX_RAW;
+
+	regex = g_regex_new(pattern, rflags, 0, &error);
+	if (regex == NULL)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+	}
+	return regex;
+}
+
+
+/* Checks whether text in enc can be split into lines and searched bytewise */
+static gboolean fif_enc_is_ascii_compatible(const gchar *enc)
+{
+	gsize len = 0;
+	gchar *newline = g_convert("\n", 1, enc, "UTF-8", NULL, &len, NULL);
+	gboolean ret = newline != NULL && len == 1 && newline[0] == '\n';
+
+	g_free(newline);
+	return ret;
+}
+
+
+/* search_text is in the encoding enc, or UTF-8 if enc is NULL */
+static gboolean fif_start_search(const gchar *search_text, const gchar *utf8_search_text,
+		const gchar *utf8_dir, const gchar *enc)
+{
+	FifSearch *search = g_new0(FifSearch, 1);
+	gchar *utf8_str;
+
+	/* text in encodings like UTF-16 is converted to UTF-8, and searched as such */
+	if (enc != NULL && ! fif_enc_is_ascii_compatible(enc))
+	{
+		search->decode_enc = enc;
+		search_text = utf8_search_text;
+		enc = NULL;
+	}
+	search->enc = enc;
+	search->case_sensitive = settings.fif_case_sensitive;
+	search->whole_word = settings.fif_match_whole_word;
+	search->invert = settings.fif_invert_results;
+	search->recursive = settings.fif_recursive;
+
+	/* the fast literal search compares bytes, so it can't ignore the case of non-ASCII text */
+	if (! settings.fif_regexp && (settings.fif_case_sensitive || fif_str_is_ascii(search_text)))
+	{
+		search->needle = g_strdup(search_text);
+		search->needle_len = strlen(search_text);
+	}
+	else
+	{
+		gchar *pattern = settings.fif_regexp ? g_strdup(search_text) :
+			g_regex_escape_string(search_text, -1);
+
+		if (settings.fif_match_whole_word)
+			SETPTR(pattern, g_strdup_printf("(?<!\\w)(?:%s)(?!\\w)", pattern));
+
+		/* text in other encodings can only be searched bytewise */
+		if (enc == NULL)
+			search->regex = fif_compile_regex(pattern, FALSE);
+		if (enc != NULL || search->regex != NULL)
+			search->raw_regex = fif_compile_regex(pattern, TRUE);
+		g_free(pattern);
+
+		if (search->raw_regex == NULL)
+		{
+			if (search->regex != NULL)
+				g_regex_unref(search->regex);
+			g_free(search);
+			return FALSE;
+		}
+	}
+
+	fif_cancel_search();
+
+	search->dir = utils_get_locale_from_utf8(utf8_dir);
+	search->patterns = fif_get_patterns();
+	/* the index only tells which files contain the text, which can't help inverted searches,
+	 * and it holds the bytes of the files, not the converted text */
+	if (search->needle != NULL && ! search->invert && search->decode_enc == NULL)
+		search->index_query = search_index_query_new(search->dir, search->needle, search->needle_len);
+	search->files = g_ptr_array_new_with_free_func(fif_file_free);
+	g_mutex_init(&search->lock);
+	search->pool = g_thread_pool_new(fif_thread_func, search, FIF_THREADS, FALSE, NULL);
+	current_fif_search = search;
+	fif_searches = g_slist_prepend(fif_searches, search);
+
+	msgwin_clear_tab(MSG_MESSAGE);
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+
+	ui_progress_bar_start(_("Searching..."));
+	msgwin_set_messages_dir(search->dir);
+	utf8_str = g_strdup_printf(_("Searching for \"%s\" (in directory: %s)"),
+		utf8_search_text, utf8_dir);
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, utf8_str);
+	g_free(utf8_str);
+
+	/* the directory walk */
+	fif_push_job(search, NULL, NULL);
+	search->source_id = g_timeout_add(FIF_FLUSH_INTERVAL, fif_flush_results, search);
+	return TRUE;
+}
+
+
+static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags)
+{
+	GRegex *regex;
+	GError *error = NULL;
+	gint rflags = 0;
+
+	if (sflags & GEANY_FIND_MULTILINE)
+		rflags |= G_REGEX_MULTILINE;
+	if (~sflags & GEANY_FIND_MATCHCASE)
+		rflags |= G_REGEX_CASELESS;
+	if (sflags & (GEANY_FIND_WHOLEWORD | GEANY_FIND_WORDSTART))
+	{
+		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
+	}
+
+	regex = g_regex_new(str, rflags, 0, &error);
+	if (!regex)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+	}
+	return regex;
+}
+
+
+/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
+static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+{
+	const gint start = match->matches[nth].start;
+	const gint end = match->matches[nth].end;
+	return g_strndup(&text[start], end - start);
+}
+
+
+/* Checks whether pattern finds the same matches when applied to many lines at once as when
+ * applied to each line separately, with ^ and $ matching at line boundaries. This is not the
+ * case for assertions looking past the subject's edges, nor for \K, which can move the match
+ * start back into a previous line, nor for inline verbs and options that change what ^ and $
+ * match, nor for atomic groups and possessive quantifiers, which can fail on a line where the
+ * backtracking line regex matches. Anything doubtful is reported as unsafe. */
+GEANY_EXPORT_SYMBOL
+gboolean search_regex_is_line_safe(const gchar *pattern)
+{
+	const gchar *p;
+
+	for (p = pattern; *p; p++)
+	{
+		if (*p == '\\')
+		{
+			p++;
+			if (*p == '\0')
+				break;
+			if (strchr("AzZGK", *p))
+				return FALSE;
+		}
+		else if (p[0] == '(' && p[1] == '*')
+			return FALSE;
+		/* possessive quantifiers */
+		else if (strchr("*+?}", p[0]) && p[1] == '+')
+			return FALSE;
+		else if (p[0] == '(' && p[1] == '?')
+		{
+			const gchar *q = p + 2;
+
+			/* lookahead, lookbehind and atomic groups */
+			if (*q == '=' || *q == '!' || *q == '>' ||
+				(*q == '<' && (q[1] == '=' || q[1] == '!')))
+				return FALSE;
+			/* option settings */
+			for (; *q && strchr("imsxXUJ-", *q); q++)
+			{
+				if (*q == 'm')
+					return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+
+/* Returns a regex to find the lines regex may match in, or NULL if there is none.
+ * It is cached, as it's needed for every search in single-line mode. */
+static GRegex *get_line_regex(GRegex *regex)
+{
+	const gchar *pattern = g_regex_get_pattern(regex);
+	gboolean caseless = (g_regex_get_compile_flags(regex) & G_REGEX_CASELESS) != 0;
+
+	if (line_regex_cache.pattern == NULL || line_regex_cache.caseless != caseless ||
+		! utils_str_equal(line_regex_cache.pattern, pattern))
+	{
+		if (line_regex_cache.regex != NULL)
+			g_regex_unref(line_regex_cache.regex);
+		line_regex_cache.regex = NULL;
+		SETPTR(line_regex_cache.pattern, g_strdup(pattern));
+		line_regex_cache.caseless = caseless;
+
+		if (search_regex_is_line_safe(pattern))
+		{
+			/* (*ANYCRLF) makes ^ and $ match at any line ending Scintilla knows about */
+			gchar *line_pattern = g_strconcat("(*ANYCRLF)", pattern, NULL);
+
+			line_regex_cache.regex = g_regex_new(line_pattern,
+				G_REGEX_MULTILINE | G_REGEX_OPTIMIZE | (caseless ? G_REGEX_CASELESS : 0),
+				0, NULL);
+			g_free(line_pattern);
+		}
+	}
+	return line_regex_cache.regex;
+}
+
+
+/* Finds the first line at or after pos's line which line_regex matches in, or -1.
+ * The text is searched in chunks ending at line boundaries, so the gap in Scintilla's buffer
+ * only needs to move within a single line rather than to the end of the document. */
+static gint find_regex_line(ScintillaObject *sci, GRegex *line_regex, gint pos)
+{
+	gint length = sci_get_length(sci);
+	gint line_count = sci_get_line_count(sci);
+	gint start = sci_get_position_from_line(sci, sci_get_line_from_position(sci, pos));
+
+	while (start < length)
+	{
+		GMatchInfo *minfo;
+		const gchar *text;
+		gint end, gap, line;
+		gint match_start = -1;
+
+		line = sci_get_line_from_position(sci, MIN(start + REGEX_CHUNK_SIZE, length));
+		end = (line + 1 < line_count) ? sci_get_position_from_line(sci, line + 1) : length;
+
+		gap = (gint) SSM(sci, SCI_GETGAPPOSITION, 0, 0);
+		if (gap > start && gap < end)
+		{
+			gint gap_line_start = sci_get_position_from_line(sci, sci_get_line_from_position(sci, gap));
+
+			if (gap_line_start > start)
+				end = gap_line_start;
+		}
+
+		text = (void*)SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
+		if (g_regex_match_full(line_regex, text, end - start, pos - start, 0, &minfo, NULL))
+			g_match_info_fetch_pos(minfo, 0, &match_start, NULL);
+		g_match_info_free(minfo);
+
+		if (match_start != -1)
+			return sci_get_line_from_position(sci, start + match_start);
+		start = pos = end;
+	}
+	return -1;
+}
+
+
+static gboolean release_text_copy(gpointer data)
+{
+	GeanyDocument *doc = document_find_by_id(text_copy.doc_id);
+
+	if (doc != NULL)
+		SSM(doc->editor->sci, SCI_RELEASECHARACTERPOINTER, 0, 0);
+	text_copy.doc_id = 0;
+	text_copy.source_id = 0;
+	return FALSE;
+}
+
+
+/* SCI_GETCHARACTERPOINTER copies chunked text whole. The copy is kept for the searches
+ * following soon, e.g. while marking or replacing all matches, but not for longer, so
+ * that a huge document doesn't take twice the memory. */
+static void hold_text_copy(ScintillaObject *sci)
+{
+	GeanyDocument *doc;
+
+	if (! (SSM(sci, SCI_GETDOCUMENTOPTIONS, 0, 0) & SC_DOCUMENTOPTION_TEXT_CHUNKED))
+		return;
+
+	doc = document_find_by_sci(sci);
+	if (doc == NULL)
+		return;
+
+	if (text_copy.source_id != 0)
+	{
+		g_source_remove(text_copy.source_id);
+		/* only one copy is held at a time */
+		if (text_copy.doc_id != doc->id)
+			release_text_copy(NULL);
+	}
+	text_copy.doc_id = doc->id;
+	text_copy.source_id = g_timeout_add_seconds(TEXT_COPY_HOLD_TIME, release_text_copy, NULL);
+}
+
+
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean multiline, GeanyMatchInfo *match)
+{
+	const gchar *text;
+	GMatchInfo *minfo = NULL;
+	guint document_length;
+	gint ret = -1;
+	gint offset = 0;
+
+	document_length = (guint)sci_get_length(sci);
+	if (document_length <= 0)
+		return -1; /* skip empty documents */
+
+	g_return_val_if_fail(pos <= document_length, -1);
+
+	if (multiline)
+	{
+		/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
+		text = (void*)SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+		g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL);
+		hold_text_copy(sci);
+	}
+	else /* single-line mode, manually match against each line */
+	{
+		GRegex *line_regex = get_line_regex(regex);
+		gint line_count = sci_get_line_count(sci);
+		gint line = sci_get_line_from_position(sci, pos);
+
+		while (line < line_count)
+		{
+			gint start, end;
+
+			if (line_regex != NULL)
+			{
+				/* skip all lines the regex can't match in at once */
+				gint next = find_regex_line(sci, line_regex, (gint) pos);
+
+				if (next == -1)
+					break;
+				if (next > line)
+				{
+					line = next;
+					pos = sci_get_position_from_line(sci, line);
+				}
+			}
+
+			start = sci_get_position_from_line(sci, line);
+			end = sci_get_line_end_position(sci, line);
+
+			text = (void*)SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
+			if (g_regex_match_full(regex, text, end - start, pos - start, 0, &minfo, NULL))
+			{
+				offset = start;
+				break;
+			}
+			g_match_info_free(minfo);
+			minfo = NULL;
+			/* not found, try next line */
+			line ++;
+			if (line < line_count)
+				pos = sci_get_position_from_line(sci, line);
+		}
+	}
+
+	/* Warning: minfo will become invalid when 'text' does! */
+	if (minfo != NULL && g_match_info_matches(minfo))
+	{
+		guint i;
+
+		/* copy whole match text and offsets before they become invalid */
+		SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
+
+		foreach_range(i, G_N_ELEMENTS(match->matches))
+		{
+			gint start = -1, end = -1;
+
+			g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
+			match->matches[i].start = offset + start;
 			match->matches[i].end = offset + end;
 		}
 		match->start = match->matches[0].start;
@@ -2059,17 +3308,14 @@ gint search_find_next(ScintillaObject *sci, const gchar *str, GeanyFindFlags fla
 }
 
 
-gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+/* Gets the text replacing match, with the back references of a regex expanded */
+static gchar *get_match_replacement(const GeanyMatchInfo *match, const gchar *replace_text)
 {
 	GString *str;
-	gint ret = 0;
 	gint i = 0;
 
-	sci_set_target_start(sci, match->start);
-	sci_set_target_end(sci, match->end);
-
 	if (! (match->flags & GEANY_FIND_REGEXP))
-		return sci_replace_target(sci, replace_text, FALSE);
+		return g_strdup(replace_text);
 
 	str = g_string_new(replace_text);
 	while (str->str[i])
@@ -2099,8 +3345,24 @@ gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, con
 		i += strlen(grp);
 		g_free(grp);
 	}
-	ret = sci_replace_target(sci, str->str, FALSE);
-	g_string_free(str, TRUE);
+	return g_string_free(str, FALSE);
+}
+
+
+gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+{
+	gchar *text;
+	gint ret;
+
+	sci_set_target_start(sci, match->start);
+	sci_set_target_end(sci, match->end);
+
+	if (! (match->flags & GEANY_FIND_REGEXP))
+		return sci_replace_target(sci, replace_text, FALSE);
+
+	text = get_match_replacement(match, replace_text);
+	ret = sci_replace_target(sci, text, FALSE);
+	g_free(text);
 	return ret;
 }
 
@@ -2200,7 +3462,7 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 	}
 
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
-	gtk_list_store_clear(msgwindow.store_msg);
+	msgwin_clear_tab(MSG_MESSAGE);
 
 	if (! in_session)
 	{	/* use current document */
@@ -2213,6 +3475,7 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 		{
 			if (documents[i]->is_valid)
 			{
+				document_load_pending(documents[i]);
 				count += find_document_usage(documents[i], search_text, flags);
 			}
 		}
@@ -2235,14 +3498,111 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 }
 
 
+/* the matches are replaced one by one when the text between them is larger than this
+ * and than REPLACE_RANGE_SPARSE_FACTOR times the matched text */
+#define REPLACE_RANGE_MIN_UNCHANGED		(64 * 1024)
+#define REPLACE_RANGE_SPARSE_FACTOR		4
+
+/* Markers of a line in a range being replaced */
+typedef struct
+{
+	gint pos;	/* start of the line, updated to the position after replacing */
+	gint mask;
+}
+LineMarkers;
+
+
+/* Replaces the matches one by one, like search_replace_range(), and frees them */
+static guint replace_matches_each(ScintillaObject *sci, struct Sci_TextToFind *ttf,
+		GSList *matches, const gchar *replace_text)
+{
+	gint count = 0;
+	gint offset = 0; /* difference between search pos and replace pos */
+	GSList *match;
+
+	foreach_slist (match, matches)
+	{
+		GeanyMatchInfo *info = match->data;
+		gint replace_len;
+
+		info->start += offset;
+		info->end += offset;
+
+		replace_len = search_replace_match(sci, info, replace_text);
+		offset += replace_len - (info->end - info->start);
+		count ++;
+
+		/* on last match, update the last match/new range end */
+		if (! match->next)
+		{
+			ttf->chrg.cpMin = info->start;
+			ttf->chrg.cpMax += offset;
+		}
+
+		geany_match_info_free(info);
+	}
+	g_slist_free(matches);
+
+	return count;
+}
+
+
+/* Whether replacing the text from start to end at once would lose data Scintilla keeps for
+ * the text between the matches, and which isn't set again by the lexer like fold levels and
+ * line states are: folded lines, annotations, margin texts and indicators.
+ * Markers are set again by search_replace_range() itself. */
+static gboolean range_has_editor_data(ScintillaObject *sci, gint start, gint end)
+{
+	gint start_line = sci_get_line_from_position(sci, start);
+	gint end_line = sci_get_line_from_position(sci, end);
+	gint line, indic;
+
+	line = (gint) SSM(sci, SCI_CONTRACTEDFOLDNEXT, (uptr_t) start_line, 0);
+	if (line != -1 && line <= end_line)
+		return TRUE;
+
+	for (indic = 0; indic <= INDIC_MAX; indic++)
+	{
+		gint run_end = (gint) SSM(sci, SCI_INDICATOREND, (uptr_t) indic, start);
+
+		/* the end is 0 if the indicator was never used */
+		if (SSM(sci, SCI_INDICATORVALUEAT, (uptr_t) indic, start) != 0 ||
+			(run_end > start && run_end < end))
+			return TRUE;
+	}
+
+	/* the first line keeps its own */
+	for (line = start_line + 1; line <= end_line; line++)
+	{
+		if (SSM(sci, SCI_ANNOTATIONGETTEXT, (uptr_t) line, 0) > 0 ||
+			SSM(sci, SCI_MARGINGETTEXT, (uptr_t) line, 0) > 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
 /* ttf is updated to include the last match position (ttf->chrg.cpMin) and
  * the new search range end (ttf->chrg.cpMax).
+ * Dense matches are replaced at once, by building the text from the first to the last
+ * match and replacing it with a single modification, which is much faster than replacing
+ * each match for many matches. Sparse matches are replaced one by one, so that the text
+ * between them isn't copied nor stored in the undo history, and so are matches around text
+ * with data that would be lost, see range_has_editor_data().
  * Note: Normally you would call sci_start/end_undo_action() around this call. */
 guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		GeanyFindFlags flags, const gchar *replace_text)
 {
 	gint count = 0;
 	gint offset = 0; /* difference between search pos and replace pos */
+	gint start, end, pos;
+	gint matched_len = 0;
+	gint start_line, line;
+	gint start_line_mask;
+	const gchar *text;
+	GString *str;
+	GArray *markers;
+	guint marker_idx = 0;
 	GSList *match, *matches;
 
 	g_return_val_if_fail(sci != NULL && ttf->lpstrText != NULL && replace_text != NULL, 0);
@@ -2250,28 +3610,101 @@ guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		return 0;
 
 	matches = find_range(sci, flags, ttf);
+	if (matches == NULL)
+		return 0;
+
+	start = ((GeanyMatchInfo *) matches->data)->start;
+	end = ((GeanyMatchInfo *) g_slist_last(matches)->data)->end;
+
 	foreach_slist (match, matches)
 	{
 		GeanyMatchInfo *info = match->data;
-		gint replace_len;
 
-		info->start += offset;
-		info->end += offset;
+		matched_len += info->end - info->start;
+	}
+	if ((end - start - matched_len > REPLACE_RANGE_MIN_UNCHANGED &&
+		end - start - matched_len > matched_len * REPLACE_RANGE_SPARSE_FACTOR) ||
+		range_has_editor_data(sci, start, end))
+	{
+		return replace_matches_each(sci, ttf, matches, replace_text);
+	}
 
-		replace_len = search_replace_match(sci, info, replace_text);
-		offset += replace_len - (info->end - info->start);
+	/* Scintilla would merge the markers of the replaced lines into the first one,
+	 * so remember them to set them again on the lines they move to */
+	markers = g_array_new(FALSE, FALSE, sizeof(LineMarkers));
+	start_line = sci_get_line_from_position(sci, start);
+	start_line_mask = (gint) SSM(sci, SCI_MARKERGET, (uptr_t) start_line, 0);
+	line = start_line;
+	while ((line = sci_marker_next(sci, line + 1, ~SC_MASK_FOLDERS, FALSE)) != -1)
+	{
+		LineMarkers lm;
+
+		lm.pos = sci_get_position_from_line(sci, line);
+		if (lm.pos > end)
+			break;
+		lm.mask = (gint) SSM(sci, SCI_MARKERGET, (uptr_t) line, 0) & ~SC_MASK_FOLDERS;
+		g_array_append_val(markers, lm);
+	}
+
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETRANGEPOINTER */
+	text = (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, start, end - start);
+	str = g_string_sized_new(end - start);
+	pos = start;
+	foreach_slist (match, matches)
+	{
+		GeanyMatchInfo *info = match->data;
+		gchar *replacement = get_match_replacement(info, replace_text);
+		gint replace_len = (gint) strlen(replacement);
+
+		g_string_append_len(str, text + (pos - start), info->start - pos);
+
+		/* move the markers of the lines up to the end of this match */
+		for (; marker_idx < markers->len; marker_idx++)
+		{
+			LineMarkers *lm = &g_array_index(markers, LineMarkers, marker_idx);
+
+			if (lm->pos >= info->end)
+				break;
+			lm->pos = MIN(lm->pos, info->start) + offset;
+		}
+
+		g_string_append_len(str, replacement, replace_len);
+		pos = info->end;
 		count ++;
 
 		/* on last match, update the last match/new range end */
 		if (! match->next)
-		{
-			ttf->chrg.cpMin = info->start;
-			ttf->chrg.cpMax += offset;
-		}
+			ttf->chrg.cpMin = info->start + offset;
+		offset += replace_len - (info->end - info->start);
 
+		g_free(replacement);
 		geany_match_info_free(info);
 	}
 	g_slist_free(matches);
+	for (; marker_idx < markers->len; marker_idx++)
+		g_array_index(markers, LineMarkers, marker_idx).pos += offset;
+	ttf->chrg.cpMax += offset;
+
+	sci_set_target_start(sci, start);
+	sci_set_target_end(sci, end);
+	SSM(sci, SCI_REPLACETARGET, str->len, (sptr_t) str->str);
+	g_string_free(str, TRUE);
+
+	if (markers->len > 0)
+	{
+		guint i;
+
+		SSM(sci, SCI_MARKERDELETE, (uptr_t) start_line, -1);
+		SSM(sci, SCI_MARKERADDSET, (uptr_t) start_line, start_line_mask);
+		for (i = 0; i < markers->len; i++)
+		{
+			LineMarkers *lm = &g_array_index(markers, LineMarkers, i);
+
+			line = sci_get_line_from_position(sci, lm->pos);
+			SSM(sci, SCI_MARKERADDSET, (uptr_t) line, lm->mask);
+		}
+	}
+	g_array_free(markers, TRUE);
 
 	return count;
 }
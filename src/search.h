@@ -61,6 +61,9 @@ typedef struct GeanySearchPrefs
 	gboolean	hide_find_dialog;		/* hide the find dialog on next or previous */
 	gboolean	replace_and_find_by_default;	/* enter in replace window performs Replace & Find instead of Replace */
 	GeanyFindSelOptions find_selection_type;
+	gboolean	builtin_find_in_files;	/* search in-process instead of spawning grep */
+	gboolean	use_search_index;		/* keep a trigram index of the project files */
+	gint		search_index_max_size;	/* in MiB */
 }
 GeanySearchPrefs;
 
@@ -132,13 +135,19 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 
 void search_find_selection(struct GeanyDocument *doc, gboolean search_backwards);
 
-gint search_mark_all(struct GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags);
+void search_mark_all(struct GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags);
+
+void search_mark_all_cancel(struct GeanyDocument *doc);
+
+void search_mark_all_text_changed(struct GeanyDocument *doc);
 
 gint search_replace_match(struct _ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text);
 
 guint search_replace_range(struct _ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		GeanyFindFlags flags, const gchar *replace_text);
 
+gboolean search_regex_is_line_safe(const gchar *pattern);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
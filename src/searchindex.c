@@ -0,0 +1,916 @@
+/*
+ *      searchindex.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2026 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Trigram index of the project files, to speed up Find in Files.
+ *
+ * The index maps each trigram (three consecutive bytes of a line, with ASCII letters
+ * lowercased) found in the files below the project base path to the files containing
+ * it. A literal search then only has to read the files containing all trigrams of the
+ * search text. Files which changed since they were indexed are always read, so the
+ * index never hides matches, it only saves reading files which can't match.
+ *
+ * The index is built in a background thread when a project is opened and is saved in
+ * the configuration directory, so that later only the changed files are read again.
+ * It is refreshed after saving a project file. Files modified since a refresh started
+ * are left unindexed, as they might have changed again within the same modification time.
+ *
+ * An index file starts with INDEX_HEADER, followed by native byte order data:
+ *   the base path, the number of files, for each file its path, modification time in
+ *   microseconds, size and indexed flag, the number of trigrams, and for each trigram its
+ *   value, the number of files and their ids.
+ * Strings are written as their length followed by the bytes.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "searchindex.h"
+
+#include "app.h"
+#include "document.h"
+#include "geany.h"
+#include "geanyobject.h"
+#include "project.h"
+#include "search.h"
+#include "support.h"
+#include "ui_utils.h"
+#include "utils.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+
+#define INDEX_HEADER "GEANY_SEARCH_INDEX 2\n"
+/* files with a NUL byte in this range are not searched, see search.c */
+#define INDEX_BINARY_CHECK_SIZE 8192
+/* delay before refreshing the index after a project file was saved, in milliseconds */
+#define INDEX_REFRESH_DELAY 2000
+#define INDEX_MAX_QUERY_TRIGRAMS 32
+#define INDEX_MAX_PATH_LENGTH 65536
+#define TRIGRAM_COUNT (1 << 24)
+/* rough memory overhead of a hash table entry with its GArray */
+#define TRIGRAM_OVERHEAD 48
+
+
+typedef struct
+{
+	gchar		*path;		/* locale path relative to the base path */
+	gint64		 mtime;		/* in microseconds */
+	gint64		 size;
+	gboolean	 indexed;	/* FALSE if the file couldn't be read or exceeded the size limit */
+}
+IndexFile;
+
+typedef struct
+{
+	gint		 ref_count;		/* atomic */
+	gchar		*base_path;		/* locale encoded real path */
+	GPtrArray	*files;			/* IndexFile */
+	GHashTable	*file_ids;		/* path -> file id + 1 */
+	GHashTable	*trigrams;		/* trigram -> GArray of guint32 file ids */
+	gsize		 size;			/* approximate memory use */
+}
+SearchIndex;
+
+struct SearchIndexQuery
+{
+	SearchIndex	*index;
+	gchar		*prefix;		/* search directory relative to the base path */
+	guint8		*counts;		/* number of query trigrams found in each file */
+	guint		 n_trigrams;
+};
+
+typedef struct
+{
+	GThread		*thread;
+	SearchIndex	*old_index;		/* index to update, NULL to load or build one */
+	gboolean	 load;			/* whether to load the saved index when there is no old_index */
+	gboolean	 verbose;		/* whether to tell when the index is ready */
+	gchar		*base_path;
+	gchar		*cache_file;
+	gsize		 max_size;
+	gint64		 start_time;	/* real time when the refresh started, in microseconds */
+	gint		 cancelled;		/* atomic */
+	SearchIndex	*result;
+}
+IndexRefresh;
+
+
+static SearchIndex *current_index = NULL;
+static IndexRefresh *current_refresh = NULL;
+static gboolean refresh_again = FALSE;
+static guint refresh_source = 0;
+
+
+/* Gets the modification time of st in microseconds, as precise as the platform allows */
+static gint64 get_stat_mtime(const GStatBuf *st)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	return (gint64) st->st_mtim.tv_sec * G_USEC_PER_SEC + st->st_mtim.tv_nsec / 1000;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	return (gint64) st->st_mtimespec.tv_sec * G_USEC_PER_SEC + st->st_mtimespec.tv_nsec / 1000;
+#else
+	return (gint64) st->st_mtime * G_USEC_PER_SEC;
+#endif
+}
+
+
+static void index_file_free(gpointer data)
+{
+	IndexFile *file = data;
+
+	g_free(file->path);
+	g_free(file);
+}
+
+
+static SearchIndex *index_new(const gchar *base_path)
+{
+	SearchIndex *index = g_new0(SearchIndex, 1);
+
+	index->ref_count = 1;
+	index->base_path = g_strdup(base_path);
+	index->files = g_ptr_array_new_with_free_func(index_file_free);
+	/* the keys are owned by the files */
+	index->file_ids = g_hash_table_new(g_str_hash, g_str_equal);
+	index->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		(GDestroyNotify) g_array_unref);
+	return index;
+}
+
+
+static SearchIndex *index_ref(SearchIndex *index)
+{
+	g_atomic_int_inc(&index->ref_count);
+	return index;
+}
+
+
+static void index_unref(SearchIndex *index)
+{
+	if (! g_atomic_int_dec_and_test(&index->ref_count))
+		return;
+
+	g_hash_table_destroy(index->trigrams);
+	g_hash_table_destroy(index->file_ids);
+	g_ptr_array_free(index->files, TRUE);
+	g_free(index->base_path);
+	g_free(index);
+}
+
+
+/* takes ownership of path */
+static guint32 index_add_file(SearchIndex *index, gchar *path, gint64 mtime, gint64 size)
+{
+	IndexFile *file = g_new(IndexFile, 1);
+	guint32 id = index->files->len;
+
+	file->path = path;
+	file->mtime = mtime;
+	file->size = size;
+	file->indexed = FALSE;
+	g_ptr_array_add(index->files, file);
+	g_hash_table_insert(index->file_ids, file->path, GUINT_TO_POINTER(id + 1));
+	index->size += sizeof(IndexFile) + strlen(path) + 1 + TRIGRAM_OVERHEAD;
+	return id;
+}
+
+
+static void index_add_posting(SearchIndex *index, guint32 trigram, guint32 id)
+{
+	GArray *ids = g_hash_table_lookup(index->trigrams, GUINT_TO_POINTER(trigram));
+
+	if (ids == NULL)
+	{
+		ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+		g_hash_table_insert(index->trigrams, GUINT_TO_POINTER(trigram), ids);
+		index->size += TRIGRAM_OVERHEAD;
+	}
+	g_array_append_val(ids, id);
+	index->size += sizeof(guint32);
+}
+
+
+/* Adds the trigrams of a file. seen is a bitmap of TRIGRAM_COUNT bits which must be
+ * cleared, found is used to collect the distinct trigrams. */
+static void index_read_file(SearchIndex *index, guint32 id, guint8 *seen, GArray *found)
+{
+	IndexFile *file = g_ptr_array_index(index->files, id);
+	gchar *path = g_build_filename(index->base_path, file->path, NULL);
+	GMappedFile *map = g_mapped_file_new(path, FALSE, NULL);
+	const guchar *text;
+	gsize len, i;
+
+	g_free(path);
+	if (map == NULL)
+		return;
+
+	text = (const guchar *) g_mapped_file_get_contents(map);
+	len = g_mapped_file_get_length(map);
+	file->indexed = TRUE;
+
+	/* binary files are indexed without trigrams, as they are never searched */
+	if (len > 0 && memchr(text, '\0', MIN(len, INDEX_BINARY_CHECK_SIZE)) == NULL)
+	{
+		guint32 trigram = 0;
+		guint valid = 0;
+
+		for (i = 0; i < len; i++)
+		{
+			guchar c = text[i];
+
+			/* search texts are single lines */
+			if (c == '\n' || c == '\r' || c == '\0')
+			{
+				valid = 0;
+				continue;
+			}
+			trigram = ((trigram << 8) | (guchar) g_ascii_tolower(c)) & (TRIGRAM_COUNT - 1);
+			if (++valid >= 3 && ! (seen[trigram >> 3] & (1 << (trigram & 7))))
+			{
+				seen[trigram >> 3] |= 1 << (trigram & 7);
+				g_array_append_val(found, trigram);
+			}
+		}
+		for (i = 0; i < found->len; i++)
+		{
+			trigram = g_array_index(found, guint32, i);
+			seen[trigram >> 3] &= ~(1 << (trigram & 7));
+			index_add_posting(index, trigram, id);
+		}
+		g_array_set_size(found, 0);
+	}
+	g_mapped_file_unref(map);
+}
+
+
+/* Adds the files below rel_dir. Files unchanged since the old index are mapped in
+ * old_ids to their new id, the ids of the other files are added to changed. */
+static void index_walk(IndexRefresh *refresh, SearchIndex *index, const gchar *rel_dir,
+		SearchIndex *old, GArray *old_ids, GArray *changed)
+{
+	const gchar *name;
+	gchar *dir_path;
+	GDir *dir;
+
+	dir_path = EMPTY(rel_dir) ? g_strdup(index->base_path) :
+		g_build_filename(index->base_path, rel_dir, NULL);
+	dir = g_dir_open(dir_path, 0, NULL);
+	if (dir == NULL)
+	{
+		g_free(dir_path);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL && ! g_atomic_int_get(&refresh->cancelled))
+	{
+		gchar *path = g_build_filename(dir_path, name, NULL);
+		gchar *rel = EMPTY(rel_dir) ? g_strdup(name) : g_build_filename(rel_dir, name, NULL);
+		GStatBuf st;
+		gboolean exists = g_stat(path, &st) == 0;
+
+		if (exists && S_ISDIR(st.st_mode))
+		{
+			/* like Find in Files, don't follow symlinks to directories */
+			if (! g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+				index_walk(refresh, index, rel, old, old_ids, changed);
+		}
+		else if (exists && S_ISREG(st.st_mode))
+		{
+			gint64 mtime = get_stat_mtime(&st);
+			gpointer old_id = old ? g_hash_table_lookup(old->file_ids, rel) : NULL;
+			guint32 id = index_add_file(index, rel, mtime, st.st_size);
+			IndexFile *old_file = old_id ?
+				g_ptr_array_index(old->files, GPOINTER_TO_UINT(old_id) - 1) : NULL;
+
+			rel = NULL;
+			/* a file modified since the refresh started may change again without its
+			 * modification time changing, so it is left unindexed until the next refresh */
+			if (old_file != NULL && old_file->indexed && mtime < refresh->start_time &&
+				old_file->mtime == mtime && old_file->size == st.st_size)
+			{
+				g_array_index(old_ids, guint32, GPOINTER_TO_UINT(old_id) - 1) = id;
+				((IndexFile *) g_ptr_array_index(index->files, id))->indexed = TRUE;
+			}
+			else if (mtime < refresh->start_time)
+				g_array_append_val(changed, id);
+		}
+		g_free(rel);
+		g_free(path);
+	}
+	g_dir_close(dir);
+	g_free(dir_path);
+}
+
+
+/* Builds a new index, taking the trigrams of unchanged files from old. */
+static SearchIndex *index_update(IndexRefresh *refresh, SearchIndex *old)
+{
+	SearchIndex *index = index_new(refresh->base_path);
+	GArray *changed = g_array_new(FALSE, FALSE, sizeof(guint32));
+	GArray *old_ids = NULL;		/* old file id -> new file id */
+	guint i;
+
+	if (old != NULL)
+	{
+		old_ids = g_array_sized_new(FALSE, FALSE, sizeof(guint32), old->files->len);
+		g_array_set_size(old_ids, old->files->len);
+		for (i = 0; i < old_ids->len; i++)
+			g_array_index(old_ids, guint32, i) = G_MAXUINT32;
+	}
+
+	index_walk(refresh, index, "", old, old_ids, changed);
+
+	if (old != NULL)
+	{
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, old->trigrams);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+		{
+			GArray *old_list = value;
+			GArray *ids = NULL;
+
+			for (i = 0; i < old_list->len; i++)
+			{
+				guint32 id = g_array_index(old_ids, guint32, g_array_index(old_list, guint32, i));
+
+				if (id == G_MAXUINT32)
+					continue;
+				if (ids == NULL)
+					ids = g_array_sized_new(FALSE, FALSE, sizeof(guint32), old_list->len);
+				g_array_append_val(ids, id);
+			}
+			if (ids != NULL)
+			{
+				g_hash_table_insert(index->trigrams, key, ids);
+				index->size += TRIGRAM_OVERHEAD + ids->len * sizeof(guint32);
+			}
+		}
+		g_array_free(old_ids, TRUE);
+	}
+
+	if (changed->len > 0)
+	{
+		guint8 *seen = g_malloc0(TRIGRAM_COUNT / 8);
+		GArray *found = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+		/* files left over by the size limit stay unindexed and are always searched */
+		for (i = 0; i < changed->len && index->size < refresh->max_size &&
+			! g_atomic_int_get(&refresh->cancelled); i++)
+		{
+			index_read_file(index, g_array_index(changed, guint32, i), seen, found);
+		}
+		g_array_free(found, TRUE);
+		g_free(seen);
+	}
+	g_array_free(changed, TRUE);
+	return index;
+}
+
+
+static gboolean write_data(FILE *fp, gconstpointer data, gsize size)
+{
+	return fwrite(data, 1, size, fp) == size;
+}
+
+
+static gboolean write_uint32(FILE *fp, guint32 value)
+{
+	return write_data(fp, &value, sizeof value);
+}
+
+
+static gboolean write_string(FILE *fp, const gchar *str)
+{
+	gsize len = strlen(str);
+
+	return write_uint32(fp, len) && write_data(fp, str, len);
+}
+
+
+static void index_save(SearchIndex *index, const gchar *filename)
+{
+	/* another refresh might still be writing the same index */
+	gchar *tmp_filename = g_strdup_printf("%s.%08x", filename, g_random_int());
+	gchar *dir = g_path_get_dirname(filename);
+	GHashTableIter iter;
+	gpointer key, value;
+	gboolean ok;
+	FILE *fp;
+	guint i;
+
+	utils_mkdir(dir, TRUE);
+	g_free(dir);
+
+	fp = g_fopen(tmp_filename, "wb");
+	if (fp == NULL)
+	{
+		geany_debug("Could not write search index %s", tmp_filename);
+		g_free(tmp_filename);
+		return;
+	}
+
+	ok = write_data(fp, INDEX_HEADER, strlen(INDEX_HEADER)) &&
+		write_string(fp, index->base_path) &&
+		write_uint32(fp, index->files->len);
+	for (i = 0; ok && i < index->files->len; i++)
+	{
+		IndexFile *file = g_ptr_array_index(index->files, i);
+
+		ok = write_string(fp, file->path) &&
+			write_data(fp, &file->mtime, sizeof file->mtime) &&
+			write_data(fp, &file->size, sizeof file->size) &&
+			write_uint32(fp, file->indexed);
+	}
+
+	ok = ok && write_uint32(fp, g_hash_table_size(index->trigrams));
+	g_hash_table_iter_init(&iter, index->trigrams);
+	while (ok && g_hash_table_iter_next(&iter, &key, &value))
+	{
+		GArray *ids = value;
+
+		ok = write_uint32(fp, GPOINTER_TO_UINT(key)) &&
+			write_uint32(fp, ids->len) &&
+			write_data(fp, ids->data, ids->len * sizeof(guint32));
+	}
+
+	ok = (fclose(fp) == 0) && ok;
+	if (ok)
+		ok = g_rename(tmp_filename, filename) == 0;
+	if (! ok)
+	{
+		geany_debug("Could not write search index %s", filename);
+		g_unlink(tmp_filename);
+	}
+	g_free(tmp_filename);
+}
+
+
+static gboolean read_data(FILE *fp, gpointer data, gsize size)
+{
+	return fread(data, 1, size, fp) == size;
+}
+
+
+static gboolean read_uint32(FILE *fp, guint32 *value)
+{
+	return read_data(fp, value, sizeof *value);
+}
+
+
+static gchar *read_string(FILE *fp)
+{
+	guint32 len;
+	gchar *str;
+
+	if (! read_uint32(fp, &len) || len > INDEX_MAX_PATH_LENGTH)
+		return NULL;
+
+	str = g_malloc(len + 1);
+	if (! read_data(fp, str, len))
+	{
+		g_free(str);
+		return NULL;
+	}
+	str[len] = '\0';
+	return str;
+}
+
+
+/* Returns the saved index of base_path, or NULL if there is none or it is invalid. */
+static SearchIndex *index_load(const gchar *filename, const gchar *base_path)
+{
+	gchar header[sizeof INDEX_HEADER];
+	SearchIndex *index;
+	guint32 n_files = 0, n_trigrams = 0, i;
+	gchar *str;
+	gboolean ok;
+	FILE *fp;
+
+	fp = g_fopen(filename, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	index = index_new(base_path);
+	ok = read_data(fp, header, strlen(INDEX_HEADER)) &&
+		memcmp(header, INDEX_HEADER, strlen(INDEX_HEADER)) == 0;
+	if (ok)
+	{
+		str = read_string(fp);
+		ok = str != NULL && strcmp(str, base_path) == 0;
+		g_free(str);
+	}
+
+	ok = ok && read_uint32(fp, &n_files);
+	for (i = 0; ok && i < n_files; i++)
+	{
+		gint64 mtime, size;
+		guint32 indexed;
+
+		str = read_string(fp);
+		ok = str != NULL &&
+			read_data(fp, &mtime, sizeof mtime) &&
+			read_data(fp, &size, sizeof size) &&
+			read_uint32(fp, &indexed);
+		if (ok)
+			((IndexFile *) g_ptr_array_index(index->files,
+				index_add_file(index, str, mtime, size)))->indexed = indexed != 0;
+		else
+			g_free(str);
+	}
+
+	ok = ok && read_uint32(fp, &n_trigrams);
+	for (i = 0; ok && i < n_trigrams; i++)
+	{
+		guint32 trigram, count, j;
+		GArray *ids;
+
+		ok = read_uint32(fp, &trigram) && read_uint32(fp, &count) &&
+			trigram != 0 && trigram < TRIGRAM_COUNT && count <= n_files;
+		if (! ok)
+			break;
+
+		ids = g_array_sized_new(FALSE, FALSE, sizeof(guint32), count);
+		g_array_set_size(ids, count);
+		ok = read_data(fp, ids->data, count * sizeof(guint32));
+		for (j = 0; ok && j < count; j++)
+			ok = g_array_index(ids, guint32, j) < n_files;
+		g_hash_table_insert(index->trigrams, GUINT_TO_POINTER(trigram), ids);
+		index->size += TRIGRAM_OVERHEAD + count * sizeof(guint32);
+	}
+	fclose(fp);
+
+	if (! ok)
+	{
+		geany_debug("Ignoring invalid search index %s", filename);
+		index_unref(index);
+		return NULL;
+	}
+	return index;
+}
+
+
+static void index_refresh_free(IndexRefresh *refresh)
+{
+	if (refresh->old_index != NULL)
+		index_unref(refresh->old_index);
+	if (refresh->result != NULL)
+		index_unref(refresh->result);
+	g_free(refresh->base_path);
+	g_free(refresh->cache_file);
+	g_free(refresh);
+}
+
+
+static void start_refresh(gboolean load, gboolean verbose);
+
+static gboolean on_refresh_done(gpointer data)
+{
+	IndexRefresh *refresh = data;
+
+	g_thread_join(refresh->thread);
+
+	/* otherwise the refresh was cancelled */
+	if (refresh == current_refresh)
+	{
+		current_refresh = NULL;
+		if (current_index != NULL)
+			index_unref(current_index);
+		current_index = refresh->result;
+		refresh->result = NULL;
+
+		if (refresh->verbose)
+			ui_set_statusbar(FALSE, _("The search index of the project is ready (%u files)."),
+				current_index->files->len);
+		if (refresh_again)
+		{
+			refresh_again = FALSE;
+			start_refresh(FALSE, FALSE);
+		}
+	}
+	index_refresh_free(refresh);
+	return FALSE;
+}
+
+
+static gpointer refresh_thread_func(gpointer data)
+{
+	IndexRefresh *refresh = data;
+	SearchIndex *old = refresh->old_index;
+	SearchIndex *loaded = NULL;
+
+	if (old == NULL && refresh->load)
+		old = loaded = index_load(refresh->cache_file, refresh->base_path);
+
+	refresh->start_time = g_get_real_time();
+	refresh->result = index_update(refresh, old);
+	if (loaded != NULL)
+		index_unref(loaded);
+
+	if (! g_atomic_int_get(&refresh->cancelled))
+		index_save(refresh->result, refresh->cache_file);
+
+	g_idle_add(on_refresh_done, refresh);
+	return NULL;
+}
+
+
+/* Returns the locale encoded real path of the project base path, or NULL. */
+static gchar *get_base_path(void)
+{
+	gchar *utf8_base_path = project_get_base_path();
+	gchar *locale_base_path, *base_path;
+
+	if (utf8_base_path == NULL)
+		return NULL;
+
+	locale_base_path = utils_get_locale_from_utf8(utf8_base_path);
+	base_path = utils_get_real_path(locale_base_path);
+	g_free(locale_base_path);
+	g_free(utf8_base_path);
+
+	if (base_path != NULL && ! g_file_test(base_path, G_FILE_TEST_IS_DIR))
+	{
+		g_free(base_path);
+		return NULL;
+	}
+	return base_path;
+}
+
+
+static gchar *get_cache_file(const gchar *base_path)
+{
+	gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_MD5, base_path, -1);
+	gchar *name = g_strconcat(checksum, ".index", NULL);
+	gchar *filename = g_build_filename(app->configdir, "searchindex", name, NULL);
+
+	g_free(name);
+	g_free(checksum);
+	return filename;
+}
+
+
+static void start_refresh(gboolean load, gboolean verbose)
+{
+	IndexRefresh *refresh;
+	gchar *base_path;
+
+	if (current_refresh != NULL)
+	{
+		refresh_again = TRUE;
+		return;
+	}
+
+	base_path = get_base_path();
+	if (base_path == NULL)
+		return;
+
+	refresh = g_new0(IndexRefresh, 1);
+	refresh->base_path = base_path;
+	refresh->cache_file = get_cache_file(base_path);
+	if (current_index != NULL && utils_str_equal(current_index->base_path, base_path))
+		refresh->old_index = index_ref(current_index);
+	refresh->load = load;
+	refresh->verbose = verbose;
+	refresh->max_size = (gsize) MAX(search_prefs.search_index_max_size, 1) * 1024 * 1024;
+
+	current_refresh = refresh;
+	refresh->thread = g_thread_new("search-index", refresh_thread_func, refresh);
+}
+
+
+/* the cancelled refresh is freed by on_refresh_done() */
+static void cancel_refresh(void)
+{
+	if (refresh_source != 0)
+	{
+		g_source_remove(refresh_source);
+		refresh_source = 0;
+	}
+	refresh_again = FALSE;
+	if (current_refresh == NULL)
+		return;
+
+	g_atomic_int_set(&current_refresh->cancelled, TRUE);
+	current_refresh = NULL;
+}
+
+
+static void clear_index(void)
+{
+	cancel_refresh();
+	if (current_index != NULL)
+	{
+		index_unref(current_index);
+		current_index = NULL;
+	}
+}
+
+
+static gboolean on_refresh_timeout(gpointer data)
+{
+	refresh_source = 0;
+	start_refresh(FALSE, FALSE);
+	return FALSE;
+}
+
+
+static void on_project_open(GObject *obj, GKeyFile *config, gpointer user_data)
+{
+	clear_index();
+	if (search_prefs.use_search_index)
+		start_refresh(TRUE, FALSE);
+}
+
+
+static void on_project_close(GObject *obj, gpointer user_data)
+{
+	clear_index();
+}
+
+
+static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_data)
+{
+	const gchar *base_path;
+	gsize len;
+
+	if (current_index == NULL || doc->real_path == NULL)
+		return;
+
+	base_path = current_index->base_path;
+	len = strlen(base_path);
+	if (strncmp(doc->real_path, base_path, len) == 0 && doc->real_path[len] == G_DIR_SEPARATOR)
+	{
+		if (refresh_source != 0)
+			g_source_remove(refresh_source);
+		refresh_source = g_timeout_add(INDEX_REFRESH_DELAY, on_refresh_timeout, NULL);
+	}
+}
+
+
+/* Builds the index of the current project from scratch. */
+void search_index_rebuild(void)
+{
+	gchar *base_path;
+
+	if (app->project == NULL || (base_path = get_base_path()) == NULL)
+	{
+		ui_set_statusbar(FALSE, _("The search index needs an open project with a valid base path."));
+		return;
+	}
+
+	clear_index();
+	SETPTR(base_path, get_cache_file(base_path));
+	g_unlink(base_path);
+	g_free(base_path);
+
+	ui_set_statusbar(FALSE, _("Building the search index of the project..."));
+	start_refresh(FALSE, TRUE);
+}
+
+
+/* Returns a query for text in locale_dir, or NULL if the index can't be used for it.
+ * The query can be used from any thread. */
+SearchIndexQuery *search_index_query_new(const gchar *locale_dir, const gchar *text, gsize len)
+{
+	guint32 trigrams[INDEX_MAX_QUERY_TRIGRAMS];
+	SearchIndexQuery *query;
+	SearchIndex *index = current_index;
+	const gchar *prefix;
+	gchar *dir;
+	gsize base_len, i;
+	guint n = 0, j;
+
+	if (index == NULL || ! search_prefs.use_search_index || len < 3)
+		return NULL;
+
+	dir = utils_get_real_path(locale_dir);
+	base_len = strlen(index->base_path);
+	if (dir == NULL || strncmp(dir, index->base_path, base_len) != 0 ||
+		(dir[base_len] != '\0' && dir[base_len] != G_DIR_SEPARATOR))
+	{
+		g_free(dir);
+		return NULL;
+	}
+	prefix = dir + base_len;
+	while (*prefix == G_DIR_SEPARATOR)
+		prefix++;
+
+	for (i = 2; i < len && n < INDEX_MAX_QUERY_TRIGRAMS; i++)
+	{
+		guint32 trigram = 0;
+		gsize k;
+
+		for (k = i - 2; k <= i; k++)
+		{
+			if (text[k] == '\n' || text[k] == '\r' || text[k] == '\0')
+				break;
+			trigram = (trigram << 8) | (guchar) g_ascii_tolower(text[k]);
+		}
+		if (k <= i)
+			continue;
+		for (j = 0; j < n && trigrams[j] != trigram; j++);
+		if (j == n)
+			trigrams[n++] = trigram;
+	}
+	if (n == 0)
+	{
+		g_free(dir);
+		return NULL;
+	}
+
+	query = g_new(SearchIndexQuery, 1);
+	query->index = index_ref(index);
+	query->prefix = g_strdup(prefix);
+	query->counts = g_new0(guint8, MAX(index->files->len, 1));
+	query->n_trigrams = n;
+	g_free(dir);
+
+	/* a file contains all trigrams if it is in all their lists */
+	for (j = 0; j < n; j++)
+	{
+		GArray *ids = g_hash_table_lookup(index->trigrams, GUINT_TO_POINTER(trigrams[j]));
+		guint k;
+
+		if (ids == NULL)
+			break;
+		for (k = 0; k < ids->len; k++)
+		{
+			guint32 id = g_array_index(ids, guint32, k);
+
+			if (query->counts[id] == j)
+				query->counts[id]++;
+		}
+	}
+	return query;
+}
+
+
+/* Returns whether the file at rel_path, relative to the queried directory, can be
+ * skipped because it was indexed as it is and doesn't contain the text. */
+gboolean search_index_query_skip_file(SearchIndexQuery *query, const gchar *rel_path,
+		const GStatBuf *st)
+{
+	gchar *path = NULL;
+	gpointer value;
+	IndexFile *file;
+	guint32 id;
+
+	if (*query->prefix)
+		path = g_build_filename(query->prefix, rel_path, NULL);
+	value = g_hash_table_lookup(query->index->file_ids, path ? path : rel_path);
+	g_free(path);
+	if (value == NULL)
+		return FALSE;
+
+	id = GPOINTER_TO_UINT(value) - 1;
+	file = g_ptr_array_index(query->index->files, id);
+	return file->indexed && file->mtime == get_stat_mtime(st) && file->size == st->st_size &&
+		query->counts[id] < query->n_trigrams;
+}
+
+
+void search_index_query_free(SearchIndexQuery *query)
+{
+	index_unref(query->index);
+	g_free(query->counts);
+	g_free(query->prefix);
+	g_free(query);
+}
+
+
+void search_index_init(void)
+{
+	g_signal_connect(geany_object, "project-open", G_CALLBACK(on_project_open), NULL);
+	g_signal_connect(geany_object, "project-close", G_CALLBACK(on_project_close), NULL);
+	g_signal_connect(geany_object, "document-save", G_CALLBACK(on_document_save), NULL);
+}
+
+
+void search_index_finalize(void)
+{
+	clear_index();
+}
@@ -0,0 +1,47 @@
+/*
+ *      searchindex.h - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2026 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef GEANY_SEARCH_INDEX_H
+#define GEANY_SEARCH_INDEX_H 1
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+G_BEGIN_DECLS
+
+typedef struct SearchIndexQuery SearchIndexQuery;
+
+
+void search_index_init(void);
+
+void search_index_finalize(void);
+
+void search_index_rebuild(void);
+
+SearchIndexQuery *search_index_query_new(const gchar *locale_dir, const gchar *text, gsize len);
+
+gboolean search_index_query_skip_file(SearchIndexQuery *query, const gchar *rel_path,
+		const GStatBuf *st);
+
+void search_index_query_free(SearchIndexQuery *query);
+
+G_END_DECLS
+
+#endif /* GEANY_SEARCH_INDEX_H */
@@ -304,6 +304,14 @@ static gchar *create_statusbar_statistics(GeanyDocument *doc,
 				g_string_append_printf(stats_str, "%d",
 					sci_get_style_at(doc->editor->sci, pos));
 				break;
+			case 'U':
+			{
+				gchar *size = g_format_size((guint64) SSM(sci, SCI_GETUNDOMEMORY, 0, 0));
+
+				g_string_append(stats_str, size);
+				g_free(size);
+				break;
+			}
 			default:
 				g_string_append_len(stats_str, expos, 1);
 		}
@@ -2353,6 +2361,8 @@ void ui_init_prefs(void)
 		"msgwin_messages_visible", TRUE);
 	stash_group_add_boolean(group, &interface_prefs.msgwin_scribble_visible,
 		"msgwin_scribble_visible", TRUE);
+	stash_group_add_integer(group, &ui_prefs.msgwin_max_rows,
+		"msgwin_max_rows", 0);
 }
 
 
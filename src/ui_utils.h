@@ -165,6 +165,7 @@ typedef struct UIPrefs
 	gboolean	allow_always_save; /* if set, files can always be saved, even if unchanged */
 	gchar		*statusbar_template;
 	gboolean	new_document_after_close;
+	gint		msgwin_max_rows;	/* rows shown at once in the Compiler and Messages tabs, 0 for all */
 
 	/* Menu-item related data */
 	GQueue		*recent_queue;
@@ -0,0 +1,292 @@
+/*
+ *      wordindex.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2026 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Index of the words of a document, for document word autocompletion.
+ *
+ * A word is a maximal run of word characters, classified like Scintilla does for UTF-8
+ * documents: ASCII characters are word characters if they are in the wordchars the index was
+ * created with, other characters if they are Unicode letters, numbers or marks. Bytes which
+ * are not valid UTF-8 are classified as the Latin-1 character of the same value.
+ *
+ * The index keeps the number of occurrences of each word, in a hash table for updates and in
+ * a sequence sorted by strcmp() for prefix lookups. The caller adds and removes the words of
+ * text ranges starting and ending at word boundaries when the document changes, see
+ * editor.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "wordindex.h"
+
+#include <string.h>
+
+
+typedef struct WordEntry
+{
+	gchar *word;
+	guint count;
+}
+WordEntry;
+
+struct WordIndex
+{
+	gchar *wordchars;
+	gboolean ascii_word[128];
+	GHashTable *words;		/* word -> GSequenceIter of its WordEntry */
+	GSequence *sorted;		/* WordEntry, sorted by word */
+	GString *buffer;		/* for nul-terminating words */
+};
+
+
+static void word_entry_free(gpointer data)
+{
+	WordEntry *entry = data;
+
+	g_free(entry->word);
+	g_slice_free(WordEntry, entry);
+}
+
+
+static gint word_entry_cmp(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return strcmp(((const WordEntry *) a)->word, ((const WordEntry *) b)->word);
+}
+
+
+WordIndex *word_index_new(const gchar *wordchars)
+{
+	WordIndex *index = g_new0(WordIndex, 1);
+	const gchar *p;
+
+	index->wordchars = g_strdup(wordchars);
+	for (p = wordchars; *p; p++)
+	{
+		if ((guchar) *p < 128)
+			index->ascii_word[(guchar) *p] = TRUE;
+	}
+	/* the words are owned by the entries in the sequence */
+	index->words = g_hash_table_new(g_str_hash, g_str_equal);
+	index->sorted = g_sequence_new(word_entry_free);
+	index->buffer = g_string_new(NULL);
+	return index;
+}
+
+
+void word_index_free(WordIndex *index)
+{
+	g_return_if_fail(index != NULL);
+
+	g_hash_table_destroy(index->words);
+	g_sequence_free(index->sorted);
+	g_string_free(index->buffer, TRUE);
+	g_free(index->wordchars);
+	g_free(index);
+}
+
+
+const gchar *word_index_get_wordchars(WordIndex *index)
+{
+	return index->wordchars;
+}
+
+
+void word_index_clear(WordIndex *index)
+{
+	g_hash_table_remove_all(index->words);
+	g_sequence_remove_range(g_sequence_get_begin_iter(index->sorted),
+		g_sequence_get_end_iter(index->sorted));
+}
+
+
+static gboolean unichar_is_word(gunichar ch)
+{
+	switch (g_unichar_type(ch))
+	{
+		case G_UNICODE_LOWERCASE_LETTER:
+		case G_UNICODE_MODIFIER_LETTER:
+		case G_UNICODE_OTHER_LETTER:
+		case G_UNICODE_TITLECASE_LETTER:
+		case G_UNICODE_UPPERCASE_LETTER:
+		case G_UNICODE_DECIMAL_NUMBER:
+		case G_UNICODE_LETTER_NUMBER:
+		case G_UNICODE_OTHER_NUMBER:
+		case G_UNICODE_SPACING_MARK:
+		case G_UNICODE_ENCLOSING_MARK:
+		case G_UNICODE_NON_SPACING_MARK:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+
+/* Classifies the character at the start of text and sets its length in bytes, which is 1
+ * for invalid UTF-8 like Scintilla does */
+static gboolean char_is_word(WordIndex *index, const gchar *text, gsize len, gsize *char_len)
+{
+	guchar ch = (guchar) text[0];
+	gsize width;
+	gunichar uc;
+
+	*char_len = 1;
+	if (ch < 128)
+		return index->ascii_word[ch];
+
+	width = g_utf8_skip[ch];
+	if (width > 1 && width <= len)
+	{
+		uc = g_utf8_get_char_validated(text, width);
+		if (uc != (gunichar) -1 && uc != (gunichar) -2)
+		{
+			*char_len = width;
+			return unichar_is_word(uc);
+		}
+	}
+	return unichar_is_word(ch);
+}
+
+
+/* Whether text is a single character and a word character */
+gboolean word_index_is_word_char(WordIndex *index, const gchar *text, gsize len)
+{
+	gsize char_len;
+
+	return len > 0 && char_is_word(index, text, len, &char_len) && char_len == len;
+}
+
+
+/* Whether text only consists of word characters */
+gboolean word_index_is_word(WordIndex *index, const gchar *text, gsize len)
+{
+	gsize i, char_len;
+
+	for (i = 0; i < len; i += char_len)
+	{
+		if (! char_is_word(index, text + i, len - i, &char_len))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+static void add_word(WordIndex *index, const gchar *word)
+{
+	GSequenceIter *iter = g_hash_table_lookup(index->words, word);
+	WordEntry *entry;
+
+	if (iter != NULL)
+	{
+		entry = g_sequence_get(iter);
+		entry->count++;
+		return;
+	}
+	entry = g_slice_new(WordEntry);
+	entry->word = g_strdup(word);
+	entry->count = 1;
+	iter = g_sequence_insert_sorted(index->sorted, entry, word_entry_cmp, NULL);
+	g_hash_table_insert(index->words, entry->word, iter);
+}
+
+
+static void remove_word(WordIndex *index, const gchar *word)
+{
+	GSequenceIter *iter = g_hash_table_lookup(index->words, word);
+	WordEntry *entry;
+
+	g_return_if_fail(iter != NULL);
+
+	entry = g_sequence_get(iter);
+	if (--entry->count == 0)
+	{
+		g_hash_table_remove(index->words, word);
+		g_sequence_remove(iter);
+	}
+}
+
+
+static void scan_words(WordIndex *index, const gchar *text, gsize len,
+		void (*func)(WordIndex *index, const gchar *word))
+{
+	gsize i = 0, char_len;
+
+	while (i < len)
+	{
+		gsize start;
+
+		while (i < len && ! char_is_word(index, text + i, len - i, &char_len))
+			i += char_len;
+		start = i;
+		while (i < len && char_is_word(index, text + i, len - i, &char_len))
+			i += char_len;
+
+		if (i > start)
+		{
+			g_string_truncate(index->buffer, 0);
+			g_string_append_len(index->buffer, text + start, i - start);
+			func(index, index->buffer->str);
+		}
+	}
+}
+
+
+/* Adds the words of text, which must start and end at word boundaries */
+void word_index_add(WordIndex *index, const gchar *text, gsize len)
+{
+	scan_words(index, text, len, add_word);
+}
+
+
+/* Removes the words of text added before, which must start and end at word boundaries */
+void word_index_remove(WordIndex *index, const gchar *text, gsize len)
+{
+	scan_words(index, text, len, remove_word);
+}
+
+
+/* Adds the number of occurrences of each word longer than and starting with prefix to counts,
+ * which maps allocated words to counts */
+void word_index_find(WordIndex *index, const gchar *prefix, gsize prefix_len, GHashTable *counts)
+{
+	WordEntry key;
+	GSequenceIter *iter;
+
+	g_string_truncate(index->buffer, 0);
+	g_string_append_len(index->buffer, prefix, prefix_len);
+	key.word = index->buffer->str;
+
+	/* the words starting with prefix are sorted right after it */
+	iter = g_sequence_search(index->sorted, &key, word_entry_cmp, NULL);
+	for (; ! g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter))
+	{
+		WordEntry *entry = g_sequence_get(iter);
+		guint count;
+
+		if (strncmp(entry->word, prefix, prefix_len) != 0)
+			break;
+		if (entry->word[prefix_len] == '\0')
+			continue;
+
+		count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, entry->word));
+		g_hash_table_insert(counts, g_strdup(entry->word), GUINT_TO_POINTER(count + entry->count));
+	}
+}
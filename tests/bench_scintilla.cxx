@@ -0,0 +1,146 @@
+// Benchmarks of Geany's changes to Scintilla's plain text search and text insertion.
+// They are not run by "make check", build them with "make bench_scintilla" and run
+//   bench_scintilla find [8bit]   searching 20 MB documents like Find Next and Mark All
+//   bench_scintilla insert [unicode]   inserting 400 MB in 4 MiB pieces like loading a file
+// To compare with the previous code, build the program against each Scintilla version.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <random>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "CharacterCategory.h"
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+
+using namespace Scintilla;
+
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+static std::string RandomWords(const char *const words[], size_t nWords, size_t size) {
+	std::mt19937 rng(42);
+	std::string text;
+
+	while (text.size() < size)
+		text += words[rng() % nWords];
+	return text;
+}
+
+
+// Finds all matches of several strings with and without matching case.
+// The printed hash changes if any match position changes.
+static void BenchFind(bool utf8) {
+	static const char *const words[] = { "alpha ", "Beta ", "gamma\n", "DELTA ", "\xc3\xa9psilon ",
+		"\xce\xa9mega ", "xyzzy\r\n", "foo", "Foobar ", "\xc5\xbftra\xc3\x9f" "e " };
+	static const char *const needles[] = { "xyzzy", "Foobar", "foobar", "gamma\ndelta",
+		"\xcf\x89mega", "zzz", "ar \xc5\xbft", "STRASSE" };
+	static const int flagSets[] = { 0, SCFIND_MATCHCASE, SCFIND_WHOLEWORD,
+		SCFIND_MATCHCASE | SCFIND_WORDSTART };
+	const std::string text = RandomWords(words, sizeof(words) / sizeof(words[0]), 20000000);
+	Document doc(SC_DOCUMENTOPTION_DEFAULT);
+	unsigned long long hash = 0;
+
+	doc.dbcsCodePage = utf8 ? SC_CP_UTF8 : 0;
+	doc.InsertString(0, text.c_str(), text.length());
+	// put the gap in the middle, so searches cross it
+	doc.InsertString(text.length() / 2, "q", 1);
+	if (utf8) {
+		doc.SetCaseFolder(new CaseFolderUnicode());
+	} else {
+		CaseFolderTable *caseFolder = new CaseFolderTable();
+		caseFolder->StandardASCII();
+		doc.SetCaseFolder(caseFolder);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (const char *needle : needles) {
+		for (const int flags : flagSets) {
+			const auto needleStart = std::chrono::steady_clock::now();
+			Sci::Position pos = 0;
+			long count = 0;
+
+			for (;;) {
+				Sci::Position length = strlen(needle);
+				const Sci::Position found = doc.FindText(pos, doc.Length(), needle, flags, &length);
+				if (found < 0)
+					break;
+				count++;
+				hash = hash * 31 + found + length;
+				pos = found + length;
+			}
+			printf("\"%s\" flags %x: %ld matches in %.3f s\n", needle, flags, count,
+				SecondsSince(needleStart));
+		}
+	}
+	printf("hash %llu, total %.3f s\n", hash, SecondsSince(start));
+}
+
+
+// Inserts text into a CellBuffer like Geany loads large files, best of 3 runs
+static void BenchInsert(bool unicodeLineEnds) {
+	static const char *const words[] = { "alpha ", "beta ", "gamma ", "delta ", "x = y + 1; ",
+		"if (a) { ", "}\n", "\treturn b;\n", "foo(bar);\r\n" };
+	const std::string text = RandomWords(words, sizeof(words) / sizeof(words[0]), 400000000);
+	const size_t pieceSize = 4 * 1024 * 1024;
+	double best = 1e9;
+	Sci::Line lines = 0;
+
+	for (int run = 0; run < 3; run++) {
+		CellBuffer cb(true, false, false);
+		bool startSequence = false;
+
+		cb.SetUndoCollection(false);
+		cb.SetUTF8Substance(true);
+		cb.SetLineEndTypes(unicodeLineEnds ? SC_LINE_END_TYPE_UNICODE : SC_LINE_END_TYPE_DEFAULT);
+		cb.Allocate(text.length() + 1);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t offset = 0; offset < text.length(); offset += pieceSize) {
+			const size_t length = std::min(pieceSize, text.length() - offset);
+			cb.InsertString(cb.Length(), text.data() + offset, length, startSequence);
+		}
+		best = std::min(best, SecondsSince(start));
+		lines = cb.Lines();
+	}
+	printf("%zu bytes, %ld lines, best %.3f s\n", text.length(), static_cast<long>(lines), best);
+}
+
+
+int main(int argc, char **argv) {
+	if (argc >= 2 && strcmp(argv[1], "find") == 0) {
+		BenchFind(argc < 3 || strcmp(argv[2], "8bit") != 0);
+	} else if (argc >= 2 && strcmp(argv[1], "insert") == 0) {
+		BenchInsert(argc >= 3 && strcmp(argv[2], "unicode") == 0);
+	} else {
+		fprintf(stderr, "Usage: %s find [8bit] | insert [unicode]\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
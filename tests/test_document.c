@@ -0,0 +1,344 @@
+
+#include "document.h"
+
+#include "gtkcompat.h"
+
+#include <string.h>
+
+#define DOC_TEST_ADD(path, func) g_test_add_func("/document/" path, func);
+
+
+static gboolean detect_type(const gchar *text, gint tab_width, gint indent_width,
+		GeanyIndentType *type)
+{
+	return document_detect_indent_type_from_text(text, strlen(text), G_MAXINT, tab_width,
+		indent_width, type);
+}
+
+
+static gboolean detect_width(const gchar *text, gint *width)
+{
+	return document_detect_indent_width_from_text(text, strlen(text), G_MAXINT, width);
+}
+
+
+static const gchar *corpus_tabs =
+	"int main(void)\n"
+	"{\n"
+	"\tif (x)\n"
+	"\t{\n"
+	"\t\tfoo();\n"
+	"\t\tbar(a, b);\n"
+	"\t}\n"
+	"\treturn 0;\n"
+	"}\n";
+
+static const gchar *corpus_spaces_4 =
+	"class Foo:\n"
+	"    \"\"\"Does things.\"\"\"\n"
+	"\n"
+	"    def bar(self):\n"
+	"        if self.x:\n"
+	"            return 1\n"
+	"        return 0\n"
+	"\n"
+	"    def baz(self):\n"
+	"        pass\n";
+
+static const gchar *corpus_spaces_2 =
+	"function foo(a) {\n"
+	"  if (a) {\n"
+	"    return {\n"
+	"      b: 1,\n"
+	"    };\n"
+	"  }\n"
+	"  return null;\n"
+	"}\n";
+
+/* GNU style, indented by 2 with 8 spaces replaced by a tab */
+static const gchar *corpus_tabs_and_spaces =
+	"int\n"
+	"main (void)\n"
+	"{\n"
+	"  if (x)\n"
+	"    {\n"
+	"      foo ();\n"
+	"\tbar ();\n"
+	"\tif (y)\n"
+	"\t  baz ();\n"
+	"\t  qux ();\n"
+	"    }\n"
+	"}\n";
+
+/* comment continuation lines don't count for the width */
+static const gchar *corpus_comments =
+	"    /* A long comment\n"
+	"     * over\n"
+	"     * many\n"
+	"     * lines\n"
+	"     * that\n"
+	"     * are\n"
+	"     * misaligned\n"
+	"     */\n"
+	"    foo();\n"
+	"        bar();\n";
+
+
+static void test_document_detect_indent_type(void)
+{
+	GeanyIndentType type;
+
+	g_assert_true(detect_type(corpus_tabs, 8, 4, &type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_TABS);
+
+	g_assert_true(detect_type(corpus_spaces_4, 8, 4, &type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_SPACES);
+
+	g_assert_true(detect_type(corpus_spaces_2, 8, 4, &type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_SPACES);
+
+	/* found from the lines with tabs then a soft tab */
+	g_assert_true(detect_type(corpus_tabs_and_spaces, 8, 2, &type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_BOTH);
+
+	g_assert_false(detect_type("", 8, 4, &type));
+	g_assert_false(detect_type("foo\nbar\n baz\n", 8, 4, &type));
+}
+
+
+static void test_document_detect_indent_width(void)
+{
+	gint width;
+
+	g_assert_true(detect_width(corpus_spaces_4, &width));
+	g_assert_cmpint(width, ==, 4);
+
+	g_assert_true(detect_width(corpus_spaces_2, &width));
+	g_assert_cmpint(width, ==, 2);
+
+	g_assert_true(detect_width(corpus_comments, &width));
+	g_assert_cmpint(width, ==, 4);
+
+	g_assert_false(detect_width("", &width));
+	g_assert_false(detect_width("foo\n bar\n", &width));
+	/* deeper than 24 is alignment */
+	g_assert_false(detect_width("foo(a,\n                          b);\n", &width));
+}
+
+
+static void test_document_detect_indent_line_ends(void)
+{
+	const gchar *corpora[] = { corpus_tabs, corpus_spaces_4, corpus_spaces_2,
+		corpus_tabs_and_spaces, corpus_comments };
+	const gchar *line_ends[] = { "\r\n", "\r" };
+	guint i, j;
+
+	for (i = 0; i < G_N_ELEMENTS(corpora); i++)
+	{
+		GeanyIndentType type, expected_type;
+		gint width, expected_width;
+		gboolean expected_type_found = detect_type(corpora[i], 8, 2, &expected_type);
+		gboolean expected_width_found = detect_width(corpora[i], &expected_width);
+
+		for (j = 0; j < G_N_ELEMENTS(line_ends); j++)
+		{
+			gchar **lines = g_strsplit(corpora[i], "\n", -1);
+			gchar *text = g_strjoinv(line_ends[j], lines);
+
+			g_assert_cmpint(detect_type(text, 8, 2, &type), ==, expected_type_found);
+			if (expected_type_found)
+				g_assert_cmpint(type, ==, expected_type);
+			g_assert_cmpint(detect_width(text, &width), ==, expected_width_found);
+			if (expected_width_found)
+				g_assert_cmpint(width, ==, expected_width);
+
+			g_free(text);
+			g_strfreev(lines);
+		}
+	}
+}
+
+
+static void test_document_detect_indent_line_count(void)
+{
+	const gchar *text = "a\n    b\n    c\n"
+		"\td\n\te\n\tf\n\tg\n\th\n\ti\n\tj\n\tk\n\tl\n\tm\n";
+	GeanyIndentType type;
+	gint width;
+
+	g_assert_true(document_detect_indent_type_from_text(text, strlen(text), 3, 8, 4, &type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_SPACES);
+	g_assert_true(document_detect_indent_type_from_text(text, strlen(text), G_MAXINT, 8, 4,
+		&type));
+	g_assert_cmpint(type, ==, GEANY_INDENT_TYPE_TABS);
+
+	g_assert_true(document_detect_indent_width_from_text(text, strlen(text), 3, &width));
+	g_assert_cmpint(width, ==, 4);
+	g_assert_false(document_detect_indent_width_from_text(text, strlen(text), 1, &width));
+}
+
+
+/* Gets the indentation of line like SCI_GETLINEINDENTATION */
+static gint ref_line_indentation(const gchar *line, gint tab_width)
+{
+	gint indent = 0;
+
+	for (; *line == ' ' || *line == '\t'; line++)
+	{
+		if (*line == '\t')
+			indent = (indent / tab_width + 1) * tab_width;
+		else
+			indent++;
+	}
+	return indent;
+}
+
+
+/* The detection of the indent type when it got every line from Scintilla and searched
+ * tabs then spaces with a regex */
+static gboolean ref_detect_indent_type(gchar **lines, gint tab_width, gint indent_width,
+		GeanyIndentType *type)
+{
+	guint line_count = g_strv_length(lines);
+	gchar *regex = g_strdup_printf("^\t+ {%d}[^ ]", indent_width);
+	gsize tabs_and_spaces = 0, tabs = 0, spaces = 0;
+	guint i;
+
+	for (i = 0; i < line_count; i++)
+	{
+		if (g_regex_match_simple(regex, lines[i], 0, 0))
+			tabs_and_spaces++;
+	}
+	g_free(regex);
+	if (tabs_and_spaces > line_count * 0.02)
+	{
+		*type = GEANY_INDENT_TYPE_BOTH;
+		return TRUE;
+	}
+
+	for (i = 0; i < line_count; i++)
+	{
+		if (ref_line_indentation(lines[i], tab_width) > 24)
+			continue;
+		if (lines[i][0] == '\t')
+			tabs++;
+		else if (lines[i][0] == ' ' && lines[i][1] == ' ')
+			spaces++;
+	}
+	if (spaces == 0 && tabs == 0)
+		return FALSE;
+
+	if (spaces > tabs * 4)
+		*type = GEANY_INDENT_TYPE_SPACES;
+	else if (tabs > spaces * 4)
+		*type = GEANY_INDENT_TYPE_TABS;
+	else
+		*type = GEANY_INDENT_TYPE_BOTH;
+	return TRUE;
+}
+
+
+/* The detection of the indent width when it got every line from Scintilla */
+static gboolean ref_detect_indent_width(gchar **lines, gint *width_)
+{
+	gint widths[7] = { 0 };
+	gint count = 0, width = 0;
+	gint i;
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		gint line_width = ref_line_indentation(lines[i], 8);
+		gint j;
+
+		if (lines[i][strspn(lines[i], " \t")] == '*' || line_width > 24 || line_width < 2)
+			continue;
+		for (j = G_N_ELEMENTS(widths) - 1; j >= 0; j--)
+		{
+			if ((line_width % (j + 2)) == 0)
+				widths[j]++;
+		}
+	}
+	for (i = G_N_ELEMENTS(widths) - 1; i >= 0; i--)
+	{
+		if (widths[i] >= count * 1.5)
+		{
+			width = i + 2;
+			count = widths[i];
+		}
+	}
+	if (count == 0)
+		return FALSE;
+
+	*width_ = width;
+	return TRUE;
+}
+
+
+static gchar *random_text(void)
+{
+	static const gchar *indents[] = { "\t", " ", "  ", "    ", "        " };
+	static const gchar *contents[] = { "", "x", "* x", "*", " ", "foo(bar);" };
+	static const gchar *line_ends[] = { "\n", "\r\n", "\r" };
+	/* mostly one indent, so that the detection often succeeds */
+	const gchar *indent = indents[g_test_rand_int_range(0, G_N_ELEMENTS(indents))];
+	GString *text = g_string_new(NULL);
+	gint n_lines = g_test_rand_int_range(0, 60);
+	gint i, j;
+
+	for (i = 0; i < n_lines; i++)
+	{
+		gint depth = g_test_rand_int_range(0, 5);
+
+		for (j = 0; j < depth; j++)
+		{
+			if (g_test_rand_int_range(0, 5) == 0)
+				g_string_append(text, indents[g_test_rand_int_range(0, G_N_ELEMENTS(indents))]);
+			else
+				g_string_append(text, indent);
+		}
+		g_string_append(text, contents[g_test_rand_int_range(0, G_N_ELEMENTS(contents))]);
+		if (i < n_lines - 1 || g_test_rand_bit())
+			g_string_append(text, line_ends[g_test_rand_int_range(0, G_N_ELEMENTS(line_ends))]);
+	}
+	return g_string_free(text, FALSE);
+}
+
+
+/* The scan of the text finds the same indentation as getting every line from Scintilla did */
+static void test_document_detect_indent_equivalence(void)
+{
+	gint i;
+
+	for (i = 0; i < 2000; i++)
+	{
+		gchar *text = random_text();
+		gchar **lines = g_regex_split_simple("\r\n|\r|\n", text, 0, 0);
+		gint tab_width = g_test_rand_int_range(1, 9);
+		gint indent_width = g_test_rand_int_range(1, 9);
+		GeanyIndentType type = GEANY_INDENT_TYPE_SPACES, ref_type = GEANY_INDENT_TYPE_SPACES;
+		gint width = 0, ref_width = 0;
+
+		g_assert_cmpint(detect_type(text, tab_width, indent_width, &type), ==,
+			ref_detect_indent_type(lines, tab_width, indent_width, &ref_type));
+		g_assert_cmpint(type, ==, ref_type);
+		g_assert_cmpint(detect_width(text, &width), ==, ref_detect_indent_width(lines, &ref_width));
+		g_assert_cmpint(width, ==, ref_width);
+
+		g_strfreev(lines);
+		g_free(text);
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	DOC_TEST_ADD("detect_indent_type", test_document_detect_indent_type);
+	DOC_TEST_ADD("detect_indent_width", test_document_detect_indent_width);
+	DOC_TEST_ADD("detect_indent_line_ends", test_document_detect_indent_line_ends);
+	DOC_TEST_ADD("detect_indent_line_count", test_document_detect_indent_line_count);
+	DOC_TEST_ADD("detect_indent_equivalence", test_document_detect_indent_equivalence);
+
+	return g_test_run();
+}
@@ -0,0 +1,370 @@
+// Tests of Geany's changes to Scintilla, comparing them to the upstream code they stand in for
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <algorithm>
+#include <memory>
+
+#include <glib.h>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "CharacterCategory.h"
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "ChunkedVector.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+
+using namespace Scintilla;
+
+#define SCI_TEST_ADD(path, func) g_test_add_func("/scintilla/" path, func);
+
+
+static std::string RandomText(const char *chars, int maxLength) {
+	std::string text;
+	const int length = g_test_rand_int_range(0, maxLength + 1);
+	for (int i = 0; i < length; i++)
+		text += chars[g_test_rand_int_range(0, strlen(chars))];
+	return text;
+}
+
+
+template <typename T>
+static void AssertSameElements(ChunkedVector<T> &chunked, SplitVector<T> &split) {
+	const ptrdiff_t length = split.Length();
+	std::vector<T> elements(length);
+
+	g_assert_cmpint(chunked.Length(), ==, length);
+	chunked.GetRange(elements.data(), 0, length);
+	g_assert_true(std::equal(elements.begin(), elements.end(), split.BufferPointer()));
+	g_assert_cmpint(chunked.ValueAt(-1), ==, split.ValueAt(-1));
+	g_assert_cmpint(chunked.ValueAt(length), ==, split.ValueAt(length));
+
+	if (length > 0) {
+		const ptrdiff_t start = g_test_rand_int_range(0, length);
+		const ptrdiff_t rangeLength = g_test_rand_int_range(0, length - start + 1);
+		const T *range = chunked.RangePointer(start, rangeLength);
+
+		g_assert_cmpint(chunked.ValueAt(start), ==, split.ValueAt(start));
+		g_assert_true(std::equal(range, range + rangeLength, split.RangePointer(start, rangeLength)));
+		g_assert_cmpint(chunked.ContiguousEnd(start), >, start);
+		g_assert_cmpint(chunked.ContiguousEnd(start), <=, length);
+	}
+	if (g_test_rand_bit()) {
+		const T *buffer = chunked.BufferPointer();
+
+		g_assert_true(std::equal(buffer, buffer + length, split.BufferPointer()));
+		if (g_test_rand_bit())
+			chunked.ReleaseBufferPointer();
+	}
+}
+
+
+// ChunkedVector keeps the same elements as the SplitVector it replaces for large documents
+static void test_chunked_vector(void) {
+	for (int round = 0; round < 20; round++) {
+		ChunkedVector<char> chunked;
+		SplitVector<char> split;
+
+		for (int step = 0; step < 200; step++) {
+			const ptrdiff_t length = split.Length();
+			const ptrdiff_t position = g_test_rand_int_range(0, length + 1);
+
+			switch (g_test_rand_int_range(0, 6)) {
+			case 0:
+			case 1: {
+				// insertions both small and across several chunks
+				const int maxInsert = g_test_rand_bit() ? 100 : 300000;
+				const std::string s = RandomText("abcdefgh\n", maxInsert);
+				chunked.InsertFromArray(position, s.c_str(), 0, s.length());
+				split.InsertFromArray(position, s.c_str(), 0, s.length());
+				break;
+			}
+			case 2: {
+				const ptrdiff_t insertLength = g_test_rand_int_range(0, 100000);
+				chunked.InsertValue(position, insertLength, 'x');
+				split.InsertValue(position, insertLength, 'x');
+				break;
+			}
+			case 3:
+			case 4: {
+				const ptrdiff_t deleteLength = g_test_rand_int_range(0, length - position + 1);
+				chunked.DeleteRange(position, deleteLength);
+				split.DeleteRange(position, deleteLength);
+				break;
+			}
+			default:
+				if (position < length) {
+					chunked.SetValueAt(position, 'S');
+					split.SetValueAt(position, 'S');
+				} else if (g_test_rand_int_range(0, 20) == 0) {
+					chunked.DeleteAll();
+					split.DeleteAll();
+				}
+				break;
+			}
+			AssertSameElements(chunked, split);
+		}
+	}
+}
+
+
+static std::string GetText(CellBuffer &cb) {
+	std::string text(cb.Length(), '\0');
+	cb.GetCharRange(&text[0], 0, cb.Length());
+	return text;
+}
+
+
+// Dropping the oldest undo actions keeps the undo memory under its limit, and the kept
+// actions still undo to the text as it was before them
+static void test_undo_memory_limit(void) {
+	const size_t limit = 100000;
+	CellBuffer cb(true, false, false);
+	std::vector<std::string> texts;
+	bool startSequence = false;
+
+	cb.SetUndoMemoryLimit(limit);
+	g_assert_cmpuint(cb.GetUndoMemoryLimit(), ==, limit);
+
+	for (int i = 0; i < 20000; i++) {
+		const Sci::Position length = cb.Length();
+		const Sci::Position position = g_test_rand_int_range(0, length + 1);
+
+		texts.push_back(GetText(cb));
+		if (length > 0 && g_test_rand_int_range(0, 3) == 0) {
+			const Sci::Position deleteLength = g_test_rand_int_range(1,
+				std::min<Sci::Position>(length - position, 50) + 1);
+			if (position < length)
+				cb.DeleteChars(position, deleteLength, startSequence);
+			else
+				texts.pop_back();
+		} else {
+			const std::string s = RandomText("ab\n", 50) + "c";
+			cb.InsertString(position, s.c_str(), s.length(), startSequence);
+		}
+		// every action is its own undo step
+		cb.BeginUndoAction();
+		cb.EndUndoAction();
+		g_assert_cmpuint(cb.GetUndoMemory(), <=, limit);
+	}
+
+	// about half the memory is kept, and undoing restores each text before that
+	size_t steps = 0;
+	while (cb.CanUndo()) {
+		const int actions = cb.StartUndo();
+		for (int i = 0; i < actions; i++)
+			cb.PerformUndoStep();
+		steps++;
+		g_assert_true(GetText(cb) == texts[texts.size() - steps]);
+	}
+	g_assert_cmpuint(steps, >, 100);
+	g_assert_cmpuint(steps, <, texts.size());
+	g_assert_cmpuint(cb.GetUndoMemory(), <=, limit);
+}
+
+
+static std::string RandomPattern() {
+	static const char *atoms[] = { "a", "b", "A", ".", "[ab]", "[^a]", "\\w", "\\s", "_", "x",
+		"[a-b]", "\\d", "1", "\\." };
+	std::string pattern;
+
+	if (g_test_rand_int_range(0, 5) == 0)
+		pattern += "^";
+	const int n = g_test_rand_int_range(1, 6);
+	bool group = false;
+	for (int i = 0; i < n; i++) {
+		if (!group && g_test_rand_int_range(0, 6) == 0) {
+			pattern += "\\(";
+			group = true;
+		}
+		if (g_test_rand_int_range(0, 10) == 0)
+			pattern += "\\<";
+		pattern += atoms[g_test_rand_int_range(0, G_N_ELEMENTS(atoms))];
+		// no "?", which RESearch treats like "*" after character classes
+		switch (g_test_rand_int_range(0, 7)) {
+		case 0: pattern += "*"; break;
+		case 1: pattern += "+"; break;
+		case 2: pattern += "*?"; break;
+		case 3: pattern += "+?"; break;
+		}
+		if (g_test_rand_int_range(0, 10) == 0)
+			pattern += "\\>";
+		if (group && g_test_rand_int_range(0, 3) == 0) {
+			pattern += "\\)";
+			group = false;
+		}
+	}
+	if (group)
+		pattern += "\\)";
+	// RESearch makes a lazy closure at the end of the pattern greedy
+	if (pattern.back() == '?')
+		pattern.pop_back();
+	if (g_test_rand_int_range(0, 5) == 0)
+		pattern += "$";
+	return pattern;
+}
+
+
+struct RegexMatch {
+	Sci::Position position;
+	Sci::Position length;
+	std::string substitution;
+};
+
+
+static RegexMatch FindRegex(Document &doc, Sci::Position minPos, Sci::Position maxPos,
+	const std::string &pattern, int flags, bool substitute) {
+	RegexMatch match;
+
+	match.length = pattern.length();
+	match.position = doc.FindText(minPos, maxPos, pattern.c_str(), SCFIND_REGEXP | flags,
+		&match.length);
+	if (match.position >= 0 && substitute) {
+		Sci::Position length = 9;
+		const char *substitution = doc.SubstituteByPosition("<\\0|\\1>", &length);
+		match.substitution.assign(substitution, length);
+	}
+	return match;
+}
+
+
+// SCFIND_LINEARREGEX finds the same matches and tags as RESearch, except where RESearch
+// misses matches
+static void test_linear_regex(void) {
+	for (int i = 0; i < 20000; i++) {
+		Document doc(SC_DOCUMENTOPTION_DEFAULT);
+		const std::string text = RandomText("ab \r\nAx_1.", 30);
+		const std::string pattern = RandomPattern();
+		const int flags = g_test_rand_bit() ? SCFIND_MATCHCASE : 0;
+
+		doc.InsertString(0, text.c_str(), text.length());
+		Sci::Position minPos = g_test_rand_int_range(0, doc.Length() + 1);
+		Sci::Position maxPos = g_test_rand_int_range(0, doc.Length() + 1);
+		// the range is whole lines, as RESearch takes its ends as the ends of the text for
+		// ^, $, \< and \>, while SCFIND_LINEARREGEX looks at the text around them
+		if (g_test_rand_bit())
+			std::swap(minPos, maxPos);
+		const Sci::Line startLine = doc.SciLineFromPosition(std::min(minPos, maxPos));
+		const Sci::Line endLine = doc.SciLineFromPosition(std::max(minPos, maxPos));
+		if (minPos <= maxPos) {
+			minPos = doc.LineStart(startLine);
+			maxPos = doc.LineEnd(endLine);
+		} else {
+			minPos = doc.LineEnd(endLine);
+			maxPos = doc.LineStart(startLine);
+		}
+
+		// a backward search looks for later matches on a line from the position after the
+		// previous one, where RESearch takes \< and \> to match like at the start of the line
+		if (minPos > maxPos && (pattern.find("\\<") != std::string::npos ||
+			pattern.find("\\>") != std::string::npos))
+			continue;
+
+		// RESearch keeps the tags of its last failed attempt after a backward search, which
+		// looks for a later match on the line, and after a lazy closure, which tries shorter
+		// repetitions after the one matching, so only compare the other substitutions
+		const bool compareTags = minPos <= maxPos && pattern.find("?") == std::string::npos;
+		const RegexMatch expected = FindRegex(doc, minPos, maxPos, pattern, flags, compareTags);
+		const RegexMatch match = FindRegex(doc, minPos, maxPos, pattern, flags | SCFIND_LINEARREGEX,
+			compareTags);
+		// RESearch never tries to match at the end of a line, which misses empty matches
+		// there, like "x*$" in "ab"
+		if (match.position >= 0 && match.length == 0 &&
+			match.position == doc.LineEnd(doc.SciLineFromPosition(match.position)))
+			continue;
+		if (match.position != expected.position || (expected.position >= 0 &&
+			(match.length != expected.length ||
+			match.substitution != expected.substitution))) {
+			g_test_message("pattern \"%s\" in \"%s\" from %d to %d", pattern.c_str(),
+				g_strescape(text.c_str(), NULL), (int) minPos, (int) maxPos);
+		}
+		g_assert_cmpint(match.position, ==, expected.position);
+		if (expected.position >= 0) {
+			g_assert_cmpint(match.length, ==, expected.length);
+			g_assert_cmpstr(match.substitution.c_str(), ==, expected.substitution.c_str());
+		}
+	}
+}
+
+
+// Cases where SCFIND_LINEARREGEX agrees with RESearch, and where it deliberately differs
+static void test_linear_regex_cases(void) {
+	static const struct {
+		const char *text;
+		const char *pattern;
+		int flags;
+	} same[] = {
+		{ "foo=bar", "\\([a-z]+\\)=\\([a-z]+\\)", 0 },
+		{ "xx Abc abc", "\\<abc", SCFIND_MATCHCASE },
+		{ "xx Abc abc", "\\<abc", 0 },
+		{ "a.b\naab", "^a+b$", 0 },
+		{ "12 ab_3", "\\w+\\d", 0 },
+		{ "a\r\nb", "[^a]", SCFIND_MATCHCASE },
+	};
+	Document doc(SC_DOCUMENTOPTION_DEFAULT);
+	RegexMatch expected, match;
+
+	for (const auto &test : same) {
+		doc.DeleteChars(0, doc.Length());
+		doc.InsertString(0, test.text, strlen(test.text));
+		expected = FindRegex(doc, 0, doc.Length(), test.pattern, test.flags, true);
+		match = FindRegex(doc, 0, doc.Length(), test.pattern, test.flags | SCFIND_LINEARREGEX, true);
+		g_assert_cmpint(expected.position, >=, 0);
+		g_assert_cmpint(match.position, ==, expected.position);
+		g_assert_cmpint(match.length, ==, expected.length);
+		g_assert_cmpstr(match.substitution.c_str(), ==, expected.substitution.c_str());
+	}
+
+	// back references are not supported, so the pattern is rejected
+	doc.DeleteChars(0, doc.Length());
+	doc.InsertString(0, "xaa", 3);
+	expected = FindRegex(doc, 0, doc.Length(), "\\(a\\)\\1", 0, false);
+	g_assert_cmpint(expected.position, ==, 1);
+	match = FindRegex(doc, 0, doc.Length(), "\\(a\\)\\1", SCFIND_LINEARREGEX, false);
+	g_assert_cmpint(match.position, <, 0);
+
+	// "?" after a character class matches at most once, where RESearch repeats it
+	doc.DeleteChars(0, doc.Length());
+	doc.InsertString(0, "aab", 3);
+	match = FindRegex(doc, 0, doc.Length(), "[ab]?b", SCFIND_LINEARREGEX, false);
+	g_assert_cmpint(match.position, ==, 1);
+	g_assert_cmpint(match.length, ==, 2);
+
+	// a pattern that backtracks exponentially finishes quickly on a long line
+	const std::string line(100000, 'a');
+	doc.DeleteChars(0, doc.Length());
+	doc.InsertString(0, line.c_str(), line.length());
+	match = FindRegex(doc, 0, doc.Length(), "\\(a*\\)*a*a*b", SCFIND_LINEARREGEX, false);
+	g_assert_cmpint(match.position, <, 0);
+}
+
+
+int main(int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	SCI_TEST_ADD("chunked_vector", test_chunked_vector);
+	SCI_TEST_ADD("undo_memory_limit", test_undo_memory_limit);
+	SCI_TEST_ADD("linear_regex", test_linear_regex);
+	SCI_TEST_ADD("linear_regex_cases", test_linear_regex_cases);
+
+	return g_test_run();
+}
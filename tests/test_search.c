@@ -0,0 +1,57 @@
+#include "search.h"
+
+#include "gtkcompat.h"
+
+#define SEARCH_TEST_ADD(path, func) g_test_add_func("/search/" path, func);
+
+
+static void test_search_regex_is_line_safe(void)
+{
+	g_assert_true(search_regex_is_line_safe(""));
+	g_assert_true(search_regex_is_line_safe("foo"));
+	g_assert_true(search_regex_is_line_safe("^\\s*foo(bar|baz)+$"));
+	g_assert_true(search_regex_is_line_safe("a{2,3}b*?c+"));
+	g_assert_true(search_regex_is_line_safe("\\\\K"));
+	g_assert_true(search_regex_is_line_safe("(?i)foo"));
+	g_assert_true(search_regex_is_line_safe("(?:foo)"));
+	g_assert_true(search_regex_is_line_safe("(?<name>foo)"));
+}
+
+
+static void test_search_regex_is_line_safe_rejects(void)
+{
+	/* assertions looking past the edges of the subject */
+	g_assert_false(search_regex_is_line_safe("\\Afoo"));
+	g_assert_false(search_regex_is_line_safe("foo\\z"));
+	g_assert_false(search_regex_is_line_safe("foo\\Z"));
+	g_assert_false(search_regex_is_line_safe("\\Gfoo"));
+	/* match start reset, e.g. finds "y" in "x\ny" when applied to both lines */
+	g_assert_false(search_regex_is_line_safe("x\\s\\Ky|x"));
+	/* verbs */
+	g_assert_false(search_regex_is_line_safe("(*CRLF)foo"));
+	/* lookahead, lookbehind and atomic groups */
+	g_assert_false(search_regex_is_line_safe("foo(?=bar)"));
+	g_assert_false(search_regex_is_line_safe("foo(?!bar)"));
+	g_assert_false(search_regex_is_line_safe("(?<=foo)bar"));
+	g_assert_false(search_regex_is_line_safe("(?<!foo)bar"));
+	g_assert_false(search_regex_is_line_safe("(?>foo|foob)ar"));
+	/* possessive quantifiers */
+	g_assert_false(search_regex_is_line_safe("a*+b"));
+	g_assert_false(search_regex_is_line_safe("a++b"));
+	g_assert_false(search_regex_is_line_safe("a?+b"));
+	g_assert_false(search_regex_is_line_safe("a{2}+b"));
+	/* option settings changing what ^ and $ match */
+	g_assert_false(search_regex_is_line_safe("(?m)^foo"));
+	g_assert_false(search_regex_is_line_safe("(?i-m)^foo"));
+}
+
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	SEARCH_TEST_ADD("regex_is_line_safe", test_search_regex_is_line_safe);
+	SEARCH_TEST_ADD("regex_is_line_safe_rejects", test_search_regex_is_line_safe_rejects);
+
+	return g_test_run();
+}